@@ -0,0 +1,108 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Cost of an access log line on the request threads: the batched access log
+// compared with a synchronous spdlog file logger.
+
+#include <boost/winasio/http/http_access_log.hpp>
+
+#include <spdlog/sinks/basic_file_sink.h>
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace winnet = boost::winasio;
+using namespace std::chrono_literals;
+using bench_clock = std::chrono::steady_clock;
+
+const int threads = 4;
+const int records_per_thread = 200'000;
+// 200k requests/s per thread.
+const auto request_gap = 5us;
+
+winnet::http::access_log_record make_record() {
+  winnet::http::access_log_record r;
+  r.time = std::chrono::system_clock::now();
+  r.family = 4;
+  r.address = {127, 0, 0, 1};
+  r.port = 5000;
+  r.verb = "GET";
+  r.set_path("/api/items?id=12345");
+  r.status = 200;
+  r.request_bytes = 0;
+  r.response_bytes = 1024;
+  r.latency = 250us;
+  return r;
+}
+
+// busy loop between records, like a server handling requests.
+void spin_for(bench_clock::duration d) {
+  auto end = bench_clock::now() + d;
+  while (bench_clock::now() < end) {
+  }
+}
+
+// runs f on each thread, and returns the mean ns spent in f.
+template <typename F> double run_threads(F f) {
+  std::vector<std::thread> ts;
+  std::atomic<std::int64_t> total_ns{0};
+  for (int t = 0; t < threads; ++t) {
+    ts.emplace_back([&f, &total_ns] {
+      bench_clock::duration spent{0};
+      for (int i = 0; i < records_per_thread; ++i) {
+        auto start = bench_clock::now();
+        f();
+        spent += bench_clock::now() - start;
+        spin_for(request_gap);
+      }
+      total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(spent)
+                      .count();
+    });
+  }
+  for (auto &t : ts) {
+    t.join();
+  }
+  return static_cast<double>(total_ns.load()) / (threads * records_per_thread);
+}
+
+int main() {
+  auto dir = std::filesystem::temp_directory_path() / "winasio_access_bench";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto record = make_record();
+
+  auto logger =
+      spdlog::basic_logger_mt("access", (dir / "spdlog.log").string());
+  logger->set_pattern("%v");
+  double sync_ns = run_threads([&] {
+    std::string line;
+    winnet::http::access_log::format(line, record);
+    logger->info(line);
+  });
+  logger->flush();
+
+  winnet::http::access_log_options opts;
+  opts.file = dir / "access.log";
+  opts.ring_capacity = 16384;
+  opts.flush_interval = 10ms;
+  winnet::http::access_log log(opts);
+  double batched_ns = run_threads([&] { log.log(record); });
+  log.stop();
+
+  std::printf("%-24s %12s %10s\n", "writer", "ns/record", "dropped");
+  std::printf("%-24s %12.1f %10d\n", "spdlog sync file", sync_ns, 0);
+  std::printf("%-24s %12.1f %10llu\n", "batched access_log", batched_ns,
+              static_cast<unsigned long long>(log.dropped()));
+  std::filesystem::remove_all(dir);
+}
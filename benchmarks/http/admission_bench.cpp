@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Overload benchmark of the controller admission control.
+// The http.sys queue and the io threads are simulated with a discrete event
+// simulation in virtual time, so results are deterministic and the benchmark
+// runs on any platform.
+
+#include <boost/winasio/http/http_admission.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace winnet = boost::winasio;
+using namespace std::chrono_literals;
+using ns = std::chrono::nanoseconds;
+
+struct scenario {
+  const char *name;
+  winnet::http::admission_options options;
+  winnet::http::route_limits limits;
+};
+
+struct result {
+  std::uint64_t served = 0;
+  std::uint64_t shed = 0;
+  std::vector<ns> latencies;
+};
+
+struct request {
+  ns arrival;
+};
+
+// Simulate `workers` io threads each serving requests with exponential service
+// time, fed by poisson arrivals at `load` times the capacity.
+result simulate(const scenario &sc, int workers, ns mean_service, double load,
+                ns duration) {
+  winnet::http::admission_control ac;
+  ac.set_options(sc.options);
+  winnet::http::route_admission route;
+  route.set_limits(sc.limits);
+
+  std::mt19937_64 rng(42);
+  const double capacity =
+      workers * 1e9 / static_cast<double>(mean_service.count());
+  std::exponential_distribution<double> arrival_gap(capacity * load / 1e9);
+  std::exponential_distribution<double> service(
+      1.0 / static_cast<double>(mean_service.count()));
+
+  auto tp = [](ns t) { return winnet::http::admission_clock::time_point(t); };
+
+  // completion times of busy workers.
+  std::priority_queue<ns, std::vector<ns>, std::greater<ns>> busy;
+  std::deque<request> backlog;
+  result res;
+
+  ns now{0};
+  ns next_arrival{static_cast<ns::rep>(arrival_gap(rng))};
+  for (;;) {
+    bool has_arrival = next_arrival < duration;
+    if (!has_arrival && busy.empty()) {
+      // backlog is drained since idle workers always pick it up.
+      break;
+    }
+    if (has_arrival && (busy.empty() || next_arrival <= busy.top())) {
+      now = next_arrival;
+      next_arrival += ns{static_cast<ns::rep>(arrival_gap(rng))};
+      // headers received, admission decides before the body is read.
+      if (ac.admit(&route, tp(now)) ==
+          winnet::http::admission_result::admitted) {
+        backlog.push_back({now});
+      } else {
+        ++res.shed;
+      }
+    } else {
+      // a worker finished a request and sent the response.
+      now = busy.top();
+      busy.pop();
+      ac.release(&route);
+    }
+
+    // idle workers pick up queued requests.
+    while (static_cast<int>(busy.size()) < workers && !backlog.empty()) {
+      request rq = backlog.front();
+      backlog.pop_front();
+      if (ac.check_queue_time(tp(rq.arrival), tp(now)) !=
+          winnet::http::admission_result::admitted) {
+        // shed response is cheap compared to the handler.
+        ac.release(&route);
+        ++res.shed;
+        continue;
+      }
+      ns done = now + ns{static_cast<ns::rep>(service(rng))};
+      busy.push(done);
+      res.latencies.push_back(done - rq.arrival);
+      ++res.served;
+    }
+  }
+  return res;
+}
+
+double percentile_ms(std::vector<ns> &v, double p) {
+  if (v.empty()) {
+    return 0;
+  }
+  std::size_t idx = static_cast<std::size_t>(p * (v.size() - 1));
+  std::nth_element(v.begin(), v.begin() + idx, v.end());
+  return std::chrono::duration<double, std::milli>(v[idx]).count();
+}
+
+int main() {
+  const int workers = 8;
+  const ns mean_service = 1ms;
+  const ns duration = 10s;
+
+  winnet::http::admission_options in_flight;
+  in_flight.max_in_flight = workers * 16;
+
+  winnet::http::admission_options queue_time = in_flight;
+  queue_time.max_queue_time = 5ms;
+
+  winnet::http::route_limits rate;
+  rate.rate = 0.9 * workers * 1000;
+  rate.burst = workers;
+
+  std::vector<scenario> scenarios = {
+      {"no admission", {}, {}},
+      {"max in flight", in_flight, {}},
+      {"in flight + queue time", queue_time, {}},
+      {"in flight + queue time + rate", queue_time, rate},
+  };
+
+  std::printf("%-32s %6s %10s %8s %9s %9s %9s\n", "scenario", "load",
+              "served/s", "shed%", "p50(ms)", "p99(ms)", "max(ms)");
+  for (double load : {0.8, 1.2, 2.0}) {
+    for (const scenario &sc : scenarios) {
+      result r = simulate(sc, workers, mean_service, load, duration);
+      double total = static_cast<double>(r.served + r.shed);
+      std::printf("%-32s %6.1f %10.0f %8.2f %9.2f %9.2f %9.2f\n", sc.name,
+                  load,
+                  r.served / std::chrono::duration<double>(duration).count(),
+                  total == 0 ? 0.0 : 100.0 * r.shed / total,
+                  percentile_ms(r.latencies, 0.5),
+                  percentile_ms(r.latencies, 0.99),
+                  percentile_ms(r.latencies, 1.0));
+    }
+  }
+}
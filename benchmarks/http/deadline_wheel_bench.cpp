@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Idle deadlines of many connections, like the read deadline of a server
+// session, with one steady_timer per connection and with a deadline_wheel.
+// arm: every connection arms its deadline.
+// rearm: every connection re-arms it, as after each read, 10 times.
+// expire: the deadlines, spread over 200ms, expire. Cpu time of the io
+// thread until all have fired.
+
+#include <boost/winasio/deadline_wheel.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <vector>
+
+namespace net = boost::asio;
+namespace winnet = boost::winasio;
+using namespace std::chrono_literals;
+using bench_clock = std::chrono::steady_clock;
+
+const int rearm_rounds = 10;
+const auto idle = 30s;
+const auto spread = 200ms;
+
+struct result {
+  double arm_ns;
+  double rearm_ns;
+  double expire_ms;
+};
+
+double ns_per_op(bench_clock::time_point start, std::size_t ops) {
+  return std::chrono::duration<double, std::nano>(bench_clock::now() - start)
+             .count() /
+         static_cast<double>(ops);
+}
+
+double cpu_ms(std::clock_t start) {
+  return 1000.0 * static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+}
+
+// the expiry of connection i.
+bench_clock::duration spread_of(std::size_t i, std::size_t n) {
+  return spread * static_cast<bench_clock::rep>(i) /
+         static_cast<bench_clock::rep>(n);
+}
+
+result run_timers(std::size_t n) {
+  net::io_context ioc(1);
+  std::vector<std::unique_ptr<net::steady_timer>> timers;
+  timers.reserve(n);
+  std::size_t fired = 0;
+  auto on_wait = [&](boost::system::error_code ec) {
+    if (!ec) {
+      ++fired;
+    }
+  };
+  result r;
+
+  auto start = bench_clock::now();
+  for (std::size_t i = 0; i < n; ++i) {
+    timers.push_back(std::make_unique<net::steady_timer>(ioc, idle));
+    timers.back()->async_wait(on_wait);
+  }
+  r.arm_ns = ns_per_op(start, n);
+
+  start = bench_clock::now();
+  for (int round = 0; round < rearm_rounds; ++round) {
+    for (auto &t : timers) {
+      // cancels the pending wait, its handler is run by poll.
+      t->expires_after(idle);
+      t->async_wait(on_wait);
+    }
+    ioc.poll();
+  }
+  r.rearm_ns = ns_per_op(start, n * rearm_rounds);
+
+  auto now = bench_clock::now();
+  for (std::size_t i = 0; i < n; ++i) {
+    timers[i]->expires_at(now + spread_of(i, n));
+    timers[i]->async_wait(on_wait);
+  }
+  ioc.poll();
+  std::clock_t cpu = std::clock();
+  ioc.run();
+  r.expire_ms = cpu_ms(cpu);
+  if (fired != n) {
+    std::printf("steady_timer fired %zu of %zu\n", fired, n);
+  }
+  return r;
+}
+
+result run_wheel(std::size_t n) {
+  net::io_context ioc(1);
+  winnet::deadline_wheel wheel(ioc.get_executor(), 10ms);
+  std::vector<std::unique_ptr<winnet::deadline>> deadlines;
+  deadlines.reserve(n);
+  std::size_t fired = 0;
+  result r;
+
+  auto start = bench_clock::now();
+  for (std::size_t i = 0; i < n; ++i) {
+    deadlines.push_back(
+        std::make_unique<winnet::deadline>(wheel, [&] { ++fired; }));
+    deadlines.back()->expires_after(idle);
+  }
+  r.arm_ns = ns_per_op(start, n);
+
+  start = bench_clock::now();
+  for (int round = 0; round < rearm_rounds; ++round) {
+    for (auto &d : deadlines) {
+      d->expires_after(idle);
+    }
+    ioc.poll();
+  }
+  r.rearm_ns = ns_per_op(start, n * rearm_rounds);
+
+  auto now = bench_clock::now();
+  for (std::size_t i = 0; i < n; ++i) {
+    deadlines[i]->expires_at(now + spread_of(i, n));
+  }
+  std::clock_t cpu = std::clock();
+  ioc.run();
+  r.expire_ms = cpu_ms(cpu);
+  if (fired != n) {
+    std::printf("deadline_wheel fired %zu of %zu\n", fired, n);
+  }
+  return r;
+}
+
+int main() {
+  std::printf("%-12s %-16s %10s %12s %14s\n", "connections", "deadlines",
+              "arm ns/op", "rearm ns/op", "expire cpu ms");
+  for (std::size_t n : {std::size_t(10'000), std::size_t(100'000)}) {
+    result t = run_timers(n);
+    result w = run_wheel(n);
+    std::printf("%-12zu %-16s %10.1f %12.1f %14.1f\n", n, "steady_timer",
+                t.arm_ns, t.rearm_ns, t.expire_ms);
+    std::printf("%-12zu %-16s %10.1f %12.1f %14.1f\n", n, "deadline_wheel",
+                w.arm_ns, w.rearm_ns, w.expire_ms);
+  }
+}
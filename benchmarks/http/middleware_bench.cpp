@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Per request overhead of the compile time middleware chain, compared with
+// the same middlewares wrapped around the handler as nested std::function.
+
+#include <boost/winasio/http/http_middleware.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <tuple>
+#include <utility>
+
+namespace winnet = boost::winasio;
+using bench_clock = std::chrono::steady_clock;
+
+// printed at the end so that the loops are not optimized away.
+std::uint64_t sink = 0;
+
+struct fake_context {
+  std::uint64_t status = 0;
+};
+
+// counts requests in before and adds to the status in after.
+template <int N> struct counter {
+  struct state_type {
+    std::uint64_t seen = 0;
+  };
+  std::uint64_t count = 0;
+
+  template <typename Ctx> bool before(Ctx &, state_type &s) {
+    s.seen = ++count;
+    return true;
+  }
+  template <typename Ctx> void after(Ctx &ctx, state_type &s) {
+    ctx.status += s.seen & N;
+  }
+};
+
+template <typename State> struct chain_context : fake_context {
+  State state;
+};
+
+template <int... Ns> double run_chain(std::uint64_t iterations) {
+  typedef winnet::http::middleware_chain<counter<Ns>...> chain_type;
+  chain_type chain(counter<Ns>{}...);
+  auto handler = [](auto &ctx) { ctx.status += 1; };
+  auto start = bench_clock::now();
+  for (std::uint64_t i = 0; i < iterations; ++i) {
+    chain_context<typename chain_type::state_type> ctx;
+    chain(ctx, handler);
+    sink += ctx.status;
+  }
+  auto elapsed = bench_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         iterations;
+}
+
+template <int... Ns> double run_function(std::uint64_t iterations) {
+  typedef std::function<void(fake_context &)> handler_type;
+  std::tuple<counter<Ns>...> middlewares;
+  handler_type h = [](fake_context &ctx) { ctx.status += 1; };
+  // wrap from the innermost middleware outwards.
+  auto wrap = [&h](auto &m) {
+    h = [&m, inner = std::move(h)](fake_context &ctx) {
+      typename std::decay_t<decltype(m)>::state_type s;
+      if (m.before(ctx, s)) {
+        inner(ctx);
+      }
+      m.after(ctx, s);
+    };
+  };
+  std::apply([&](auto &...ms) { (wrap(ms), ...); }, middlewares);
+  auto start = bench_clock::now();
+  for (std::uint64_t i = 0; i < iterations; ++i) {
+    fake_context ctx;
+    h(ctx);
+    sink += ctx.status;
+  }
+  auto elapsed = bench_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         iterations;
+}
+
+int main() {
+  const std::uint64_t iterations = 50'000'000;
+  double c0 = run_chain<>(iterations);
+  double f0 = run_function<>(iterations);
+  double c3 = run_chain<1, 2, 3>(iterations);
+  double f3 = run_function<1, 2, 3>(iterations);
+  double c8 = run_chain<1, 2, 3, 4, 5, 6, 7, 8>(iterations);
+  double f8 = run_function<1, 2, 3, 4, 5, 6, 7, 8>(iterations);
+
+  std::printf("%-12s %14s %22s\n", "middlewares", "chain(ns/req)",
+              "std::function(ns/req)");
+  std::printf("%-12d %14.2f %22.2f\n", 0, c0, f0);
+  std::printf("%-12d %14.2f %22.2f\n", 3, c3, f3);
+  std::printf("%-12d %14.2f %22.2f\n", 8, c8, f8);
+  std::printf("(sink %llu)\n", static_cast<unsigned long long>(sink));
+}
@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Tail latency of a fast route sharing io threads with a cpu heavy route.
+// Mirrors how the controller dispatches: requests complete on the io
+// threads, handlers run inline or on the offload pool, and the response is
+// sent from the io executor.
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/winasio/http/http_offload_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace net = boost::asio;
+namespace winnet = boost::winasio;
+using namespace std::chrono_literals;
+using bench_clock = std::chrono::steady_clock;
+
+// busy loop to simulate cpu bound handler.
+void spin_for(bench_clock::duration d) {
+  auto end = bench_clock::now() + d;
+  while (bench_clock::now() < end) {
+  }
+}
+
+struct latencies {
+  std::mutex m;
+  std::vector<bench_clock::duration> fast;
+};
+
+void run(const char *name, bool offload) {
+  const int io_threads = 2;
+  const auto duration = 3s;
+  const auto fast_cost = 50us;
+  const auto slow_cost = 5ms;
+  // 4000 requests/s, one in 20 is slow: about 1 core of slow handlers and
+  // 0.2 core of fast handlers.
+  const int slow_every = 20;
+  const auto gap = 250us;
+
+  net::io_context ioc(io_threads);
+  auto work = net::make_work_guard(ioc);
+  winnet::http::offload_pool pool(4, 1024);
+  latencies lat;
+  std::atomic<int> rejected = 0;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < io_threads; ++i) {
+    threads.emplace_back([&] { ioc.run(); });
+  }
+
+  // the request generator plays the role of http.sys completing receives.
+  auto start = bench_clock::now();
+  int n = 0;
+  for (auto next = start; next < start + duration; next += gap, ++n) {
+    std::this_thread::sleep_until(next);
+    bool slow = n % slow_every == 0;
+    auto received = bench_clock::now();
+    net::post(ioc, [&, slow, received] {
+      auto handler = [slow, fast_cost, slow_cost] {
+        spin_for(slow ? slow_cost : fast_cost);
+      };
+      auto send = [&, slow, received] {
+        if (!slow) {
+          std::lock_guard<std::mutex> lk(lat.m);
+          lat.fast.push_back(bench_clock::now() - received);
+        }
+      };
+      if (offload && slow) {
+        bool ok = pool.try_submit([&, handler, send] {
+          handler();
+          net::post(ioc, send);
+        });
+        if (!ok) {
+          ++rejected;
+        }
+        return;
+      }
+      handler();
+      send();
+    });
+  }
+
+  work.reset();
+  for (auto &t : threads) {
+    t.join();
+  }
+  pool.stop();
+
+  auto pct = [&](double p) {
+    std::size_t idx = static_cast<std::size_t>(p * (lat.fast.size() - 1));
+    std::nth_element(lat.fast.begin(), lat.fast.begin() + idx, lat.fast.end());
+    return std::chrono::duration<double, std::micro>(lat.fast[idx]).count();
+  };
+  std::printf("%-10s fast route: n=%zu p50=%8.1fus p99=%8.1fus p99.9=%8.1fus "
+              "max=%8.1fus rejected=%d\n",
+              name, lat.fast.size(), pct(0.5), pct(0.99), pct(0.999),
+              pct(1.0), rejected.load());
+}
+
+int main() {
+  run("inline", false);
+  run("offload", true);
+}
@@ -0,0 +1,136 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Small messages over a named pipe, read with and without read ahead. A
+// client writes 64 byte frames, one message each, while the server reads
+// them with async_read, both on one io thread.
+// direct: each frame is a read of the handle, in message mode.
+// read ahead: the pipe reads in byte mode into its 64KB buffer, a read of
+// the handle returns the frames written so far.
+// read ahead split: each frame is read as a 4 byte header and a body,
+// which in message mode fails with ERROR_MORE_DATA.
+
+#include <boost/winasio/named_pipe/named_pipe_protocol.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+namespace net = boost::asio;
+namespace winnet = boost::winasio;
+using bench_clock = std::chrono::steady_clock;
+
+typedef winnet::named_pipe_protocol<net::io_context::executor_type>::pipe
+    pipe_type;
+
+const std::size_t frame_size = 64;
+const std::size_t header_size = 4;
+const int frames = 200'000;
+
+struct result {
+  double rate;
+  bool ok;
+};
+
+result run(std::size_t read_ahead, bool split) {
+  net::io_context ioc(1);
+  const std::string name = "\\\\.\\pipe\\winasio_read_ahead_bench";
+  pipe_type server(ioc);
+  server.set_read_ahead(read_ahead);
+  boost::system::error_code ec;
+  server.server_create(ec, name);
+  if (ec) {
+    std::printf("create failed: %s\n", ec.message().c_str());
+    return {0, false};
+  }
+  server.async_server_connect([](boost::system::error_code) {});
+  pipe_type client(ioc);
+  client.connect(name, ec);
+  if (ec) {
+    std::printf("connect failed: %s\n", ec.message().c_str());
+    return {0, false};
+  }
+  ioc.run();
+  ioc.restart();
+
+  std::array<char, frame_size> out;
+  out.fill('x');
+  std::array<char, frame_size> in;
+  int written = 0;
+  int read = 0;
+  bool ok = true;
+
+  std::function<void()> write_next = [&] {
+    net::async_write(client, net::buffer(out),
+                     [&](boost::system::error_code e, std::size_t) {
+                       if (e) {
+                         ok = false;
+                         return;
+                       }
+                       if (++written < frames) {
+                         write_next();
+                       }
+                     });
+  };
+  std::function<void()> read_next;
+  auto on_read = [&](boost::system::error_code e, std::size_t) {
+    if (e) {
+      std::printf("read failed: %s\n", e.message().c_str());
+      ok = false;
+      return;
+    }
+    if (++read < frames) {
+      read_next();
+    }
+  };
+  read_next = [&] {
+    if (!split) {
+      net::async_read(server, net::buffer(in), on_read);
+      return;
+    }
+    net::async_read(server, net::buffer(in.data(), header_size),
+                    [&](boost::system::error_code e, std::size_t) {
+                      if (e) {
+                        on_read(e, 0);
+                        return;
+                      }
+                      net::async_read(server,
+                                      net::buffer(in.data() + header_size,
+                                                  frame_size - header_size),
+                                      on_read);
+                    });
+  };
+
+  auto start = bench_clock::now();
+  write_next();
+  read_next();
+  ioc.run();
+  double secs =
+      std::chrono::duration<double>(bench_clock::now() - start).count();
+  return {read / secs, ok && read == frames};
+}
+
+int main() {
+  struct {
+    const char *name;
+    std::size_t read_ahead;
+    bool split;
+  } modes[] = {{"direct", 0, false},
+               {"read ahead", 64 * 1024, false},
+               {"read ahead split", 64 * 1024, true}};
+  std::printf("%-18s %12s\n", "reads", "frames/s");
+  for (const auto &m : modes) {
+    result r = run(m.read_ahead, m.split);
+    std::printf("%-18s %12.0f%s\n", m.name, r.rate, r.ok ? "" : " (failed)");
+  }
+}
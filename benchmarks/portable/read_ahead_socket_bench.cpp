@@ -0,0 +1,179 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// The read ahead of named pipes over a local socket pair, which reads like a
+// pipe in byte mode, so that it runs on other platforms. A client writes 64
+// byte frames while the server reads them with async_read, both on one io
+// thread.
+// direct: each frame is a read of the socket.
+// direct split: each frame is read as a 4 byte header and a body.
+// read ahead: reads go through a 64KB buffer, a read of the socket returns
+// the frames written so far.
+// read ahead split: like direct split, through the buffer.
+
+#include <boost/winasio/named_pipe/read_ahead.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+
+namespace net = boost::asio;
+namespace winnet = boost::winasio;
+using bench_clock = std::chrono::steady_clock;
+
+typedef net::local::stream_protocol::socket socket_type;
+
+const std::size_t frame_size = 64;
+const std::size_t header_size = 4;
+const int frames = 200'000;
+
+// counts the reads of the socket.
+class counted_socket {
+public:
+  typedef socket_type::executor_type executor_type;
+
+  explicit counted_socket(socket_type &s) : s_(s), reads_(0) {}
+
+  executor_type get_executor() { return s_.get_executor(); }
+
+  std::size_t reads() const { return reads_; }
+
+  template <typename MutableBufferSequence, typename Token>
+  auto async_read_some(const MutableBufferSequence &buffers, Token &&token) {
+    ++reads_;
+    return s_.async_read_some(buffers, std::forward<Token>(token));
+  }
+
+private:
+  socket_type &s_;
+  std::size_t reads_;
+};
+
+// the counted socket, read through a buffer when it has one.
+class server_stream {
+public:
+  typedef socket_type::executor_type executor_type;
+
+  server_stream(socket_type &s, std::size_t read_ahead) : s_(s) {
+    if (read_ahead != 0) {
+      ahead_ = std::make_shared<winnet::details::read_ahead_buffer>(read_ahead);
+    }
+  }
+
+  executor_type get_executor() { return s_.get_executor(); }
+
+  std::size_t reads() const { return s_.reads(); }
+
+  template <typename MutableBufferSequence, typename Token>
+  auto async_read_some(const MutableBufferSequence &buffers, Token &&token) {
+    if (ahead_) {
+      return winnet::details::async_read_ahead(s_, ahead_, buffers,
+                                               std::forward<Token>(token));
+    }
+    return s_.async_read_some(buffers, std::forward<Token>(token));
+  }
+
+private:
+  counted_socket s_;
+  std::shared_ptr<winnet::details::read_ahead_buffer> ahead_;
+};
+
+struct result {
+  double rate;
+  double reads_per_frame;
+  bool ok;
+};
+
+result run(std::size_t read_ahead, bool split) {
+  net::io_context ioc(1);
+  socket_type server_socket(ioc);
+  socket_type client(ioc);
+  net::local::connect_pair(server_socket, client);
+  server_stream server(server_socket, read_ahead);
+
+  std::array<char, frame_size> out;
+  out.fill('x');
+  std::array<char, frame_size> in;
+  int written = 0;
+  int read = 0;
+  bool ok = true;
+
+  std::function<void()> write_next = [&] {
+    net::async_write(client, net::buffer(out),
+                     [&](boost::system::error_code e, std::size_t) {
+                       if (e) {
+                         ok = false;
+                         return;
+                       }
+                       if (++written < frames) {
+                         write_next();
+                       }
+                     });
+  };
+  std::function<void()> read_next;
+  auto on_read = [&](boost::system::error_code e, std::size_t) {
+    if (e) {
+      std::printf("read failed: %s\n", e.message().c_str());
+      ok = false;
+      return;
+    }
+    if (++read < frames) {
+      read_next();
+    }
+  };
+  read_next = [&] {
+    if (!split) {
+      net::async_read(server, net::buffer(in), on_read);
+      return;
+    }
+    net::async_read(server, net::buffer(in.data(), header_size),
+                    [&](boost::system::error_code e, std::size_t) {
+                      if (e) {
+                        on_read(e, 0);
+                        return;
+                      }
+                      net::async_read(server,
+                                      net::buffer(in.data() + header_size,
+                                                  frame_size - header_size),
+                                      on_read);
+                    });
+  };
+
+  auto start = bench_clock::now();
+  write_next();
+  read_next();
+  ioc.run();
+  double secs =
+      std::chrono::duration<double>(bench_clock::now() - start).count();
+  return {read / secs, static_cast<double>(server.reads()) / frames,
+          ok && read == frames};
+}
+
+int main() {
+  struct {
+    const char *name;
+    std::size_t read_ahead;
+    bool split;
+  } modes[] = {{"direct", 0, false},
+               {"direct split", 0, true},
+               {"read ahead", 64 * 1024, false},
+               {"read ahead split", 64 * 1024, true}};
+  std::printf("%-18s %12s %12s\n", "reads", "frames/s", "reads/frame");
+  for (const auto &m : modes) {
+    result r = run(m.read_ahead, m.split);
+    std::printf("%-18s %12.0f %12.3f%s\n", m.name, r.rate, r.reads_per_frame,
+                r.ok ? "" : " (failed)");
+  }
+}
@@ -0,0 +1,89 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Lookups of 5 headers per response.
+// copy: the previous path. Each header is fetched into its own wstring, here
+// by searching the raw block like WinHttpQueryHeaders by name does.
+// parsed: response_headers, one fill and views into it.
+// Runs without winhttp.
+
+#include <boost/winasio/winhttp/response_headers.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cwctype>
+#include <optional>
+#include <string>
+
+using bench_clock = std::chrono::steady_clock;
+using boost::winasio::winhttp::response_headers;
+
+const int rounds = 200'000;
+
+const std::wstring raw = L"HTTP/1.1 200 OK\r\n"
+                         L"Date: Mon, 01 Jan 2024 00:00:00 GMT\r\n"
+                         L"Server: bench\r\n"
+                         L"Cache-Control: max-age=60\r\n"
+                         L"Content-Type: application/json\r\n"
+                         L"Vary: Accept-Encoding\r\n"
+                         L"ETag: \"0123456789abcdef\"\r\n"
+                         L"X-Request-Id: 42\r\n"
+                         L"Content-Length: 4096\r\n"
+                         L"\r\n";
+
+const wchar_t *const names[] = {L"Content-Type", L"Content-Length", L"ETag",
+                                L"Cache-Control", L"X-Missing"};
+
+std::optional<std::wstring> copy_header(const std::wstring &block,
+                                        const std::wstring &name) {
+  std::wstring lower_block(block);
+  std::wstring key(L"\r\n" + name + L":");
+  for (auto &c : lower_block) {
+    c = static_cast<wchar_t>(std::towlower(c));
+  }
+  for (auto &c : key) {
+    c = static_cast<wchar_t>(std::towlower(c));
+  }
+  std::size_t pos = lower_block.find(key);
+  if (pos == std::wstring::npos) {
+    return std::nullopt;
+  }
+  pos += key.size();
+  std::size_t eol = block.find(L"\r\n", pos);
+  std::wstring v = block.substr(pos, eol - pos);
+  v.erase(0, v.find_first_not_of(L' '));
+  return v;
+}
+
+int main() {
+  std::size_t sink = 0;
+
+  auto start = bench_clock::now();
+  for (int i = 0; i < rounds; ++i) {
+    for (const wchar_t *n : names) {
+      auto v = copy_header(raw, n);
+      sink += v ? v->size() : 0;
+    }
+  }
+  std::chrono::duration<double> copy = bench_clock::now() - start;
+
+  response_headers h;
+  start = bench_clock::now();
+  for (int i = 0; i < rounds; ++i) {
+    h.assign(raw);
+    for (const wchar_t *n : names) {
+      auto v = h.get(n);
+      sink += v ? v->size() : 0;
+    }
+  }
+  std::chrono::duration<double> parsed = bench_clock::now() - start;
+
+  std::printf("%-8s %12s\n", "path", "ns/response");
+  std::printf("%-8s %12.1f\n", "copy", copy.count() * 1e9 / rounds);
+  std::printf("%-8s %12.1f\n", "parsed", parsed.count() * 1e9 / rounds);
+  return sink == 0;
+}
@@ -0,0 +1,265 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Heap allocations per 100KB response read once warmed up. The body is
+// read like async_read_body in direct mode, with step completions from a
+// fake winhttp callback thread that returns at most 8KB per read.
+// recycling: the step handlers use the default recycling_allocator.
+// heap: the handler is bound to an allocator of plain new and delete, so
+// every step allocates its handler.
+
+#include <boost/winasio/winhttp/body_read_sizer.hpp>
+#include <boost/winasio/winhttp/winhttp_step.hpp>
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+
+namespace net = boost::asio;
+namespace winnet = boost::winasio;
+using bench_clock = std::chrono::steady_clock;
+using winnet::winhttp::details::async_step;
+using winnet::winhttp::details::body_read_sizer;
+using winnet::winhttp::details::step_state;
+
+const std::size_t body_size = 100 * 1024;
+const std::size_t chunk_size = 8 * 1024;
+const int warmup = 1'000;
+const int requests = 20'000;
+
+// allocations of all threads.
+std::atomic<bool> counting{false};
+std::atomic<std::size_t> allocations{0};
+
+void *operator new(std::size_t n) {
+  if (counting.load(std::memory_order_relaxed)) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (void *p = std::malloc(n == 0 ? 1 : n)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+// called through a pointer, so that the compiler does not take free as the
+// pair of the replaced operator new (-Wmismatched-new-delete).
+void (*volatile heap_free)(void *) = std::free;
+
+void operator delete(void *p) noexcept { heap_free(p); }
+void operator delete(void *p, std::size_t) noexcept { heap_free(p); }
+
+typedef net::io_context::executor_type executor_type;
+
+// completes one step at a time, like the winhttp callback thread. Does not
+// allocate.
+class callback_thread {
+public:
+  callback_thread() : step_(nullptr), len_(0), stopped_(false) {
+    th_ = std::thread([this] { run(); });
+  }
+  ~callback_thread() {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      stopped_ = true;
+    }
+    cv_.notify_one();
+    th_.join();
+  }
+
+  void complete(async_step<executor_type> *step, std::size_t len) {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      step_ = step;
+      len_ = len;
+    }
+    cv_.notify_one();
+  }
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> lk(m_);
+    for (;;) {
+      cv_.wait(lk, [this] { return stopped_ || step_ != nullptr; });
+      if (step_ == nullptr) {
+        return;
+      }
+      async_step<executor_type> *step = step_;
+      step_ = nullptr;
+      lk.unlock();
+      step->complete(boost::system::error_code(), len_);
+      lk.lock();
+    }
+  }
+
+  std::mutex m_;
+  std::condition_variable cv_;
+  async_step<executor_type> *step_;
+  std::size_t len_;
+  bool stopped_;
+  std::thread th_;
+};
+
+// a response body served in chunks through an async_step.
+class fake_request {
+public:
+  fake_request(const executor_type &ex, callback_thread &cb)
+      : step_(ex), cb_(cb), remaining_(0) {}
+
+  executor_type get_executor() { return step_.get_executor(); }
+
+  void reset() { remaining_ = body_size; }
+
+  template <typename Token>
+  auto async_read_data(void *data, std::size_t len, Token &&token) {
+    step_.begin(step_state::read_complete);
+    std::size_t n = (std::min)({len, chunk_size, remaining_});
+    std::memset(data, 'x', n);
+    remaining_ -= n;
+    cb_.complete(&step_, n);
+    return winnet::winhttp::details::async_wait_step_len(
+        step_, std::forward<Token>(token));
+  }
+
+private:
+  async_step<executor_type> step_;
+  callback_thread &cb_;
+  std::size_t remaining_;
+};
+
+// async_read_body_op in direct mode.
+template <typename DynamicBuffer> class read_body_op {
+public:
+  read_body_op(fake_request &r, DynamicBuffer &buff)
+      : r_(r), buff_(buff), sizer_(body_size), requested_(0), total_(0) {}
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec = {},
+                  std::size_t len = std::size_t(-1)) {
+    if (ec || len == 0) {
+      self.complete(ec, total_);
+      return;
+    }
+    if (len != std::size_t(-1)) {
+      buff_.commit(len);
+      total_ += len;
+      sizer_.consumed(requested_, len);
+    }
+    requested_ = sizer_.next();
+    r_.async_read_data(buff_.prepare(requested_).data(), requested_,
+                       std::move(self));
+  }
+
+private:
+  fake_request &r_;
+  DynamicBuffer &buff_;
+  body_read_sizer sizer_;
+  std::size_t requested_;
+  std::size_t total_;
+};
+
+template <typename DynamicBuffer, typename Token>
+auto async_read_body(fake_request &r, DynamicBuffer &buff, Token &&token) {
+  return net::async_compose<Token,
+                            void(boost::system::error_code, std::size_t)>(
+      read_body_op<DynamicBuffer>(r, buff), token, r.get_executor());
+}
+
+// new and delete. std::allocator would be taken as no allocator.
+template <typename T> struct heap_allocator {
+  typedef T value_type;
+  heap_allocator() = default;
+  template <typename U> heap_allocator(const heap_allocator<U> &) {}
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(::operator new(sizeof(T) * n));
+  }
+  void deallocate(T *p, std::size_t) { ::operator delete(p); }
+  template <typename U> bool operator==(const heap_allocator<U> &) const {
+    return true;
+  }
+  template <typename U> bool operator!=(const heap_allocator<U> &) const {
+    return false;
+  }
+};
+
+// a handler with heap_allocator as its associated allocator.
+template <typename Handler> struct heap_handler {
+  typedef heap_allocator<void> allocator_type;
+  allocator_type get_allocator() const { return allocator_type(); }
+
+  Handler h;
+  void operator()(boost::system::error_code ec, std::size_t n) { h(ec, n); }
+};
+
+struct result {
+  double rate;
+  double allocs;
+};
+
+template <bool Recycling> result run() {
+  net::io_context ioc(1);
+  callback_thread cb;
+  fake_request req(ioc.get_executor(), cb);
+  std::string body;
+  body.reserve(body_size + 1);
+  auto buff = net::dynamic_buffer(body);
+  int done = 0;
+  bench_clock::time_point start;
+
+  std::function<void()> next;
+  auto on_read = [&](boost::system::error_code ec, std::size_t n) {
+    if (ec || n != body_size) {
+      std::printf("read failed: %s %zu\n", ec.message().c_str(), n);
+      return;
+    }
+    if (++done == warmup) {
+      allocations = 0;
+      counting = true;
+      start = bench_clock::now();
+    }
+    if (done == warmup + requests) {
+      counting = false;
+      return;
+    }
+    next();
+  };
+  next = [&] {
+    buff.consume(buff.size());
+    req.reset();
+    if constexpr (Recycling) {
+      async_read_body(req, buff, on_read);
+    } else {
+      async_read_body(req, buff, heap_handler<decltype(on_read)>{on_read});
+    }
+  };
+  next();
+  ioc.run();
+  double secs =
+      std::chrono::duration<double>(bench_clock::now() - start).count();
+  return {requests / secs,
+          static_cast<double>(allocations.load()) / requests};
+}
+
+int main() {
+  result r[2] = {run<true>(), run<false>()};
+  std::printf("%-14s %12s %14s\n", "allocator", "requests/s", "allocs/request");
+  std::printf("%-14s %12.0f %14.3f\n", "recycling", r[0].rate, r[0].allocs);
+  std::printf("%-14s %12.0f %14.3f\n", "heap", r[1].rate, r[1].allocs);
+}
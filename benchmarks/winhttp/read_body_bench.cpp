@@ -0,0 +1,101 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Winhttp callbacks per MB and throughput of async_read_body against the
+// beast test server, in query mode (query data then read, per chunk) and
+// direct mode (sized reads only). Windows only.
+
+#include <boost/winasio/winhttp/winhttp_asio.hpp>
+
+#include "../../tests/portable/beast_test_server.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cwchar>
+#include <string>
+#include <thread>
+#include <vector>
+
+using bench_clock = std::chrono::steady_clock;
+typedef net::io_context::executor_type executor_type;
+
+const int rounds = 20;
+
+struct result {
+  double callbacks_per_mb;
+  double mb_per_s;
+};
+
+result run(winnet::winhttp::basic_winhttp_connect_handle<executor_type> &conn,
+           net::io_context &ioc, const std::wstring &path,
+           winnet::winhttp::read_body_mode mode) {
+  std::size_t callbacks = 0;
+  std::size_t bytes = 0;
+  bench_clock::duration spent{0};
+  for (int i = 0; i < rounds; ++i) {
+    boost::system::error_code ec;
+    winnet::winhttp::basic_winhttp_request_asio_handle<executor_type> h(
+        ioc.get_executor());
+    h.managed_open(conn.native_handle(), L"GET", path.c_str(), NULL,
+                   WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, NULL, ec);
+    std::vector<BYTE> body;
+    auto buff = net::dynamic_buffer(body);
+    std::size_t after_headers = 0;
+    bench_clock::time_point start;
+    h.async_send(NULL, 0, WINHTTP_NO_REQUEST_DATA, 0, 0,
+                 [&](boost::system::error_code) {
+                   h.async_recieve_response([&](boost::system::error_code) {
+                     after_headers = h.step_count();
+                     start = bench_clock::now();
+                     winnet::winhttp::async_read_body(
+                         h, buff, mode,
+                         [&](boost::system::error_code, std::size_t len) {
+                           spent += bench_clock::now() - start;
+                           bytes += len;
+                         });
+                   });
+                 });
+    ioc.restart();
+    ioc.run();
+    callbacks += h.step_count() - after_headers;
+  }
+  double mb = static_cast<double>(bytes) / (1024 * 1024);
+  return {callbacks / mb, mb / std::chrono::duration<double>(spent).count()};
+}
+
+int main() {
+  net::io_context server_ioc(1);
+  myacceptor acceptor{server_ioc, {tcp::v4(), 12345}};
+  mysocket socket{server_ioc};
+  http_server(acceptor, socket);
+  std::thread server([&server_ioc] { server_ioc.run(); });
+
+  boost::system::error_code ec;
+  net::io_context ioc;
+  winnet::winhttp::basic_winhttp_session_handle<executor_type> session(ioc);
+  session.open(ec);
+  winnet::winhttp::basic_winhttp_connect_handle<executor_type> conn(ioc);
+  conn.connect(session.native_handle(), L"localhost", 12345, ec);
+
+  std::printf("%-18s %-8s %14s %10s\n", "body", "mode", "callbacks/MB",
+              "MB/s");
+  for (const wchar_t *path : {L"/bytes/65536", L"/bytes/4194304",
+                              L"/chunked/4194304"}) {
+    for (auto mode : {winnet::winhttp::read_body_mode::query,
+                      winnet::winhttp::read_body_mode::direct}) {
+      result r = run(conn, ioc, path, mode);
+      std::string name(path, path + std::wcslen(path));
+      std::printf("%-18s %-8s %14.1f %10.1f\n", name.c_str(),
+                  mode == winnet::winhttp::read_body_mode::query ? "query"
+                                                                 : "direct",
+                  r.callbacks_per_mb, r.mb_per_s);
+    }
+  }
+
+  server_ioc.stop();
+  server.join();
+}
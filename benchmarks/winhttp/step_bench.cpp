@@ -0,0 +1,163 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Steps per second of a single request, completing each step from a fake
+// winhttp callback thread.
+// event: the previous path. The callback sets an event, a thread pool wait
+// wakes up and posts the handler to the io_context.
+// direct: the callback posts the stored handler to the io_context.
+
+#include <boost/winasio/winhttp/winhttp_step.hpp>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace net = boost::asio;
+namespace winnet = boost::winasio;
+using bench_clock = std::chrono::steady_clock;
+using winnet::winhttp::details::async_step;
+using winnet::winhttp::details::step_state;
+
+const int steps = 200'000;
+
+// single thread running tasks in order, like a winhttp callback thread.
+class worker {
+public:
+  worker() : stopped_(false), t_([this] { run(); }) {}
+  ~worker() {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      stopped_ = true;
+    }
+    cv_.notify_one();
+    t_.join();
+  }
+  void submit(std::function<void()> f) {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      tasks_.push_back(std::move(f));
+    }
+    cv_.notify_one();
+  }
+
+private:
+  void run() {
+    for (;;) {
+      std::function<void()> f;
+      {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [this] { return stopped_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+          return;
+        }
+        f = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      f();
+    }
+  }
+
+  std::mutex m_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopped_;
+  std::thread t_;
+};
+
+// manual reset event waited by a thread pool thread.
+class event_wait {
+public:
+  void set() {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      set_ = true;
+    }
+    cv_.notify_one();
+  }
+  void reset() {
+    std::lock_guard<std::mutex> lk(m_);
+    set_ = false;
+  }
+  void wait() {
+    std::unique_lock<std::mutex> lk(m_);
+    cv_.wait(lk, [this] { return set_; });
+  }
+
+private:
+  std::mutex m_;
+  std::condition_variable cv_;
+  bool set_ = false;
+};
+
+double run_event() {
+  net::io_context ioc;
+  auto work = net::make_work_guard(ioc);
+  worker callback;
+  worker wait_pool;
+  event_wait ev;
+  int done = 0;
+  std::function<void()> next = [&] {
+    ev.reset();
+    // winhttp api returns, callback fires later.
+    callback.submit([&] { ev.set(); });
+    // basic_object_handle::async_wait
+    wait_pool.submit([&] {
+      ev.wait();
+      net::post(ioc, [&] {
+        if (++done < steps) {
+          next();
+        } else {
+          work.reset();
+        }
+      });
+    });
+  };
+  auto start = bench_clock::now();
+  next();
+  ioc.run();
+  return steps / std::chrono::duration<double>(bench_clock::now() - start)
+                     .count();
+}
+
+double run_direct() {
+  net::io_context ioc;
+  async_step<net::io_context::executor_type> step(ioc.get_executor());
+  worker callback;
+  int done = 0;
+  std::function<void()> next = [&] {
+    step.begin(step_state::read_complete);
+    callback.submit([&] { step.complete({}, 1); });
+    winnet::winhttp::details::async_wait_step_len(
+        step, [&](boost::system::error_code, std::size_t) {
+          if (++done < steps) {
+            next();
+          }
+        });
+  };
+  auto start = bench_clock::now();
+  next();
+  ioc.run();
+  return steps / std::chrono::duration<double>(bench_clock::now() - start)
+                     .count();
+}
+
+int main() {
+  double event = run_event();
+  double direct = run_direct();
+  std::printf("%-8s %14s\n", "path", "steps/s");
+  std::printf("%-8s %14.0f\n", "event", event);
+  std::printf("%-8s %14.0f\n", "direct", direct);
+}
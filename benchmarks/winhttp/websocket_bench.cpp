@@ -0,0 +1,201 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Small messages per second on one websocket connection, against a local
+// Beast echo server, and heap allocations per message on the client
+// thread once warmed up.
+// pingpong: write a message, read its echo, repeat. One message per round
+// trip through the echo server thread, so its rate is that of the loopback
+// round trip rather than of the client.
+// duplex: a write loop and a read loop run at the same time, the sustained
+// rate of one connection.
+// Runs the winhttp backend on Windows and the Beast backend elsewhere.
+
+#include <boost/winasio/winhttp/websocket.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/websocket.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace winnet = boost::winasio;
+using tcp = net::ip::tcp;
+using bench_clock = std::chrono::steady_clock;
+
+const int warmup = 10'000;
+const int messages = 200'000;
+
+// allocations of the thread that sets counting.
+thread_local bool counting = false;
+std::atomic<std::size_t> allocations{0};
+
+void *operator new(std::size_t n) {
+  if (counting) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (void *p = std::malloc(n == 0 ? 1 : n)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+// called through a pointer, so that the compiler does not take free as the
+// pair of the replaced operator new (-Wmismatched-new-delete).
+void (*volatile heap_free)(void *) = std::free;
+
+void operator delete(void *p) noexcept { heap_free(p); }
+void operator delete(void *p, std::size_t) noexcept { heap_free(p); }
+
+// echoes messages on one connection at a time.
+class echo_server {
+public:
+  echo_server()
+      : ioc_(1), acceptor_(ioc_, {net::ip::make_address("127.0.0.1"), 0}),
+        port_(acceptor_.local_endpoint().port()), th_([this] { run(); }) {}
+  ~echo_server() { th_.join(); }
+
+  std::wstring url() const {
+    return L"ws://127.0.0.1:" + std::to_wstring(port_) + L"/";
+  }
+
+private:
+  void run() {
+    for (int i = 0; i < 2; ++i) {
+      beast::websocket::stream<tcp::socket> ws(acceptor_.accept());
+      ws.accept();
+      beast::flat_buffer b;
+      for (;;) {
+        boost::system::error_code ec;
+        ws.read(b, ec);
+        if (ec) {
+          break;
+        }
+        ws.binary(true);
+        ws.write(b.data(), ec);
+        if (ec) {
+          break;
+        }
+        b.consume(b.size());
+      }
+    }
+  }
+
+  net::io_context ioc_;
+  tcp::acceptor acceptor_;
+  unsigned short port_;
+  std::thread th_;
+};
+
+typedef winnet::winhttp::basic_winhttp_websocket<net::io_context::executor_type>
+    bench_websocket;
+
+struct result {
+  double rate;
+  double allocs;
+};
+
+class client {
+public:
+  client(net::io_context &ioc, bool duplex)
+      : ws_(ioc.get_executor()), duplex_(duplex), out_(32, 'm'), in_(),
+        buff_(in_), sent_(0), received_(0), start_(), end_() {
+    in_.reserve(1024);
+  }
+
+  result run(net::io_context &ioc, const std::wstring &url) {
+    ws_.async_connect(url, [this](boost::system::error_code ec) {
+      if (ec) {
+        std::printf("connect: %s\n", ec.message().c_str());
+        return;
+      }
+      write();
+      if (duplex_) {
+        read();
+      }
+    });
+    ioc.run();
+    double secs = std::chrono::duration<double>(end_ - start_).count();
+    return {messages / secs,
+            static_cast<double>(allocations.load()) / messages};
+  }
+
+private:
+  void write() {
+    ws_.async_write(net::buffer(out_),
+                    [this](boost::system::error_code ec, std::size_t) {
+                      if (ec) {
+                        return;
+                      }
+                      ++sent_;
+                      if (!duplex_) {
+                        read();
+                      } else if (sent_ < warmup + messages) {
+                        write();
+                      }
+                    });
+  }
+
+  void read() {
+    ws_.async_read(buff_, [this](boost::system::error_code ec, std::size_t) {
+      if (ec) {
+        return;
+      }
+      buff_.consume(buff_.size());
+      if (++received_ == warmup) {
+        allocations = 0;
+        counting = true;
+        start_ = bench_clock::now();
+      }
+      if (received_ == warmup + messages) {
+        counting = false;
+        end_ = bench_clock::now();
+        ws_.close();
+        return;
+      }
+      if (duplex_) {
+        read();
+      } else {
+        write();
+      }
+    });
+  }
+
+  bench_websocket ws_;
+  bool duplex_;
+  std::string out_;
+  std::string in_;
+  net::dynamic_string_buffer<char, std::char_traits<char>,
+                             std::allocator<char>>
+      buff_;
+  int sent_;
+  int received_;
+  bench_clock::time_point start_;
+  bench_clock::time_point end_;
+};
+
+int main() {
+  echo_server server;
+  result r[2];
+  for (int i = 0; i < 2; ++i) {
+    net::io_context ioc(1);
+    client c(ioc, i == 1);
+    r[i] = c.run(ioc, server.url());
+  }
+  std::printf("%-10s %14s %12s\n", "path", "messages/s", "allocs/msg");
+  std::printf("%-10s %14.0f %12.3f\n", "pingpong", r[0].rate, r[0].allocs);
+  std::printf("%-10s %14.0f %12.3f\n", "duplex", r[1].rate, r[1].allocs);
+}
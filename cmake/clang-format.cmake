@@ -1,4 +1,6 @@
 file(GLOB_RECURSE ALL_SOURCE_FILES 
+    benchmarks/*.cpp
+    benchmarks/*.hpp
     examples/*.cpp
     examples/*.hpp
     include/*.cpp
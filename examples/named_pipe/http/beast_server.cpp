@@ -21,6 +21,7 @@
 #include <boost/beast/version.hpp>
 #pragma warning(pop)
 
+#include "boost/winasio/deadline_wheel.hpp"
 #include "boost/winasio/named_pipe/named_pipe_protocol.hpp"
 
 #include <chrono>
@@ -55,12 +56,17 @@ std::time_t now() { return std::time(0); }
 
 class http_connection : public std::enable_shared_from_this<http_connection> {
 public:
-  http_connection(mysocket socket) : socket_(std::move(socket)) {}
+  http_connection(mysocket socket, winnet::deadline_wheel &wheel)
+      : socket_(std::move(socket)), deadline_(wheel, [this] {
+          // Close socket to cancel any outstanding operation.
+          beast::error_code ec;
+          socket_.close(ec);
+        }) {}
 
   // Initiate the asynchronous operations associated with the connection.
   void start() {
+    deadline_.expires_after(std::chrono::seconds(60));
     read_request();
-    check_deadline();
   }
 
 private:
@@ -76,8 +82,9 @@ private:
   // The response message.
   http::response<http::dynamic_body> response_;
 
-  // The timer for putting a deadline on connection processing.
-  net::steady_timer deadline_{socket_.get_executor(), std::chrono::seconds(60)};
+  // The deadline on connection processing. The connections share the timer
+  // of the wheel, the deadline is cancelled when the connection is gone.
+  winnet::deadline deadline_;
 
   // Asynchronously receive a complete request message.
   void read_request() {
@@ -163,26 +170,15 @@ private:
                         self->deadline_.cancel();
                       });
   }
-
-  // Check whether we have spent enough time on this connection.
-  void check_deadline() {
-    auto self = shared_from_this();
-
-    deadline_.async_wait([self](beast::error_code ec) {
-      if (!ec) {
-        // Close socket to cancel any outstanding operation.
-        self->socket_.close(ec);
-      }
-    });
-  }
 };
 
 // "Loop" forever accepting new connections.
-void http_server(myacceptor &acceptor, mysocket &socket) {
+void http_server(myacceptor &acceptor, mysocket &socket,
+                 winnet::deadline_wheel &wheel) {
   acceptor.async_accept(socket, [&](beast::error_code ec) {
     if (!ec)
-      std::make_shared<http_connection>(std::move(socket))->start();
-    http_server(acceptor, socket);
+      std::make_shared<http_connection>(std::move(socket), wheel)->start();
+    http_server(acceptor, socket, wheel);
   });
 }
 
@@ -208,8 +204,11 @@ int main() {
 
     myacceptor acceptor(ioc, "\\\\.\\pipe\\mynamedpipe");
 
+    // deadlines of all connections, checked every second.
+    winnet::deadline_wheel wheel(ioc.get_executor(), std::chrono::seconds(1));
+
     mysocket socket{ioc};
-    http_server(acceptor, socket);
+    http_server(acceptor, socket, wheel);
 
     ioc.run();
   } catch (std::exception const &e) {
@@ -0,0 +1,410 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_WINASIO_DEADLINE_WHEEL_HPP
+#define BOOST_WINASIO_DEADLINE_WHEEL_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+// Deadlines of many connections on a single timer.
+// A hierarchical timer wheel, 4 levels of 64 slots, keeps the armed
+// deadlines in intrusive lists. Arming, re-arming and cancelling a deadline
+// is O(1) and does not allocate, and so is expiring it. The wheel ticks with
+// one steady_timer while deadlines are armed, and expires the deadlines of
+// all elapsed ticks in one batch. A deadline fires up to a tick late, never
+// early.
+// A wheel and its deadlines are not thread safe, they are used from the
+// executor of the wheel, i.e. a strand with a multi threaded io_context.
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace boost {
+namespace winasio {
+
+namespace details {
+
+// node of an intrusive circular list. Unlinked nodes point to themselves,
+// a list is a node used as head.
+struct wheel_node {
+  wheel_node() noexcept : prev(this), next(this) {}
+  wheel_node(const wheel_node &) = delete;
+  wheel_node &operator=(const wheel_node &) = delete;
+
+  bool linked() const noexcept { return next != this; }
+
+  void unlink() noexcept {
+    prev->next = next;
+    next->prev = prev;
+    prev = this;
+    next = this;
+  }
+
+  // appends n to the list of this head.
+  void push_back(wheel_node &n) noexcept {
+    BOOST_ASSERT(!n.linked());
+    n.prev = prev;
+    n.next = this;
+    prev->next = &n;
+    prev = &n;
+  }
+
+  // moves all nodes of the list of this head to the list of other.
+  void splice_to(wheel_node &other) noexcept {
+    if (!linked()) {
+      return;
+    }
+    next->prev = other.prev;
+    prev->next = &other;
+    other.prev->next = next;
+    other.prev = prev;
+    prev = this;
+    next = this;
+  }
+
+  wheel_node *prev;
+  wheel_node *next;
+};
+
+struct wheel_entry : wheel_node {
+  wheel_entry() noexcept : expiry(0), in_wheel(false) {}
+  std::uint64_t expiry;
+  // in a slot, otherwise unlinked or in an expired batch.
+  bool in_wheel;
+};
+
+// The wheel in ticks, without a clock. Entries are placed at the level
+// whose span holds their distance to the current tick, in the slot of
+// their expiry, and moved down a level when the ticks reach that slot.
+class timer_wheel {
+public:
+  static constexpr unsigned level_bits = 6;
+  static constexpr std::size_t slot_count = std::size_t(1) << level_bits;
+  static constexpr std::size_t level_count = 4;
+  // farther entries wait at the end of the last level, and are placed
+  // again when they get there.
+  static constexpr std::uint64_t max_distance =
+      (std::uint64_t(1) << (level_bits * level_count)) - 1;
+
+  explicit timer_wheel(std::uint64_t now = 0) noexcept
+      : current_(now), size_(0) {}
+
+  timer_wheel(const timer_wheel &) = delete;
+  timer_wheel &operator=(const timer_wheel &) = delete;
+
+  // the next tick to expire.
+  std::uint64_t current() const noexcept { return current_; }
+
+  // entries in the wheel.
+  std::size_t size() const noexcept { return size_; }
+
+  // moves an empty wheel to tick now, so that it does not walk the ticks
+  // it was idle for.
+  void reset(std::uint64_t now) noexcept {
+    BOOST_ASSERT(size_ == 0);
+    current_ = now;
+  }
+
+  // e expires at the start of tick expiry, or the current tick if that is
+  // past.
+  void insert(wheel_entry &e, std::uint64_t expiry) noexcept {
+    BOOST_ASSERT(!e.linked());
+    e.expiry = expiry < current_ ? current_ : expiry;
+    e.in_wheel = true;
+    place(e);
+    ++size_;
+  }
+
+  void remove(wheel_entry &e) noexcept {
+    BOOST_ASSERT(e.in_wheel);
+    e.unlink();
+    e.in_wheel = false;
+    --size_;
+  }
+
+  // removes all entries.
+  void clear() noexcept {
+    for (auto &level : slots_) {
+      for (wheel_node &slot : level) {
+        while (slot.linked()) {
+          remove(static_cast<wheel_entry &>(*slot.next));
+        }
+      }
+    }
+  }
+
+  // expires the ticks up to and including to. Expired entries are
+  // appended to expired, in the order of their ticks.
+  void advance(std::uint64_t to, wheel_node &expired) noexcept {
+    while (current_ <= to) {
+      if (size_ == 0) {
+        current_ = to + 1;
+        return;
+      }
+      std::uint64_t t = current_;
+      // the ticks reached the next slot of the upper levels.
+      for (std::size_t level = 1; level < level_count; ++level) {
+        if ((t & mask(level)) != 0) {
+          break;
+        }
+        cascade(slots_[level][index(t, level)]);
+      }
+      wheel_node &slot = slots_[0][index(t, 0)];
+      while (slot.linked()) {
+        wheel_entry &e = static_cast<wheel_entry &>(*slot.next);
+        e.unlink();
+        if (e.expiry > t) {
+          // beyond max_distance when inserted.
+          place(e);
+          continue;
+        }
+        e.in_wheel = false;
+        --size_;
+        expired.push_back(e);
+      }
+      ++current_;
+    }
+  }
+
+private:
+  // the ticks below a slot of level.
+  static std::uint64_t mask(std::size_t level) noexcept {
+    return (std::uint64_t(1) << (level_bits * level)) - 1;
+  }
+
+  static std::size_t index(std::uint64_t tick, std::size_t level) noexcept {
+    return static_cast<std::size_t>(tick >> (level_bits * level)) &
+           (slot_count - 1);
+  }
+
+  void place(wheel_entry &e) noexcept {
+    std::uint64_t at = e.expiry;
+    if (at - current_ > max_distance) {
+      at = current_ + max_distance;
+    }
+    std::uint64_t distance = at - current_;
+    std::size_t level = 0;
+    while (distance > mask(level + 1)) {
+      ++level;
+    }
+    slots_[level][index(at, level)].push_back(e);
+  }
+
+  void cascade(wheel_node &slot) noexcept {
+    wheel_node moved;
+    slot.splice_to(moved);
+    while (moved.linked()) {
+      wheel_entry &e = static_cast<wheel_entry &>(*moved.next);
+      e.unlink();
+      place(e);
+    }
+  }
+
+  std::uint64_t current_;
+  std::size_t size_;
+  wheel_node slots_[level_count][slot_count];
+};
+
+} // namespace details
+
+class deadline;
+
+// The wheel with a clock, see basic_deadline_wheel.
+class deadline_wheel_base {
+public:
+  typedef std::chrono::steady_clock clock_type;
+  typedef clock_type::duration duration;
+  typedef clock_type::time_point time_point;
+
+  deadline_wheel_base(const deadline_wheel_base &) = delete;
+  deadline_wheel_base &operator=(const deadline_wheel_base &) = delete;
+
+  duration tick() const noexcept { return tick_; }
+
+  // armed deadlines.
+  std::size_t size() const noexcept { return wheel_.size(); }
+
+  // deadlines expired so far.
+  std::uint64_t expired() const noexcept { return expired_; }
+
+  // expires the deadlines due at now. Called by the timer of the wheel.
+  void expire(time_point now);
+
+protected:
+  explicit deadline_wheel_base(duration tick)
+      : tick_(tick), start_(clock_type::now()), wheel_(), expired_(0) {
+    BOOST_ASSERT(tick > duration::zero());
+  }
+
+  // disarms the deadlines left.
+  ~deadline_wheel_base() { wheel_.clear(); }
+
+  // time of the next tick to expire.
+  time_point next_tick() const noexcept {
+    return start_ + tick_ * static_cast<duration::rep>(wheel_.current());
+  }
+
+  // the timer must wake the wheel at next_tick().
+  virtual void schedule() = 0;
+
+private:
+  friend class deadline;
+
+  // the last tick that started at or before t.
+  std::uint64_t tick_floor(time_point t) const noexcept {
+    return t <= start_ ? 0 : static_cast<std::uint64_t>((t - start_) / tick_);
+  }
+
+  // the first tick that starts at or after t.
+  std::uint64_t tick_ceil(time_point t) const noexcept {
+    if (t <= start_) {
+      return 0;
+    }
+    duration d = t - start_;
+    return static_cast<std::uint64_t>((d + tick_ - duration(1)) / tick_);
+  }
+
+  void arm(details::wheel_entry &e, time_point at) {
+    bool was_empty = wheel_.size() == 0;
+    if (was_empty) {
+      wheel_.reset(
+          (std::max)(wheel_.current(), tick_floor(clock_type::now())));
+    }
+    wheel_.insert(e, tick_ceil(at));
+    if (was_empty) {
+      schedule();
+    }
+  }
+
+  duration tick_;
+  time_point start_;
+  details::timer_wheel wheel_;
+  std::uint64_t expired_;
+};
+
+// A deadline registered with a wheel. on_expiry runs on the executor of the
+// wheel when an armed deadline expires. It may re-arm, cancel or destroy
+// other deadlines, but must not destroy its own; post that instead.
+// A deadline may outlive its wheel, like a connection freed with the
+// handlers of a stopped io_context, but is not armed again then.
+class deadline : private details::wheel_entry {
+public:
+  deadline(deadline_wheel_base &wheel, std::function<void()> on_expiry)
+      : wheel_(&wheel), on_expiry_(std::move(on_expiry)) {}
+
+  deadline(const deadline &) = delete;
+  deadline &operator=(const deadline &) = delete;
+
+  ~deadline() { cancel(); }
+
+  // arms, or re-arms, the deadline.
+  void expires_at(deadline_wheel_base::time_point at) {
+    cancel();
+    wheel_->arm(*this, at);
+  }
+
+  void expires_after(deadline_wheel_base::duration d) {
+    expires_at(deadline_wheel_base::clock_type::now() + d);
+  }
+
+  // disarms the deadline, also when it expired and waits in the batch.
+  void cancel() noexcept {
+    if (in_wheel) {
+      wheel_->wheel_.remove(*this);
+    } else if (linked()) {
+      unlink();
+    }
+  }
+
+  bool armed() const noexcept { return linked(); }
+
+private:
+  friend class deadline_wheel_base;
+
+  deadline_wheel_base *wheel_;
+  std::function<void()> on_expiry_;
+};
+
+inline void deadline_wheel_base::expire(time_point now) {
+  details::wheel_node batch;
+  wheel_.advance(tick_floor(now), batch);
+  while (batch.linked()) {
+    // unlinked before it runs, so that it may re-arm itself.
+    deadline &d = static_cast<deadline &>(
+        static_cast<details::wheel_entry &>(*batch.next));
+    d.unlink();
+    ++expired_;
+    d.on_expiry_();
+  }
+}
+
+// A deadline wheel ticking on a steady_timer of its executor.
+template <typename Executor = boost::asio::any_io_executor>
+class basic_deadline_wheel : public deadline_wheel_base {
+public:
+  typedef Executor executor_type;
+
+  explicit basic_deadline_wheel(
+      const executor_type &ex,
+      duration tick = std::chrono::milliseconds(100))
+      : deadline_wheel_base(tick), timer_(ex), ticking_(false),
+        alive_(std::make_shared<char>(0)) {}
+
+  ~basic_deadline_wheel() { timer_.cancel(); }
+
+  executor_type get_executor() noexcept { return timer_.get_executor(); }
+
+private:
+  void schedule() override {
+    if (ticking_) {
+      return;
+    }
+    ticking_ = true;
+    timer_.expires_at(next_tick());
+    // the wait may complete after the wheel is gone.
+    std::weak_ptr<char> alive = alive_;
+    timer_.async_wait([this, alive](boost::system::error_code ec) {
+      if (alive.expired()) {
+        return;
+      }
+      ticking_ = false;
+      if (ec) {
+        return;
+      }
+      expire(clock_type::now());
+      if (size() != 0) {
+        schedule();
+      }
+    });
+  }
+
+  boost::asio::basic_waitable_timer<clock_type,
+                                    boost::asio::wait_traits<clock_type>,
+                                    executor_type>
+      timer_;
+  bool ticking_;
+  std::shared_ptr<char> alive_;
+};
+
+typedef basic_deadline_wheel<> deadline_wheel;
+
+} // namespace winasio
+} // namespace boost
+
+#endif // BOOST_WINASIO_DEADLINE_WHEEL_HPP
@@ -12,16 +12,29 @@
 #pragma once
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
 
+#include <boost/winasio/deadline_wheel.hpp>
 #include <boost/winasio/http/basic_http_queue_handle.hpp>
 #include <boost/winasio/http/basic_http_request_context.hpp>
 #include <boost/winasio/http/convert.hpp>
+#include <boost/winasio/http/http_access_log.hpp>
+#include <boost/winasio/http/http_admission.hpp>
 #include <boost/winasio/http/http_asio.hpp>
+#include <boost/winasio/http/http_metrics.hpp>
+#include <boost/winasio/http/http_middleware.hpp>
+#include <boost/winasio/http/http_offload_pool.hpp>
 
 // #include "boost/winasio/http/basic_http_request.hpp"
 // #include "boost/winasio/http/basic_http_response.hpp"
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 
 namespace boost {
 namespace winasio {
@@ -29,48 +42,130 @@ namespace http {
 
 namespace net = boost::asio;
 
-template <typename Executor = net::any_io_executor>
+// Middlewares run around every handler, see http_middleware.hpp. They are
+// shared by io threads and the offload pool, so must be thread safe.
+template <typename Executor = net::any_io_executor, typename... Middlewares>
 class basic_http_controller {
 
 public:
+  using middleware_chain_type = middleware_chain<Middlewares...>;
   using request_context =
-      basic_http_request_context<simple_request, simple_response>;
+      basic_http_request_context<simple_request, simple_response,
+                                 typename middleware_chain_type::state_type>;
   using request_handler = std::function<void(request_context &ctx)>;
 
 public:
   basic_http_controller(basic_http_queue_handle<Executor> &queue,
-                        const std::wstring &url_base)
-      : queue_(queue), base_url_(format_url_base(url_base)) {
+                        const std::wstring &url_base,
+                        Middlewares... middlewares)
+      : queue_(queue), base_url_(format_url_base(url_base)),
+        middlewares_(std::move(middlewares)...),
+        unmatched_metrics_(&metrics_.add_endpoint("unmatched", "*")),
+        timeout_target_(std::make_shared<timeout_target>(this)) {
     //    TODO: need to use http_url_handler to add/remove url
     //    boost::system::error_code ec;
     //    queue_.add_url(url_base, ec);
+    build_shed_response();
+  }
+
+  basic_http_controller(const basic_http_controller &) = delete;
+  basic_http_controller &operator=(const basic_http_controller &) = delete;
+
+  // deadlines of requests still in flight no longer reach the controller.
+  // Waits for offloaded handlers still queued or running on the pool.
+  ~basic_http_controller() {
+    {
+      std::unique_lock<std::mutex> lock(offload_mutex_);
+      offload_cv_.wait(lock, [this] { return offloaded_ == 0; });
+    }
+    std::lock_guard<std::mutex> lock(timeout_target_->mutex);
+    timeout_target_->self = nullptr;
   }
 
   template <typename Handler>
-  void get(const std::wstring &url_part, Handler &&h) {
+  void get(const std::wstring &url_part, Handler &&h,
+           handler_execution exec = handler_execution::inline_io) {
     register_url_part<HTTP_VERB::HttpVerbGET>(url_part,
-                                              std::forward<Handler>(h));
+                                              std::forward<Handler>(h), exec);
   }
 
   template <typename Handler>
-  void post(const std::wstring &url_part, Handler &&h) {
+  void post(const std::wstring &url_part, Handler &&h,
+            handler_execution exec = handler_execution::inline_io) {
 
     register_url_part<HTTP_VERB::HttpVerbPOST>(url_part,
-                                               std::forward<Handler>(h));
+                                               std::forward<Handler>(h), exec);
   }
 
   template <typename Handler>
-  void put(const std::wstring &url_part, Handler &&h) {
+  void put(const std::wstring &url_part, Handler &&h,
+           handler_execution exec = handler_execution::inline_io) {
 
     register_url_part<HTTP_VERB::HttpVerbPUT>(url_part,
-                                              std::forward<Handler>(h));
+                                              std::forward<Handler>(h), exec);
   }
 
   template <typename Handler>
-  void del(const std::wstring &url_part, Handler &&h) {
+  void del(const std::wstring &url_part, Handler &&h,
+           handler_execution exec = handler_execution::inline_io) {
 
     register_url_part<HTTP_VERB::HttpVerbDELETE>(url_part,
-                                                 std::forward<Handler>(h));
+                                                 std::forward<Handler>(h),
+                                                 exec);
+  }
+
+  // Global admission limits. Requests over the limits are answered with a
+  // 503 and Retry-After, without reading the body or invoking handlers.
+  // Call before start().
+  void set_admission(const admission_options &options) {
+    admission_.set_options(options);
+    build_shed_response();
+  }
+
+  // Limits of a single url, shared by all verbs. Call before start().
+  void set_route_limits(const std::wstring &url_part,
+                        const route_limits &limits) {
+    validate_url_part(url_part);
+    routes_[build_url(url_part)].admission.set_limits(limits);
+  }
+
+  const admission_control &get_admission() const { return admission_; }
+
+  middleware_chain_type &get_middlewares() { return middlewares_; }
+
+  const http_metrics &get_metrics() const { return metrics_; }
+
+  // Serve metrics in prometheus text format on GET url_part.
+  void enable_metrics(const std::wstring &url_part) {
+    get(url_part, [this](request_context &ctx) {
+      std::string body;
+      metrics_.write_prometheus(body);
+      ctx.response.set_content_type("text/plain; version=0.0.4");
+      ctx.response.set_body(std::move(body));
+    });
+  }
+
+  // Pool for routes registered with handler_execution::offload.
+  // Without a pool, those handlers run inline. Pool must outlive the
+  // controller. The destructor waits for the offloaded handlers, so they
+  // must not destroy the controller. Call before start().
+  void set_offload_pool(offload_pool &pool) { pool_ = &pool; }
+
+  // Log every response sent. The log must outlive the controller. Call
+  // before start().
+  void set_access_log(access_log &log) { access_log_ = &log; }
+
+  // Cancel requests not responded within timeout of their admission, so
+  // that a slow client does not hold a request forever. http.sys resets
+  // the connection of a cancelled request, which is counted in the
+  // timeouts metric and logged with status 408. The deadlines of
+  // all requests share the wheel, which is used on its executor, i.e. a
+  // strand of the io threads. The wheel must outlive the controller. Call
+  // before start().
+  void set_request_timeout(deadline_wheel &wheel,
+                           deadline_wheel::duration timeout) {
+    wheel_ = &wheel;
+    request_timeout_ = timeout;
   }
 
   void start() { receive_next_request(); }
@@ -94,70 +189,386 @@ private:
   }
 
   template <HTTP_VERB verb, typename Handler>
-  void register_url_part(const std::wstring &url_part, Handler &&h) {
+  void register_url_part(const std::wstring &url_part, Handler &&h,
+                         handler_execution exec) {
     validate_url_part(url_part);
-    register_handler<verb>(build_url(url_part), std::forward<Handler>(h));
+    register_handler<verb>(build_url(url_part), std::forward<Handler>(h),
+                           exec);
   }
 
   template <HTTP_VERB verb, typename Handler>
-  void register_handler(const std::wstring &url, Handler &&h) {
-    handlers_[url][verb] = std::forward<Handler>(h);
+  void register_handler(const std::wstring &url, Handler &&h,
+                        handler_execution exec) {
+    route &r = routes_[url];
+    r.handlers[verb] = std::forward<Handler>(h);
+    r.execution[verb] = exec;
+    if (r.metrics[verb] == nullptr) {
+      r.metrics[verb] = &metrics_.add_endpoint(
+          metrics_label(url.substr(base_url_.size())), verb_name(verb));
+    }
+  }
+
+  static std::string metrics_label(const std::wstring &url_part) {
+    std::string label;
+    label.reserve(url_part.size());
+    for (wchar_t c : url_part) {
+      label += c < 0x80 ? static_cast<char>(c) : '?';
+    }
+    return label;
+  }
+
+  static const char *verb_name(HTTP_VERB verb) {
+    static constexpr const char *names[HTTP_VERB::HttpVerbMaximum] = {
+        "UNPARSED",  "UNKNOWN", "INVALID", "OPTIONS", "GET",
+        "HEAD",      "POST",    "PUT",     "DELETE",  "TRACE",
+        "CONNECT",   "TRACK",   "MOVE",    "COPY",    "PROPFIND",
+        "PROPPATCH", "MKCOL",   "LOCK",    "UNLOCK",  "SEARCH"};
+    return verb < HTTP_VERB::HttpVerbMaximum ? names[verb] : "INVALID";
+  }
+
+  struct route {
+    std::array<request_handler, HTTP_VERB::HttpVerbMaximum> handlers;
+    std::array<handler_execution, HTTP_VERB::HttpVerbMaximum> execution{};
+    std::array<endpoint_metrics *, HTTP_VERB::HttpVerbMaximum> metrics{};
+    route_admission admission;
+  };
+
+  // request in the receive loop, with the bookkeeping of admission.
+  struct pending_request {
+    request_context ctx;
+    route *r = nullptr;
+    admission_clock::time_point received;
+    metrics_clock::time_point send_started;
+    std::size_t more_data = 0;
+    // armed and freed on the executor of the wheel, in the order of
+    // arm_timeout and release.
+    std::unique_ptr<deadline> timeout;
+    // set on the executor of the wheel, so a late arm does not arm.
+    bool released = false;
+    // the deadline cancelled the request.
+    std::atomic<bool> timed_out{false};
+
+    route_admission *admission() {
+      return r == nullptr ? nullptr : &r->admission;
+    }
+  };
+
+  endpoint_metrics &metrics_of(const pending_request &rq) {
+    endpoint_metrics *m = nullptr;
+    if (rq.r != nullptr) {
+      m = rq.r->metrics.at(rq.ctx.request.get_request()->Verb);
+    }
+    return m == nullptr ? *unmatched_metrics_ : *m;
+  }
+
+  // request is done, successfully or not.
+  void release(const std::shared_ptr<pending_request> &rq) {
+    admission_.release(rq->admission());
+    metrics_.in_flight.sub();
+    if (wheel_ != nullptr) {
+      net::dispatch(wheel_->get_executor(), [rq] {
+        rq->released = true;
+        rq->timeout.reset();
+      });
+    }
+  }
+
+  // the controller as seen by deadlines, which may expire while it is
+  // destroyed on another thread.
+  struct timeout_target {
+    explicit timeout_target(basic_http_controller *c) : self(c) {}
+    std::mutex mutex;
+    basic_http_controller *self;
+  };
+
+  void arm_timeout(const std::shared_ptr<pending_request> &rq) {
+    if (wheel_ == nullptr) {
+      return;
+    }
+    net::dispatch(wheel_->get_executor(), [this, rq] {
+      // the request was released before this ran.
+      if (rq->released) {
+        return;
+      }
+      // the deadline belongs to the request, so it holds no reference.
+      pending_request *p = rq.get();
+      std::weak_ptr<timeout_target> target = timeout_target_;
+      p->timeout = std::make_unique<deadline>(*wheel_, [target, p] {
+        auto t = target.lock();
+        if (!t) {
+          return;
+        }
+        std::lock_guard<std::mutex> lock(t->mutex);
+        if (t->self != nullptr) {
+          t->self->on_timeout(*p);
+        }
+      });
+      p->timeout->expires_after(request_timeout_);
+    });
+  }
+
+  // http.sys resets the connection, the pending receive or send of the
+  // request fails and logs the request as 408.
+  void on_timeout(pending_request &rq) {
+    metrics_.timeouts.add();
+    rq.timed_out.store(true, std::memory_order_relaxed);
+    boost::system::error_code ec;
+    queue_.cancel_request(rq.ctx.request.get_request_id(), ec);
+    if (ec) {
+      spdlog::debug("cancel_request failed: {}", ec.message());
+    }
+  }
+
+  void build_shed_response() {
+    shed_response_ = simple_response();
+    shed_response_.set_status_code(503);
+    shed_response_.set_reason("Service Unavailable");
+    shed_response_.add_known_header(
+        HttpHeaderRetryAfter,
+        std::to_string(admission_.options().retry_after.count()));
+    // The response is built once and shared by all shed requests, since
+    // http.sys only reads from it.
+    shed_response_ptr_ = shed_response_.get_response();
+  }
+
+  void send_shed_response(const std::shared_ptr<pending_request> &rq) {
+    metrics_.shed.add();
+    queue_.async_send_response(
+        shed_response_ptr_, rq->ctx.request.get_request_id(),
+        HTTP_SEND_RESPONSE_FLAG_DISCONNECT,
+        [this, rq](const boost::system::error_code &ec, size_t) {
+          if (!ec) {
+            log_access(*rq, 503, 0);
+          }
+        });
+  }
+
+  // runs on the send completion, after the response is out.
+  void log_access(const pending_request &rq, USHORT status,
+                  std::size_t response_bytes) {
+    if (access_log_ == nullptr) {
+      return;
+    }
+    auto *prq = rq.ctx.request.get_request();
+    access_log_record r;
+    r.time = std::chrono::system_clock::now();
+    const SOCKADDR *addr = prq->Address.pRemoteAddress;
+    if (addr != nullptr && addr->sa_family == AF_INET) {
+      auto *in = reinterpret_cast<const SOCKADDR_IN *>(addr);
+      r.family = 4;
+      std::memcpy(r.address.data(), &in->sin_addr, 4);
+      r.port = ntohs(in->sin_port);
+    } else if (addr != nullptr && addr->sa_family == AF_INET6) {
+      auto *in6 = reinterpret_cast<const SOCKADDR_IN6 *>(addr);
+      r.family = 6;
+      std::memcpy(r.address.data(), &in6->sin6_addr, 16);
+      r.port = ntohs(in6->sin6_port);
+    }
+    r.verb = verb_name(prq->Verb);
+    r.set_path(std::string_view(prq->pRawUrl, prq->RawUrlLength));
+    r.status = status;
+    r.request_bytes = rq.ctx.request.get_body_string_veiw().size();
+    r.response_bytes = response_bytes;
+    r.latency = admission_clock::now() - rq.received;
+    access_log_->log(r);
+  }
+
+  route *find_route(const simple_request &request) {
+    auto *prq = request.get_request();
+    const auto *url_b = prq->CookedUrl.pFullUrl;
+    const auto *url_e =
+        prq->CookedUrl.pQueryString == nullptr
+            ? prq->CookedUrl.pFullUrl + (prq->CookedUrl.FullUrlLength /
+                                         sizeof(std::wstring::value_type))
+            : prq->CookedUrl.pQueryString;
+
+    auto it = routes_.find(std::wstring(url_b, url_e));
+    if (it == routes_.end()) {
+      return nullptr;
+    }
+    return &it->second;
   }
 
   void receive_next_request() {
     // We want the request to stay const after, but when
     // we read into it, it's okay.
-    auto rq = std::make_shared<request_context>();
+    auto rq = std::make_shared<pending_request>();
     http::async_receive(
         queue_,
-        const_cast<simple_request &>(rq->request).get_request_dynamic_buffer(),
+        const_cast<simple_request &>(rq->ctx.request)
+            .get_request_dynamic_buffer(),
+        &rq->more_data,
         [this, rq](const boost::system::error_code &ec, size_t) {
           receive_next_request();
-          if (ec)
+          metrics_.receive_more_data.add(
+              static_cast<std::int64_t>(rq->more_data));
+          if (ec) {
+            metrics_.receive_errors.add();
+            return;
+          }
+          rq->r = find_route(rq->ctx.request);
+          rq->received = admission_clock::now();
+          if (admission_.admit(rq->admission(), rq->received) !=
+              admission_result::admitted) {
+            send_shed_response(rq);
             return;
+          }
+          metrics_.in_flight.add();
+          arm_timeout(rq);
           http::async_receive_body(
-              queue_, rq->request.get_request_id(),
-              const_cast<simple_request &>(rq->request)
+              queue_, rq->ctx.request.get_request_id(),
+              const_cast<simple_request &>(rq->ctx.request)
                   .get_body_dynamic_buffer(),
               [this, rq](const boost::system::error_code &ec, size_t) {
-                if (!ec)
-                  dispatch(*rq);
+                if (ec) {
+                  if (rq->timed_out.load(std::memory_order_relaxed)) {
+                    log_access(*rq, 408, 0);
+                    release(rq);
+                    return;
+                  }
+                  // http.sys still waits for a response.
+                  metrics_.receive_errors.add();
+                  rq->ctx.response.set_status_code(400);
+                  rq->ctx.response.set_reason("Bad Request");
+                  send_response(rq);
+                  return;
+                }
+                metrics_.request_body_bytes.add(static_cast<std::int64_t>(
+                    rq->ctx.request.get_body_string_veiw().size()));
+                metrics_of(*rq).observe(metrics_phase::receive,
+                                        metrics_clock::now() - rq->received);
+                dispatch(rq);
               });
         });
   }
 
-  void dispatch(request_context &rq) {
+  void dispatch(const std::shared_ptr<pending_request> &rq) {
+    request_context &ctx = rq->ctx;
+    if (admission_.check_queue_time(rq->received, admission_clock::now()) !=
+        admission_result::admitted) {
+      release(rq);
+      send_shed_response(rq);
+      return;
+    }
 
-    auto *prq = rq.request.get_request();
-    const auto *url_b = prq->CookedUrl.pFullUrl;
-    const auto *url_e =
-        prq->CookedUrl.pQueryString == nullptr
-            ? prq->CookedUrl.pFullUrl + (prq->CookedUrl.FullUrlLength /
-                                         sizeof(std::wstring::value_type))
-            : prq->CookedUrl.pQueryString;
+    auto *prq = ctx.request.get_request();
+    if (rq->r == nullptr || rq->r->handlers.at(prq->Verb) == nullptr) {
+      // middlewares still see unknown urls, i.e. for logging.
+      invoke(rq, [](request_context &c) {
+        c.response.set_status_code(404);
+        c.response.set_reason("Not found");
+      });
+      send_response(rq);
+      return;
+    }
 
-    std::wstring url(url_b, url_e);
+    ctx.response.set_status_code(200); // default to 200
+    if (pool_ != nullptr &&
+        rq->r->execution.at(prq->Verb) == handler_execution::offload) {
+      offload_started();
+      bool ok = pool_->try_submit([this, rq] {
+        // the controller may be destroyed right after.
+        struct finished {
+          basic_http_controller *self;
+          ~finished() { self->offload_finished(); }
+        } guard{this};
+        try {
+          invoke(rq, rq->r->handlers.at(rq->ctx.request.get_request()->Verb));
+        } catch (const std::exception &e) {
+          spdlog::error("offloaded handler failed: {}", e.what());
+          set_internal_error(rq->ctx.response);
+        } catch (...) {
+          spdlog::error("offloaded handler failed");
+          set_internal_error(rq->ctx.response);
+        }
+        // always answered, so that the request is released.
+        // send from the io executor, so that pool threads only run handlers.
+        net::post(queue_.get_executor(), [this, rq] { send_response(rq); });
+      });
+      if (!ok) {
+        // pool is saturated.
+        offload_finished();
+        release(rq);
+        send_shed_response(rq);
+      }
+      return;
+    }
+    invoke(rq, rq->r->handlers.at(prq->Verb));
+    send_response(rq);
+  }
 
-    if (handlers_.find(url) == handlers_.end() ||
-        handlers_[url].at(prq->Verb) == nullptr) {
-      rq.response.set_status_code(404);
-      rq.response.set_reason("Not found");
-    } else {
-      rq.response.set_status_code(200); // default to 200
-      handlers_[url].at(prq->Verb)(rq);
+  void offload_started() {
+    std::lock_guard<std::mutex> lock(offload_mutex_);
+    ++offloaded_;
+  }
+
+  void offload_finished() {
+    std::lock_guard<std::mutex> lock(offload_mutex_);
+    if (--offloaded_ == 0) {
+      offload_cv_.notify_all();
     }
+  }
+
+  // run middlewares and handler, and measure them.
+  template <typename Handler>
+  void invoke(const std::shared_ptr<pending_request> &rq, Handler &&handler) {
+    auto start = metrics_clock::now();
+    middlewares_(rq->ctx, handler);
+    metrics_of(*rq).observe(metrics_phase::handler,
+                            metrics_clock::now() - start);
+  }
+
+  // replaces whatever the handler left in the response.
+  static void set_internal_error(simple_response &response) {
+    response = simple_response();
+    response.set_status_code(500);
+    response.set_reason("Internal Server Error");
+  }
+
+  void send_response(const std::shared_ptr<pending_request> &rq) {
+    request_context &ctx = rq->ctx;
+    rq->send_started = metrics_clock::now();
     queue_.async_send_response(
-        rq.response.get_response(), rq.request.get_request_id(),
+        ctx.response.get_response(), ctx.request.get_request_id(),
         HTTP_SEND_RESPONSE_FLAG_DISCONNECT,
-        [rq](const boost::system::error_code &, size_t) {});
+        [this, rq](const boost::system::error_code &ec, size_t) {
+          if (ec) {
+            metrics_.send_errors.add();
+            if (rq->timed_out.load(std::memory_order_relaxed)) {
+              log_access(*rq, 408, 0);
+            }
+          } else {
+            metrics_.response_body_bytes.add(static_cast<std::int64_t>(
+                rq->ctx.response.get_body_size()));
+            log_access(*rq, rq->ctx.response.get_status_code(),
+                       rq->ctx.response.get_body_size());
+          }
+          metrics_of(*rq).observe(metrics_phase::send,
+                                  metrics_clock::now() - rq->send_started);
+          release(rq);
+        });
   }
 
 private:
-  std::map<std::wstring,
-           std::array<request_handler, HTTP_VERB::HttpVerbMaximum>>
-      handlers_;
+  std::map<std::wstring, route> routes_;
   const std::wstring base_url_;
   basic_http_queue_handle<Executor> &queue_;
+  admission_control admission_;
+  simple_response shed_response_;
+  PHTTP_RESPONSE shed_response_ptr_ = nullptr;
+  offload_pool *pool_ = nullptr;
+  // offloaded handlers not finished yet, the destructor waits for them.
+  std::mutex offload_mutex_;
+  std::condition_variable offload_cv_;
+  std::size_t offloaded_ = 0;
+  access_log *access_log_ = nullptr;
+  deadline_wheel *wheel_ = nullptr;
+  deadline_wheel::duration request_timeout_{};
+  middleware_chain_type middlewares_;
+  http_metrics metrics_;
+  // requests without a route or handler.
+  endpoint_metrics *unmatched_metrics_;
+  std::shared_ptr<timeout_target> timeout_target_;
 };
 
 } // namespace http
@@ -18,6 +18,9 @@
 #include <boost/asio/windows/basic_overlapped_handle.hpp>
 #include <boost/asio/windows/overlapped_ptr.hpp>
 
+#include <boost/winasio/overlapped_cancellation.hpp>
+#include <boost/winasio/trace.hpp>
+
 #include <spdlog/spdlog.h>
 
 #include <iostream>
@@ -80,6 +83,10 @@ public:
     return *this;
   }
 
+  // The async ops are cancelled through the cancellation slot of their
+  // handler with CancelIoEx, and complete with
+  // net::error::operation_aborted. The queue stays usable.
+
   template <BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
                                                  std::size_t)) ReadHandler
                 BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
@@ -93,8 +100,10 @@ public:
           handler BOOST_ASIO_DEFAULT_COMPLETION_TOKEN(executor_type)) {
     spdlog::debug("async_recieve_request buff len {}", RequestBufferLength);
 
-    boost::asio::windows::overlapped_ptr optr(this->get_executor(),
-                                              std::move(handler));
+    winasio::details::cancellable_overlapped_ptr optr(
+        this->get_executor(), this->native_handle(),
+        BOOST_WINASIO_TRACE_HANDLER(http_receive_request, RequestBufferLength,
+                                    std::move(handler)));
     ULONG result =
         HttpReceiveHttpRequest(this->native_handle(), // Req Queue
                                RequestId,             // Req ID
@@ -144,8 +153,10 @@ public:
           handler BOOST_ASIO_DEFAULT_COMPLETION_TOKEN(executor_type)) {
 
     spdlog::debug("async_recieve_body buff len {}", EntityBufferLength);
-    boost::asio::windows::overlapped_ptr optr(this->get_executor(),
-                                              std::move(handler));
+    winasio::details::cancellable_overlapped_ptr optr(
+        this->get_executor(), this->native_handle(),
+        BOOST_WINASIO_TRACE_HANDLER(http_receive_body, EntityBufferLength,
+                                    std::move(handler)));
     DWORD result =
         HttpReceiveRequestEntityBody(this->native_handle(), RequestId, Flags,
                                      EntityBuffer, EntityBufferLength,
@@ -178,7 +189,9 @@ public:
           handler BOOST_ASIO_DEFAULT_COMPLETION_TOKEN(executor_type)) {
 
     spdlog::debug("async_send_response");
-    boost::asio::windows::overlapped_ptr optr(this->get_executor(), handler);
+    winasio::details::cancellable_overlapped_ptr optr(
+        this->get_executor(), this->native_handle(),
+        BOOST_WINASIO_TRACE_HANDLER(http_send_response, 0, handler));
     DWORD result = HttpSendHttpResponse(
         this->native_handle(), // ReqQueueHandle
         requestId,             // Request ID
@@ -228,6 +241,16 @@ public:
                                    boost::asio::error::get_system_category());
   }
 
+  // Cancels the pending io of a request, i.e. at its deadline. The request
+  // is aborted, its receives and sends complete with an error.
+  void cancel_request(HTTP_REQUEST_ID requestId,
+                      boost::system::error_code &ec) {
+    DWORD result =
+        HttpCancelHttpRequest(this->native_handle(), requestId, NULL);
+    ec = boost::system::error_code(result,
+                                   boost::asio::error::get_system_category());
+  }
+
   void shutdown(boost::system::error_code &ec) {
     DWORD result = HttpShutdownRequestQueue(this->native_handle());
     ec = boost::system::error_code(result,
@@ -12,15 +12,19 @@
 #pragma once
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
 
+#include <tuple>
+
 namespace boost {
 namespace winasio {
 namespace http {
 
-template <typename RequestT, typename ResponseT>
+// StateT holds per request state of controller middlewares.
+template <typename RequestT, typename ResponseT, typename StateT = std::tuple<>>
 struct basic_http_request_context {
 
   const RequestT request;
   ResponseT response;
+  StateT state;
 };
 } // namespace http
 } // namespace winasio
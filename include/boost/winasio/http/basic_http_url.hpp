@@ -44,6 +44,8 @@ public:
   basic_http_url(basic_http_url &&) = delete;
   basic_http_url &operator=(basic_http_url &&) = delete;
 
+  url_handler<Executor, Http_Ver> &get_url_handler() { return url_handler_; }
+
 private:
   basic_http_queue_handle<executor_type> &queue_handle_;
   std::wstring url_;
@@ -159,9 +159,13 @@ public:
     status_code_ = status_code;
   }
 
+  inline USHORT get_status_code() const { return status_code_; }
+
   // use std::move to move body into response if needed.
   inline void set_body(std::string body) { body_ = std::move(body); }
 
+  inline std::size_t get_body_size() const { return body_.size(); }
+
   inline void add_known_header(HTTP_HEADER_ID id, std::string data) {
     this->known_headers_[id] = std::move(data);
   }
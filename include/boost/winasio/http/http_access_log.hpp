@@ -0,0 +1,447 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_WINASIO_HTTP_ACCESS_LOG_HPP
+#define BOOST_WINASIO_HTTP_ACCESS_LOG_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+// Access log of the controller.
+// Request threads push fixed size records into their own single producer
+// ring. Only the first record of a thread takes a lock, to register its
+// ring, afterwards logging never blocks or allocates. A background thread
+// drains the rings, formats records in batches and appends them to a
+// spdlog rotating file sink. The rings of exited threads are dropped once
+// drained.
+// Records are dropped and counted when a ring is full.
+
+#include <spdlog/pattern_formatter.h>
+#include <spdlog/sinks/rotating_file_sink.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace boost {
+namespace winasio {
+namespace http {
+
+struct access_log_record {
+  static constexpr std::size_t max_path = 128;
+
+  std::chrono::system_clock::time_point time;
+  // remote address, family is 4 or 6. 0 if unknown.
+  std::uint8_t family = 0;
+  std::array<std::uint8_t, 16> address{};
+  std::uint16_t port = 0;
+  // static string, not owned.
+  const char *verb = "-";
+  // raw url, truncated to max_path.
+  std::array<char, max_path> path{};
+  std::uint8_t path_length = 0;
+  std::uint16_t status = 0;
+  std::uint64_t request_bytes = 0;
+  std::uint64_t response_bytes = 0;
+  std::chrono::nanoseconds latency{0};
+
+  void set_path(std::string_view p) noexcept {
+    path_length = static_cast<std::uint8_t>(std::min(p.size(), max_path));
+    std::copy_n(p.data(), path_length, path.data());
+  }
+};
+
+struct access_log_options {
+  std::filesystem::path file;
+  // file is rotated when it would exceed this size, as spdlog names them:
+  // access.log to access.1.log, access.2.log, ...
+  std::uintmax_t max_file_size = 64 * 1024 * 1024;
+  // number of rotated files kept.
+  std::size_t max_files = 5;
+  // records buffered per thread. Rounded up to a power of 2.
+  std::size_t ring_capacity = 4096;
+  // how often the writer drains the rings.
+  std::chrono::milliseconds flush_interval{200};
+};
+
+namespace detail {
+
+// bounded single producer single consumer ring.
+template <typename T> class spsc_ring {
+public:
+  explicit spsc_ring(std::size_t capacity)
+      : mask_(round_up(capacity) - 1), items_(mask_ + 1), head_(0), tail_(0) {}
+
+  // producer only.
+  bool try_push(const T &item) noexcept {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) {
+      return false;
+    }
+    items_[tail & mask_] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only.
+  template <typename F> std::size_t drain(F &&f) {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    std::size_t tail = tail_.load(std::memory_order_acquire);
+    for (std::size_t i = head; i != tail; ++i) {
+      f(items_[i & mask_]);
+    }
+    head_.store(tail, std::memory_order_release);
+    return tail - head;
+  }
+
+private:
+  static std::size_t round_up(std::size_t n) {
+    std::size_t r = 1;
+    while (r < n) {
+      r <<= 1;
+    }
+    return r;
+  }
+
+  const std::size_t mask_;
+  std::vector<T> items_;
+  alignas(64) std::atomic<std::size_t> head_;
+  alignas(64) std::atomic<std::size_t> tail_;
+};
+
+} // namespace detail
+
+class access_log {
+public:
+  explicit access_log(access_log_options options)
+      : options_(std::move(options)), written_(0), retired_dropped_(0),
+        stopped_(false), id_(next_id()) {
+    open_sink();
+    writer_ = std::thread([this] { run(); });
+  }
+
+  access_log(const access_log &) = delete;
+  access_log &operator=(const access_log &) = delete;
+
+  ~access_log() { stop(); }
+
+  // Never blocks. Returns false and counts the record as dropped if the
+  // ring of this thread is full, or the log is stopped.
+  bool log(const access_log_record &record) noexcept {
+    producer *p = local_producer();
+    if (p == nullptr) {
+      unregistered_dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    // Announced before the closed check, and the writer waits for it before
+    // its last drain. Either this sees closed, or the drain sees the record.
+    p->pushing.fetch_add(1, std::memory_order_seq_cst);
+    if (p->closed.load(std::memory_order_seq_cst)) {
+      p->pushing.fetch_sub(1, std::memory_order_relaxed);
+      unregistered_dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    bool pushed = p->ring.try_push(record);
+    if (!pushed) {
+      p->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    p->pushing.fetch_sub(1, std::memory_order_release);
+    return pushed;
+  }
+
+  // write the remaining records and stop the writer.
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      if (stopped_) {
+        return;
+      }
+      stopped_ = true;
+      // before the last drain of the writer, so that later records are
+      // dropped instead of left in the rings. Also lets threads forget
+      // this log.
+      for (auto &p : producers_) {
+        p->closed.store(true, std::memory_order_seq_cst);
+      }
+    }
+    cv_.notify_all();
+    if (writer_.joinable()) {
+      writer_.join();
+    }
+    sink_.reset();
+  }
+
+  std::uint64_t dropped() const {
+    std::uint64_t n = unregistered_dropped_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lk(m_);
+    n += retired_dropped_;
+    for (const auto &p : producers_) {
+      n += p->dropped.load(std::memory_order_relaxed);
+    }
+    return n;
+  }
+
+  std::uint64_t written() const {
+    return written_.load(std::memory_order_relaxed);
+  }
+
+  // format a record as a single line, without the line break.
+  static void format(std::string &out, const access_log_record &r) {
+    char buf[96];
+    auto secs = std::chrono::time_point_cast<std::chrono::seconds>(r.time);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(r.time -
+                                                                    secs)
+                  .count();
+    std::time_t t = std::chrono::system_clock::to_time_t(secs);
+    std::tm tm{};
+#ifdef _WIN32
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+    std::size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    std::snprintf(buf + n, sizeof(buf) - n, ".%03dZ ", static_cast<int>(ms));
+    out += buf;
+
+    append_address(out, r);
+    out += ' ';
+    out += r.verb;
+    out += ' ';
+    if (r.path_length == 0) {
+      out += '-';
+    } else {
+      out.append(r.path.data(), r.path_length);
+    }
+    std::snprintf(buf, sizeof(buf), " %u %llu %llu %.3fms",
+                  static_cast<unsigned>(r.status),
+                  static_cast<unsigned long long>(r.request_bytes),
+                  static_cast<unsigned long long>(r.response_bytes),
+                  std::chrono::duration<double, std::milli>(r.latency).count());
+    out += buf;
+  }
+
+private:
+  struct producer {
+    explicit producer(std::uint64_t id, std::size_t capacity)
+        : log_id(id), ring(capacity), dropped(0), pushing(0),
+          exited(false), closed(false) {}
+    const std::uint64_t log_id;
+    detail::spsc_ring<access_log_record> ring;
+    std::atomic<std::uint64_t> dropped;
+    // log() calls past the closed check.
+    std::atomic<std::uint32_t> pushing;
+    // the thread is gone, set after its last push.
+    std::atomic<bool> exited;
+    // the log is stopped.
+    std::atomic<bool> closed;
+  };
+
+  // The rings of a thread, one per log it used. Marks them exited when the
+  // thread ends.
+  struct thread_producers {
+    std::vector<std::shared_ptr<producer>> rings;
+    producer *last = nullptr;
+
+    ~thread_producers() {
+      for (auto &p : rings) {
+        p->exited.store(true, std::memory_order_release);
+      }
+    }
+  };
+
+  static std::uint64_t next_id() {
+    static std::atomic<std::uint64_t> id{1};
+    return id.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // The ring of the calling thread. The last used ring is cached thread
+  // locally, the lock is only taken when a thread first logs to a log. The
+  // writer holds it only to copy the list of rings.
+  producer *local_producer() noexcept {
+    static thread_local thread_producers tp;
+    if (tp.last != nullptr && tp.last->log_id == id_) {
+      return tp.last;
+    }
+    try {
+      // forget stopped logs.
+      tp.rings.erase(std::remove_if(tp.rings.begin(), tp.rings.end(),
+                                    [](const auto &p) {
+                                      return p->closed.load(
+                                          std::memory_order_relaxed);
+                                    }),
+                     tp.rings.end());
+      tp.last = nullptr;
+      for (auto &p : tp.rings) {
+        if (p->log_id == id_) {
+          tp.last = p.get();
+          return tp.last;
+        }
+      }
+      auto p = std::make_shared<producer>(id_, options_.ring_capacity);
+      tp.rings.push_back(p);
+      {
+        std::lock_guard<std::mutex> lk(m_);
+        if (stopped_) {
+          tp.rings.pop_back();
+          return nullptr;
+        }
+        producers_.push_back(p);
+      }
+      tp.last = p.get();
+      return tp.last;
+    } catch (...) {
+      return nullptr;
+    }
+  }
+
+  static void append_address(std::string &out, const access_log_record &r) {
+    char buf[64];
+    if (r.family == 4) {
+      std::snprintf(buf, sizeof(buf), "%u.%u.%u.%u:%u", r.address[0],
+                    r.address[1], r.address[2], r.address[3],
+                    static_cast<unsigned>(r.port));
+      out += buf;
+    } else if (r.family == 6) {
+      out += '[';
+      for (std::size_t i = 0; i < 16; i += 2) {
+        std::snprintf(buf, sizeof(buf), i == 0 ? "%x" : ":%x",
+                      (r.address[i] << 8) | r.address[i + 1]);
+        out += buf;
+      }
+      std::snprintf(buf, sizeof(buf), "]:%u", static_cast<unsigned>(r.port));
+      out += buf;
+    } else {
+      out += '-';
+    }
+  }
+
+  void open_sink() {
+    try {
+#ifdef SPDLOG_WCHAR_FILENAMES
+      spdlog::filename_t name = options_.file.wstring();
+#else  // SPDLOG_WCHAR_FILENAMES
+      spdlog::filename_t name = options_.file.string();
+#endif // SPDLOG_WCHAR_FILENAMES
+      sink_ = std::make_unique<spdlog::sinks::rotating_file_sink_st>(
+          name, static_cast<std::size_t>(options_.max_file_size),
+          options_.max_files);
+      // records are formatted by format().
+      sink_->set_formatter(std::make_unique<spdlog::pattern_formatter>(
+          "%v", spdlog::pattern_time_type::local, "\n"));
+    } catch (const spdlog::spdlog_ex &e) {
+      spdlog::error("Failed to open access log: {} {}",
+                    options_.file.string(), e.what());
+    }
+  }
+
+  // Drains all rings and writes their records. The list of rings is copied
+  // under the lock, formatting and writing are done without it. Rings of
+  // exited threads are removed once drained. The last batch, after the
+  // rings are closed, waits for the pushes in progress.
+  void write_batch(std::vector<std::shared_ptr<producer>> &batch,
+                   std::string &line, bool last) {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      batch = producers_;
+    }
+    std::uint64_t count = 0;
+    bool retire = false;
+    for (auto &p : batch) {
+      // read before the drain, which then sees every record of the thread.
+      bool exited = p->exited.load(std::memory_order_acquire);
+      while (last && p->pushing.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+      }
+      count += p->ring.drain([this, &line](const access_log_record &r) {
+        if (sink_ == nullptr) {
+          return;
+        }
+        line.clear();
+        format(line, r);
+        sink_->log(spdlog::details::log_msg(
+            spdlog::string_view_t(), spdlog::level::info,
+            spdlog::string_view_t(line.data(), line.size())));
+      });
+      if (!exited) {
+        p.reset();
+      }
+      retire = retire || exited;
+    }
+    if (count != 0 && sink_ != nullptr) {
+      sink_->flush();
+      written_.fetch_add(count, std::memory_order_relaxed);
+    }
+    if (retire) {
+      // batch now holds the rings drained after their thread exited.
+      std::lock_guard<std::mutex> lk(m_);
+      auto it = std::remove_if(
+          producers_.begin(), producers_.end(), [this, &batch](const auto &p) {
+            if (std::find(batch.begin(), batch.end(), p) == batch.end()) {
+              return false;
+            }
+            retired_dropped_ += p->dropped.load(std::memory_order_relaxed);
+            return true;
+          });
+      producers_.erase(it, producers_.end());
+    }
+    batch.clear();
+  }
+
+  void run() {
+    std::vector<std::shared_ptr<producer>> batch;
+    std::string line;
+    for (;;) {
+      bool stopped;
+      {
+        std::unique_lock<std::mutex> lk(m_);
+        // producers do not notify, so that they never touch the lock.
+        cv_.wait_for(lk, options_.flush_interval, [this] { return stopped_; });
+        stopped = stopped_;
+      }
+      write_batch(batch, line, stopped);
+      if (stopped) {
+        return;
+      }
+    }
+  }
+
+  const access_log_options options_;
+  // used by the writer thread only.
+  std::unique_ptr<spdlog::sinks::rotating_file_sink_st> sink_;
+  std::atomic<std::uint64_t> written_;
+  // dropped without a ring, or after stop.
+  std::atomic<std::uint64_t> unregistered_dropped_{0};
+  // dropped by the rings of exited threads.
+  std::uint64_t retired_dropped_;
+  bool stopped_;
+  const std::uint64_t id_;
+  mutable std::mutex m_;
+  std::condition_variable cv_;
+  std::vector<std::shared_ptr<producer>> producers_;
+  std::thread writer_;
+};
+
+} // namespace http
+} // namespace winasio
+} // namespace boost
+
+#endif // BOOST_WINASIO_HTTP_ACCESS_LOG_HPP
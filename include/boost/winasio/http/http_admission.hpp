@@ -0,0 +1,231 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_WINASIO_HTTP_ADMISSION_HPP
+#define BOOST_WINASIO_HTTP_ADMISSION_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+// Admission control used by the controller receive loop.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace boost {
+namespace winasio {
+namespace http {
+
+using admission_clock = std::chrono::steady_clock;
+
+// limits applied to a single route (url). 0 means unlimited.
+struct route_limits {
+  // max requests of this route being processed at the same time.
+  std::size_t max_in_flight = 0;
+  // sustained requests per second allowed for this route.
+  double rate = 0;
+  // number of requests allowed to burst above the rate.
+  double burst = 1;
+};
+
+// limits applied to the whole controller. 0 means unlimited.
+struct admission_options {
+  // max requests being processed at the same time, across all routes.
+  std::size_t max_in_flight = 0;
+  // requests waiting longer than this between receiving the headers and
+  // invoking the handler are shed.
+  std::chrono::milliseconds max_queue_time{0};
+  // value of Retry-After header in the shed response.
+  std::chrono::seconds retry_after{1};
+};
+
+enum class admission_result {
+  admitted,
+  global_limit,
+  route_limit,
+  rate_limited,
+  queue_timeout
+};
+
+// Token bucket implemented as GCRA (generic cell rate algorithm).
+// The whole state is a single atomic, the theoretical arrival time, so
+// acquire is lock free.
+class token_bucket {
+public:
+  token_bucket() : interval_ns_(0), tolerance_ns_(0), tat_ns_(0) {}
+
+  void set_rate(double rate, double burst) {
+    if (rate <= 0) {
+      interval_ns_ = 0;
+      tolerance_ns_ = 0;
+      return;
+    }
+    if (burst < 1) {
+      burst = 1;
+    }
+    interval_ns_ = static_cast<std::int64_t>(1e9 / rate);
+    tolerance_ns_ = static_cast<std::int64_t>(interval_ns_ * (burst - 1));
+  }
+
+  bool unlimited() const noexcept { return interval_ns_ == 0; }
+
+  bool try_acquire(admission_clock::time_point now) noexcept {
+    if (unlimited()) {
+      return true;
+    }
+    const std::int64_t now_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now.time_since_epoch())
+            .count();
+    std::int64_t tat = tat_ns_.load(std::memory_order_relaxed);
+    for (;;) {
+      const std::int64_t base = tat > now_ns ? tat : now_ns;
+      if (base - now_ns > tolerance_ns_) {
+        return false;
+      }
+      if (tat_ns_.compare_exchange_weak(tat, base + interval_ns_,
+                                        std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+  }
+
+private:
+  std::int64_t interval_ns_;
+  std::int64_t tolerance_ns_;
+  std::atomic<std::int64_t> tat_ns_;
+};
+
+// counts in flight requests against a limit.
+class in_flight_limiter {
+public:
+  in_flight_limiter() : max_(0), count_(0) {}
+
+  void set_max(std::size_t max) noexcept { max_ = max; }
+
+  bool try_acquire() noexcept {
+    std::size_t prev = count_.fetch_add(1, std::memory_order_relaxed);
+    if (max_ != 0 && prev >= max_) {
+      count_.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  void release() noexcept { count_.fetch_sub(1, std::memory_order_relaxed); }
+
+  std::size_t count() const noexcept {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::size_t max_;
+  std::atomic<std::size_t> count_;
+};
+
+// per route admission state. Must outlive all requests of the route.
+class route_admission {
+public:
+  void set_limits(const route_limits &limits) {
+    in_flight_.set_max(limits.max_in_flight);
+    bucket_.set_rate(limits.rate, limits.burst);
+  }
+
+  in_flight_limiter &in_flight() noexcept { return in_flight_; }
+  token_bucket &bucket() noexcept { return bucket_; }
+
+private:
+  in_flight_limiter in_flight_;
+  token_bucket bucket_;
+};
+
+// Decides whether a request is processed or shed.
+// admit() is called when request headers arrive, and every admitted request
+// must be paired with a release() when its response is sent.
+class admission_control {
+public:
+  admission_control()
+      : options_(), global_(), shed_count_(0), admitted_count_(0) {}
+
+  // not thread safe. Call before requests are received.
+  void set_options(const admission_options &options) {
+    options_ = options;
+    global_.set_max(options.max_in_flight);
+  }
+
+  const admission_options &options() const noexcept { return options_; }
+
+  // route can be null if the request does not match any route.
+  admission_result admit(route_admission *route,
+                         admission_clock::time_point now) noexcept {
+    if (!global_.try_acquire()) {
+      return shed(admission_result::global_limit);
+    }
+    if (route != nullptr) {
+      // the rate token is spent last, a request shed by a limit keeps it.
+      if (!route->in_flight().try_acquire()) {
+        global_.release();
+        return shed(admission_result::route_limit);
+      }
+      if (!route->bucket().try_acquire(now)) {
+        route->in_flight().release();
+        global_.release();
+        return shed(admission_result::rate_limited);
+      }
+    }
+    admitted_count_.fetch_add(1, std::memory_order_relaxed);
+    return admission_result::admitted;
+  }
+
+  // check the queue time of an admitted request before invoking handler.
+  // The request stays admitted, and caller still needs to release it.
+  admission_result check_queue_time(admission_clock::time_point received,
+                                    admission_clock::time_point now) noexcept {
+    if (options_.max_queue_time.count() != 0 &&
+        now - received > options_.max_queue_time) {
+      return shed(admission_result::queue_timeout);
+    }
+    return admission_result::admitted;
+  }
+
+  void release(route_admission *route) noexcept {
+    if (route != nullptr) {
+      route->in_flight().release();
+    }
+    global_.release();
+  }
+
+  std::size_t in_flight() const noexcept { return global_.count(); }
+
+  std::uint64_t shed_count() const noexcept {
+    return shed_count_.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t admitted_count() const noexcept {
+    return admitted_count_.load(std::memory_order_relaxed);
+  }
+
+private:
+  admission_result shed(admission_result r) noexcept {
+    shed_count_.fetch_add(1, std::memory_order_relaxed);
+    return r;
+  }
+
+  admission_options options_;
+  in_flight_limiter global_;
+  std::atomic<std::uint64_t> shed_count_;
+  std::atomic<std::uint64_t> admitted_count_;
+};
+
+} // namespace http
+} // namespace winasio
+} // namespace boost
+
+#endif // BOOST_WINASIO_HTTP_ADMISSION_HPP
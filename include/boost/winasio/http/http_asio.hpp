@@ -16,6 +16,8 @@
 #include <boost/winasio/http/basic_http_queue_handle.hpp>
 #include <spdlog/spdlog.h>
 
+#include <utility>
+
 namespace boost {
 namespace winasio {
 namespace http {
@@ -40,8 +42,9 @@ class async_receive_op : boost::asio::coroutine {
 public:
   typedef Executor executor_type;
   async_receive_op(basic_http_queue_handle<executor_type> &h,
-                   DynamicBuffer &buff)
-      : h_(h), buff_(buff), state_(state::idle) {}
+                   DynamicBuffer &buff, std::size_t *more_data_count)
+      : h_(h), buff_(buff), state_(state::idle),
+        more_data_count_(more_data_count) {}
 
   template <typename Self>
   void operator()(Self &self, boost::system::error_code ec = {},
@@ -65,6 +68,9 @@ public:
           spdlog::debug("async_receive_op ERROR_MORE_DATA with len {}", len);
           // resize mutbuff and try again. still in recieving state.
           BOOST_ASSERT_MSG(len > buff_.size(), "len should increase");
+          if (more_data_count_ != nullptr) {
+            ++*more_data_count_;
+          }
           this->recieve(self, len, false);
         } else {
           // genuine error
@@ -86,6 +92,7 @@ private:
   basic_http_queue_handle<executor_type> &h_;
   DynamicBuffer &buff_;
   enum class state { idle, recieving } state_;
+  std::size_t *more_data_count_;
 
   // helper to recieve request with buff size len
   template <typename Self>
@@ -178,16 +185,31 @@ private:
 } // namespace details
 
 // async recieve request, headers only
+// more_data_count, if not null, is incremented each time the receive is
+// retried with a larger buffer.
 template <typename Executor, typename DynamicBuffer,
           BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
                                                std::size_t))
               Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
 auto async_receive(basic_http_queue_handle<Executor> &h, DynamicBuffer &buffer,
-                   Token &&token) {
+                   std::size_t *more_data_count, Token &&token) {
 
   return boost::asio::async_compose<Token, void(boost::system::error_code,
                                                 std::size_t)>(
-      details::async_receive_op<Executor, DynamicBuffer>(h, buffer), token, h);
+      details::async_receive_op<Executor, DynamicBuffer>(h, buffer,
+                                                         more_data_count),
+      token, h);
+}
+
+// async recieve request, headers only
+template <typename Executor, typename DynamicBuffer,
+          BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
+                                               std::size_t))
+              Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
+auto async_receive(basic_http_queue_handle<Executor> &h, DynamicBuffer &buffer,
+                   Token &&token) {
+  return async_receive(h, buffer, static_cast<std::size_t *>(nullptr),
+                       std::forward<Token>(token));
 }
 
 // async recieve body
@@ -0,0 +1,314 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_WINASIO_HTTP_METRICS_HPP
+#define BOOST_WINASIO_HTTP_METRICS_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+// Server metrics of the controller.
+// Every updating thread writes to its own shard with relaxed atomics, so
+// recording does not contend or lock. Shards are summed on scrape.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+
+namespace boost {
+namespace winasio {
+namespace http {
+
+using metrics_clock = std::chrono::steady_clock;
+
+// phases of a request measured by the controller.
+enum class metrics_phase {
+  // headers received to body received.
+  receive,
+  // middlewares and handler.
+  handler,
+  // response send started to send completed.
+  send
+};
+
+constexpr std::size_t metrics_phase_count = 3;
+
+// upper bounds of latency buckets, in microseconds. The last bucket is +Inf.
+constexpr std::array<std::uint64_t, 18> latency_bucket_bounds_us = {
+    10,    25,     50,     100,    250,     500,     1000,    2500,    5000,
+    10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 10000000};
+
+constexpr std::size_t latency_bucket_count =
+    latency_bucket_bounds_us.size() + 1;
+
+// number of shards. Threads are assigned shards round robin, so up to this
+// many recording threads never share a shard.
+constexpr std::size_t metrics_shard_count = 16;
+
+namespace detail {
+
+inline std::size_t metrics_shard_index() {
+  static std::atomic<std::size_t> next{0};
+  static thread_local std::size_t index =
+      next.fetch_add(1, std::memory_order_relaxed) % metrics_shard_count;
+  return index;
+}
+
+inline std::size_t latency_bucket(metrics_clock::duration d) {
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+  std::size_t i = 0;
+  while (i < latency_bucket_bounds_us.size() &&
+         static_cast<std::uint64_t>(us) > latency_bucket_bounds_us[i]) {
+    ++i;
+  }
+  return i;
+}
+
+// T of each shard on its own cache line.
+template <typename T> class sharded {
+public:
+  T &local() noexcept { return shards_[metrics_shard_index()].value; }
+
+  template <typename F> void for_each(F &&f) const {
+    for (const auto &s : shards_) {
+      f(s.value);
+    }
+  }
+
+private:
+  struct alignas(64) shard {
+    T value{};
+  };
+  std::array<shard, metrics_shard_count> shards_;
+};
+
+} // namespace detail
+
+// monotonic counter, or a gauge when sub is used.
+class metrics_counter {
+public:
+  void add(std::int64_t n = 1) noexcept {
+    values_.local().fetch_add(n, std::memory_order_relaxed);
+  }
+  void sub(std::int64_t n = 1) noexcept {
+    values_.local().fetch_sub(n, std::memory_order_relaxed);
+  }
+  std::int64_t value() const noexcept {
+    std::int64_t sum = 0;
+    values_.for_each([&sum](const std::atomic<std::int64_t> &v) {
+      sum += v.load(std::memory_order_relaxed);
+    });
+    return sum;
+  }
+
+private:
+  detail::sharded<std::atomic<std::int64_t>> values_;
+};
+
+// merged view of a histogram.
+struct histogram_snapshot {
+  // non cumulative count of each bucket.
+  std::array<std::uint64_t, latency_bucket_count> buckets{};
+  std::uint64_t count = 0;
+  std::chrono::nanoseconds sum{0};
+};
+
+// latency histogram of all phases of one route and verb.
+class endpoint_metrics {
+public:
+  endpoint_metrics(std::string route, std::string verb)
+      : route_(std::move(route)), verb_(std::move(verb)) {}
+
+  void observe(metrics_phase phase, metrics_clock::duration d) noexcept {
+    phase_data &p = shards_.local()[static_cast<std::size_t>(phase)];
+    p.buckets[detail::latency_bucket(d)].fetch_add(1,
+                                                   std::memory_order_relaxed);
+    p.sum_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(),
+        std::memory_order_relaxed);
+  }
+
+  histogram_snapshot snapshot(metrics_phase phase) const {
+    histogram_snapshot s;
+    std::int64_t sum_ns = 0;
+    shards_.for_each([&](const phases &ps) {
+      const phase_data &p = ps[static_cast<std::size_t>(phase)];
+      for (std::size_t i = 0; i < latency_bucket_count; ++i) {
+        std::uint64_t n = p.buckets[i].load(std::memory_order_relaxed);
+        s.buckets[i] += n;
+        s.count += n;
+      }
+      sum_ns += p.sum_ns.load(std::memory_order_relaxed);
+    });
+    s.sum = std::chrono::nanoseconds(sum_ns);
+    return s;
+  }
+
+  const std::string &route() const noexcept { return route_; }
+  const std::string &verb() const noexcept { return verb_; }
+
+private:
+  struct phase_data {
+    std::array<std::atomic<std::uint64_t>, latency_bucket_count> buckets{};
+    std::atomic<std::int64_t> sum_ns{0};
+  };
+  typedef std::array<phase_data, metrics_phase_count> phases;
+
+  std::string route_;
+  std::string verb_;
+  detail::sharded<phases> shards_;
+};
+
+class http_metrics {
+public:
+  // Register metrics of a route and verb. Not thread safe, endpoints are
+  // added during setup. The returned reference is stable.
+  endpoint_metrics &add_endpoint(std::string route, std::string verb) {
+    return endpoints_.emplace_back(std::move(route), std::move(verb));
+  }
+
+  // requests admitted and not yet responded.
+  metrics_counter in_flight;
+  // receives retried with a larger buffer because of ERROR_MORE_DATA.
+  metrics_counter receive_more_data;
+  metrics_counter receive_errors;
+  metrics_counter request_body_bytes;
+  metrics_counter response_body_bytes;
+  metrics_counter send_errors;
+  metrics_counter shed;
+  // requests cancelled at their deadline.
+  metrics_counter timeouts;
+
+  // Render all metrics in prometheus text exposition format.
+  void write_prometheus(std::string &out) const {
+    out += "# HELP winasio_http_request_duration_seconds Latency of request "
+           "phases.\n"
+           "# TYPE winasio_http_request_duration_seconds histogram\n";
+    for (const endpoint_metrics &e : endpoints_) {
+      for (std::size_t p = 0; p < metrics_phase_count; ++p) {
+        write_histogram(out, e, static_cast<metrics_phase>(p));
+      }
+    }
+    write_counter(out, "winasio_http_in_flight_requests", "gauge",
+                  "Requests admitted and not yet responded.", in_flight);
+    write_counter(out, "winasio_http_receive_more_data_total", "counter",
+                  "Request receives retried with a larger buffer.",
+                  receive_more_data);
+    write_counter(out, "winasio_http_receive_errors_total", "counter",
+                  "Failed request receives.", receive_errors);
+    write_counter(out, "winasio_http_request_body_bytes_total", "counter",
+                  "Bytes of request bodies received.", request_body_bytes);
+    write_counter(out, "winasio_http_response_body_bytes_total", "counter",
+                  "Bytes of response bodies sent.", response_body_bytes);
+    write_counter(out, "winasio_http_send_errors_total", "counter",
+                  "Failed response sends.", send_errors);
+    write_counter(out, "winasio_http_shed_total", "counter",
+                  "Requests shed with 503.", shed);
+    write_counter(out, "winasio_http_timeouts_total", "counter",
+                  "Requests cancelled at their deadline.", timeouts);
+  }
+
+private:
+  static const char *phase_name(metrics_phase p) {
+    switch (p) {
+    case metrics_phase::receive:
+      return "receive";
+    case metrics_phase::handler:
+      return "handler";
+    default:
+      return "send";
+    }
+  }
+
+  static void append_label_value(std::string &out, const std::string &v) {
+    for (char c : v) {
+      if (c == '\\' || c == '"') {
+        out += '\\';
+        out += c;
+      } else if (c == '\n') {
+        out += "\\n";
+      } else {
+        out += c;
+      }
+    }
+  }
+
+  static void write_histogram(std::string &out, const endpoint_metrics &e,
+                              metrics_phase phase) {
+    histogram_snapshot s = e.snapshot(phase);
+    std::string labels = "route=\"";
+    append_label_value(labels, e.route());
+    labels += "\",verb=\"";
+    append_label_value(labels, e.verb());
+    labels += "\",phase=\"";
+    labels += phase_name(phase);
+    labels += '"';
+
+    char num[64];
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < latency_bucket_count; ++i) {
+      cumulative += s.buckets[i];
+      out += "winasio_http_request_duration_seconds_bucket{";
+      out += labels;
+      out += ",le=\"";
+      if (i < latency_bucket_bounds_us.size()) {
+        std::snprintf(num, sizeof(num), "%g",
+                      latency_bucket_bounds_us[i] / 1e6);
+        out += num;
+      } else {
+        out += "+Inf";
+      }
+      std::snprintf(num, sizeof(num), "\"} %llu\n",
+                    static_cast<unsigned long long>(cumulative));
+      out += num;
+    }
+    out += "winasio_http_request_duration_seconds_sum{";
+    out += labels;
+    std::snprintf(num, sizeof(num), "} %.9f\n",
+                  std::chrono::duration<double>(s.sum).count());
+    out += num;
+    out += "winasio_http_request_duration_seconds_count{";
+    out += labels;
+    std::snprintf(num, sizeof(num), "} %llu\n",
+                  static_cast<unsigned long long>(s.count));
+    out += num;
+  }
+
+  static void write_counter(std::string &out, const char *name,
+                            const char *type, const char *help,
+                            const metrics_counter &c) {
+    char num[32];
+    std::snprintf(num, sizeof(num), " %lld\n",
+                  static_cast<long long>(c.value()));
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+    out += name;
+    out += num;
+  }
+
+  // deque so that references stay valid.
+  std::deque<endpoint_metrics> endpoints_;
+};
+
+} // namespace http
+} // namespace winasio
+} // namespace boost
+
+#endif // BOOST_WINASIO_HTTP_METRICS_HPP
@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_WINASIO_HTTP_MIDDLEWARE_HPP
+#define BOOST_WINASIO_HTTP_MIDDLEWARE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace boost {
+namespace winasio {
+namespace http {
+
+// Middlewares are composed at compile time around the route handler, so the
+// calls can be inlined. A middleware looks like:
+//
+// struct auth {
+//   // optional, stored per request in request_context::state.
+//   struct state_type { std::string user; };
+//
+//   // return false to short circuit. The middleware should have filled
+//   // ctx.response, inner middlewares and the handler are skipped.
+//   template <typename Ctx> bool before(Ctx &ctx, state_type &s);
+//
+//   // optional, runs after inner middlewares and the handler, in reverse
+//   // order of before. It also runs if this middleware short circuited.
+//   template <typename Ctx> void after(Ctx &ctx, state_type &s);
+// };
+
+// state of middlewares without state_type.
+struct empty_middleware_state {};
+
+namespace detail {
+
+template <typename M, typename = void> struct middleware_state {
+  typedef empty_middleware_state type;
+};
+
+template <typename M>
+struct middleware_state<M, std::void_t<typename M::state_type>> {
+  typedef typename M::state_type type;
+};
+
+template <typename M, typename Ctx, typename S, typename = void>
+struct has_middleware_after : std::false_type {};
+
+template <typename M, typename Ctx, typename S>
+struct has_middleware_after<M, Ctx, S,
+                            std::void_t<decltype(std::declval<M &>().after(
+                                std::declval<Ctx &>(), std::declval<S &>()))>>
+    : std::true_type {};
+
+} // namespace detail
+
+template <typename M>
+using middleware_state_t = typename detail::middleware_state<M>::type;
+
+template <typename... Middlewares> class middleware_chain {
+public:
+  // per request state of all middlewares, in order.
+  typedef std::tuple<middleware_state_t<Middlewares>...> state_type;
+
+  explicit middleware_chain(Middlewares... middlewares)
+      : middlewares_(std::move(middlewares)...) {}
+
+  // run middlewares and the handler. Ctx must have a member `state` of
+  // state_type.
+  template <typename Ctx, typename Handler>
+  void operator()(Ctx &ctx, Handler &&handler) {
+    this->run<0>(ctx, handler);
+  }
+
+  template <std::size_t I> auto &get() noexcept {
+    return std::get<I>(middlewares_);
+  }
+
+private:
+  template <std::size_t I, typename Ctx, typename Handler>
+  void run(Ctx &ctx, Handler &handler) {
+    if constexpr (I == sizeof...(Middlewares)) {
+      handler(ctx);
+    } else {
+      auto &m = std::get<I>(middlewares_);
+      auto &s = std::get<I>(ctx.state);
+      if (m.before(ctx, s)) {
+        this->run<I + 1>(ctx, handler);
+      }
+      if constexpr (detail::has_middleware_after<
+                        std::decay_t<decltype(m)>, Ctx,
+                        std::decay_t<decltype(s)>>::value) {
+        m.after(ctx, s);
+      }
+    }
+  }
+
+  std::tuple<Middlewares...> middlewares_;
+};
+
+} // namespace http
+} // namespace winasio
+} // namespace boost
+
+#endif // BOOST_WINASIO_HTTP_MIDDLEWARE_HPP
@@ -0,0 +1,221 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_WINASIO_HTTP_OFFLOAD_POOL_HPP
+#define BOOST_WINASIO_HTTP_OFFLOAD_POOL_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include <boost/assert.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace boost {
+namespace winasio {
+namespace http {
+
+// where the controller runs a route handler.
+enum class handler_execution {
+  // on the io thread that completed the body receive.
+  inline_io,
+  // on the offload pool. Response is sent from the io executor.
+  offload
+};
+
+// Thread pool for cpu heavy handlers, so that they do not block io threads.
+// Each worker owns a queue. Workers pop their own queue from the back and
+// steal from the front of other queues when idle.
+// The total number of queued tasks is bounded, and try_submit fails instead
+// of blocking the io thread when the pool is saturated.
+// Tasks should not throw. An exception escaping a task is caught and counted
+// by failed_count(), the worker goes on with the next task.
+class offload_pool {
+public:
+  typedef std::function<void()> task_type;
+
+  explicit offload_pool(std::size_t thread_count, std::size_t max_queued = 1024)
+      : max_queued_(max_queued), queued_(0), pending_(0), failed_(0),
+        next_(0), stopped_(false) {
+    BOOST_ASSERT(thread_count > 0);
+    for (std::size_t i = 0; i < thread_count; ++i) {
+      queues_.push_back(std::make_unique<worker_queue>());
+    }
+    for (std::size_t i = 0; i < thread_count; ++i) {
+      threads_.emplace_back([this, i] { run(i); });
+    }
+  }
+
+  offload_pool(const offload_pool &) = delete;
+  offload_pool &operator=(const offload_pool &) = delete;
+
+  ~offload_pool() { stop(); }
+
+  // returns false if the pool is stopped or max_queued tasks are pending.
+  bool try_submit(task_type t) {
+    if (stopped_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    // tasks submitted from a worker stay on that worker.
+    std::size_t idx = current_worker() == this
+                          ? current_index()
+                          : next_.fetch_add(1, std::memory_order_relaxed) %
+                                queues_.size();
+    {
+      // Reserved and published under the lock stop() takes, so that workers
+      // do not return while an accepted task is not pushed yet, and notify
+      // cannot be lost between a worker's check and wait.
+      std::lock_guard<std::mutex> lk(sleep_m_);
+      if (stopped_.load(std::memory_order_relaxed)) {
+        return false;
+      }
+      std::size_t prev = queued_.fetch_add(1, std::memory_order_relaxed);
+      if (prev >= max_queued_) {
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+      }
+      {
+        std::lock_guard<std::mutex> qlk(queues_[idx]->m);
+        queues_[idx]->tasks.push_back(std::move(t));
+      }
+      // counted once pushed, so that woken workers find the task.
+      pending_.fetch_add(1, std::memory_order_relaxed);
+    }
+    sleep_cv_.notify_one();
+    return true;
+  }
+
+  // stop workers after the queued tasks are finished.
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lk(sleep_m_);
+      stopped_.store(true, std::memory_order_relaxed);
+    }
+    sleep_cv_.notify_all();
+    for (auto &t : threads_) {
+      if (t.joinable()) {
+        t.join();
+      }
+    }
+  }
+
+  std::size_t queued() const noexcept {
+    return queued_.load(std::memory_order_relaxed);
+  }
+
+  std::size_t thread_count() const noexcept { return queues_.size(); }
+
+  // tasks that threw.
+  std::size_t failed_count() const noexcept {
+    return failed_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct worker_queue {
+    std::mutex m;
+    std::deque<task_type> tasks;
+  };
+
+  static offload_pool *&current_worker() {
+    static thread_local offload_pool *pool = nullptr;
+    return pool;
+  }
+
+  static std::size_t &current_index() {
+    static thread_local std::size_t index = 0;
+    return index;
+  }
+
+  bool pop_local(std::size_t idx, task_type &t) {
+    worker_queue &q = *queues_[idx];
+    std::lock_guard<std::mutex> lk(q.m);
+    if (q.tasks.empty()) {
+      return false;
+    }
+    t = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  bool steal(std::size_t idx, task_type &t) {
+    for (std::size_t i = 1; i < queues_.size(); ++i) {
+      worker_queue &q = *queues_[(idx + i) % queues_.size()];
+      std::lock_guard<std::mutex> lk(q.m);
+      if (!q.tasks.empty()) {
+        t = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run(std::size_t idx) {
+    current_worker() = this;
+    current_index() = idx;
+    task_type t;
+    for (;;) {
+      if (pop_local(idx, t) || steal(idx, t)) {
+        if (queued_.fetch_sub(1, std::memory_order_relaxed) == 1 &&
+            stopped_.load(std::memory_order_relaxed)) {
+          // the last task after stop, idle workers can return.
+          std::lock_guard<std::mutex> lk(sleep_m_);
+          sleep_cv_.notify_all();
+        }
+        try {
+          t();
+        } catch (...) {
+          failed_.fetch_add(1, std::memory_order_relaxed);
+        }
+        t = nullptr;
+        continue;
+      }
+      std::unique_lock<std::mutex> lk(sleep_m_);
+      if (stopped_.load(std::memory_order_relaxed) &&
+          queued_.load(std::memory_order_relaxed) == 0) {
+        return;
+      }
+      // after stop, other workers may still run the last tasks. Wait for
+      // them instead of spinning.
+      sleep_cv_.wait(lk, [this] {
+        return pending_.load(std::memory_order_relaxed) != 0 ||
+               (stopped_.load(std::memory_order_relaxed) &&
+                queued_.load(std::memory_order_relaxed) == 0);
+      });
+    }
+  }
+
+  std::vector<std::unique_ptr<worker_queue>> queues_;
+  std::vector<std::thread> threads_;
+  const std::size_t max_queued_;
+  // reserved by try_submit, bounded by max_queued_.
+  std::atomic<std::size_t> queued_;
+  // pushed and not popped yet, what workers wait for.
+  std::atomic<std::size_t> pending_;
+  std::atomic<std::size_t> failed_;
+  std::atomic<std::size_t> next_;
+  std::atomic<bool> stopped_;
+  std::mutex sleep_m_;
+  std::condition_variable sleep_cv_;
+};
+
+} // namespace http
+} // namespace winasio
+} // namespace boost
+
+#endif // BOOST_WINASIO_HTTP_OFFLOAD_POOL_HPP
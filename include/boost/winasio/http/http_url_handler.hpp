@@ -106,6 +106,19 @@ public:
     ec = boost::system::error_code(retCode,
                                    boost::asio::error::get_system_category());
   }
+  // Max number of requests http.sys queues for the request queue before
+  // rejecting with 503. Default is 1000.
+  void set_queue_length(ULONG length, boost::system::error_code &ec) {
+    DWORD retCode = HttpSetRequestQueueProperty(
+        queue_handle_.native_handle(), HttpServerQueueLengthProperty, &length,
+        sizeof(length), 0, nullptr);
+    if (retCode != NO_ERROR) {
+      spdlog::error("Failed to set queue length: {}, err : {}", length,
+                    retCode);
+    }
+    ec = boost::system::error_code(retCode,
+                                   boost::asio::error::get_system_category());
+  }
   HTTP_SERVER_SESSION_ID get_session_id() const { return session_id_; }
   HTTP_SERVER_SESSION_ID group_id() const { return group_id_; }
 
@@ -0,0 +1,356 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_WINASIO_IO_RUNTIME_HPP
+#define BOOST_WINASIO_IO_RUNTIME_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+// One io_context per logical processor, each run by a single thread.
+// Objects created on a context, i.e. an acceptor with its sessions or a
+// request queue with its controller, are only used from that thread, and
+// need no strand. Pipe instances of one name may listen on every context,
+// clients connect to any of them. A request queue completes on the context
+// it is opened on, its requests can be handed to other contexts with post.
+// Threads may be pinned to their processor. With numa_aware, contexts are
+// ordered by numa node and their threads kept on their node. Each context
+// is created on its own thread, and so should the objects of for_each, so
+// that their memory is first touched, and allocated, on the node.
+// Handlers run on the contexts must not throw: an exception escaping one
+// leaves the thread of its context and terminates the process. for_each
+// catches those of its function.
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif // _WIN32
+
+namespace boost {
+namespace winasio {
+
+struct io_runtime_options {
+  // number of contexts. 0 runs one per logical processor.
+  std::size_t contexts = 0;
+  // pins the thread of each context to one processor.
+  bool pin_threads = false;
+  // orders contexts by numa node, and keeps their threads on their node.
+  bool numa_aware = false;
+};
+
+namespace details {
+
+struct logical_processor {
+  unsigned group;
+  unsigned number;
+  unsigned node;
+};
+
+#ifdef _WIN32
+
+// all processor groups, as hosts over 64 processors have more than one.
+inline std::vector<logical_processor> logical_processors() {
+  std::vector<logical_processor> ps;
+  WORD groups = ::GetActiveProcessorGroupCount();
+  for (WORD g = 0; g < groups; ++g) {
+    DWORD count = ::GetActiveProcessorCount(g);
+    for (DWORD n = 0; n < count; ++n) {
+      PROCESSOR_NUMBER pn = {};
+      pn.Group = g;
+      pn.Number = static_cast<BYTE>(n);
+      USHORT node = 0;
+      if (!::GetNumaProcessorNodeEx(&pn, &node)) {
+        node = 0;
+      }
+      ps.push_back({g, n, node});
+    }
+  }
+  return ps;
+}
+
+inline bool set_thread_affinity(const logical_processor &p, bool whole_node) {
+  GROUP_AFFINITY ga = {};
+  ga.Group = static_cast<WORD>(p.group);
+  ga.Mask = KAFFINITY(1) << p.number;
+  if (whole_node) {
+    GROUP_AFFINITY node = {};
+    if (!::GetNumaNodeProcessorMaskEx(static_cast<USHORT>(p.node), &node) ||
+        node.Group != ga.Group) {
+      return false;
+    }
+    ga.Mask = node.Mask;
+  }
+  return ::SetThreadGroupAffinity(::GetCurrentThread(), &ga, nullptr) != 0;
+}
+
+#else // _WIN32
+
+// the processors the process may run on, on a single node.
+inline std::vector<logical_processor> logical_processors() {
+  std::vector<logical_processor> ps;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (unsigned n = 0; n < CPU_SETSIZE; ++n) {
+      if (CPU_ISSET(n, &set)) {
+        ps.push_back({0, n, 0});
+      }
+    }
+  }
+  if (ps.empty()) {
+    unsigned count = (std::max)(1u, std::thread::hardware_concurrency());
+    for (unsigned n = 0; n < count; ++n) {
+      ps.push_back({0, n, 0});
+    }
+  }
+  return ps;
+}
+
+inline bool set_thread_affinity(const logical_processor &p, bool whole_node) {
+  if (whole_node) {
+    // a single node, the thread may run anywhere.
+    return true;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(p.number, &set);
+  return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+}
+
+#endif // _WIN32
+
+} // namespace details
+
+class io_runtime {
+public:
+  typedef boost::asio::io_context::executor_type executor_type;
+
+  explicit io_runtime(const io_runtime_options &options = io_runtime_options())
+      : next_(0), stopped_(false) {
+    std::vector<details::logical_processor> ps =
+        details::logical_processors();
+    if (options.numa_aware) {
+      std::stable_sort(ps.begin(), ps.end(),
+                       [](const details::logical_processor &a,
+                          const details::logical_processor &b) {
+                         return a.node < b.node;
+                       });
+    }
+    std::size_t count = options.contexts == 0 ? ps.size() : options.contexts;
+    BOOST_ASSERT(count > 0);
+    for (std::size_t i = 0; i < count; ++i) {
+      slots_.push_back(std::make_unique<slot>());
+      slots_[i]->processor = ps[i % ps.size()];
+    }
+    std::latch created(static_cast<std::ptrdiff_t>(count));
+    for (std::size_t i = 0; i < count; ++i) {
+      slots_[i]->thread = std::thread([this, i, &created, options] {
+        run(i, options, created);
+      });
+    }
+    created.wait();
+  }
+
+  io_runtime(const io_runtime &) = delete;
+  io_runtime &operator=(const io_runtime &) = delete;
+
+  ~io_runtime() {
+    stop();
+    join();
+  }
+
+  std::size_t size() const noexcept { return slots_.size(); }
+
+  boost::asio::io_context &context(std::size_t i) { return *slots_.at(i)->ioc; }
+
+  executor_type get_executor(std::size_t i) {
+    return slots_.at(i)->ioc->get_executor();
+  }
+
+  // numa node of the thread of context i.
+  unsigned node(std::size_t i) const { return slots_.at(i)->processor.node; }
+
+  // whether the thread of context i got the affinity asked for.
+  bool pinned(std::size_t i) const { return slots_.at(i)->pinned; }
+
+  // index of the context run by the calling thread, size() on other threads.
+  std::size_t current_index() const noexcept {
+    return current().runtime == this ? current().index : size();
+  }
+
+  // contexts in turn, i.e. for the next connection.
+  std::size_t next_index() noexcept {
+    return next_.fetch_add(1, std::memory_order_relaxed) % size();
+  }
+
+  // runs f on context i, never inside the caller.
+  template <typename Function> void post(std::size_t i, Function &&f) {
+    boost::asio::post(get_executor(i), std::forward<Function>(f));
+  }
+
+  // runs f inside the caller if it runs context i, otherwise like post.
+  template <typename Function> void dispatch(std::size_t i, Function &&f) {
+    boost::asio::dispatch(get_executor(i), std::forward<Function>(f));
+  }
+
+  // posts a copy of f to every context.
+  template <typename Function> void post_all(const Function &f) {
+    for (std::size_t i = 0; i < size(); ++i) {
+      boost::asio::post(get_executor(i), f);
+    }
+  }
+
+  // Runs f(index, io_context) on every context, and returns once all have
+  // run. Used to create the objects of each context on its thread. The
+  // first exception thrown by f is rethrown. Not callable from a context.
+  // Once stop() or join() is called the contexts may not run f, for_each
+  // throws operation_aborted then instead of waiting forever. f may still
+  // be running on some contexts, or run later with join(), and must not
+  // refer to objects the caller destroys after the throw.
+  template <typename Function> void for_each(Function f) {
+    BOOST_ASSERT(current_index() == size());
+    // shared with the handlers, which may outlive an aborted for_each.
+    struct state {
+      explicit state(Function fn, std::size_t n)
+          : f(std::move(fn)), remaining(n) {}
+      Function f;
+      std::size_t remaining;
+      std::exception_ptr error;
+    };
+    auto st = std::make_shared<state>(std::move(f), size());
+    {
+      std::lock_guard<std::mutex> lk(wait_m_);
+      if (stopped_.load(std::memory_order_relaxed)) {
+        throw boost::system::system_error(
+            boost::asio::error::operation_aborted);
+      }
+    }
+    for (std::size_t i = 0; i < size(); ++i) {
+      boost::asio::post(get_executor(i), [this, st, i] {
+        std::exception_ptr error;
+        try {
+          st->f(i, context(i));
+        } catch (...) {
+          error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lk(wait_m_);
+        if (error && !st->error) {
+          st->error = error;
+        }
+        --st->remaining;
+        wait_cv_.notify_all();
+      });
+    }
+    std::unique_lock<std::mutex> lk(wait_m_);
+    wait_cv_.wait(lk, [this, &st] {
+      return st->remaining == 0 || stopped_.load(std::memory_order_relaxed);
+    });
+    if (st->remaining != 0) {
+      throw boost::system::system_error(boost::asio::error::operation_aborted);
+    }
+    if (st->error) {
+      std::rethrow_exception(st->error);
+    }
+  }
+
+  // stops all contexts, handlers not run yet are left.
+  void stop() {
+    set_stopped();
+    for (auto &s : slots_) {
+      s->ioc->stop();
+    }
+  }
+
+  // lets the contexts run out of work, and waits for their threads.
+  void join() {
+    set_stopped();
+    for (auto &s : slots_) {
+      s->work.reset();
+    }
+    for (auto &s : slots_) {
+      if (s->thread.joinable()) {
+        s->thread.join();
+      }
+    }
+  }
+
+private:
+  struct slot {
+    details::logical_processor processor{};
+    bool pinned = false;
+    std::unique_ptr<boost::asio::io_context> ioc;
+    std::unique_ptr<boost::asio::executor_work_guard<executor_type>> work;
+    std::thread thread;
+  };
+
+  struct current_context {
+    const io_runtime *runtime = nullptr;
+    std::size_t index = 0;
+  };
+
+  // wakes for_each, under the lock so that the wake is not lost.
+  void set_stopped() {
+    {
+      std::lock_guard<std::mutex> lk(wait_m_);
+      stopped_.store(true, std::memory_order_release);
+    }
+    wait_cv_.notify_all();
+  }
+
+  static current_context &current() noexcept {
+    static thread_local current_context c;
+    return c;
+  }
+
+  void run(std::size_t i, io_runtime_options options, std::latch &created) {
+    slot &s = *slots_[i];
+    if (options.pin_threads || options.numa_aware) {
+      s.pinned = details::set_thread_affinity(s.processor,
+                                              !options.pin_threads);
+    }
+    // on the thread, so that it is allocated on its node.
+    s.ioc = std::make_unique<boost::asio::io_context>(1);
+    s.work = std::make_unique<boost::asio::executor_work_guard<executor_type>>(
+        s.ioc->get_executor());
+    current() = {this, i};
+    created.count_down();
+    s.ioc->run();
+    current() = {};
+  }
+
+  std::vector<std::unique_ptr<slot>> slots_;
+  std::atomic<std::size_t> next_;
+  std::atomic<bool> stopped_;
+  // for_each waits on these.
+  std::mutex wait_m_;
+  std::condition_variable wait_cv_;
+};
+
+} // namespace winasio
+} // namespace boost
+
+#endif // BOOST_WINASIO_IO_RUNTIME_HPP
@@ -15,12 +15,15 @@
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
 
 #include "boost/asio/any_io_executor.hpp"
+#include "boost/asio/associated_cancellation_slot.hpp"
 #include "boost/asio/windows/overlapped_ptr.hpp"
 #include "boost/asio/windows/stream_handle.hpp"
 #include <boost/asio/detail/config.hpp>
 #include <boost/asio/detail/type_traits.hpp>
 
 #include "boost/winasio/named_pipe/named_pipe_client_details.hpp"
+#include "boost/winasio/named_pipe/read_ahead.hpp"
+#include "boost/winasio/overlapped_cancellation.hpp"
 
 #include <list>
 #include <map>
@@ -50,9 +53,72 @@ public:
       : boost::asio::windows::basic_stream_handle<executor_type>(
             context.get_executor()) {}
 
+  // other keeps its read ahead size, i.e. the pipe of an acceptor.
   named_pipe(named_pipe<executor_type> &&other)
       : boost::asio::windows::basic_stream_handle<executor_type>(
-            std::move(other)) {}
+            std::move(other)),
+        ahead_(std::move(other.ahead_)) {
+    other.set_read_ahead(read_ahead());
+  }
+
+  // Reads smaller than size read up to size bytes into a buffer of the
+  // pipe, and the reads after it are served from the buffer without a read
+  // of the handle. The pipe is then read in byte mode, so one read returns
+  // the messages written so far, and a read smaller than a message does not
+  // fail with ERROR_MORE_DATA. 0, the default, turns it off. Call before
+  // the pipe is created or connected.
+  void set_read_ahead(std::size_t size) {
+    if (size == 0) {
+      ahead_.reset();
+    } else {
+      ahead_ = std::make_shared<details::read_ahead_buffer>(size);
+    }
+  }
+
+  std::size_t read_ahead() const noexcept {
+    return ahead_ ? ahead_->capacity() : 0;
+  }
+
+  template <typename MutableBufferSequence>
+  std::size_t read_some(const MutableBufferSequence &buffers) {
+    boost::system::error_code ec;
+    std::size_t n = read_some(buffers, ec);
+    boost::asio::detail::throw_error(ec, "read_some");
+    return n;
+  }
+
+  template <typename MutableBufferSequence>
+  std::size_t read_some(const MutableBufferSequence &buffers,
+                        boost::system::error_code &ec) {
+    if (!ahead_) {
+      return parent_type::read_some(buffers, ec);
+    }
+    return details::read_ahead(static_cast<parent_type &>(*this), *ahead_,
+                               buffers, ec);
+  }
+
+  template <typename MutableBufferSequence,
+            BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
+                                                 std::size_t))
+                ReadToken BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(
+                    executor_type)>
+  auto async_read_some(const MutableBufferSequence &buffers,
+                       BOOST_ASIO_MOVE_ARG(ReadToken)
+                           token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN(
+                               executor_type)) {
+    return boost::asio::async_initiate<ReadToken,
+                                       void(boost::system::error_code,
+                                            std::size_t)>(
+        [this](auto handler, const MutableBufferSequence &b) {
+          parent_type &pipe = *this;
+          if (!ahead_) {
+            pipe.async_read_some(b, std::move(handler));
+            return;
+          }
+          details::async_read_ahead(pipe, ahead_, b, std::move(handler));
+        },
+        token, buffers);
+  }
 
   void server_create(boost::system::error_code &ec,
                      endpoint_type const &endpoint) {
@@ -61,9 +127,9 @@ public:
         CreateNamedPipe(endpoint.c_str(),           // pipe name
                         PIPE_ACCESS_DUPLEX |        // read/write access
                             FILE_FLAG_OVERLAPPED,   // overlapped mode
-                        PIPE_TYPE_MESSAGE |         // message-type pipe
-                            PIPE_READMODE_MESSAGE | // message-read mode
-                            PIPE_WAIT,              // blocking mode
+                        PIPE_TYPE_MESSAGE | // message-type pipe
+                            read_mode() |   // message or byte-read mode
+                            PIPE_WAIT,      // blocking mode
                         PIPE_UNLIMITED_INSTANCES,   // number of instances
                         bufsize * sizeof(TCHAR),    // output buffer size
                         bufsize * sizeof(TCHAR),    // input buffer size
@@ -79,13 +145,17 @@ public:
     parent_type::assign(hPipe);
   }
 
+  // waits for a client. Cancelled through the cancellation slot of the
+  // handler with CancelIoEx. Reads and writes are cancelled by the stream
+  // handle.
   template <typename Token> auto async_server_connect(Token &&token) {
     return boost::asio::async_initiate<decltype(token),
                                        void(boost::system::error_code)>(
         [this](auto handler) {
+          auto slot = boost::asio::get_associated_cancellation_slot(handler);
           // init optr to pass through the user handler.
-          boost::asio::windows::overlapped_ptr optr(
-              this->get_executor(),
+          details::cancellable_overlapped_ptr optr(
+              this->get_executor(), this->native_handle(), slot,
               [h = std::move(handler)](boost::system::error_code ec,
                                        std::size_t) mutable {
                 std::move(h)(ec);
@@ -138,7 +208,7 @@ public:
     }
 
     HANDLE hPipe = NULL;
-    details::client_connect(ec, hPipe, endpoint, timeout_ms);
+    details::client_connect(ec, hPipe, endpoint, timeout_ms, read_mode());
 
     if (ec) {
       BOOST_ASIO_SYNC_OP_VOID_RETURN(ec);
@@ -170,6 +240,13 @@ public:
       }
     }
   }
+
+private:
+  DWORD read_mode() const noexcept {
+    return ahead_ ? PIPE_READMODE_BYTE : PIPE_READMODE_MESSAGE;
+  }
+
+  std::shared_ptr<details::read_ahead_buffer> ahead_;
 };
 
 } // namespace winasio
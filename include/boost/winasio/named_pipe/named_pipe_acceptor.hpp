@@ -12,6 +12,7 @@
 #pragma once
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
 
+#include "boost/asio/bind_cancellation_slot.hpp"
 #include "boost/asio/compose.hpp"
 #include "boost/asio/windows/basic_object_handle.hpp"
 #include "boost/winasio/named_pipe/named_pipe.hpp"
@@ -65,9 +66,12 @@ public:
             std::move(handler)(ec);
             return;
           }
-          pipe.async_server_connect(
-              [h = std::move(handler), this](
-                  boost::system::error_code ec) mutable { std::move(h)(ec); });
+          auto slot = boost::asio::get_associated_cancellation_slot(handler);
+          pipe.async_server_connect(boost::asio::bind_cancellation_slot(
+              slot, [h = std::move(handler), this](
+                        boost::system::error_code ec) mutable {
+                std::move(h)(ec);
+              }));
         },
         token);
   }
@@ -92,10 +96,12 @@ public:
             std::move(handler)(ec, std::move(pipe_));
             return;
           }
-          pipe_.async_server_connect([h = std::move(handler), this](
-                                         boost::system::error_code ec) mutable {
-            std::move(h)(ec, std::move(pipe_));
-          });
+          auto slot = boost::asio::get_associated_cancellation_slot(handler);
+          pipe_.async_server_connect(boost::asio::bind_cancellation_slot(
+              slot, [h = std::move(handler), this](
+                        boost::system::error_code ec) mutable {
+                std::move(h)(ec, std::move(pipe_));
+              }));
         },
         token);
   }
@@ -21,7 +21,8 @@ namespace details {
 // return the ok handle. Caller is responsible for freeing the handle.
 inline void client_connect(boost::system::error_code &ec, HANDLE &pipe_ret,
                            std::string const &endpoint,
-                           std::uint32_t timeout_ms) {
+                           std::uint32_t timeout_ms,
+                           DWORD read_mode = PIPE_READMODE_MESSAGE) {
 
   HANDLE hPipe;
   BOOL fSuccess = FALSE;
@@ -66,8 +67,8 @@ inline void client_connect(boost::system::error_code &ec, HANDLE &pipe_ret,
     }
   }
 
-  // The pipe connected; change to message-read mode.
-  dwMode = PIPE_READMODE_MESSAGE;
+  // The pipe connected; change to message-read mode, or byte-read mode.
+  dwMode = read_mode;
   fSuccess = SetNamedPipeHandleState(hPipe,   // pipe handle
                                      &dwMode, // new pipe mode
                                      NULL,    // don't set maximum bytes
@@ -0,0 +1,194 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_NAMED_PIPE_READ_AHEAD_HPP
+#define ASIO_NAMED_PIPE_READ_AHEAD_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+// Reads of a stream through a buffer owned by the stream. A read smaller
+// than the buffer reads as much as is available into the buffer, and the
+// reads after it are served from the buffer until it is empty, without a
+// read of the stream. The buffer is allocated once, and reused by every
+// read.
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace boost {
+namespace winasio {
+namespace details {
+
+// Shared with the pending read, which may complete after the stream is
+// gone.
+class read_ahead_buffer {
+public:
+  explicit read_ahead_buffer(std::size_t capacity)
+      : data_(new char[capacity]), capacity_(capacity), begin_(0), end_(0) {
+    BOOST_ASSERT(capacity > 0);
+  }
+
+  read_ahead_buffer(const read_ahead_buffer &) = delete;
+  read_ahead_buffer &operator=(const read_ahead_buffer &) = delete;
+
+  std::size_t capacity() const noexcept { return capacity_; }
+
+  // bytes read ahead and not consumed.
+  std::size_t size() const noexcept { return end_ - begin_; }
+
+  // the whole buffer, to read into when it is empty.
+  boost::asio::mutable_buffer prepare() noexcept {
+    BOOST_ASSERT(size() == 0);
+    begin_ = 0;
+    end_ = 0;
+    return boost::asio::buffer(data_.get(), capacity_);
+  }
+
+  void commit(std::size_t n) noexcept {
+    BOOST_ASSERT(n <= capacity_);
+    end_ = n;
+  }
+
+  // copies to buffers what fits.
+  template <typename MutableBufferSequence>
+  std::size_t consume(const MutableBufferSequence &buffers) {
+    std::size_t n = boost::asio::buffer_copy(
+        buffers, boost::asio::buffer(data_.get() + begin_, size()));
+    begin_ += n;
+    return n;
+  }
+
+private:
+  std::unique_ptr<char[]> data_;
+  std::size_t capacity_;
+  std::size_t begin_;
+  std::size_t end_;
+};
+
+// the rest of a message follows with the next read, as in byte mode.
+inline void ignore_partial_message(boost::system::error_code &ec) {
+#ifdef _WIN32
+  if (ec.value() == ERROR_MORE_DATA &&
+      ec.category() == boost::asio::error::get_system_category()) {
+    ec = boost::system::error_code();
+  }
+#else  // _WIN32
+  (void)ec;
+#endif // _WIN32
+}
+
+template <typename Stream, typename MutableBufferSequence>
+class read_ahead_op {
+public:
+  read_ahead_op(Stream &s, std::shared_ptr<read_ahead_buffer> ahead,
+                const MutableBufferSequence &buffers)
+      : s_(s), ahead_(std::move(ahead)), buffers_(buffers),
+        state_(state::starting) {}
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec = {},
+                  std::size_t n = 0) {
+    switch (state_) {
+    case state::starting: {
+      std::size_t want = boost::asio::buffer_size(buffers_);
+      if (ahead_->size() != 0 || want == 0) {
+        // not completed inside the initiation.
+        state_ = state::buffered;
+        boost::asio::post(s_.get_executor(), std::move(self));
+        return;
+      }
+      if (want >= ahead_->capacity()) {
+        // nothing to gain from a copy.
+        state_ = state::direct;
+        s_.async_read_some(buffers_, std::move(self));
+        return;
+      }
+      state_ = state::filling;
+      s_.async_read_some(ahead_->prepare(), std::move(self));
+      return;
+    }
+    case state::filling:
+      ignore_partial_message(ec);
+      if (n == 0) {
+        self.complete(ec, 0);
+        return;
+      }
+      // an error with data is reported by the next read.
+      ahead_->commit(n);
+      self.complete(boost::system::error_code(), ahead_->consume(buffers_));
+      return;
+    case state::buffered:
+      self.complete(boost::system::error_code(), ahead_->consume(buffers_));
+      return;
+    case state::direct:
+      ignore_partial_message(ec);
+      self.complete(ec, n);
+      return;
+    }
+  }
+
+private:
+  enum class state { starting, filling, buffered, direct };
+
+  Stream &s_;
+  std::shared_ptr<read_ahead_buffer> ahead_;
+  MutableBufferSequence buffers_;
+  state state_;
+};
+
+// async_read_some of s through ahead. s must not be read otherwise while
+// ahead holds data.
+template <typename Stream, typename MutableBufferSequence, typename Token>
+auto async_read_ahead(Stream &s, std::shared_ptr<read_ahead_buffer> ahead,
+                      const MutableBufferSequence &buffers, Token &&token) {
+  return boost::asio::async_compose<
+      Token, void(boost::system::error_code, std::size_t)>(
+      read_ahead_op<Stream, MutableBufferSequence>(s, std::move(ahead),
+                                                   buffers),
+      token, s);
+}
+
+// read_some of s through ahead.
+template <typename Stream, typename MutableBufferSequence>
+std::size_t read_ahead(Stream &s, read_ahead_buffer &ahead,
+                       const MutableBufferSequence &buffers,
+                       boost::system::error_code &ec) {
+  ec = boost::system::error_code();
+  std::size_t want = boost::asio::buffer_size(buffers);
+  if (ahead.size() != 0 || want == 0) {
+    return ahead.consume(buffers);
+  }
+  if (want >= ahead.capacity()) {
+    std::size_t n = s.read_some(buffers, ec);
+    ignore_partial_message(ec);
+    return n;
+  }
+  std::size_t n = s.read_some(ahead.prepare(), ec);
+  ignore_partial_message(ec);
+  if (n == 0) {
+    return 0;
+  }
+  ec = boost::system::error_code();
+  ahead.commit(n);
+  return ahead.consume(buffers);
+}
+
+} // namespace details
+} // namespace winasio
+} // namespace boost
+
+#endif // ASIO_NAMED_PIPE_READ_AHEAD_HPP
@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_WINASIO_OVERLAPPED_CANCELLATION_HPP
+#define BOOST_WINASIO_OVERLAPPED_CANCELLATION_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+// Per operation cancellation of overlapped io started with an
+// overlapped_ptr. A cancellation through the cancellation slot of the
+// handler cancels the io with CancelIoEx, which completes it with
+// net::error::operation_aborted. Only that io is cancelled, and the handle
+// stays usable, so terminal, partial and total cancellation are supported.
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/cancellation_type.hpp>
+#include <boost/asio/windows/overlapped_ptr.hpp>
+
+#include <type_traits>
+#include <utility>
+
+namespace boost {
+namespace winasio {
+namespace details {
+
+namespace net = boost::asio;
+
+// installed in the cancellation slot of the handler of an overlapped io.
+class overlapped_cancellation {
+public:
+  overlapped_cancellation(HANDLE h, OVERLAPPED *o) noexcept : h_(h), o_(o) {}
+
+  void operator()(net::cancellation_type type) const {
+    if ((type & (net::cancellation_type::terminal |
+                 net::cancellation_type::partial |
+                 net::cancellation_type::total)) !=
+        net::cancellation_type::none) {
+      // fails with ERROR_NOT_FOUND if the io is completing, which is fine.
+      ::CancelIoEx(h_, o_);
+    }
+  }
+
+private:
+  HANDLE h_;
+  OVERLAPPED *o_;
+};
+
+// Clears the cancellation slot before the handler is called. The OVERLAPPED
+// is freed by then, and may be reused by the next io of the handle.
+template <typename Handler> class cancellable_handler {
+public:
+  template <typename H>
+  cancellable_handler(net::cancellation_slot slot, H &&h)
+      : slot_(slot), h_(std::forward<H>(h)) {}
+
+  template <typename... Args> void operator()(Args &&...args) {
+    slot_.clear();
+    std::move(h_)(std::forward<Args>(args)...);
+  }
+
+  const Handler &get() const noexcept { return h_; }
+
+private:
+  net::cancellation_slot slot_;
+  Handler h_;
+};
+
+// overlapped_ptr of an io of handle h, cancelled through the cancellation
+// slot of the handler, or through slot for handlers that wrap the user
+// handler.
+class cancellable_overlapped_ptr : public net::windows::overlapped_ptr {
+public:
+  template <typename Executor, typename Handler>
+  cancellable_overlapped_ptr(const Executor &ex, HANDLE h, Handler &&handler)
+      : cancellable_overlapped_ptr(
+            ex, h, net::get_associated_cancellation_slot(handler),
+            std::forward<Handler>(handler)) {}
+
+  template <typename Executor, typename Handler>
+  cancellable_overlapped_ptr(const Executor &ex, HANDLE h,
+                             net::cancellation_slot slot, Handler &&handler)
+      : net::windows::overlapped_ptr(
+            ex, cancellable_handler<typename std::decay<Handler>::type>(
+                    slot, std::forward<Handler>(handler))) {
+    // before the io is started, as it may complete on another thread.
+    if (slot.is_connected()) {
+      slot.template emplace<overlapped_cancellation>(h, this->get());
+    }
+  }
+};
+
+} // namespace details
+} // namespace winasio
+
+namespace asio {
+
+template <typename Handler, typename Executor>
+struct associated_executor<
+    winasio::details::cancellable_handler<Handler>, Executor> {
+  typedef typename associated_executor<Handler, Executor>::type type;
+  static type get(const winasio::details::cancellable_handler<Handler> &h,
+                  const Executor &ex = Executor()) noexcept {
+    return associated_executor<Handler, Executor>::get(h.get(), ex);
+  }
+};
+
+template <typename Handler, typename Allocator>
+struct associated_allocator<
+    winasio::details::cancellable_handler<Handler>, Allocator> {
+  typedef typename associated_allocator<Handler, Allocator>::type type;
+  static type get(const winasio::details::cancellable_handler<Handler> &h,
+                  const Allocator &a = Allocator()) noexcept {
+    return associated_allocator<Handler, Allocator>::get(h.get(), a);
+  }
+};
+
+} // namespace asio
+} // namespace boost
+
+#endif // BOOST_WINASIO_OVERLAPPED_CANCELLATION_HPP
@@ -0,0 +1,201 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_WINASIO_RECYCLING_ALLOCATOR_HPP
+#define BOOST_WINASIO_RECYCLING_ALLOCATOR_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+// Allocator of the intermediate handlers of async operations. Freed blocks
+// are kept in a small cache of the freeing thread and handed out again to
+// allocations of the same or a smaller size, so that the steps of an
+// operation, and the operations after it, reuse the same memory.
+// A block may be freed on any thread. It is reused when it is freed on the
+// thread that allocates next, which is the case when the memory of a
+// handler is freed before the handler is called.
+
+#include <boost/asio/associated_allocator.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace boost {
+namespace winasio {
+
+namespace details {
+
+class recycling_cache {
+public:
+  // blocks kept per thread.
+  static constexpr std::size_t slots = 8;
+  // sizes are rounded up to this, so that blocks fit more requests.
+  static constexpr std::size_t granularity = 64;
+  // larger blocks are not kept.
+  static constexpr std::size_t max_size = 64 * 1024;
+
+  recycling_cache() : blocks_() {}
+  recycling_cache(const recycling_cache &) = delete;
+  recycling_cache &operator=(const recycling_cache &) = delete;
+
+  ~recycling_cache() {
+    for (block *&b : blocks_) {
+      if (b != nullptr) {
+        ::operator delete(b);
+        b = nullptr;
+      }
+    }
+  }
+
+  static recycling_cache &local() noexcept {
+    static thread_local recycling_cache c;
+    return c;
+  }
+
+  void *allocate(std::size_t n) {
+    std::size_t size = round_up(n);
+    for (block *&b : blocks_) {
+      if (b != nullptr && b->size >= size) {
+        block *found = b;
+        b = nullptr;
+        return found + 1;
+      }
+    }
+    block *b = static_cast<block *>(::operator new(sizeof(block) + size));
+    b->size = size;
+    return b + 1;
+  }
+
+  void deallocate(void *p) noexcept {
+    block *b = static_cast<block *>(p) - 1;
+    if (b->size <= max_size) {
+      for (block *&slot : blocks_) {
+        if (slot == nullptr) {
+          slot = b;
+          return;
+        }
+      }
+      // replace the smallest kept block, larger blocks fit more requests.
+      block **smallest = &blocks_[0];
+      for (block *&slot : blocks_) {
+        if (slot->size < (*smallest)->size) {
+          smallest = &slot;
+        }
+      }
+      if ((*smallest)->size < b->size) {
+        std::swap(*smallest, b);
+      }
+    }
+    ::operator delete(b);
+  }
+
+private:
+  // header of a block, aligned for any handler.
+  struct alignas(std::max_align_t) block {
+    std::size_t size;
+  };
+
+  static std::size_t round_up(std::size_t n) noexcept {
+    return (n + granularity - 1) / granularity * granularity;
+  }
+
+  block *blocks_[slots];
+};
+
+} // namespace details
+
+template <typename T> class recycling_allocator {
+public:
+  typedef T value_type;
+
+  template <typename U> struct rebind {
+    typedef recycling_allocator<U> other;
+  };
+
+  constexpr recycling_allocator() noexcept {}
+
+  template <typename U>
+  constexpr recycling_allocator(const recycling_allocator<U> &) noexcept {}
+
+  T *allocate(std::size_t n) {
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "over-aligned types are not supported");
+    return static_cast<T *>(
+        details::recycling_cache::local().allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T *p, std::size_t) noexcept {
+    details::recycling_cache::local().deallocate(p);
+  }
+
+  template <typename U>
+  constexpr bool operator==(const recycling_allocator<U> &) const noexcept {
+    return true;
+  }
+
+  template <typename U>
+  constexpr bool operator!=(const recycling_allocator<U> &) const noexcept {
+    return false;
+  }
+};
+
+// The allocator of a handler's intermediate memory: its associated
+// allocator, or a recycling_allocator when it has none. Handlers without
+// one report std::allocator, which is taken as no choice.
+template <typename Handler> struct handler_allocator {
+  typedef boost::asio::associated_allocator_t<Handler,
+                                              recycling_allocator<void>>
+      associated;
+  typedef std::conditional_t<std::is_same_v<associated, std::allocator<void>>,
+                             recycling_allocator<void>, associated>
+      type;
+
+  static type get(const Handler &h) noexcept {
+    if constexpr (std::is_same_v<associated, std::allocator<void>>) {
+      return type();
+    } else {
+      return boost::asio::get_associated_allocator(
+          h, recycling_allocator<void>());
+    }
+  }
+};
+
+template <typename Handler>
+using handler_allocator_t = typename handler_allocator<Handler>::type;
+
+template <typename Handler>
+handler_allocator_t<Handler> get_handler_allocator(const Handler &h) noexcept {
+  return handler_allocator<Handler>::get(h);
+}
+
+// The call of a handler with its result, dispatched with the allocator of
+// the handler, like the posts of winhttp_step.
+template <typename Handler, typename... Args> struct handler_call {
+  typedef handler_allocator_t<Handler> allocator_type;
+
+  allocator_type get_allocator() const noexcept {
+    return get_handler_allocator(handler);
+  }
+
+  void operator()() {
+    std::apply(
+        [this](Args &...a) { std::move(handler)(std::move(a)...); }, args);
+  }
+
+  Handler handler;
+  std::tuple<Args...> args;
+};
+
+} // namespace winasio
+} // namespace boost
+
+#endif // BOOST_WINASIO_RECYCLING_ALLOCATOR_HPP
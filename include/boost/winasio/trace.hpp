@@ -0,0 +1,430 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_WINASIO_TRACE_HPP
+#define BOOST_WINASIO_TRACE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+// Tracing of async operations, to diagnose stalls without debug logging.
+// Compiled in with WINASIO_TRACE, otherwise the BOOST_WINASIO_TRACE macros
+// expand to nothing and their arguments are not evaluated.
+// Each thread records fixed size events into its own ring, which keeps the
+// last WINASIO_TRACE_RING_SIZE events. Only the first event of a thread
+// takes a lock, to register its ring, afterwards recording never blocks or
+// allocates. snapshot() copies all rings while threads keep recording.
+// Events are saved with write() and turned into Chrome trace json, for
+// chrome://tracing or Perfetto, by write_chrome_json() or the trace_dump
+// tool.
+// An operation is a begin event and an end event with the same op and
+// handle, which may be recorded on different threads. A begin without an
+// end is an operation still outstanding.
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef WINASIO_TRACE_RING_SIZE
+#define WINASIO_TRACE_RING_SIZE 4096
+#endif
+
+namespace boost {
+namespace winasio {
+namespace trace {
+
+enum class op : std::uint16_t {
+  // a winhttp status callback. state is the WINHTTP_CALLBACK_STATUS.
+  winhttp_callback,
+  // a step of a winhttp request or websocket. state is the step_state.
+  winhttp_step,
+  // HttpReceiveHttpRequest, HttpReceiveRequestEntityBody and
+  // HttpSendHttpResponse.
+  http_receive_request,
+  http_receive_body,
+  http_send_response,
+  // first value for applications.
+  user = 256
+};
+
+enum class phase : std::uint8_t { instant, begin, end };
+
+inline const char *op_name(op o) {
+  switch (o) {
+  case op::winhttp_callback:
+    return "winhttp_callback";
+  case op::winhttp_step:
+    return "winhttp_step";
+  case op::http_receive_request:
+    return "http_receive_request";
+  case op::http_receive_body:
+    return "http_receive_body";
+  case op::http_send_response:
+    return "http_send_response";
+  default:
+    return nullptr;
+  }
+}
+
+struct event {
+  // steady clock nanoseconds.
+  std::uint64_t time;
+  // identifies the operation, e.g. a step or an OVERLAPPED.
+  std::uint64_t handle;
+  std::uint64_t bytes;
+  std::uint32_t state;
+  // error_code value, 0 on success.
+  std::int32_t ec;
+  op what;
+  phase ph;
+  std::uint8_t reserved;
+  // index of the recording thread's ring.
+  std::uint32_t thread;
+};
+
+static_assert(sizeof(event) == 40, "events are saved as is");
+
+namespace details {
+
+// single producer ring that overwrites its oldest events.
+// The slots are atomic words, so that a snapshot can race with the owner.
+// started is stored before a slot is written, and published after, so that
+// the reader can tell which slots it may have read half written.
+class ring {
+public:
+  static constexpr std::size_t capacity = WINASIO_TRACE_RING_SIZE;
+  static_assert((capacity & (capacity - 1)) == 0, "a power of 2");
+
+  explicit ring(std::uint32_t index)
+      : index_(index), slots_(new slot[capacity]), started_(0),
+        published_(0) {}
+
+  std::uint32_t index() const noexcept { return index_; }
+
+  // owner thread only.
+  void push(std::uint64_t time, std::uint64_t handle, std::uint64_t bytes,
+            std::uint32_t state, std::int32_t ec, op what,
+            phase ph) noexcept {
+    std::uint64_t i = published_.load(std::memory_order_relaxed);
+    started_.store(i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot &s = slots_[i & (capacity - 1)];
+    s.w[0].store(time, std::memory_order_relaxed);
+    s.w[1].store(handle, std::memory_order_relaxed);
+    s.w[2].store(bytes, std::memory_order_relaxed);
+    s.w[3].store(state | (std::uint64_t(std::uint32_t(ec)) << 32),
+                 std::memory_order_relaxed);
+    s.w[4].store(std::uint64_t(what) | (std::uint64_t(ph) << 16),
+                 std::memory_order_relaxed);
+    published_.store(i + 1, std::memory_order_release);
+  }
+
+  // any thread. Appends the events that were not overwritten while copied.
+  void copy(std::vector<event> &out) const {
+    std::uint64_t end = published_.load(std::memory_order_acquire);
+    std::uint64_t begin = end > capacity ? end - capacity : 0;
+    std::size_t first = out.size();
+    for (std::uint64_t i = begin; i != end; ++i) {
+      const slot &s = slots_[i & (capacity - 1)];
+      event e{};
+      e.time = s.w[0].load(std::memory_order_relaxed);
+      e.handle = s.w[1].load(std::memory_order_relaxed);
+      e.bytes = s.w[2].load(std::memory_order_relaxed);
+      std::uint64_t w3 = s.w[3].load(std::memory_order_relaxed);
+      std::uint64_t w4 = s.w[4].load(std::memory_order_relaxed);
+      e.state = static_cast<std::uint32_t>(w3);
+      e.ec = static_cast<std::int32_t>(w3 >> 32);
+      e.what = static_cast<op>(w4 & 0xffff);
+      e.ph = static_cast<phase>((w4 >> 16) & 0xff);
+      e.thread = index_;
+      out.push_back(e);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    std::uint64_t started = started_.load(std::memory_order_relaxed);
+    // slots of indexes below started - capacity may have been rewritten.
+    if (started > capacity && started - capacity > begin) {
+      std::size_t torn = static_cast<std::size_t>(
+          (std::min)(started - capacity, end) - begin);
+      out.erase(out.begin() + first, out.begin() + first + torn);
+    }
+  }
+
+private:
+  struct slot {
+    std::atomic<std::uint64_t> w[5];
+  };
+
+  const std::uint32_t index_;
+  std::unique_ptr<slot[]> slots_;
+  alignas(64) std::atomic<std::uint64_t> started_;
+  std::atomic<std::uint64_t> published_;
+};
+
+// all rings. Rings of exited threads are kept, with their last events.
+class registry {
+public:
+  static registry &get() {
+    static registry r;
+    return r;
+  }
+
+  ring *local() noexcept {
+    static thread_local ring *r = nullptr;
+    if (r == nullptr) {
+      try {
+        std::lock_guard<std::mutex> lk(m_);
+        rings_.push_back(std::make_unique<ring>(
+            static_cast<std::uint32_t>(rings_.size())));
+        r = rings_.back().get();
+      } catch (...) {
+        return nullptr;
+      }
+    }
+    return r;
+  }
+
+  void copy(std::vector<event> &out) const {
+    std::lock_guard<std::mutex> lk(m_);
+    for (const auto &r : rings_) {
+      r->copy(out);
+    }
+  }
+
+private:
+  mutable std::mutex m_;
+  std::vector<std::unique_ptr<ring>> rings_;
+};
+
+inline std::uint64_t now() noexcept {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+} // namespace details
+
+inline std::uint64_t to_handle(std::uint64_t h) noexcept { return h; }
+inline std::uint64_t to_handle(const volatile void *p) noexcept {
+  return reinterpret_cast<std::uintptr_t>(p);
+}
+
+// records an event on the calling thread.
+template <typename Handle>
+inline void record(op what, phase ph, Handle handle, std::uint32_t state,
+                   std::uint64_t bytes,
+                   const boost::system::error_code &ec) noexcept {
+  if (details::ring *r = details::registry::get().local()) {
+    r->push(details::now(), to_handle(handle), bytes, state, ec.value(), what,
+            ph);
+  }
+}
+
+// a unique handle for operations without a natural one.
+inline std::uint64_t next_handle() noexcept {
+  static std::atomic<std::uint64_t> h{1};
+  return h.fetch_add(1, std::memory_order_relaxed);
+}
+
+// events of all threads, ordered by time.
+inline std::vector<event> snapshot() {
+  std::vector<event> out;
+  details::registry::get().copy(out);
+  std::stable_sort(out.begin(), out.end(),
+                   [](const event &a, const event &b) {
+                     return a.time < b.time;
+                   });
+  return out;
+}
+
+// binary form, read by the trace_dump tool.
+inline constexpr char file_magic[8] = {'W', 'A', 'T', 'R', 'A', 'C', 'E', '1'};
+
+inline void write(std::ostream &os, const std::vector<event> &events) {
+  std::uint64_t n = events.size();
+  os.write(file_magic, sizeof(file_magic));
+  os.write(reinterpret_cast<const char *>(&n), sizeof(n));
+  os.write(reinterpret_cast<const char *>(events.data()),
+           static_cast<std::streamsize>(n * sizeof(event)));
+}
+
+// false if is is not a trace.
+inline bool read(std::istream &is, std::vector<event> &events) {
+  char magic[sizeof(file_magic)];
+  std::uint64_t n = 0;
+  if (!is.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, file_magic, sizeof(magic)) != 0 ||
+      !is.read(reinterpret_cast<char *>(&n), sizeof(n))) {
+    return false;
+  }
+  events.resize(static_cast<std::size_t>(n));
+  return static_cast<bool>(
+      is.read(reinterpret_cast<char *>(events.data()),
+              static_cast<std::streamsize>(n * sizeof(event))));
+}
+
+// saves a snapshot, e.g. from a watchdog that sees a stall.
+inline bool dump(const std::string &path) {
+  std::ofstream f(path, std::ios::binary);
+  write(f, snapshot());
+  return static_cast<bool>(f);
+}
+
+// Chrome trace event format. Begin and end events are async slices keyed
+// by op and handle, so that they pair across threads.
+inline void write_chrome_json(std::ostream &os,
+                              const std::vector<event> &events) {
+  std::uint64_t origin = events.empty() ? 0 : events.front().time;
+  for (const event &e : events) {
+    origin = (std::min)(origin, e.time);
+  }
+  os << "{\"traceEvents\":[";
+  char buf[384];
+  bool first = true;
+  for (const event &e : events) {
+    char name[32];
+    const char *n = op_name(e.what);
+    if (n == nullptr) {
+      std::snprintf(name, sizeof(name), "op_%u", unsigned(e.what));
+      n = name;
+    }
+    const char *ph = e.ph == phase::begin ? "b"
+                     : e.ph == phase::end ? "e"
+                                          : "i";
+    std::uint64_t ns = e.time - origin;
+    std::snprintf(
+        buf, sizeof(buf),
+        "%s\n{\"name\":\"%s\",\"cat\":\"winasio\",\"ph\":\"%s\","
+        "\"ts\":%llu.%03u,\"pid\":1,\"tid\":%u,%s\"id\":\"0x%llx\","
+        "\"args\":{\"state\":%u,\"bytes\":%llu,\"ec\":%d}}",
+        first ? "" : ",", n, ph, static_cast<unsigned long long>(ns / 1000),
+        static_cast<unsigned>(ns % 1000), e.thread,
+        e.ph == phase::instant ? "\"s\":\"t\"," : "",
+        static_cast<unsigned long long>(e.handle), e.state,
+        static_cast<unsigned long long>(e.bytes), e.ec);
+    os << buf;
+    first = false;
+  }
+  os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+namespace details {
+
+// records the end of an operation before calling the handler.
+template <typename Handler> class traced_handler {
+public:
+  template <typename H>
+  traced_handler(op what, std::uint64_t handle, H &&h)
+      : what_(what), handle_(handle), h_(std::forward<H>(h)) {}
+
+  template <typename... Args>
+  void operator()(const boost::system::error_code &ec, std::size_t bytes,
+                  Args &&...args) {
+    record(what_, phase::end, handle_, 0, bytes, ec);
+    std::move(h_)(ec, bytes, std::forward<Args>(args)...);
+  }
+
+  const Handler &get() const noexcept { return h_; }
+
+private:
+  op what_;
+  std::uint64_t handle_;
+  Handler h_;
+};
+
+template <typename Handler>
+traced_handler<typename std::decay<Handler>::type>
+traced(op what, std::uint64_t bytes, Handler &&h) {
+  std::uint64_t handle = next_handle();
+  record(what, phase::begin, handle, 0, bytes, {});
+  return traced_handler<typename std::decay<Handler>::type>(
+      what, handle, std::forward<Handler>(h));
+}
+
+} // namespace details
+
+} // namespace trace
+} // namespace winasio
+
+namespace asio {
+
+// a traced handler runs where the handler would.
+template <typename Handler, typename Executor>
+struct associated_executor<winasio::trace::details::traced_handler<Handler>,
+                           Executor> {
+  typedef typename associated_executor<Handler, Executor>::type type;
+  static type
+  get(const winasio::trace::details::traced_handler<Handler> &h,
+      const Executor &ex = Executor()) noexcept {
+    return associated_executor<Handler, Executor>::get(h.get(), ex);
+  }
+};
+
+template <typename Handler, typename Allocator>
+struct associated_allocator<winasio::trace::details::traced_handler<Handler>,
+                            Allocator> {
+  typedef typename associated_allocator<Handler, Allocator>::type type;
+  static type
+  get(const winasio::trace::details::traced_handler<Handler> &h,
+      const Allocator &a = Allocator()) noexcept {
+    return associated_allocator<Handler, Allocator>::get(h.get(), a);
+  }
+};
+
+template <typename Handler, typename CancellationSlot>
+struct associated_cancellation_slot<
+    winasio::trace::details::traced_handler<Handler>, CancellationSlot> {
+  typedef typename associated_cancellation_slot<Handler,
+                                                CancellationSlot>::type type;
+  static type
+  get(const winasio::trace::details::traced_handler<Handler> &h,
+      const CancellationSlot &s = CancellationSlot()) noexcept {
+    return associated_cancellation_slot<Handler, CancellationSlot>::get(
+        h.get(), s);
+  }
+};
+
+} // namespace asio
+} // namespace boost
+
+#if defined(WINASIO_TRACE)
+// BOOST_WINASIO_TRACE(what, ph, handle, state, bytes, ec)
+#define BOOST_WINASIO_TRACE(what, ph, handle, state, bytes, ec)                \
+  ::boost::winasio::trace::record(                                             \
+      ::boost::winasio::trace::op::what, ::boost::winasio::trace::phase::ph,   \
+      handle, static_cast<std::uint32_t>(state),                               \
+      static_cast<std::uint64_t>(bytes), ec)
+// the handler of an operation that begins now, and ends when it is called.
+#define BOOST_WINASIO_TRACE_HANDLER(what, bytes, handler)                      \
+  ::boost::winasio::trace::details::traced(                                    \
+      ::boost::winasio::trace::op::what, static_cast<std::uint64_t>(bytes),    \
+      handler)
+#else
+#define BOOST_WINASIO_TRACE(what, ph, handle, state, bytes, ec) ((void)0)
+#define BOOST_WINASIO_TRACE_HANDLER(what, bytes, handler) handler
+#endif
+
+#endif // BOOST_WINASIO_TRACE_HPP
@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Counting semaphore with asynchronous acquire.
+// Waiters are served in fifo order and their handlers are posted, never
+// invoked inside release(). A waiting handler keeps its executor running,
+// like a pending timer.
+
+#include "boost/winasio/winhttp/winhttp_step.hpp"
+
+#include <boost/asio/error.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+template <typename Executor> class async_semaphore {
+public:
+  typedef Executor executor_type;
+
+  async_semaphore(const executor_type &ex, std::size_t count)
+      : ex_(ex), count_(count) {}
+
+  async_semaphore(const async_semaphore &) = delete;
+  async_semaphore &operator=(const async_semaphore &) = delete;
+
+  ~async_semaphore() { cancel(); }
+
+  executor_type get_executor() const noexcept { return ex_; }
+
+  bool try_acquire() {
+    std::lock_guard<std::mutex> lk(m_);
+    if (count_ == 0) {
+      return false;
+    }
+    --count_;
+    return true;
+  }
+
+  // handler signature is void(boost::system::error_code).
+  // Completes with operation_aborted if the semaphore is cancelled.
+  template <typename Token> auto async_acquire(Token &&token) {
+    return net::async_initiate<Token, void(boost::system::error_code)>(
+        [](auto handler, async_semaphore *self) {
+          typedef details::step_handler<decltype(handler), executor_type,
+                                        false>
+              waiter_type;
+          waiter_type *w = waiter_type::create(std::move(handler), self->ex_);
+          std::unique_lock<std::mutex> lk(self->m_);
+          if (self->count_ > 0) {
+            --self->count_;
+            lk.unlock();
+            w->post(boost::system::error_code{}, 0);
+            return;
+          }
+          self->waiters_.push_back(w);
+        },
+        token, this);
+  }
+
+  // give the permit to the oldest waiter, or return it to the pool.
+  void release() {
+    std::unique_lock<std::mutex> lk(m_);
+    if (waiters_.empty()) {
+      ++count_;
+      return;
+    }
+    details::step_handler_base *w = waiters_.front();
+    waiters_.pop_front();
+    lk.unlock();
+    w->post(boost::system::error_code{}, 0);
+  }
+
+  // fail all current waiters with operation_aborted.
+  void cancel() {
+    std::deque<details::step_handler_base *> waiters;
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      waiters.swap(waiters_);
+    }
+    for (auto *w : waiters) {
+      w->post(net::error::operation_aborted, 0);
+    }
+  }
+
+  std::size_t available() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return count_;
+  }
+
+  std::size_t waiting() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return waiters_.size();
+  }
+
+private:
+  executor_type ex_;
+  mutable std::mutex m_;
+  std::size_t count_;
+  // owned, each is deleted by post().
+  std::deque<details::step_handler_base *> waiters_;
+};
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
@@ -0,0 +1,84 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Sizes the WinHttpReadData calls of a response body, so that a body is read
+// with a few large reads instead of a query and a read per chunk.
+// With a content length the first read is at most max_read, so that a
+// response claiming a large body and sending little does not allocate it
+// up front, and reads double toward the remaining length each time one
+// fills its buffer. Otherwise reads start at initial_read and double up to
+// max_read. The body ends with a zero length read.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+namespace details {
+
+class body_read_sizer {
+public:
+  static constexpr std::size_t initial_read = 16 * 1024;
+  static constexpr std::size_t max_read = 1024 * 1024;
+  // larger content lengths are read like unknown lengths.
+  static constexpr std::uint64_t max_presize = 64 * 1024 * 1024;
+
+  body_read_sizer() : remaining_(), next_(initial_read) {}
+
+  explicit body_read_sizer(std::optional<std::uint64_t> content_length)
+      : remaining_(), next_(initial_read) {
+    if (content_length && *content_length <= max_presize) {
+      remaining_ = content_length;
+      next_ = max_read;
+    }
+  }
+
+  // size of the next read, never 0.
+  std::size_t next() const {
+    if (remaining_) {
+      std::uint64_t n = (std::min)(*remaining_, std::uint64_t{next_});
+      // the read after the last byte returns 0.
+      return (std::max)(static_cast<std::size_t>(n), std::size_t{1});
+    }
+    return next_;
+  }
+
+  // a read of requested bytes returned n bytes.
+  void consumed(std::size_t requested, std::size_t n) {
+    if (remaining_) {
+      if (n > *remaining_) {
+        // more than the content length, fall back to growing reads.
+        remaining_.reset();
+        next_ = initial_read;
+        return;
+      }
+      *remaining_ -= n;
+      if (n == requested && next_ < max_presize) {
+        next_ = static_cast<std::size_t>(
+            (std::min)(std::uint64_t{next_} * 2, max_presize));
+      }
+      return;
+    }
+    if (n == requested && next_ < max_read) {
+      next_ = (std::min)(next_ * 2, max_read);
+    }
+  }
+
+private:
+  std::optional<std::uint64_t> remaining_;
+  std::size_t next_;
+};
+
+} // namespace details
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
@@ -7,10 +7,21 @@
 
 #pragma once
 
+#include "boost/winasio/winhttp/client_pool.hpp"
+#include "boost/winasio/winhttp/upload.hpp"
+#include "boost/winasio/winhttp/url.hpp"
 #include "boost/winasio/winhttp/winhttp.hpp"
 #include "boost/winasio/winhttp/winhttp_asio.hpp"
+#ifdef WINASIO_ZLIB
+#include "boost/winasio/winhttp/decoded_body.hpp"
+#endif
 #include <spdlog/spdlog.h>
 
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
 namespace boost {
 namespace winasio {
 namespace winhttp {
@@ -26,11 +37,28 @@ public:
   std::optional<header::accept_types> accept;
   std::optional<header::headers> header;
   std::optional<std::string> body;
+  // streamed body, used instead of body. Sent chunked if it has no size.
+  std::optional<upload_source> upload;
   bool insecure_skip_verify;
+  // ask for gzip or deflate, and decode the body as it is read. Needs
+  // WINASIO_ZLIB, the request fails with operation_not_supported without.
+  bool decompress = false;
 };
 
 namespace details {
 
+// asks for compressed bodies, if they can be decoded.
+template <typename Executor>
+void accept_encoding(basic_winhttp_request_handle<Executor> &h,
+                     boost::system::error_code &ec) {
+#ifdef WINASIO_ZLIB
+  header::add_accept_encoding(h, ec);
+#else
+  (void)h;
+  ec = net::error::operation_not_supported;
+#endif
+}
+
 // compose operation that reads all http body into buff
 template <typename Executor, typename DynamicBuffer>
 class async_exec_op : boost::asio::coroutine {
@@ -38,11 +66,12 @@ public:
   typedef Executor executor_type;
   async_exec_op(basic_winhttp_request_asio_handle<executor_type> &h,
                 DynamicBuffer &buff, LPCWSTR lpszHeaders, DWORD dwHeadersLength,
-                LPVOID lpOptional, DWORD dwOptionalLength, DWORD dwTotalLength)
+                LPVOID lpOptional, DWORD dwOptionalLength, DWORD dwTotalLength,
+                upload_source *upload = nullptr, bool decompress = false)
       : h_(h), buff_(buff), lpszHeaders_(lpszHeaders),
         dwHeadersLength_(dwHeadersLength), lpOptional_(lpOptional),
         dwOptionalLength_(dwOptionalLength), dwTotalLength_(dwTotalLength),
-        state_(state::idle) {}
+        upload_(upload), decompress_(decompress), state_(state::idle) {}
 
   template <typename Self>
   void operator()(Self &self, boost::system::error_code ec = {},
@@ -59,12 +88,25 @@ public:
                     dwOptionalLength_, dwTotalLength_, std::move(self));
       break;
     case state::send:
+      if (upload_ != nullptr) {
+        state_ = state::upload;
+        async_upload(h_, *upload_, h_.get_executor(), std::move(self));
+        break;
+      }
+      [[fallthrough]];
+    case state::upload:
       state_ = state::receive_response;
       h_.async_recieve_response(std::move(self));
       break;
     case state::receive_response:
       // read body and finish
       state_ = state::done;
+#ifdef WINASIO_ZLIB
+      if (decompress_) {
+        async_read_decoded_body(h_, buff_, std::move(self));
+        break;
+      }
+#endif
       async_read_body(h_, buff_, std::move(self));
       break;
     case state::done:
@@ -84,7 +126,9 @@ private:
   LPVOID lpOptional_;
   DWORD dwOptionalLength_;
   DWORD dwTotalLength_;
-  enum class state { idle, send, receive_response, done } state_;
+  upload_source *upload_;
+  bool decompress_;
+  enum class state { idle, send, upload, receive_response, done } state_;
 };
 } // namespace details
 
@@ -136,6 +180,14 @@ void async_exec(payload &p, basic_winhttp_connect_handle<Executor> &h_connect,
     }
   }
 
+  if (p.decompress) {
+    details::accept_encoding(h_request, ec);
+    if (ec) {
+      net::post(h_request.get_executor(), std::bind(token, ec, 0));
+      return;
+    }
+  }
+
   LPCWSTR lpszHeaders = NULL;
   DWORD dwHeadersLength = 0;
   if (p.header) {
@@ -151,12 +203,37 @@ void async_exec(payload &p, basic_winhttp_connect_handle<Executor> &h_connect,
   }
   DWORD dwTotalLength = dwOptionalLength; // the same for now.
 
+  upload_source *upload = nullptr;
+  if (p.upload) {
+    upload = &*p.upload;
+    lpOptional = WINHTTP_NO_REQUEST_DATA;
+    dwOptionalLength = 0;
+    std::wstring length_header;
+    if (!upload->size()) {
+      dwTotalLength = WINHTTP_IGNORE_REQUEST_TOTAL_LENGTH;
+      length_header = L"Transfer-Encoding: chunked";
+    } else if (*upload->size() > MAXDWORD) {
+      // too large for dwTotalLength.
+      dwTotalLength = WINHTTP_IGNORE_REQUEST_TOTAL_LENGTH;
+      length_header = L"Content-Length: " + std::to_wstring(*upload->size());
+    } else {
+      dwTotalLength = static_cast<DWORD>(*upload->size());
+    }
+    if (!length_header.empty()) {
+      header::add_header(h_request, length_header, ec);
+      if (ec) {
+        net::post(h_request.get_executor(), std::bind(token, ec, 0));
+        return;
+      }
+    }
+  }
+
   // send request
   return boost::asio::async_compose<Token, void(boost::system::error_code,
                                                 std::size_t)>(
       details::async_exec_op<Executor, DynamicBuffer>(
           h_request, buffer, lpszHeaders, dwHeadersLength, lpOptional,
-          dwOptionalLength, dwTotalLength),
+          dwOptionalLength, dwTotalLength, upload, p.decompress),
       token, h_request.get_executor());
 }
 
@@ -169,6 +246,291 @@ std::string buff_to_string(DynamicBuffer &buff) {
   return std::string((BYTE *)view, (BYTE *)view + size);
 }
 
+// cached connect handle of a host.
+template <typename Executor> struct winhttp_connection {
+  explicit winhttp_connection(const Executor &ex) : handle(ex), secure() {}
+  basic_winhttp_connect_handle<Executor> handle;
+  bool secure;
+};
+
+namespace details {
+
+// opens a request on a cached connection, executes it and reads the
+// response. The request handle is owned by the op, and closed when it
+// completes, or when the cancel signal is emitted.
+template <typename Executor> class client_exec_op : boost::asio::coroutine {
+public:
+  client_exec_op(winhttp_connection<Executor> &conn, const client_request &req,
+                 std::shared_ptr<cancel_signal> cancel)
+      : conn_(conn),
+        s_(std::make_shared<state>(conn.handle.get_executor(), req)),
+        cancel_(std::move(cancel)) {}
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec = {},
+                  std::size_t = 0) {
+    BOOST_ASIO_CORO_REENTER(*this) {
+      s_->h.managed_open(conn_.handle.native_handle(),
+                         s_->req.method.c_str(), s_->req.target.c_str(),
+                         NULL, // http 1.1
+                         WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+                         conn_.secure ? WINHTTP_FLAG_SECURE : 0, s_->ec);
+      if (s_->ec) {
+        BOOST_ASIO_CORO_YIELD net::post(s_->h.get_executor(),
+                                        std::move(self));
+        self.complete(s_->ec, client_response{});
+        return;
+      }
+      if (s_->req.decompress) {
+        details::accept_encoding(s_->h, s_->ec);
+        if (s_->ec) {
+          BOOST_ASIO_CORO_YIELD net::post(s_->h.get_executor(),
+                                          std::move(self));
+          self.complete(s_->ec, client_response{});
+          return;
+        }
+      }
+      // closing the handle fails the pending winhttp call with
+      // ERROR_WINHTTP_OPERATION_CANCELLED.
+      cancel_->install([w = std::weak_ptr<state>(s_)] {
+        if (auto s = w.lock()) {
+          net::dispatch(s->h.get_executor(), [s] { s->h.close(); });
+        }
+      });
+      BOOST_ASIO_CORO_YIELD {
+        const client_request &req = s_->req;
+        LPCWSTR headers = req.headers.empty() ? NULL : req.headers.c_str();
+        LPVOID body = WINHTTP_NO_REQUEST_DATA;
+        DWORD body_len = 0;
+        if (req.body && !req.body->empty()) {
+          body = (LPVOID)req.body->data();
+          body_len = static_cast<DWORD>(req.body->size());
+        }
+        net::async_compose<Self, void(boost::system::error_code,
+                                      std::size_t)>(
+            async_exec_op<Executor, buffer_type>(
+                s_->h, s_->buff, headers,
+                static_cast<DWORD>(req.headers.size()), body, body_len,
+                body_len, nullptr, req.decompress),
+            std::move(self), s_->h.get_executor());
+      }
+      if (ec) {
+        self.complete(ec, client_response{});
+        return;
+      }
+      {
+        // status and headers with a single query.
+        response_headers rh;
+        header::get_response_headers(s_->h, ec, rh);
+        if (!ec && !rh.status()) {
+          ec = net::error::invalid_argument;
+        }
+        if (ec) {
+          self.complete(ec, client_response{});
+          return;
+        }
+        client_response resp;
+        resp.status = *rh.status();
+        resp.headers.assign(rh.raw());
+        if (s_->req.body_buffer) {
+          resp.body = borrowed_body(s_->req.body_buffer);
+        } else {
+          resp.body = std::make_shared<const std::string>(std::move(s_->body));
+        }
+        self.complete(ec, std::move(resp));
+      }
+    }
+  }
+
+private:
+  typedef net::dynamic_string_buffer<char, std::char_traits<char>,
+                                     std::allocator<char>>
+      buffer_type;
+
+  // heap allocated, winhttp holds pointers into it. The pool starts an
+  // attempt with a body buffer only after the previous one completed, so
+  // clearing the buffer here races no read of winhttp.
+  struct state {
+    state(const Executor &ex, const client_request &r)
+        : h(ex), req(r), body(),
+          buff(cleared(r.body_buffer ? r.body_buffer : &body)), ec() {}
+    static std::string &cleared(std::string *s) {
+      s->clear();
+      return *s;
+    }
+    basic_winhttp_request_asio_handle<Executor> h;
+    client_request req;
+    // the body, unless the request has a body buffer.
+    std::string body;
+    buffer_type buff;
+    boost::system::error_code ec;
+  };
+
+  winhttp_connection<Executor> &conn_;
+  // shared with the cancel function.
+  std::shared_ptr<state> s_;
+  std::shared_ptr<cancel_signal> cancel_;
+};
+
+} // namespace details
+
+// Transport of basic_client_pool using winhttp.
+// WinHttpConnect does no io, winhttp keeps its own socket pool per session.
+template <typename Executor> class winhttp_transport {
+public:
+  typedef Executor executor_type;
+  typedef winhttp_connection<executor_type> connection_type;
+
+  explicit winhttp_transport(basic_winhttp_session_handle<executor_type> &s)
+      : session_(&s) {}
+
+  std::unique_ptr<connection_type> connect(const host_key &key,
+                                           boost::system::error_code &ec) {
+    auto c = std::make_unique<connection_type>(session_->get_executor());
+    c->handle.connect(session_->native_handle(), key.host.c_str(), key.port,
+                      ec);
+    if (ec) {
+      return nullptr;
+    }
+    c->secure = key.secure;
+    return c;
+  }
+
+  template <typename Handler>
+  void async_exec(connection_type &conn, const client_request &req,
+                  std::shared_ptr<cancel_signal> cancel, Handler &&handler) {
+    net::async_compose<Handler,
+                       void(boost::system::error_code, client_response)>(
+        details::client_exec_op<executor_type>(conn, req, std::move(cancel)),
+        std::forward<Handler>(handler), conn.handle.get_executor());
+  }
+
+private:
+  basic_winhttp_session_handle<executor_type> *session_;
+};
+
+// High level client. Reuses one async session, caches connect handles per
+// (scheme, host, port) and caps concurrent requests per host.
+//   auto resp = co_await client.request(L"GET", url, "", net::use_awaitable);
+template <typename Executor = net::any_io_executor> class basic_client {
+public:
+  typedef Executor executor_type;
+  typedef winhttp_transport<executor_type> transport_type;
+
+  explicit basic_client(const executor_type &ex, std::size_t max_per_host = 8)
+      : max_per_host_(max_per_host), session_(ex),
+        pool_(ex, transport_type(session_), max_per_host) {}
+
+  // opens the async session. Must be called before any request.
+  void open(boost::system::error_code &ec) {
+    session_.open(ec);
+    if (ec) {
+      return;
+    }
+    // let winhttp keep as many sockets as requests are allowed.
+    DWORD conns = static_cast<DWORD>(max_per_host_);
+    session_.set_option(WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &conns,
+                        sizeof(conns), ec);
+  }
+
+  executor_type get_executor() { return session_.get_executor(); }
+
+  basic_client_pool<transport_type> &get_pool() { return pool_; }
+
+  // handler signature void(boost::system::error_code, client_response)
+  // A bad url, or one not http or https, completes with the error of
+  // parse_url or net::error::invalid_argument.
+  template <typename Token>
+  auto request(std::wstring method, std::wstring_view url, std::string body,
+               Token &&token) {
+    return request(std::move(method), url, std::move(body), request_policy{},
+                   std::forward<Token>(token));
+  }
+
+  // as above, with deadlines, retries and hedging.
+  template <typename Token>
+  auto request(std::wstring method, std::wstring_view url, std::string body,
+               const request_policy &policy, Token &&token) {
+    boost::system::error_code ec;
+    wurl_view u = parse_url(url, ec);
+    if (!ec && !wurl_view::iequals(u.scheme, "http") &&
+        !wurl_view::iequals(u.scheme, "https")) {
+      ec = net::error::invalid_argument;
+    }
+    host_key key;
+    client_request req;
+    if (!ec) {
+      key = make_host_key(u);
+      req.method = std::move(method);
+      req.target = u.target().empty() ? L"/" : u.target();
+      if (!body.empty()) {
+        req.body = std::make_shared<const std::string>(std::move(body));
+      }
+    }
+    return net::async_initiate<Token, void(boost::system::error_code,
+                                           client_response)>(
+        initiate_url_request(), token, this, ec, std::move(key),
+        std::move(req), policy);
+  }
+
+  template <typename Token>
+  auto async_request(const host_key &key, client_request req, Token &&token) {
+    return pool_.async_request(key, std::move(req),
+                               std::forward<Token>(token));
+  }
+
+  template <typename Token>
+  auto async_request(const host_key &key, client_request req,
+                     const request_policy &policy, Token &&token) {
+    return pool_.async_request(key, std::move(req), policy,
+                               std::forward<Token>(token));
+  }
+
+  // handler signature void(boost::system::error_code,
+  //                        std::vector<batch_result>)
+  // see basic_client_pool::async_exec_all.
+  template <typename Token>
+  auto async_exec_all(std::vector<batch_item> items,
+                      std::size_t max_concurrency, batch_mode mode,
+                      Token &&token) {
+    return pool_.async_exec_all(std::move(items), max_concurrency, mode,
+                                std::forward<Token>(token));
+  }
+
+  template <typename Token>
+  auto async_exec_all(std::vector<batch_item> items,
+                      std::size_t max_concurrency, batch_mode mode,
+                      const request_policy &policy, Token &&token) {
+    return pool_.async_exec_all(std::move(items), max_concurrency, mode,
+                                policy, std::forward<Token>(token));
+  }
+
+private:
+  struct initiate_url_request {
+    template <typename Handler>
+    void operator()(Handler &&handler, basic_client *self,
+                    boost::system::error_code ec, host_key key,
+                    client_request req, const request_policy &policy) const {
+      if (ec) {
+        // do not complete inside the initiating function.
+        auto ex = net::get_associated_executor(handler, self->get_executor());
+        net::post(ex, handler_call<std::decay_t<Handler>,
+                                   boost::system::error_code, client_response>{
+                          std::move(handler), {ec, client_response{}}});
+        return;
+      }
+      self->pool_.async_request(key, std::move(req), policy,
+                                std::move(handler));
+    }
+  };
+
+  const std::size_t max_per_host_;
+  basic_winhttp_session_handle<executor_type> session_;
+  basic_client_pool<transport_type> pool_;
+};
+
+typedef basic_client<> client;
+
 } // namespace winhttp
 } // namespace winasio
 } // namespace boost
\ No newline at end of file
@@ -0,0 +1,465 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Private cache of GET responses, in the spirit of RFC 9111, used by
+// basic_client_pool when one is set.
+// Requests with headers of their own are not cached, decompressed and
+// encoded bodies are cached apart.
+// Only 200 responses are stored, unless they have Cache-Control no-store
+// or a Vary header. The freshness lifetime is max-age, less the Age of the
+// response. Expires and heuristic freshness are not used, so a response
+// without max-age is stored only if it has a validator, and is revalidated
+// on every use.
+// A stale entry is revalidated with If-None-Match and If-Modified-Since. A
+// 304 refreshes the entry and the cached response is returned. Within
+// stale-while-revalidate the stale response is returned at once and the
+// entry is refreshed in the background.
+// Entries live in a sharded, size bounded LRU. Bodies are shared immutable
+// strings, a hit does not copy them.
+
+#include "boost/winasio/winhttp/client_message.hpp"
+#include "boost/winasio/winhttp/response_headers.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+struct cache_control {
+  std::optional<std::chrono::seconds> max_age;
+  std::optional<std::chrono::seconds> stale_while_revalidate;
+  bool no_store = false;
+  bool no_cache = false;
+  bool must_revalidate = false;
+};
+
+// directives of a Cache-Control value. Unknown ones are ignored.
+inline cache_control parse_cache_control(std::wstring_view v) {
+  cache_control cc;
+  // delta seconds above 2^31 count as 2^31, RFC 9111 1.2.2.
+  auto seconds =
+      [](std::wstring_view s) -> std::optional<std::chrono::seconds> {
+    if (s.size() >= 2 && s.front() == L'"' && s.back() == L'"') {
+      s = s.substr(1, s.size() - 2);
+    }
+    auto n = response_headers::parse_number(s);
+    if (!n) {
+      return std::nullopt;
+    }
+    return std::chrono::seconds(
+        (std::min)(*n, std::uint64_t{0x80000000}));
+  };
+  while (!v.empty()) {
+    std::size_t comma = v.find(L',');
+    std::wstring_view d = v.substr(0, comma);
+    v = comma == std::wstring_view::npos ? std::wstring_view()
+                                         : v.substr(comma + 1);
+    std::size_t eq = d.find(L'=');
+    std::wstring_view name = d.substr(0, eq);
+    std::wstring_view value =
+        eq == std::wstring_view::npos ? std::wstring_view() : d.substr(eq + 1);
+    while (!name.empty() && (name.front() == L' ' || name.front() == L'\t')) {
+      name.remove_prefix(1);
+    }
+    while (!name.empty() && (name.back() == L' ' || name.back() == L'\t')) {
+      name.remove_suffix(1);
+    }
+    if (response_headers::iequals(name, L"max-age")) {
+      cc.max_age = seconds(value);
+    } else if (response_headers::iequals(name, L"stale-while-revalidate")) {
+      cc.stale_while_revalidate = seconds(value);
+    } else if (response_headers::iequals(name, L"no-store")) {
+      cc.no_store = true;
+    } else if (response_headers::iequals(name, L"no-cache")) {
+      cc.no_cache = true;
+    } else if (response_headers::iequals(name, L"must-revalidate")) {
+      cc.must_revalidate = true;
+    }
+  }
+  return cc;
+}
+
+class cache_entry {
+public:
+  typedef std::chrono::steady_clock clock;
+
+  cache_entry(client_response resp, clock::time_point now)
+      : response(std::move(resp)), etag(), last_modified(), stored(now),
+        lifetime(0), stale_while_revalidate(0), no_cache(false),
+        revalidating_(false) {
+    response_headers h;
+    h.assign(response.headers);
+    update(h, now);
+  }
+
+  // a copy refreshed by the headers of a 304.
+  cache_entry(const cache_entry &other, const std::wstring &headers,
+              clock::time_point now)
+      : response(other.response), etag(other.etag),
+        last_modified(other.last_modified), stored(now),
+        lifetime(other.lifetime),
+        stale_while_revalidate(other.stale_while_revalidate),
+        no_cache(other.no_cache), revalidating_(false) {
+    response_headers h;
+    h.assign(headers);
+    update(h, now);
+  }
+
+  bool fresh(clock::time_point now) const {
+    return !no_cache && now - stored < lifetime;
+  }
+
+  // stale, but may be returned while it is revalidated.
+  bool usable_stale(clock::time_point now) const {
+    return !no_cache && now - stored < lifetime + stale_while_revalidate;
+  }
+
+  bool has_validator() const {
+    return !etag.empty() || !last_modified.empty();
+  }
+
+  // headers making a request conditional, crlf separated.
+  std::wstring conditional_headers() const {
+    std::wstring out;
+    if (!etag.empty()) {
+      out += L"If-None-Match: ";
+      out += etag;
+    }
+    if (!last_modified.empty()) {
+      if (!out.empty()) {
+        out += L"\r\n";
+      }
+      out += L"If-Modified-Since: ";
+      out += last_modified;
+    }
+    return out;
+  }
+
+  // true for the one caller that should start a background revalidation.
+  bool begin_revalidation() const {
+    return !revalidating_.exchange(true, std::memory_order_acq_rel);
+  }
+
+  // after a failed revalidation, so that the next stale hit starts another.
+  void end_revalidation() const {
+    revalidating_.store(false, std::memory_order_release);
+  }
+
+  std::size_t cost() const {
+    return sizeof(*this) + (response.body ? response.body->size() : 0) +
+           (response.headers.size() + etag.size() + last_modified.size()) *
+               sizeof(wchar_t);
+  }
+
+  client_response response;
+  std::wstring etag;
+  std::wstring last_modified;
+  // time of the response, less its Age.
+  clock::time_point stored;
+  clock::duration lifetime;
+  clock::duration stale_while_revalidate;
+  // revalidate on every use.
+  bool no_cache;
+
+private:
+  void update(response_headers &h, clock::time_point now) {
+    if (auto v = h.get(L"ETag")) {
+      etag.assign(*v);
+    }
+    if (auto v = h.get(L"Last-Modified")) {
+      last_modified.assign(*v);
+    }
+    if (auto v = h.get(L"Age")) {
+      if (auto age = response_headers::parse_number(*v)) {
+        stored = now - std::chrono::seconds(
+                           (std::min)(*age, std::uint64_t{0x80000000}));
+      }
+    }
+    if (auto v = h.get(L"Cache-Control")) {
+      cache_control cc = parse_cache_control(*v);
+      lifetime = cc.max_age.value_or(std::chrono::seconds(0));
+      stale_while_revalidate =
+          cc.must_revalidate
+              ? clock::duration(0)
+              : clock::duration(cc.stale_while_revalidate.value_or(
+                    std::chrono::seconds(0)));
+      no_cache = cc.no_cache;
+    }
+  }
+
+  mutable std::atomic<bool> revalidating_;
+};
+
+struct cache_stats {
+  std::size_t hits = 0;
+  // stale responses returned during a background revalidation.
+  std::size_t stale_hits = 0;
+  std::size_t misses = 0;
+  // conditional requests, in the foreground or background.
+  std::size_t revalidations = 0;
+  std::size_t not_modified = 0;
+  std::size_t stores = 0;
+  std::size_t evictions = 0;
+};
+
+class response_cache {
+public:
+  typedef cache_entry::clock clock;
+
+  // max_bytes is split evenly over the shards. An entry larger than its
+  // shard is not stored.
+  explicit response_cache(std::size_t max_bytes, std::size_t shards = 16)
+      : shards_(), shard_bytes_(max_bytes / (std::max)(shards, std::size_t{1})),
+        skew_(0) {
+    for (std::size_t i = 0; i < (std::max)(shards, std::size_t{1}); ++i) {
+      shards_.push_back(std::make_unique<shard>());
+    }
+  }
+
+  response_cache(const response_cache &) = delete;
+  response_cache &operator=(const response_cache &) = delete;
+
+  // GET requests without a body_buffer or headers of their own go through
+  // the cache. Responses may depend on such headers, i.e. Authorization or
+  // Accept, and Vary is not supported.
+  static bool cacheable(const client_request &req) {
+    return req.method == L"GET" && !req.body_buffer && req.headers.empty();
+  }
+
+  // A decompressed body is stored decoded, with the headers as received,
+  // so it does not share the entry of the encoded one.
+  static std::wstring make_key(const host_key &key, const client_request &req) {
+    std::wstring k(key.secure ? L"https://" : L"http://");
+    k += key.host;
+    k += L':';
+    k += std::to_wstring(key.port);
+    k += req.target;
+    if (req.decompress) {
+      // a target has no crlf.
+      k += L"\r\ndecompress";
+    }
+    return k;
+  }
+
+  clock::time_point now() const {
+    return clock::now() + clock::duration(skew_.load());
+  }
+
+  // moves the clock of the cache forward, for tests.
+  void advance(clock::duration d) { skew_.fetch_add(d.count()); }
+
+  // the entry of key, and marks it as recently used.
+  std::shared_ptr<const cache_entry> find(const std::wstring &key) {
+    shard &s = get_shard(key);
+    std::lock_guard<std::mutex> lk(s.m);
+    auto it = s.index.find(key);
+    if (it == s.index.end()) {
+      return nullptr;
+    }
+    s.lru.splice(s.lru.begin(), s.lru, it->second);
+    return it->second->entry;
+  }
+
+  void store(const std::wstring &key, std::shared_ptr<const cache_entry> e) {
+    std::size_t cost = e->cost() + key.size() * sizeof(wchar_t);
+    shard &s = get_shard(key);
+    std::lock_guard<std::mutex> lk(s.m);
+    erase_locked(s, key);
+    if (cost > shard_bytes_) {
+      return;
+    }
+    while (s.bytes + cost > shard_bytes_) {
+      erase_locked(s, s.lru.back().key);
+      evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+    s.lru.push_front(node{key, std::move(e), cost});
+    s.index.emplace(s.lru.front().key, s.lru.begin());
+    s.bytes += cost;
+    stores_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void erase(const std::wstring &key) {
+    shard &s = get_shard(key);
+    std::lock_guard<std::mutex> lk(s.m);
+    erase_locked(s, key);
+  }
+
+  void clear() {
+    for (auto &s : shards_) {
+      std::lock_guard<std::mutex> lk(s->m);
+      s->index.clear();
+      s->lru.clear();
+      s->bytes = 0;
+    }
+  }
+
+  std::size_t size() const {
+    std::size_t n = 0;
+    for (auto &s : shards_) {
+      std::lock_guard<std::mutex> lk(s->m);
+      n += s->lru.size();
+    }
+    return n;
+  }
+
+  std::size_t bytes() const {
+    std::size_t n = 0;
+    for (auto &s : shards_) {
+      std::lock_guard<std::mutex> lk(s->m);
+      n += s->bytes;
+    }
+    return n;
+  }
+
+  cache_stats stats() const {
+    cache_stats st;
+    st.hits = hits_.load(std::memory_order_relaxed);
+    st.stale_hits = stale_hits_.load(std::memory_order_relaxed);
+    st.misses = misses_.load(std::memory_order_relaxed);
+    st.revalidations = revalidations_.load(std::memory_order_relaxed);
+    st.not_modified = not_modified_.load(std::memory_order_relaxed);
+    st.stores = stores_.load(std::memory_order_relaxed);
+    st.evictions = evictions_.load(std::memory_order_relaxed);
+    return st;
+  }
+
+  // How a request is served.
+  enum class lookup_result {
+    // return the entry.
+    hit,
+    // return the entry and revalidate it in the background.
+    stale_hit,
+    // send the request, conditional if there is an entry.
+    fetch
+  };
+
+  // the entry of key, if any, and what to do with it. A stale_hit is
+  // returned to one caller at a time, the others get a hit.
+  lookup_result lookup(const std::wstring &key,
+                       std::shared_ptr<const cache_entry> &entry) {
+    entry = find(key);
+    clock::time_point t = now();
+    if (entry && entry->fresh(t)) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return lookup_result::hit;
+    }
+    if (entry && entry->usable_stale(t)) {
+      if (entry->begin_revalidation()) {
+        stale_hits_.fetch_add(1, std::memory_order_relaxed);
+        revalidations_.fetch_add(1, std::memory_order_relaxed);
+        return lookup_result::stale_hit;
+      }
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return lookup_result::hit;
+    }
+    if (entry && entry->has_validator()) {
+      revalidations_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      entry.reset();
+      misses_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return lookup_result::fetch;
+  }
+
+  // updates the cache from the response of a request for key, sent
+  // conditional on entry if it is set. Returns the response for the caller.
+  client_response on_response(const std::wstring &key,
+                              const std::shared_ptr<const cache_entry> &entry,
+                              client_response resp) {
+    if (resp.status == 304 && entry) {
+      not_modified_.fetch_add(1, std::memory_order_relaxed);
+      auto refreshed =
+          std::make_shared<cache_entry>(*entry, resp.headers, now());
+      client_response out = refreshed->response;
+      store(key, std::move(refreshed));
+      return out;
+    }
+    if (resp.status != 200) {
+      if (entry) {
+        entry->end_revalidation();
+      }
+      return resp;
+    }
+    response_headers h;
+    h.assign(resp.headers);
+    bool no_store = false;
+    if (auto v = h.get(L"Cache-Control")) {
+      no_store = parse_cache_control(*v).no_store;
+    }
+    if (no_store || h.get(L"Vary")) {
+      erase(key);
+      return resp;
+    }
+    auto e = std::make_shared<cache_entry>(resp, now());
+    if (e->lifetime.count() > 0 || e->has_validator()) {
+      store(key, std::move(e));
+    } else {
+      erase(key);
+    }
+    return resp;
+  }
+
+private:
+  struct node {
+    std::wstring key;
+    std::shared_ptr<const cache_entry> entry;
+    std::size_t cost;
+  };
+
+  struct shard {
+    mutable std::mutex m;
+    std::list<node> lru;
+    // keys are views of the keys in lru.
+    std::unordered_map<std::wstring_view, std::list<node>::iterator> index;
+    std::size_t bytes = 0;
+  };
+
+  shard &get_shard(const std::wstring &key) {
+    return *shards_[std::hash<std::wstring>()(key) % shards_.size()];
+  }
+
+  static void erase_locked(shard &s, std::wstring_view key) {
+    auto it = s.index.find(key);
+    if (it == s.index.end()) {
+      return;
+    }
+    auto node_it = it->second;
+    s.bytes -= node_it->cost;
+    s.index.erase(it);
+    s.lru.erase(node_it);
+  }
+
+  std::vector<std::unique_ptr<shard>> shards_;
+  const std::size_t shard_bytes_;
+  std::atomic<clock::rep> skew_;
+  std::atomic<std::size_t> hits_{0};
+  std::atomic<std::size_t> stale_hits_{0};
+  std::atomic<std::size_t> misses_{0};
+  std::atomic<std::size_t> revalidations_{0};
+  std::atomic<std::size_t> not_modified_{0};
+  std::atomic<std::size_t> stores_{0};
+  std::atomic<std::size_t> evictions_{0};
+};
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
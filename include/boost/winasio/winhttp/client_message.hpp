@@ -0,0 +1,71 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Requests and responses of the high level client, shared by the pool, the
+// cache and the transports. No dependency on winhttp.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+struct host_key {
+  bool secure = false;
+  // an ipv6 literal is without its brackets, as WinHttpConnect takes it.
+  std::wstring host;
+  std::uint16_t port = 0;
+
+  friend bool operator<(const host_key &a, const host_key &b) {
+    return std::tie(a.secure, a.host, a.port) <
+           std::tie(b.secure, b.host, b.port);
+  }
+  friend bool operator==(const host_key &a, const host_key &b) {
+    return a.secure == b.secure && a.host == b.host && a.port == b.port;
+  }
+};
+
+struct client_request {
+  std::wstring method;
+  // path and query.
+  std::wstring target;
+  // additional headers, crlf separated.
+  std::wstring headers;
+  // shared so that the request can be resent without copying the body.
+  std::shared_ptr<const std::string> body;
+  // optional caller owned storage of the response body, so that batches can
+  // reuse preallocated buffers. Must outlive the request. Such requests are
+  // not hedged, as two attempts would write into it.
+  std::string *body_buffer = nullptr;
+  // ask for gzip or deflate, and decode the body as it is read. The
+  // response headers stay as received. Needs WINASIO_ZLIB, the request
+  // fails with operation_not_supported without.
+  bool decompress = false;
+};
+
+struct client_response {
+  unsigned int status = 0;
+  // raw headers, crlf separated.
+  std::wstring headers;
+  std::shared_ptr<const std::string> body;
+};
+
+// a response body that points to a body_buffer, without owning it.
+inline std::shared_ptr<const std::string>
+borrowed_body(const std::string *buffer) {
+  return std::shared_ptr<const std::string>(
+      std::shared_ptr<const std::string>(), buffer);
+}
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
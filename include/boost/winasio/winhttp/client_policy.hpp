@@ -0,0 +1,187 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Deadlines, retries and hedging of the high level client.
+// A request runs as one or more attempts. An attempt that fails or misses
+// its deadline may be retried, and a hedged request starts a second attempt
+// when the first is slower than the recent p95 of the host. The first
+// attempt to succeed wins, the others are cancelled.
+// Retries and hedges are drawn from a retry_budget, so that a failing
+// backend does not see a multiple of the normal traffic.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+struct request_policy {
+  // of the whole request, all attempts. Zero is no deadline.
+  std::chrono::milliseconds timeout{0};
+  // of each attempt. Zero is no deadline.
+  std::chrono::milliseconds attempt_timeout{0};
+  // attempts in total, hedges included.
+  unsigned int max_attempts = 1;
+  // start a second attempt after the p95 latency of the host.
+  bool hedge = false;
+  // hedge delay until the host has enough samples.
+  std::chrono::milliseconds hedge_delay{50};
+  // retries and hedges are only done for idempotent requests. By default
+  // the method decides.
+  std::optional<bool> idempotent;
+};
+
+// GET, HEAD, OPTIONS, TRACE, PUT and DELETE.
+inline bool is_idempotent(std::wstring_view method) {
+  for (std::wstring_view m :
+       {L"GET", L"HEAD", L"OPTIONS", L"TRACE", L"PUT", L"DELETE"}) {
+    if (m == method) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Stops the io of an attempt. The transport installs a function, the pool
+// emits the signal.
+class cancel_signal {
+public:
+  cancel_signal() : emitted_(false) {}
+
+  // fn runs once, inside emit(), or at once if already emitted.
+  void install(std::function<void()> fn) {
+    std::unique_lock<std::mutex> lk(m_);
+    if (emitted_) {
+      lk.unlock();
+      fn();
+      return;
+    }
+    fn_ = std::move(fn);
+  }
+
+  void emit() {
+    std::function<void()> fn;
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      if (emitted_) {
+        return;
+      }
+      emitted_ = true;
+      fn.swap(fn_);
+    }
+    if (fn) {
+      fn();
+    }
+  }
+
+  bool emitted() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return emitted_;
+  }
+
+private:
+  mutable std::mutex m_;
+  bool emitted_;
+  std::function<void()> fn_;
+};
+
+// Latencies of the last capacity successful attempts.
+class latency_tracker {
+public:
+  typedef std::chrono::steady_clock::duration duration;
+
+  // fewer samples give no percentile.
+  static constexpr std::size_t min_samples = 20;
+
+  explicit latency_tracker(std::size_t capacity = 256)
+      : samples_(), capacity_(capacity), next_(0) {
+    samples_.reserve(capacity);
+  }
+
+  void record(duration d) {
+    std::lock_guard<std::mutex> lk(m_);
+    if (samples_.size() < capacity_) {
+      samples_.push_back(d);
+    } else {
+      samples_[next_] = d;
+    }
+    next_ = (next_ + 1) % capacity_;
+  }
+
+  // p in [0, 1].
+  std::optional<duration> percentile(double p) const {
+    std::vector<duration> s;
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      if (samples_.size() < min_samples) {
+        return std::nullopt;
+      }
+      s = samples_;
+    }
+    std::size_t k = static_cast<std::size_t>(p * (s.size() - 1) + 0.5);
+    std::nth_element(s.begin(), s.begin() + k, s.end());
+    return s[k];
+  }
+
+  std::size_t count() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return samples_.size();
+  }
+
+private:
+  mutable std::mutex m_;
+  std::vector<duration> samples_;
+  const std::size_t capacity_;
+  std::size_t next_;
+};
+
+// Every request deposits ratio, every retry or hedge withdraws 1. The
+// balance is capped at reserve, which it starts with. So retries are about
+// ratio of the requests, with bursts of up to reserve.
+class retry_budget {
+public:
+  explicit retry_budget(double ratio = 0.1, double reserve = 10)
+      : ratio_(ratio), reserve_(reserve), balance_(reserve) {}
+
+  void deposit() {
+    std::lock_guard<std::mutex> lk(m_);
+    balance_ = (std::min)(balance_ + ratio_, reserve_);
+  }
+
+  bool try_withdraw() {
+    std::lock_guard<std::mutex> lk(m_);
+    if (balance_ < 1) {
+      return false;
+    }
+    balance_ -= 1;
+    return true;
+  }
+
+  double balance() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return balance_;
+  }
+
+private:
+  mutable std::mutex m_;
+  const double ratio_;
+  const double reserve_;
+  double balance_;
+};
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
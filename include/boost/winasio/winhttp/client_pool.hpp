@@ -0,0 +1,712 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Scheduling part of the high level client.
+// Connections are cached per (scheme, host, port) and the number of
+// concurrent requests per host is capped by an async semaphore. Each
+// attempt of a request takes a slot, see client_policy.hpp for deadlines,
+// retries and hedging. With a response_cache GET requests are served from
+// it, see client_cache.hpp.
+// The transport does the actual io. The client in client.hpp uses winhttp,
+// tests can plug in any other transport.
+//
+// A Transport provides:
+//   typedef ... executor_type;
+//   typedef ... connection_type;
+//   std::unique_ptr<connection_type> connect(const host_key &,
+//                                            boost::system::error_code &);
+//   template <typename Handler>
+//   void async_exec(connection_type &, const client_request &,
+//                   std::shared_ptr<cancel_signal>, Handler &&);
+//     handler signature void(boost::system::error_code, client_response)
+//     the request is owned by the handler, copy it before moving the handler.
+//     The transport should install a function into the signal that aborts
+//     the attempt. It may ignore the signal, the result is then dropped.
+//     If request.body_buffer is set, the body is read into it, and the
+//     response body is borrowed_body(request.body_buffer). The handler must
+//     not be called while the attempt may still write into the buffer. The
+//     attempts of such a request run one at a time, and the request
+//     completes once none is left in the transport.
+// and optionally:
+//   typedef ... timer_type;
+//     a net::basic_waitable_timer for the deadlines and hedges of requests,
+//     net::steady_timer if not given. A simulated transport sets a timer of
+//     its virtual clock, whose duration must be that of steady_clock.
+
+#include "boost/winasio/recycling_allocator.hpp"
+#include "boost/winasio/winhttp/async_semaphore.hpp"
+#include "boost/winasio/winhttp/client_cache.hpp"
+#include "boost/winasio/winhttp/client_message.hpp"
+#include "boost/winasio/winhttp/client_policy.hpp"
+#include "boost/winasio/winhttp/url.hpp"
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/cancellation_type.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+namespace details {
+
+template <typename Transport, typename = void> struct transport_timer {
+  typedef net::steady_timer type;
+};
+
+template <typename Transport>
+struct transport_timer<Transport,
+                       std::void_t<typename Transport::timer_type>> {
+  typedef typename Transport::timer_type type;
+};
+
+} // namespace details
+
+// the server of a parsed http or https url.
+inline host_key make_host_key(const wurl_view &u) {
+  host_key key;
+  key.secure = u.secure();
+  key.host = u.host;
+  key.port = u.port;
+  return key;
+}
+
+// one request of async_exec_all.
+struct batch_item {
+  host_key key;
+  client_request request;
+};
+
+struct batch_result {
+  boost::system::error_code ec;
+  client_response response;
+};
+
+enum class batch_mode {
+  // run every request, the batch completes without error.
+  collect_all,
+  // on the first error cancel the running requests and start no more. The
+  // batch completes with that error, the cancelled and unstarted requests
+  // with operation_aborted.
+  fail_fast
+};
+
+template <typename Transport> class basic_client_pool {
+public:
+  typedef typename Transport::executor_type executor_type;
+  typedef typename Transport::connection_type connection_type;
+  typedef typename details::transport_timer<Transport>::type timer_type;
+
+  basic_client_pool(const executor_type &ex, Transport transport,
+                    std::size_t max_per_host)
+      : ex_(ex), transport_(std::move(transport)),
+        max_per_host_(max_per_host) {}
+
+  basic_client_pool(const basic_client_pool &) = delete;
+  basic_client_pool &operator=(const basic_client_pool &) = delete;
+
+  executor_type get_executor() const noexcept { return ex_; }
+
+  Transport &get_transport() noexcept { return transport_; }
+
+  // handler signature void(boost::system::error_code, client_response)
+  // Waits for a free slot of the host, then executes the request.
+  template <typename Token>
+  auto async_request(const host_key &key, client_request request,
+                     Token &&token) {
+    return async_request(key, std::move(request), request_policy{},
+                         std::forward<Token>(token));
+  }
+
+  // as above, with deadlines, retries and hedging. A missed deadline of the
+  // request completes with net::error::timed_out. A cancellation through
+  // the cancellation slot of the handler completes the request with
+  // net::error::operation_aborted.
+  template <typename Token>
+  auto async_request(const host_key &key, client_request request,
+                     const request_policy &policy, Token &&token) {
+    return net::async_initiate<Token, void(boost::system::error_code,
+                                           client_response)>(
+        initiate_request(), token, this, key, std::move(request), policy,
+        nullptr);
+  }
+
+  // as above. Emitting cancel completes the request with
+  // net::error::operation_aborted.
+  template <typename Token>
+  auto async_request(const host_key &key, client_request request,
+                     const request_policy &policy,
+                     std::shared_ptr<cancel_signal> cancel, Token &&token) {
+    return net::async_initiate<Token, void(boost::system::error_code,
+                                           client_response)>(
+        initiate_request(), token, this, key, std::move(request), policy,
+        std::move(cancel));
+  }
+
+  // handler signature void(boost::system::error_code,
+  //                        std::vector<batch_result>)
+  // Runs the requests with at most max_concurrency in flight, each with
+  // policy. Results are in the order of items.
+  template <typename Token>
+  auto async_exec_all(std::vector<batch_item> items,
+                      std::size_t max_concurrency, batch_mode mode,
+                      const request_policy &policy, Token &&token) {
+    return net::async_initiate<Token, void(boost::system::error_code,
+                                           std::vector<batch_result>)>(
+        [](auto handler, basic_client_pool *self,
+           std::vector<batch_item> batch, std::size_t max, batch_mode m,
+           const request_policy &pol) {
+          auto op = std::make_shared<batch_op<decltype(handler)>>(
+              self, std::move(batch), max, m, pol, std::move(handler));
+          op->start();
+        },
+        token, this, std::move(items), max_concurrency, mode, policy);
+  }
+
+  template <typename Token>
+  auto async_exec_all(std::vector<batch_item> items,
+                      std::size_t max_concurrency, batch_mode mode,
+                      Token &&token) {
+    return async_exec_all(std::move(items), max_concurrency, mode,
+                          request_policy{}, std::forward<Token>(token));
+  }
+
+  retry_budget &get_budget() noexcept { return budget_; }
+
+  // GET requests go through the cache, none if null. Set before requests
+  // are made.
+  void set_cache(std::shared_ptr<response_cache> cache) {
+    cache_ = std::move(cache);
+  }
+
+  std::shared_ptr<response_cache> get_cache() const { return cache_; }
+
+  // recent latencies of the host, empty if not connected.
+  std::shared_ptr<const latency_tracker> latency(const host_key &key) const {
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = hosts_.find(key);
+    if (it == hosts_.end()) {
+      return nullptr;
+    }
+    return std::shared_ptr<const latency_tracker>(it->second,
+                                                  &it->second->latency);
+  }
+
+  std::size_t host_count() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return hosts_.size();
+  }
+
+  // requests waiting for a slot of the host.
+  std::size_t waiting(const host_key &key) const {
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = hosts_.find(key);
+    return it == hosts_.end() ? 0 : it->second->slots.waiting();
+  }
+
+  // drop cached connections. In flight requests keep theirs.
+  void clear() {
+    std::lock_guard<std::mutex> lk(m_);
+    for (auto &h : hosts_) {
+      h.second->slots.cancel();
+    }
+    hosts_.clear();
+  }
+
+private:
+  struct host {
+    host(const executor_type &ex, std::size_t max,
+         std::unique_ptr<connection_type> c)
+        : conn(std::move(c)), slots(ex, max), latency() {}
+    std::unique_ptr<connection_type> conn;
+    async_semaphore<executor_type> slots;
+    latency_tracker latency;
+  };
+
+  std::shared_ptr<host> get_host(const host_key &key,
+                                 boost::system::error_code &ec) {
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = hosts_.find(key);
+    if (it != hosts_.end()) {
+      return it->second;
+    }
+    auto conn = transport_.connect(key, ec);
+    if (ec) {
+      return nullptr;
+    }
+    auto h = std::make_shared<host>(ex_, max_per_host_, std::move(conn));
+    hosts_.emplace(key, h);
+    return h;
+  }
+
+  struct initiate_request {
+    template <typename Handler>
+    void operator()(Handler &&handler, basic_client_pool *self,
+                    const host_key &key, client_request req,
+                    const request_policy &policy,
+                    std::shared_ptr<cancel_signal> cancel) const {
+      if (self->cache_ && response_cache::cacheable(req)) {
+        self->cached_request(key, std::move(req), policy, std::move(cancel),
+                             std::move(handler));
+        return;
+      }
+      self->start_request(key, std::move(req), policy, std::move(cancel),
+                          std::move(handler));
+    }
+  };
+
+  template <typename Handler>
+  void start_request(const host_key &key, client_request req,
+                     const request_policy &policy,
+                     std::shared_ptr<cancel_signal> cancel, Handler &&handler) {
+    auto op = std::make_shared<exec_op<std::decay_t<Handler>>>(
+        this, key, std::move(req), policy, std::move(cancel),
+        std::move(handler));
+    op->start();
+  }
+
+  template <typename Handler>
+  void cached_request(const host_key &key, client_request req,
+                      const request_policy &policy,
+                      std::shared_ptr<cancel_signal> cancel,
+                      Handler &&handler) {
+    auto cache = cache_;
+    auto ex = net::get_associated_executor(handler, ex_);
+    std::wstring ckey = response_cache::make_key(key, req);
+    std::shared_ptr<const cache_entry> entry;
+    auto r = cache->lookup(ckey, entry);
+    if (r != response_cache::lookup_result::fetch) {
+      if (r == response_cache::lookup_result::stale_hit) {
+        // refresh in the background, nobody waits for it.
+        client_request bg = req;
+        add_conditional_headers(bg, *entry);
+        start_request(key, std::move(bg), policy, nullptr,
+                      net::bind_executor(
+                          ex_, [cache, ckey, entry](boost::system::error_code e,
+                                                    client_response resp) {
+                            if (e) {
+                              entry->end_revalidation();
+                              return;
+                            }
+                            cache->on_response(ckey, entry, std::move(resp));
+                          }));
+      }
+      // do not complete inside the initiating function.
+      net::post(ex, handler_call<std::decay_t<Handler>,
+                                 boost::system::error_code, client_response>{
+                        std::move(handler),
+                        {boost::system::error_code(), entry->response}});
+      return;
+    }
+    if (entry) {
+      add_conditional_headers(req, *entry);
+    }
+    start_request(key, std::move(req), policy, std::move(cancel),
+                  cache_fill<std::decay_t<Handler>>{
+                      cache, std::move(ckey), entry, ex, std::move(handler)});
+  }
+
+  // completes a GET request fetched for the cache. The executor, allocator
+  // and cancellation slot are those of the handler.
+  template <typename Handler> struct cache_fill {
+    typedef net::associated_executor_t<
+        Handler, typename basic_client_pool::executor_type>
+        executor_type;
+    typedef net::associated_allocator_t<Handler> allocator_type;
+    typedef net::associated_cancellation_slot_t<Handler>
+        cancellation_slot_type;
+
+    executor_type get_executor() const noexcept { return ex; }
+
+    allocator_type get_allocator() const noexcept {
+      return net::get_associated_allocator(handler);
+    }
+
+    cancellation_slot_type get_cancellation_slot() const noexcept {
+      return net::get_associated_cancellation_slot(handler);
+    }
+
+    void operator()(boost::system::error_code e, client_response resp) {
+      if (!e) {
+        resp = cache->on_response(key, entry, std::move(resp));
+      }
+      std::move(handler)(e, std::move(resp));
+    }
+
+    std::shared_ptr<response_cache> cache;
+    std::wstring key;
+    std::shared_ptr<const cache_entry> entry;
+    executor_type ex;
+    Handler handler;
+  };
+
+  static void add_conditional_headers(client_request &req,
+                                      const cache_entry &entry) {
+    if (!req.headers.empty()) {
+      req.headers += L"\r\n";
+    }
+    req.headers += entry.conditional_headers();
+  }
+
+  // A request and its attempts. All callbacks run on a strand, results of
+  // the transport are dispatched to it.
+  template <typename Handler>
+  class exec_op : public std::enable_shared_from_this<exec_op<Handler>> {
+  public:
+    typedef typename timer_type::clock_type clock;
+
+    exec_op(basic_client_pool *pool, const host_key &key,
+            client_request request, const request_policy &policy,
+            std::shared_ptr<cancel_signal> cancel, Handler &&h)
+        : pool_(pool), key_(key), request_(std::move(request)),
+          policy_(policy), cancel_(std::move(cancel)),
+          strand_(net::make_strand(pool->ex_)),
+          deadline_(strand_), hedge_timer_(strand_),
+          work_(net::make_work_guard(
+              net::get_associated_executor(h, pool->ex_))),
+          handler_(std::move(h)),
+          idempotent_(policy.idempotent.value_or(
+              is_idempotent(request_.method))),
+          started_(0), in_flight_(0), executing_(0), done_(false),
+          deferred_(false) {}
+
+    // the first attempt is queued for a slot before this returns.
+    void start() {
+      boost::system::error_code ec;
+      host_ = pool_->get_host(key_, ec);
+      auto self = this->shared_from_this();
+      if (ec) {
+        // do not complete inside the initiating function.
+        net::post(strand_, [self, ec] { self->finish(ec, client_response{}); });
+        return;
+      }
+      pool_->budget_.deposit();
+      if (cancel_) {
+        cancel_->install([w = std::weak_ptr<exec_op>(self)] {
+          if (auto op = w.lock()) {
+            op->abort();
+          }
+        });
+      }
+      auto slot = net::get_associated_cancellation_slot(handler_);
+      if (slot.is_connected()) {
+        slot.template emplace<cancellation>(std::weak_ptr<exec_op>(self));
+      }
+      if (policy_.timeout.count() > 0) {
+        deadline_.expires_after(policy_.timeout);
+        deadline_.async_wait([self](boost::system::error_code e) {
+          if (!e && !self->done_) {
+            self->finish(net::error::timed_out, client_response{});
+          }
+        });
+      }
+      if (policy_.hedge && idempotent_ && policy_.max_attempts > 1 &&
+          !request_.body_buffer) {
+        auto delay = host_->latency.percentile(0.95).value_or(
+            std::chrono::duration_cast<typename clock::duration>(
+                policy_.hedge_delay));
+        hedge_timer_.expires_after(delay);
+        hedge_timer_.async_wait([self](boost::system::error_code e) {
+          // only while the first attempt is the only one.
+          if (!e && !self->done_ && self->in_flight_ == 1 &&
+              self->started_ == 1 && self->pool_->budget_.try_withdraw()) {
+            self->launch();
+          }
+        });
+      }
+      launch();
+    }
+
+  private:
+    // installed in the cancellation slot of the handler. Any type of
+    // cancellation aborts the request. The slot belongs to the caller and
+    // is not thread safe, so it is only touched by the initiation, never
+    // cleared from the strand: once the request is done, this is a no-op.
+    struct cancellation {
+      explicit cancellation(std::weak_ptr<exec_op> o) noexcept
+          : op(std::move(o)) {}
+      void operator()(net::cancellation_type) const {
+        if (auto o = op.lock()) {
+          o->abort();
+        }
+      }
+      std::weak_ptr<exec_op> op;
+    };
+
+    struct attempt {
+      explicit attempt(const net::strand<executor_type> &s)
+          : cancel(std::make_shared<cancel_signal>()), timer(s),
+            timed_out(false) {}
+      std::shared_ptr<cancel_signal> cancel;
+      timer_type timer;
+      typename clock::time_point start;
+      bool timed_out;
+    };
+
+    void launch() {
+      ++started_;
+      ++in_flight_;
+      auto a = std::make_shared<attempt>(strand_);
+      attempts_.push_back(a);
+      auto self = this->shared_from_this();
+      host_->slots.async_acquire([self, a](boost::system::error_code ec) {
+        net::dispatch(self->strand_, [self, a, ec] { self->on_slot(a, ec); });
+      });
+    }
+
+    void on_slot(std::shared_ptr<attempt> a, boost::system::error_code ec) {
+      if (ec) {
+        // the pool was cleared, no slot to release.
+        on_attempt_done(a, ec, client_response{});
+        return;
+      }
+      if (done_ || a->cancel->emitted()) {
+        host_->slots.release();
+        on_attempt_done(a, net::error::operation_aborted, client_response{});
+        return;
+      }
+      a->start = clock::now();
+      if (policy_.attempt_timeout.count() > 0) {
+        a->timer.expires_after(policy_.attempt_timeout);
+        a->timer.async_wait([a](boost::system::error_code e) {
+          if (!e) {
+            a->timed_out = true;
+            a->cancel->emit();
+          }
+        });
+      }
+      auto self = this->shared_from_this();
+      ++executing_;
+      pool_->transport_.async_exec(
+          *host_->conn, request_, a->cancel,
+          [self, a](boost::system::error_code e, client_response resp) {
+            net::dispatch(self->strand_,
+                          [self, a, e, resp = std::move(resp)]() mutable {
+                            self->host_->slots.release();
+                            --self->executing_;
+                            self->on_attempt_done(a, e, std::move(resp));
+                          });
+          });
+    }
+
+    void on_attempt_done(const std::shared_ptr<attempt> &a,
+                         boost::system::error_code ec, client_response resp) {
+      --in_flight_;
+      a->timer.cancel();
+      if (done_) {
+        if (deferred_ && executing_ == 0) {
+          deferred_ = false;
+          complete();
+        }
+        return;
+      }
+      if (a->timed_out) {
+        ec = net::error::timed_out;
+      }
+      if (!ec) {
+        host_->latency.record(clock::now() - a->start);
+        finish(ec, std::move(resp));
+        return;
+      }
+      last_ec_ = ec;
+      if (idempotent_ && started_ < policy_.max_attempts &&
+          ec != net::error::operation_aborted &&
+          pool_->budget_.try_withdraw()) {
+        launch();
+        return;
+      }
+      if (in_flight_ == 0) {
+        finish(last_ec_, client_response{});
+      }
+    }
+
+    // from any thread.
+    void abort() {
+      auto self = this->shared_from_this();
+      net::post(strand_, [self] {
+        if (!self->done_) {
+          self->finish(net::error::operation_aborted, client_response{});
+        }
+      });
+    }
+
+    // decides the result and cancels what is still running. With a body
+    // buffer the handler is called once no attempt can write into it.
+    void finish(boost::system::error_code ec, client_response resp) {
+      done_ = true;
+      deadline_.cancel();
+      hedge_timer_.cancel();
+      for (auto &a : attempts_) {
+        a->timer.cancel();
+        a->cancel->emit();
+      }
+      attempts_.clear();
+      result_ec_ = ec;
+      result_ = std::move(resp);
+      if (request_.body_buffer && executing_ > 0) {
+        deferred_ = true;
+        return;
+      }
+      complete();
+    }
+
+    void complete() {
+      net::dispatch(work_.get_executor(),
+                    handler_call<Handler, boost::system::error_code,
+                                 client_response>{
+                        std::move(handler_), {result_ec_, std::move(result_)}});
+      work_.reset();
+    }
+
+    basic_client_pool *pool_;
+    host_key key_;
+    client_request request_;
+    request_policy policy_;
+    std::shared_ptr<cancel_signal> cancel_;
+    net::strand<executor_type> strand_;
+    timer_type deadline_;
+    timer_type hedge_timer_;
+    net::executor_work_guard<net::associated_executor_t<Handler, executor_type>>
+        work_;
+    Handler handler_;
+    const bool idempotent_;
+    std::shared_ptr<host> host_;
+    std::vector<std::shared_ptr<attempt>> attempts_;
+    unsigned int started_;
+    unsigned int in_flight_;
+    // attempts given to the transport, not yet completed.
+    unsigned int executing_;
+    bool done_;
+    // finished, waiting for executing_ to drain.
+    bool deferred_;
+    boost::system::error_code last_ec_;
+    boost::system::error_code result_ec_;
+    client_response result_;
+  };
+
+  // Runs the items of a batch through async_request. Callbacks run on a
+  // strand.
+  template <typename Handler>
+  class batch_op : public std::enable_shared_from_this<batch_op<Handler>> {
+  public:
+    batch_op(basic_client_pool *pool, std::vector<batch_item> items,
+             std::size_t max_concurrency, batch_mode mode,
+             const request_policy &policy, Handler &&h)
+        : pool_(pool), items_(std::move(items)), results_(items_.size()),
+          cancels_(items_.size()),
+          max_((std::max)(max_concurrency, std::size_t{1})), mode_(mode),
+          policy_(policy), strand_(net::make_strand(pool->ex_)),
+          work_(net::make_work_guard(
+              net::get_associated_executor(h, pool->ex_))),
+          handler_(std::move(h)), next_(0), in_flight_(0), ec_() {}
+
+    void start() {
+      auto self = this->shared_from_this();
+      // do not complete inside the initiating function.
+      net::post(strand_, [self] { self->fill(); });
+    }
+
+  private:
+    void fill() {
+      while (!ec_ && next_ < items_.size() && in_flight_ < max_) {
+        launch(next_++);
+      }
+      if (in_flight_ == 0) {
+        finish();
+      }
+    }
+
+    void launch(std::size_t i) {
+      ++in_flight_;
+      cancels_[i] = std::make_shared<cancel_signal>();
+      auto self = this->shared_from_this();
+      pool_->async_request(
+          items_[i].key, std::move(items_[i].request), policy_, cancels_[i],
+          net::bind_executor(strand_, [self, i](boost::system::error_code ec,
+                                                client_response resp) {
+            self->on_done(i, ec, std::move(resp));
+          }));
+    }
+
+    void on_done(std::size_t i, boost::system::error_code ec,
+                 client_response resp) {
+      --in_flight_;
+      cancels_[i].reset();
+      results_[i].ec = ec;
+      results_[i].response = std::move(resp);
+      if (ec && !ec_ && mode_ == batch_mode::fail_fast) {
+        ec_ = ec;
+        for (auto &c : cancels_) {
+          if (c) {
+            c->emit();
+          }
+        }
+        for (std::size_t j = next_; j < items_.size(); ++j) {
+          results_[j].ec = net::error::operation_aborted;
+        }
+      }
+      fill();
+    }
+
+    void finish() {
+      net::dispatch(work_.get_executor(),
+                    handler_call<Handler, boost::system::error_code,
+                                 std::vector<batch_result>>{
+                        std::move(handler_), {ec_, std::move(results_)}});
+      work_.reset();
+    }
+
+    basic_client_pool *pool_;
+    std::vector<batch_item> items_;
+    std::vector<batch_result> results_;
+    // of the requests in flight.
+    std::vector<std::shared_ptr<cancel_signal>> cancels_;
+    const std::size_t max_;
+    const batch_mode mode_;
+    request_policy policy_;
+    net::strand<executor_type> strand_;
+    net::executor_work_guard<net::associated_executor_t<Handler, executor_type>>
+        work_;
+    Handler handler_;
+    std::size_t next_;
+    std::size_t in_flight_;
+    boost::system::error_code ec_;
+  };
+
+  executor_type ex_;
+  Transport transport_;
+  const std::size_t max_per_host_;
+  retry_budget budget_;
+  std::shared_ptr<response_cache> cache_;
+  mutable std::mutex m_;
+  // shared so that in flight requests keep the host alive after clear().
+  std::map<host_key, std::shared_ptr<host>> hosts_;
+};
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
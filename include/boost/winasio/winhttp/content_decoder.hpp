@@ -0,0 +1,345 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Streaming Content-Encoding decoder of response bodies. Compressed bytes
+// are read into a small fixed input buffer and inflated with zlib straight
+// into the user's DynamicBuffer as each chunk arrives, so memory is bounded
+// by the output buffer and not by the compressed size.
+// Portable: async_read_decoded runs on any source with
+//   get_executor()
+//   async_read_some(net::mutable_buffer, void(error_code, std::size_t))
+// where a read of 0 bytes ends the body.
+// Needs zlib. The cmake option winasio_WithZlib links it and defines
+// WINASIO_ZLIB, under which the client decodes bodies with this header.
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+namespace net = boost::asio; // from <boost/asio.hpp>
+
+enum class content_coding { identity, gzip, deflate };
+
+// request header for the codings content_decoder supports.
+inline constexpr std::wstring_view accept_encoding_header =
+    L"Accept-Encoding: gzip, deflate";
+
+// coding of a Content-Encoding value, nullopt if not supported. Stacked
+// codings like "deflate, gzip" are not supported.
+inline std::optional<content_coding>
+parse_content_encoding(std::wstring_view v) {
+  auto space = [](wchar_t c) { return c == L' ' || c == L'\t'; };
+  while (!v.empty() && space(v.front())) {
+    v.remove_prefix(1);
+  }
+  while (!v.empty() && space(v.back())) {
+    v.remove_suffix(1);
+  }
+  auto is = [v](std::wstring_view name) {
+    return v.size() == name.size() &&
+           std::equal(v.begin(), v.end(), name.begin(), [](wchar_t a,
+                                                           wchar_t b) {
+             return (a >= L'A' && a <= L'Z' ? a - L'A' + L'a' : a) == b;
+           });
+  };
+  if (v.empty() || is(L"identity")) {
+    return content_coding::identity;
+  }
+  if (is(L"gzip") || is(L"x-gzip")) {
+    return content_coding::gzip;
+  }
+  if (is(L"deflate")) {
+    return content_coding::deflate;
+  }
+  return std::nullopt;
+}
+
+// inflates one encoded body. Input is staged in a fixed buffer with
+// prepare and commit, and decoded into caller supplied output.
+// Corrupt and truncated streams fail with errc::bad_message.
+class content_decoder {
+public:
+  static constexpr std::size_t input_size = 16 * 1024;
+
+  explicit content_decoder(content_coding coding = content_coding::identity)
+      : coding_(coding), z_(), in_(), begin_(0), end_(0), full_(false),
+        done_(false) {}
+
+  content_coding coding() const { return coding_; }
+
+  // free space for encoded bytes. Buffered input moves to the front.
+  net::mutable_buffer prepare() {
+    if (!in_) {
+      in_ = std::make_unique<unsigned char[]>(input_size);
+    }
+    if (begin_ != 0) {
+      std::memmove(in_.get(), in_.get() + begin_, end_ - begin_);
+      end_ -= begin_;
+      begin_ = 0;
+    }
+    return net::mutable_buffer(in_.get() + end_, input_size - end_);
+  }
+
+  void commit(std::size_t n) {
+    BOOST_ASSERT(end_ + n <= input_size);
+    end_ += n;
+  }
+
+  // true if decode can produce more without new input.
+  bool buffered() const { return begin_ != end_ || full_; }
+
+  // encoded bytes not decoded yet.
+  std::size_t available() const { return end_ - begin_; }
+
+  // true once the end of the encoded stream is decoded. Bytes after it are
+  // dropped, except further gzip members which are decoded too.
+  bool done() const { return done_; }
+
+  // decodes buffered input into out, returns the bytes written.
+  std::size_t decode(net::mutable_buffer out, boost::system::error_code &ec) {
+    full_ = false;
+    if (coding_ == content_coding::identity) {
+      std::size_t n = (std::min)(out.size(), end_ - begin_);
+      std::memcpy(out.data(), in_.get() + begin_, n);
+      begin_ += n;
+      full_ = n == out.size() && begin_ != end_;
+      return n;
+    }
+    if (done_) {
+      if (coding_ == content_coding::gzip && begin_ != end_ &&
+          in_[begin_] == 0x1f) {
+        // another gzip member.
+        ::inflateReset(z_.get());
+        done_ = false;
+      } else {
+        begin_ = end_;
+        return 0;
+      }
+    }
+    if (!z_ && !init(ec)) {
+      return 0;
+    }
+    z_stream &z = *z_;
+    z.next_in = in_.get() + begin_;
+    z.avail_in = static_cast<uInt>(end_ - begin_);
+    z.next_out = static_cast<Bytef *>(out.data());
+    z.avail_out =
+        static_cast<uInt>((std::min)(out.size(), std::size_t{0x7fffffff}));
+    uInt avail_out = z.avail_out;
+    int ret = ::inflate(&z, Z_NO_FLUSH);
+    begin_ = end_ - z.avail_in;
+    std::size_t n = avail_out - z.avail_out;
+    if (ret == Z_STREAM_END) {
+      done_ = true;
+    } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+      // Z_BUF_ERROR only means no progress was possible.
+      ec = boost::system::errc::make_error_code(
+          boost::system::errc::bad_message);
+      return n;
+    }
+    full_ = z.avail_out == 0 && !done_;
+    return n;
+  }
+
+  // the body ended. Fails if the encoded stream is incomplete, an empty
+  // body is fine.
+  void finish(boost::system::error_code &ec) {
+    bool empty = !z_ && begin_ == end_;
+    if (coding_ != content_coding::identity && !done_ && !empty) {
+      ec = boost::system::errc::make_error_code(
+          boost::system::errc::bad_message);
+    }
+  }
+
+private:
+  // deflate is the zlib format, but some servers send raw deflate. The
+  // zlib header tells them apart, so init waits for its 2 bytes.
+  bool init(boost::system::error_code &ec) {
+    int bits = 16 + MAX_WBITS;
+    if (coding_ == content_coding::deflate) {
+      if (end_ - begin_ < 2) {
+        return false;
+      }
+      unsigned cmf = in_[begin_];
+      unsigned flg = in_[begin_ + 1];
+      bool zlib = (cmf & 0x0f) == Z_DEFLATED && (cmf * 256 + flg) % 31 == 0;
+      bits = zlib ? MAX_WBITS : -MAX_WBITS;
+    }
+    std::unique_ptr<z_stream, z_deleter> z(new z_stream());
+    if (::inflateInit2(z.get(), bits) != Z_OK) {
+      ec = net::error::no_memory;
+      return false;
+    }
+    z_ = std::move(z);
+    return true;
+  }
+
+  struct z_deleter {
+    void operator()(z_stream *z) const {
+      ::inflateEnd(z);
+      delete z;
+    }
+  };
+
+  content_coding coding_;
+  // zlib keeps a pointer back to the stream, so it does not move.
+  std::unique_ptr<z_stream, z_deleter> z_;
+  std::unique_ptr<unsigned char[]> in_;
+  std::size_t begin_;
+  std::size_t end_;
+  // the last decode filled its output.
+  bool full_;
+  bool done_;
+};
+
+namespace details {
+
+// reads source through decoder into buff, to the end of the body, or in
+// some mode until some bytes are decoded.
+template <typename Source, typename DynamicBuffer>
+class async_read_decoded_op {
+public:
+  // output prepared per decode.
+  static constexpr std::size_t output_size = 64 * 1024;
+
+  async_read_decoded_op(Source &source, content_decoder &decoder,
+                        DynamicBuffer &buff, bool some)
+      : source_(source), decoder_(decoder), buff_(buff), some_(some),
+        state_(state::idle), total_(0) {}
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec = {},
+                  std::size_t len = 0) {
+    if (ec) {
+      self.complete(ec, total_);
+      return;
+    }
+    switch (state_) {
+    case state::idle:
+      if (!decoder_.buffered()) {
+        read(self);
+        return;
+      }
+      // nothing completes inline.
+      state_ = state::post;
+      net::post(source_.get_executor(), std::move(self));
+      break;
+    case state::post:
+      decode(self);
+      break;
+    case state::read:
+      if (len == 0) {
+        decoder_.finish(ec);
+        state_ = state::done;
+        self.complete(ec, total_);
+        return;
+      }
+      decoder_.commit(len);
+      decode(self);
+      break;
+    default:
+      BOOST_ASSERT_MSG(false, "unknown state");
+      break;
+    }
+  }
+
+private:
+  template <typename Self> void read(Self &self) {
+    state_ = state::read;
+    source_.async_read_some(decoder_.prepare(), std::move(self));
+  }
+
+  // decodes all buffered input, then reads more or completes.
+  template <typename Self> void decode(Self &self) {
+    boost::system::error_code ec;
+    while (decoder_.buffered()) {
+      std::size_t room = buff_.max_size() - buff_.size();
+      if (room == 0) {
+        self.complete(net::error::no_buffer_space, total_);
+        return;
+      }
+      std::size_t before = decoder_.available();
+      std::size_t n = (std::min)(room, output_size);
+      n = decoder_.decode(buff_.prepare(n), ec);
+      buff_.commit(n);
+      total_ += n;
+      if (ec) {
+        self.complete(ec, total_);
+        return;
+      }
+      if (n == 0 && decoder_.available() == before) {
+        // needs more input.
+        break;
+      }
+    }
+    if (some_ && total_ != 0) {
+      self.complete(ec, total_);
+      return;
+    }
+    read(self);
+  }
+
+  Source &source_;
+  content_decoder &decoder_;
+  DynamicBuffer &buff_;
+  bool some_;
+  enum class state { idle, post, read, done } state_;
+  std::size_t total_;
+};
+
+} // namespace details
+
+// reads the whole body from source and decodes it into buffer.
+// handler signature void(ec, size_t), size_t is the decoded length.
+template <typename Source, typename DynamicBuffer,
+          BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
+                                               std::size_t)) Token>
+auto async_read_decoded(Source &source, content_decoder &decoder,
+                        DynamicBuffer &buffer, Token &&token) {
+  return net::async_compose<Token, void(boost::system::error_code,
+                                        std::size_t)>(
+      details::async_read_decoded_op<Source, DynamicBuffer>(source, decoder,
+                                                            buffer, false),
+      token, source.get_executor());
+}
+
+// completes as soon as some bytes are decoded into buffer, for consumers
+// that process the body as it arrives. 0 bytes means the body ended.
+template <typename Source, typename DynamicBuffer,
+          BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
+                                               std::size_t)) Token>
+auto async_read_some_decoded(Source &source, content_decoder &decoder,
+                             DynamicBuffer &buffer, Token &&token) {
+  return net::async_compose<Token, void(boost::system::error_code,
+                                        std::size_t)>(
+      details::async_read_decoded_op<Source, DynamicBuffer>(source, decoder,
+                                                            buffer, true),
+      token, source.get_executor());
+}
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
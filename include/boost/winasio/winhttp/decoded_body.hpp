@@ -0,0 +1,157 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Reading of gzip and deflate response bodies of winhttp requests, with the
+// decoder of content_decoder.hpp. Needs zlib, unlike the rest of winhttp.
+
+#include "boost/winasio/winhttp/content_decoder.hpp"
+#include "boost/winasio/winhttp/winhttp.hpp"
+#include "boost/winasio/winhttp/winhttp_asio.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+namespace net = boost::asio; // from <boost/asio.hpp>
+
+namespace header {
+
+// asks for the codings that async_read_decoded_body decodes.
+template <typename Executor = net::any_io_executor>
+void add_accept_encoding(basic_winhttp_request_handle<Executor> &h,
+                         _Out_ boost::system::error_code &ec) {
+  std::wstring data(accept_encoding_header);
+  add_header(h, data, ec);
+}
+
+} // namespace header
+
+namespace details {
+
+// the body of a request as the source of async_read_decoded.
+template <typename Executor> class winhttp_body_source {
+public:
+  typedef Executor executor_type;
+
+  explicit winhttp_body_source(
+      basic_winhttp_request_asio_handle<executor_type> &h)
+      : h_(h) {}
+
+  executor_type get_executor() { return h_.get_executor(); }
+
+  template <typename Token>
+  auto async_read_some(net::mutable_buffer b, Token &&token) {
+    DWORD len = static_cast<DWORD>((std::min)(b.size(), max_winhttp_io));
+    return h_.async_read_data(b.data(), len, std::forward<Token>(token));
+  }
+
+private:
+  basic_winhttp_request_asio_handle<executor_type> &h_;
+};
+
+// reads the body with the decoder of its Content-Encoding.
+template <typename Executor, typename DynamicBuffer>
+class async_read_decoded_body_op : boost::asio::coroutine {
+public:
+  typedef Executor executor_type;
+  async_read_decoded_body_op(
+      basic_winhttp_request_asio_handle<executor_type> &h,
+      DynamicBuffer &buff)
+      : h_request_(h), buff_(buff), state_(state::idle), ec_(),
+        decoder_() {}
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec = {},
+                  std::size_t len = 0) {
+    switch (state_) {
+    case state::idle: {
+      std::wstring encoding;
+      header::get_content_encoding(h_request_, ec, encoding);
+      if (ec.value() == ERROR_WINHTTP_HEADER_NOT_FOUND) {
+        ec.clear();
+      }
+      std::optional<content_coding> coding;
+      if (!ec) {
+        coding = parse_content_encoding(encoding);
+        if (!coding) {
+          ec = net::error::operation_not_supported;
+        }
+      }
+      if (ec) {
+        // nothing completes inline.
+        ec_ = ec;
+        state_ = state::failed;
+        net::post(h_request_.get_executor(), std::move(self));
+        break;
+      }
+      state_ = state::done;
+      if (*coding == content_coding::identity) {
+        async_read_body(h_request_, buff_, std::move(self));
+        break;
+      }
+      // heap allocated, the read holds references to it while this op is
+      // moved.
+      decoder_ = std::make_unique<decoder_state>(h_request_, *coding);
+      async_read_decoded(decoder_->source, decoder_->decoder, buff_,
+                         std::move(self));
+    } break;
+    case state::failed:
+      self.complete(ec_, 0);
+      break;
+    case state::done:
+      self.complete(ec, len);
+      break;
+    default:
+      BOOST_ASSERT_MSG(false, "unknown state");
+      break;
+    }
+  }
+
+private:
+  struct decoder_state {
+    decoder_state(basic_winhttp_request_asio_handle<executor_type> &h,
+                  content_coding coding)
+        : source(h), decoder(coding) {}
+    winhttp_body_source<executor_type> source;
+    content_decoder decoder;
+  };
+
+  basic_winhttp_request_asio_handle<executor_type> &h_request_;
+  DynamicBuffer &buff_;
+  enum class state { idle, failed, done } state_;
+  boost::system::error_code ec_;
+  std::unique_ptr<decoder_state> decoder_;
+};
+
+} // namespace details
+
+// async read all body into buffer, decoding gzip and deflate bodies as
+// they arrive. Ask for them with header::add_accept_encoding.
+// Other codings fail with operation_not_supported.
+// handler signature void(ec, size_t), size_t is the decoded length.
+template <typename Executor, typename DynamicBuffer,
+          BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
+                                               std::size_t))
+              Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
+auto async_read_decoded_body(basic_winhttp_request_asio_handle<Executor> &h,
+                             DynamicBuffer &buffer, Token &&token) {
+  return boost::asio::async_compose<Token, void(boost::system::error_code,
+                                                std::size_t)>(
+      details::async_read_decoded_body_op<Executor, DynamicBuffer>(h, buffer),
+      token, h.get_executor());
+}
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
@@ -0,0 +1,309 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Response headers read once as WINHTTP_QUERY_RAW_HEADERS_CRLF into a
+// reusable buffer, and indexed on the first lookup. Lookups return views
+// into the buffer, valid until the next fill.
+// header::get_response_headers fills it from a request.
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+class response_headers {
+public:
+  struct field {
+    std::wstring_view name;
+    std::wstring_view value;
+  };
+
+  response_headers()
+      : raw_(), fields_(), status_line_len_(0), indexed_(false), utf8_() {}
+
+  // copy raw headers, crlf separated, starting with the status line.
+  void assign(std::wstring_view raw) {
+    raw_.assign(raw.data(), raw.size());
+    reset_index();
+  }
+
+  // storage of n chars to fill in place, then commit() the used size.
+  wchar_t *prepare(std::size_t n) {
+    raw_.resize(n);
+    return raw_.data();
+  }
+
+  // chars the buffer holds without reallocation.
+  std::size_t capacity() const noexcept { return raw_.capacity(); }
+
+  void commit(std::size_t n) {
+    raw_.resize(n);
+    // winhttp may count the terminating nulls.
+    while (!raw_.empty() && raw_.back() == L'\0') {
+      raw_.pop_back();
+    }
+    reset_index();
+  }
+
+  std::wstring_view raw() const noexcept { return raw_; }
+
+  // e.g. HTTP/1.1 200 OK
+  std::wstring_view status_line() {
+    index();
+    return view(0, status_line_len_);
+  }
+
+  std::wstring_view version() {
+    std::wstring_view line = status_line();
+    return line.substr(0, line.find(L' '));
+  }
+
+  std::optional<unsigned int> status() {
+    std::wstring_view line = status_line();
+    std::size_t sp = line.find(L' ');
+    if (sp == std::wstring_view::npos) {
+      return std::nullopt;
+    }
+    line.remove_prefix(sp + 1);
+    auto n = parse_number(line.substr(0, line.find(L' ')));
+    if (!n || *n > 999) {
+      return std::nullopt;
+    }
+    return static_cast<unsigned int>(*n);
+  }
+
+  std::wstring_view reason() {
+    std::wstring_view line = status_line();
+    std::size_t sp = line.find(L' ');
+    if (sp == std::wstring_view::npos) {
+      return {};
+    }
+    sp = line.find(L' ', sp + 1);
+    return sp == std::wstring_view::npos ? std::wstring_view()
+                                         : line.substr(sp + 1);
+  }
+
+  std::size_t size() {
+    index();
+    return fields_.size();
+  }
+
+  field at(std::size_t i) {
+    index();
+    return {view(fields_[i].name, fields_[i].name_len),
+            view(fields_[i].value, fields_[i].value_len)};
+  }
+
+  // value of the first field with the name, case insensitive.
+  std::optional<std::wstring_view> get(std::wstring_view name) {
+    index();
+    for (const auto &f : fields_) {
+      if (iequals(view(f.name, f.name_len), name)) {
+        return view(f.value, f.value_len);
+      }
+    }
+    return std::nullopt;
+  }
+
+  // calls fn(value) for every field with the name.
+  template <typename F> void for_each(std::wstring_view name, F fn) {
+    index();
+    for (const auto &f : fields_) {
+      if (iequals(view(f.name, f.name_len), name)) {
+        fn(view(f.value, f.value_len));
+      }
+    }
+  }
+
+  std::optional<std::uint64_t> content_length() {
+    auto v = get(L"Content-Length");
+    if (!v) {
+      return std::nullopt;
+    }
+    return parse_number(*v);
+  }
+
+  // value as utf-8. The whole block is converted on the first call.
+  std::optional<std::string_view> get_utf8(std::wstring_view name) {
+    index();
+    for (const auto &f : fields_) {
+      if (iequals(view(f.name, f.name_len), name)) {
+        convert_utf8();
+        return std::string_view(utf8_.data() + f.value_utf8,
+                                f.value_utf8_len);
+      }
+    }
+    return std::nullopt;
+  }
+
+  // decimal digits only, empty on overflow.
+  static std::optional<std::uint64_t> parse_number(std::wstring_view s) {
+    s = trim(s);
+    if (s.empty()) {
+      return std::nullopt;
+    }
+    std::uint64_t n = 0;
+    for (wchar_t c : s) {
+      if (c < L'0' || c > L'9') {
+        return std::nullopt;
+      }
+      std::uint64_t d = static_cast<std::uint64_t>(c - L'0');
+      if (n > (UINT64_MAX - d) / 10) {
+        return std::nullopt;
+      }
+      n = n * 10 + d;
+    }
+    return n;
+  }
+
+  static bool iequals(std::wstring_view a, std::wstring_view b) {
+    if (a.size() != b.size()) {
+      return false;
+    }
+    for (std::size_t i = 0; i < a.size(); ++i) {
+      if (lower(a[i]) != lower(b[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  struct field_index {
+    std::uint32_t name;
+    std::uint32_t name_len;
+    std::uint32_t value;
+    std::uint32_t value_len;
+    // offsets in utf8_, valid once converted.
+    std::uint32_t value_utf8;
+    std::uint32_t value_utf8_len;
+  };
+
+  static wchar_t lower(wchar_t c) {
+    return c >= L'A' && c <= L'Z' ? static_cast<wchar_t>(c + (L'a' - L'A'))
+                                  : c;
+  }
+
+  static std::wstring_view trim(std::wstring_view s) {
+    while (!s.empty() && (s.front() == L' ' || s.front() == L'\t')) {
+      s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == L' ' || s.back() == L'\t')) {
+      s.remove_suffix(1);
+    }
+    return s;
+  }
+
+  std::wstring_view view(std::uint32_t off, std::uint32_t len) const {
+    return std::wstring_view(raw_.data() + off, len);
+  }
+
+  void reset_index() {
+    fields_.clear();
+    status_line_len_ = 0;
+    indexed_ = false;
+    utf8_.clear();
+  }
+
+  void index() {
+    if (indexed_) {
+      return;
+    }
+    indexed_ = true;
+    std::wstring_view all = raw_;
+    std::size_t pos = 0;
+    bool first = true;
+    while (pos < all.size()) {
+      std::size_t eol = all.find(L"\r\n", pos);
+      if (eol == std::wstring_view::npos) {
+        eol = all.size();
+      }
+      std::wstring_view line = all.substr(pos, eol - pos);
+      if (first) {
+        status_line_len_ = static_cast<std::uint32_t>(line.size());
+        first = false;
+      } else if (!line.empty()) {
+        std::size_t colon = line.find(L':');
+        if (colon != std::wstring_view::npos) {
+          std::wstring_view value = trim(line.substr(colon + 1));
+          field_index f{};
+          f.name = static_cast<std::uint32_t>(pos);
+          f.name_len = static_cast<std::uint32_t>(colon);
+          f.value = static_cast<std::uint32_t>(value.data() - raw_.data());
+          f.value_len = static_cast<std::uint32_t>(value.size());
+          fields_.push_back(f);
+        }
+      }
+      pos = eol + 2;
+    }
+  }
+
+  // appends c, a utf-16 unit or utf-32 char, as utf-8.
+  void append_utf8(const wchar_t *&p, const wchar_t *end) {
+    std::uint32_t c = static_cast<std::uint32_t>(*p++);
+    if (sizeof(wchar_t) == 2 && c >= 0xD800 && c <= 0xDBFF && p != end &&
+        static_cast<std::uint32_t>(*p) >= 0xDC00 &&
+        static_cast<std::uint32_t>(*p) <= 0xDFFF) {
+      c = 0x10000 + ((c - 0xD800) << 10) +
+          (static_cast<std::uint32_t>(*p++) - 0xDC00);
+    }
+    if (c < 0x80) {
+      utf8_.push_back(static_cast<char>(c));
+    } else if (c < 0x800) {
+      utf8_.push_back(static_cast<char>(0xC0 | (c >> 6)));
+      utf8_.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+      utf8_.push_back(static_cast<char>(0xE0 | (c >> 12)));
+      utf8_.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      utf8_.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else {
+      utf8_.push_back(static_cast<char>(0xF0 | (c >> 18)));
+      utf8_.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+      utf8_.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      utf8_.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+  }
+
+  // converts all values at once, so that views stay valid.
+  void convert_utf8() {
+    if (!utf8_.empty() || fields_.empty()) {
+      return;
+    }
+    utf8_.reserve(raw_.size());
+    for (auto &f : fields_) {
+      f.value_utf8 = static_cast<std::uint32_t>(utf8_.size());
+      const wchar_t *p = raw_.data() + f.value;
+      const wchar_t *end = p + f.value_len;
+      while (p != end) {
+        append_utf8(p, end);
+      }
+      f.value_utf8_len =
+          static_cast<std::uint32_t>(utf8_.size() - f.value_utf8);
+    }
+    // utf8_ is not empty from here, even if all values are.
+    utf8_.push_back('\0');
+  }
+
+  std::wstring raw_;
+  std::vector<field_index> fields_;
+  // the status line starts raw_, offsets stay valid when copied or moved.
+  std::uint32_t status_line_len_;
+  bool indexed_;
+  std::string utf8_;
+};
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
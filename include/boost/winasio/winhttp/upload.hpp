@@ -0,0 +1,390 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Streaming request bodies.
+// An upload_source produces the body in chunks. async_upload writes it with
+// WinHttpWriteData, one write outstanding, while the next chunk is read into
+// the second of two buffers. Peak memory is two chunks.
+// If the source has no size the body is sent with chunked transfer
+// encoding, the framing is written by async_upload.
+// The writer is any object with
+//   async_write_data(const void *, std::uint32_t, handler)
+//     handler signature void(boost::system::error_code, std::size_t)
+// like basic_winhttp_request_asio_handle.
+
+#include <boost/winasio/recycling_allocator.hpp>
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+namespace net = boost::asio;
+
+// handler signature void(boost::system::error_code, std::size_t)
+// 0 bytes means the end of the source.
+typedef std::function<void(boost::system::error_code, std::size_t)>
+    upload_read_handler;
+
+class upload_source {
+public:
+  typedef std::function<void(net::mutable_buffer, upload_read_handler)>
+      read_function;
+
+  static constexpr std::size_t default_chunk_size = 64 * 1024;
+
+  // size is empty if unknown, the body is then sent chunked.
+  // read may invoke the handler inside the call.
+  upload_source(std::optional<std::uint64_t> size, read_function read,
+                std::size_t chunk_size = default_chunk_size)
+      : size_(size), read_(std::move(read)), chunk_size_(chunk_size) {}
+
+  std::optional<std::uint64_t> size() const noexcept { return size_; }
+
+  std::size_t chunk_size() const noexcept { return chunk_size_; }
+
+  void async_read_some(net::mutable_buffer b, upload_read_handler h) {
+    read_(b, std::move(h));
+  }
+
+private:
+  std::optional<std::uint64_t> size_;
+  read_function read_;
+  std::size_t chunk_size_;
+};
+
+// buffers must stay valid until the upload completes.
+template <typename ConstBufferSequence>
+upload_source make_buffer_upload(const ConstBufferSequence &buffers) {
+  struct state {
+    ConstBufferSequence buffers;
+    std::size_t offset;
+  };
+  auto s = std::make_shared<state>(state{buffers, 0});
+  std::size_t size = net::buffer_size(buffers);
+  return upload_source(size, [s](net::mutable_buffer b,
+                                 upload_read_handler h) {
+    // copy from the first buffer not fully consumed.
+    std::size_t skip = s->offset;
+    std::size_t n = 0;
+    auto end = net::buffer_sequence_end(s->buffers);
+    for (auto it = net::buffer_sequence_begin(s->buffers);
+         it != end && n < b.size(); ++it) {
+      net::const_buffer cb(*it);
+      if (skip >= cb.size()) {
+        skip -= cb.size();
+        continue;
+      }
+      n += net::buffer_copy(b + n, cb + skip);
+      skip = 0;
+    }
+    s->offset += n;
+    h(boost::system::error_code{}, n);
+  });
+}
+
+// reads the file in chunks. ec is set if the file cannot be opened.
+inline upload_source make_file_upload(const std::filesystem::path &p,
+                                      boost::system::error_code &ec,
+                                      std::size_t chunk_size =
+                                          upload_source::default_chunk_size) {
+  std::error_code sec;
+  std::uint64_t size = std::filesystem::file_size(p, sec);
+  auto f = std::make_shared<std::ifstream>(p, std::ios::binary);
+  if (sec || !*f) {
+    ec = sec ? boost::system::error_code(sec.value(),
+                                         boost::system::generic_category())
+             : boost::system::error_code(net::error::not_found);
+    return upload_source(0, nullptr);
+  }
+  return upload_source(
+      size,
+      [f](net::mutable_buffer b, upload_read_handler h) {
+        f->read(static_cast<char *>(b.data()),
+                static_cast<std::streamsize>(b.size()));
+        std::size_t n = static_cast<std::size_t>(f->gcount());
+        boost::system::error_code read_ec;
+        if (f->bad()) {
+          read_ec = net::error::fault;
+        }
+        h(read_ec, n);
+      },
+      chunk_size);
+}
+
+// body of unknown size produced by an async generator:
+//   void gen(net::mutable_buffer, upload_read_handler)
+// that completes with 0 bytes at the end. Sent chunked.
+template <typename Generator>
+upload_source make_generator_upload(
+    Generator gen, std::size_t chunk_size = upload_source::default_chunk_size) {
+  return upload_source(std::nullopt, std::move(gen), chunk_size);
+}
+
+namespace details {
+
+// hex length line of a chunk, at most 8 digits.
+constexpr std::size_t chunk_prefix = 10;
+// crlf after the chunk data.
+constexpr std::size_t chunk_suffix = 2;
+
+template <typename Writer, typename Executor, typename Handler>
+class upload_op : public std::enable_shared_from_this<
+                      upload_op<Writer, Executor, Handler>> {
+public:
+  upload_op(Writer &w, upload_source &source, const Executor &ex,
+            Handler &&h)
+      : writer_(w), source_(source), ex_(ex),
+        work_(net::make_work_guard(net::get_associated_executor(h, ex))),
+        handler_(std::move(h)), chunked_(!source.size()),
+        remaining_(source.size().value_or(0)), total_(0), read_idx_(0),
+        write_idx_(0), reading_(false), writing_(false), eof_(false),
+        done_(false), starting_(false), ec_() {
+    std::size_t cap = source.chunk_size() + chunk_prefix + chunk_suffix;
+    for (auto &b : bufs_) {
+      b.data.resize(cap);
+    }
+  }
+
+  void start() {
+    std::unique_lock<std::mutex> lk(m_);
+    starting_ = true;
+    pump(lk);
+    lk.lock();
+    starting_ = false;
+  }
+
+private:
+  enum class buf_state { free, filled, writing };
+  struct buffer {
+    std::vector<char> data;
+    buf_state state = buf_state::free;
+    // range to write.
+    std::size_t begin = 0;
+    std::size_t end = 0;
+  };
+
+  // starts whatever can run. Unlocks lk.
+  void pump(std::unique_lock<std::mutex> &lk) {
+    bool do_write = false;
+    bool do_read = false;
+    std::size_t wi = 0;
+    std::size_t ri = 0;
+    std::size_t read_len = 0;
+    if (!ec_ && !writing_ && bufs_[write_idx_].state == buf_state::filled) {
+      wi = write_idx_;
+      bufs_[wi].state = buf_state::writing;
+      writing_ = true;
+      do_write = true;
+    }
+    if (!ec_ && !reading_ && !eof_ &&
+        bufs_[read_idx_].state == buf_state::free) {
+      read_len = source_.chunk_size();
+      if (!chunked_) {
+        if (remaining_ == 0) {
+          // all bytes read, the source is not asked again.
+          eof_ = true;
+        }
+        read_len = static_cast<std::size_t>(
+            (std::min)(static_cast<std::uint64_t>(read_len), remaining_));
+      }
+      if (!eof_) {
+        ri = read_idx_;
+        reading_ = true;
+        do_read = true;
+      }
+    }
+    if (!reading_ && !writing_ && !done_ &&
+        (ec_ || (eof_ && bufs_[0].state == buf_state::free &&
+                 bufs_[1].state == buf_state::free))) {
+      done_ = true;
+      bool inside_start = starting_;
+      lk.unlock();
+      complete(inside_start);
+      return;
+    }
+    lk.unlock();
+    if (do_write) {
+      write(wi);
+    }
+    if (do_read) {
+      read(ri, read_len);
+    }
+  }
+
+  void read(std::size_t i, std::size_t len) {
+    auto self = this->shared_from_this();
+    source_.async_read_some(
+        net::buffer(bufs_[i].data.data() + chunk_prefix, len),
+        [self, i](boost::system::error_code ec, std::size_t n) {
+          // the source may complete inline.
+          net::post(self->ex_, [self, i, ec, n] { self->on_read(i, ec, n); });
+        });
+  }
+
+  void on_read(std::size_t i, boost::system::error_code ec, std::size_t n) {
+    std::unique_lock<std::mutex> lk(m_);
+    reading_ = false;
+    buffer &b = bufs_[i];
+    if (ec) {
+      ec_ = ec;
+    } else if (n == 0) {
+      eof_ = true;
+      if (!chunked_ && remaining_ != 0) {
+        // the source is shorter than its size.
+        ec_ = net::error::eof;
+      } else if (chunked_) {
+        // last chunk.
+        static const char last[] = "0\r\n\r\n";
+        std::copy(last, last + 5, b.data.begin());
+        b.begin = 0;
+        b.end = 5;
+        b.state = buf_state::filled;
+        read_idx_ ^= 1;
+      }
+    } else {
+      total_ += n;
+      b.begin = chunk_prefix;
+      b.end = chunk_prefix + n;
+      if (chunked_) {
+        char line[chunk_prefix + 1];
+        int len = std::snprintf(line, sizeof(line), "%zx\r\n", n);
+        b.begin = chunk_prefix - static_cast<std::size_t>(len);
+        std::copy(line, line + len, b.data.begin() + b.begin);
+        b.data[b.end++] = '\r';
+        b.data[b.end++] = '\n';
+      } else {
+        remaining_ -= n;
+      }
+      b.state = buf_state::filled;
+      read_idx_ ^= 1;
+    }
+    pump(lk);
+  }
+
+  void write(std::size_t i) {
+    auto self = this->shared_from_this();
+    buffer &b = bufs_[i];
+    writer_.async_write_data(
+        b.data.data() + b.begin, static_cast<std::uint32_t>(b.end - b.begin),
+        [self, i](boost::system::error_code ec, std::size_t n) {
+          self->on_write(i, ec, n);
+        });
+  }
+
+  void on_write(std::size_t i, boost::system::error_code ec, std::size_t n) {
+    std::unique_lock<std::mutex> lk(m_);
+    buffer &b = bufs_[i];
+    if (ec) {
+      writing_ = false;
+      ec_ = ec;
+      pump(lk);
+      return;
+    }
+    b.begin += n;
+    if (b.begin < b.end) {
+      if (n == 0) {
+        // the rest of the chunk would be skipped.
+        writing_ = false;
+        ec_ = net::error::eof;
+        pump(lk);
+        return;
+      }
+      // partial write, keep the write slot.
+      lk.unlock();
+      write(i);
+      return;
+    }
+    writing_ = false;
+    b.state = buf_state::free;
+    write_idx_ ^= 1;
+    pump(lk);
+  }
+
+  // an upload without io, e.g. of an empty source, ends inside start(),
+  // and must not complete inside the initiating function.
+  void complete(bool inside_start) {
+    handler_call<Handler, boost::system::error_code, std::size_t> call{
+        std::move(handler_), {ec_, static_cast<std::size_t>(total_)}};
+    if (inside_start) {
+      net::post(work_.get_executor(), std::move(call));
+    } else {
+      net::dispatch(work_.get_executor(), std::move(call));
+    }
+    work_.reset();
+  }
+
+  Writer &writer_;
+  upload_source &source_;
+  Executor ex_;
+  net::executor_work_guard<net::associated_executor_t<Handler, Executor>>
+      work_;
+  Handler handler_;
+  const bool chunked_;
+  std::uint64_t remaining_;
+  std::uint64_t total_;
+  std::mutex m_;
+  std::array<buffer, 2> bufs_;
+  std::size_t read_idx_;
+  std::size_t write_idx_;
+  bool reading_;
+  bool writing_;
+  bool eof_;
+  bool done_;
+  // start() is running pump.
+  bool starting_;
+  boost::system::error_code ec_;
+};
+
+} // namespace details
+
+// writes the whole source as the request body, after async_send.
+// For a source without size, send must have been called with
+// WINHTTP_IGNORE_REQUEST_TOTAL_LENGTH and a Transfer-Encoding: chunked
+// header.
+// handler signature void(boost::system::error_code, std::size_t), size_t is
+// the number of body bytes, without chunk framing.
+// The writer and the source must stay valid until the handler is invoked.
+template <typename Writer, typename Executor, typename Token>
+auto async_upload(Writer &writer, upload_source &source, const Executor &ex,
+                  Token &&token) {
+  return net::async_initiate<Token,
+                             void(boost::system::error_code, std::size_t)>(
+      [](auto handler, Writer *w, upload_source *s, const Executor &e) {
+        auto op = std::make_shared<
+            details::upload_op<Writer, Executor, decltype(handler)>>(
+            *w, *s, e, std::move(handler));
+        op->start();
+      },
+      token, &writer, &source, ex);
+}
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
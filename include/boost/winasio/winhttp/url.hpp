@@ -0,0 +1,443 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Absolute URI parser after RFC 3986, over std::string_view and
+// std::wstring_view. It does not allocate, the components are views into
+// the input, without their delimiters.
+//   scheme ":" ["//" [userinfo "@"] host [":" port]] path ["?" query]
+//   ["#" fragment]
+// percent_decode uses SSE2 to skip runs without escapes when available.
+
+#include <boost/asio/error.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BOOST_WINASIO_URL_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+namespace net = boost::asio;
+
+template <typename CharT> struct basic_url_view {
+  typedef std::basic_string_view<CharT> string_view_type;
+
+  string_view_type scheme;
+  string_view_type userinfo;
+  // an ipv6 literal is without its brackets.
+  string_view_type host;
+  string_view_type port_text;
+  string_view_type path;
+  string_view_type query;
+  string_view_type fragment;
+  // the explicit port, or the default port of the scheme, or 0.
+  std::uint16_t port = 0;
+  bool has_authority = false;
+  bool has_userinfo = false;
+  bool has_port = false;
+  bool has_query = false;
+  bool has_fragment = false;
+  bool ipv6 = false;
+
+  // host as written, with the brackets of an ipv6 literal.
+  string_view_type host_text() const {
+    return ipv6 ? string_view_type(host.data() - 1, host.size() + 2) : host;
+  }
+
+  // path and query, the request target of http.
+  string_view_type target() const {
+    const CharT *end = has_query ? query.data() + query.size()
+                                 : path.data() + path.size();
+    return string_view_type(path.data(),
+                            static_cast<std::size_t>(end - path.data()));
+  }
+
+  // "?" query "#" fragment, what WinHttpCrackUrl calls extra info.
+  string_view_type extra() const {
+    const CharT *begin = path.data() + path.size();
+    const CharT *end = has_fragment ? fragment.data() + fragment.size()
+                       : has_query ? query.data() + query.size()
+                                   : begin;
+    return string_view_type(begin, static_cast<std::size_t>(end - begin));
+  }
+
+  bool secure() const {
+    return iequals(scheme, "https") || iequals(scheme, "wss");
+  }
+
+  // ascii case insensitive compare with a lower case literal.
+  static bool iequals(string_view_type a, const char *lower) {
+    std::size_t i = 0;
+    for (; i < a.size() && lower[i] != '\0'; ++i) {
+      CharT c = a[i];
+      if (c >= CharT('A') && c <= CharT('Z')) {
+        c = static_cast<CharT>(c + (CharT('a') - CharT('A')));
+      }
+      if (c != static_cast<CharT>(lower[i])) {
+        return false;
+      }
+    }
+    return i == a.size() && lower[i] == '\0';
+  }
+};
+
+typedef basic_url_view<char> url_view;
+typedef basic_url_view<wchar_t> wurl_view;
+
+namespace details {
+
+template <typename CharT> bool is_alpha(CharT c) {
+  return (c >= CharT('a') && c <= CharT('z')) ||
+         (c >= CharT('A') && c <= CharT('Z'));
+}
+
+template <typename CharT> bool is_digit(CharT c) {
+  return c >= CharT('0') && c <= CharT('9');
+}
+
+// value of a hex digit, or -1.
+template <typename CharT> int hex_value(CharT c) {
+  if (c >= CharT('0') && c <= CharT('9')) {
+    return static_cast<int>(c - CharT('0'));
+  }
+  if (c >= CharT('a') && c <= CharT('f')) {
+    return static_cast<int>(c - CharT('a')) + 10;
+  }
+  if (c >= CharT('A') && c <= CharT('F')) {
+    return static_cast<int>(c - CharT('A')) + 10;
+  }
+  return -1;
+}
+
+// chars that may appear in a uri outside of the ipv6 brackets, other than
+// the gen-delims which the parser handles.
+template <typename CharT> bool is_uri_char(CharT c) {
+  // non ascii chars are taken as they are, like in an iri.
+  if (static_cast<std::make_unsigned_t<CharT>>(c) > 0x7f || is_alpha(c) ||
+      is_digit(c)) {
+    return true;
+  }
+  switch (c) {
+  case CharT('-'):
+  case CharT('.'):
+  case CharT('_'):
+  case CharT('~'):
+  case CharT('%'):
+  case CharT('!'):
+  case CharT('$'):
+  case CharT('&'):
+  case CharT('\''):
+  case CharT('('):
+  case CharT(')'):
+  case CharT('*'):
+  case CharT('+'):
+  case CharT(','):
+  case CharT(';'):
+  case CharT('='):
+  case CharT(':'):
+  case CharT('@'):
+  case CharT('/'):
+  case CharT('?'):
+    return true;
+  default:
+    return false;
+  }
+}
+
+// every char is allowed and every % starts an escape.
+template <typename CharT>
+bool valid_component(std::basic_string_view<CharT> s, bool allow_at,
+                     bool allow_colon) {
+  for (std::size_t i = 0; i < s.size(); ++i) {
+    CharT c = s[i];
+    if (!is_uri_char(c) || (c == CharT('@') && !allow_at) ||
+        (c == CharT(':') && !allow_colon)) {
+      return false;
+    }
+    if (c == CharT('%')) {
+      if (i + 2 >= s.size() || hex_value(s[i + 1]) < 0 ||
+          hex_value(s[i + 2]) < 0) {
+        return false;
+      }
+      i += 2;
+    }
+  }
+  return true;
+}
+
+template <typename CharT> bool valid_ipv6(std::basic_string_view<CharT> s) {
+  if (s.empty()) {
+    return false;
+  }
+  // IPvFuture, "v" 1*HEXDIG "." 1*( unreserved / sub-delims / ":" )
+  if (s[0] == CharT('v') || s[0] == CharT('V')) {
+    std::size_t dot = s.find(CharT('.'));
+    return dot != std::basic_string_view<CharT>::npos && dot > 1 &&
+           dot + 1 < s.size() &&
+           valid_component(s.substr(1), false, true);
+  }
+  for (CharT c : s) {
+    if (hex_value(c) < 0 && c != CharT(':') && c != CharT('.')) {
+      return false;
+    }
+  }
+  return s.find(CharT(':')) != std::basic_string_view<CharT>::npos;
+}
+
+template <typename CharT>
+std::uint16_t default_port(std::basic_string_view<CharT> scheme) {
+  typedef basic_url_view<CharT> view;
+  if (view::iequals(scheme, "http") || view::iequals(scheme, "ws")) {
+    return 80;
+  }
+  if (view::iequals(scheme, "https") || view::iequals(scheme, "wss")) {
+    return 443;
+  }
+  return 0;
+}
+
+template <typename CharT>
+basic_url_view<CharT> parse_url(std::basic_string_view<CharT> s,
+                                boost::system::error_code &ec) {
+  typedef std::basic_string_view<CharT> sv;
+  basic_url_view<CharT> u;
+  const auto fail = [&ec]() {
+    ec = net::error::invalid_argument;
+    return basic_url_view<CharT>{};
+  };
+
+  // scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." )
+  std::size_t pos = 0;
+  if (s.empty() || !is_alpha(s[0])) {
+    return fail();
+  }
+  while (pos < s.size() &&
+         (is_alpha(s[pos]) || is_digit(s[pos]) || s[pos] == CharT('+') ||
+          s[pos] == CharT('-') || s[pos] == CharT('.'))) {
+    ++pos;
+  }
+  if (pos == s.size() || s[pos] != CharT(':')) {
+    return fail();
+  }
+  u.scheme = s.substr(0, pos);
+  ++pos;
+
+  // the path ends at the first ? or #, the query at the first #.
+  std::size_t hash = s.find(CharT('#'), pos);
+  std::size_t end = hash == sv::npos ? s.size() : hash;
+  std::size_t question = s.substr(0, end).find(CharT('?'), pos);
+  std::size_t hier_end = question == sv::npos ? end : question;
+
+  if (s.size() - pos >= 2 && s[pos] == CharT('/') &&
+      s[pos + 1] == CharT('/')) {
+    u.has_authority = true;
+    pos += 2;
+    std::size_t auth_end = s.substr(0, hier_end).find(CharT('/'), pos);
+    if (auth_end == sv::npos) {
+      auth_end = hier_end;
+    }
+    sv auth = s.substr(pos, auth_end - pos);
+    std::size_t at = auth.rfind(CharT('@'));
+    if (at != sv::npos) {
+      u.has_userinfo = true;
+      u.userinfo = auth.substr(0, at);
+      if (!valid_component(u.userinfo, false, true)) {
+        return fail();
+      }
+      auth.remove_prefix(at + 1);
+    }
+    std::size_t host_end = 0;
+    if (!auth.empty() && auth[0] == CharT('[')) {
+      std::size_t close = auth.find(CharT(']'));
+      if (close == sv::npos) {
+        return fail();
+      }
+      u.ipv6 = true;
+      u.host = auth.substr(1, close - 1);
+      if (!valid_ipv6(u.host)) {
+        return fail();
+      }
+      host_end = close + 1;
+      if (host_end < auth.size() && auth[host_end] != CharT(':')) {
+        return fail();
+      }
+    } else {
+      host_end = auth.find(CharT(':'));
+      if (host_end == sv::npos) {
+        host_end = auth.size();
+      }
+      u.host = auth.substr(0, host_end);
+      if (!valid_component(u.host, false, false)) {
+        return fail();
+      }
+    }
+    if (host_end < auth.size()) {
+      // ":" port, an empty port is allowed.
+      u.port_text = auth.substr(host_end + 1);
+      std::uint32_t port = 0;
+      for (CharT c : u.port_text) {
+        if (!is_digit(c)) {
+          return fail();
+        }
+        port = port * 10 + static_cast<std::uint32_t>(c - CharT('0'));
+        if (port > 65535) {
+          return fail();
+        }
+      }
+      if (!u.port_text.empty()) {
+        u.has_port = true;
+        u.port = static_cast<std::uint16_t>(port);
+      }
+    } else {
+      u.port_text = auth.substr(auth.size());
+    }
+    pos = auth_end;
+  }
+  if (!u.has_port) {
+    u.port = default_port(u.scheme);
+  }
+
+  u.path = s.substr(pos, hier_end - pos);
+  if (!valid_component(u.path, true, true)) {
+    return fail();
+  }
+  if (question != sv::npos) {
+    u.has_query = true;
+    u.query = s.substr(question + 1, end - question - 1);
+    if (!valid_component(u.query, true, true)) {
+      return fail();
+    }
+  } else {
+    u.query = s.substr(end, 0);
+  }
+  if (hash != sv::npos) {
+    u.has_fragment = true;
+    u.fragment = s.substr(hash + 1);
+    if (!valid_component(u.fragment, true, true)) {
+      return fail();
+    }
+  } else {
+    u.fragment = s.substr(s.size());
+  }
+  return u;
+}
+
+// first % in [p, end), or end.
+template <typename CharT>
+const CharT *find_percent(const CharT *p, const CharT *end) {
+#ifdef BOOST_WINASIO_URL_SSE2
+  constexpr std::size_t lanes = 16 / sizeof(CharT);
+  __m128i pct;
+  if constexpr (sizeof(CharT) == 1) {
+    pct = _mm_set1_epi8('%');
+  } else if constexpr (sizeof(CharT) == 2) {
+    pct = _mm_set1_epi16('%');
+  } else {
+    pct = _mm_set1_epi32('%');
+  }
+  while (static_cast<std::size_t>(end - p) >= lanes) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i eq;
+    if constexpr (sizeof(CharT) == 1) {
+      eq = _mm_cmpeq_epi8(v, pct);
+    } else if constexpr (sizeof(CharT) == 2) {
+      eq = _mm_cmpeq_epi16(v, pct);
+    } else {
+      eq = _mm_cmpeq_epi32(v, pct);
+    }
+    unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(eq));
+    if (mask != 0) {
+#ifdef _MSC_VER
+      unsigned long bit;
+      _BitScanForward(&bit, mask);
+#else
+      unsigned int bit = static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+      return p + bit / sizeof(CharT);
+    }
+    p += lanes;
+  }
+#endif
+  while (p != end && *p != CharT('%')) {
+    ++p;
+  }
+  return p;
+}
+
+} // namespace details
+
+// parses an absolute uri. ec is invalid_argument if s is not one.
+inline url_view parse_url(std::string_view s, boost::system::error_code &ec) {
+  return details::parse_url(s, ec);
+}
+
+inline wurl_view parse_url(std::wstring_view s,
+                           boost::system::error_code &ec) {
+  return details::parse_url(s, ec);
+}
+
+// decodes the %XX escapes of s into out, which has room for s.size() chars
+// and may be s.data() itself. Each escape becomes one char with the value
+// of the octet, for wide strings too. Returns the decoded size, ec is
+// invalid_argument on a malformed escape.
+template <typename CharT>
+std::size_t percent_decode(std::basic_string_view<CharT> s, CharT *out,
+                           boost::system::error_code &ec) {
+  const CharT *p = s.data();
+  const CharT *end = p + s.size();
+  CharT *o = out;
+  while (p != end) {
+    const CharT *pct = details::find_percent(p, end);
+    std::size_t run = static_cast<std::size_t>(pct - p);
+    if (o != p) {
+      std::memmove(o, p, run * sizeof(CharT));
+    }
+    o += run;
+    p = pct;
+    if (p == end) {
+      break;
+    }
+    int hi = end - p > 2 ? details::hex_value(p[1]) : -1;
+    int lo = hi < 0 ? -1 : details::hex_value(p[2]);
+    if (lo < 0) {
+      ec = net::error::invalid_argument;
+      return 0;
+    }
+    *o++ = static_cast<CharT>((hi << 4) | lo);
+    p += 3;
+  }
+  return static_cast<std::size_t>(o - out);
+}
+
+// out is resized, reusing its storage.
+template <typename CharT>
+void percent_decode(std::basic_string_view<CharT> s,
+                    std::basic_string<CharT> &out,
+                    boost::system::error_code &ec) {
+  out.resize(s.size());
+  out.resize(percent_decode(s, out.data(), ec));
+}
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
@@ -0,0 +1,880 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// WebSocket client with asio style async operations on whole messages.
+// On Windows it runs on the winhttp websocket api, elsewhere on a Beast
+// websocket stream, so that code using it can be tested and benchmarked
+// without winhttp. Both backends have the same api:
+//
+//   async_connect(url, token)        void(ec), url is ws:// or wss://
+//   async_read(dynamic_buffer, token) void(ec, size_t), one message
+//   async_write(buffers, token)      void(ec, size_t), one message
+//   async_close(code, token)         void(ec)
+//
+// Reads take any DynamicBuffer, including those of several buffers like
+// beast::multi_buffer.
+// One read and one write may be outstanding at the same time. A read
+// reuses the free capacity of the buffer, so a buffer reused across
+// messages does not allocate once it is large enough. Nor do the frames of
+// the winhttp backend: the step handler of a frame comes from the
+// recycling cache of the io thread, see recycling_allocator.hpp.
+// A close of the peer completes the read with net::error::eof, and
+// close_code() returns its code. A declined upgrade is
+// errc::protocol_error.
+// Pings of the peer are answered by both backends. With set_keepalive()
+// pings are also sent on an idle connection.
+// The Beast backend supports ws:// only.
+// A terminal cancellation through the cancellation slot of a handler
+// completes the op with net::error::operation_aborted and leaves the
+// websocket closed.
+
+#include "boost/winasio/winhttp/url.hpp"
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#include "boost/winasio/winhttp/winhttp.hpp"
+#include "boost/winasio/winhttp/winhttp_asio.hpp"
+#include "boost/winasio/winhttp/winhttp_step.hpp"
+#else
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/stream_traits.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/websocket/stream.hpp>
+#endif
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+namespace net = boost::asio;
+
+namespace details {
+
+// checks the scheme of a websocket url.
+inline void check_websocket_url(const wurl_view &u, bool &secure,
+                                boost::system::error_code &ec) {
+  if (wurl_view::iequals(u.scheme, "ws")) {
+    secure = false;
+  } else if (wurl_view::iequals(u.scheme, "wss")) {
+    secure = true;
+  } else {
+    ec = net::error::invalid_argument;
+  }
+}
+
+inline boost::system::error_code websocket_upgrade_declined() {
+  return boost::system::errc::make_error_code(
+      boost::system::errc::protocol_error);
+}
+
+// reads land in the free capacity of the buffer if there is enough,
+// otherwise in a new chunk of this size.
+constexpr std::size_t websocket_min_read = 512;
+constexpr std::size_t websocket_read_chunk = 4096;
+
+template <typename DynamicBuffer>
+std::size_t websocket_read_size(const DynamicBuffer &b) {
+  std::size_t room = b.max_size() - b.size();
+  std::size_t free = b.capacity() - b.size();
+  std::size_t n = free >= websocket_min_read ? free : websocket_read_chunk;
+  return (std::min)(n, room);
+}
+
+} // namespace details
+
+#ifdef _WIN32
+
+namespace details {
+
+// callback context of a websocket handle. Receives complete the read step,
+// sends and the close handshake the write step.
+template <typename Executor>
+class websocket_context : public duplex_step<Executor> {
+public:
+  explicit websocket_context(const Executor &ex)
+      : duplex_step<Executor>(ex),
+        buffer_type(WINHTTP_WEB_SOCKET_BINARY_MESSAGE_BUFFER_TYPE) {}
+
+  // of the last receive, set before the read step completes.
+  WINHTTP_WEB_SOCKET_BUFFER_TYPE buffer_type;
+};
+
+template <typename Executor>
+void __stdcall WebSocketAsioCallback(HINTERNET hInternet, DWORD_PTR dwContext,
+                                     DWORD dwInternetStatus,
+                                     LPVOID lpvStatusInformation,
+                                     DWORD dwStatusInformationLength) {
+  UNREFERENCED_PARAMETER(hInternet);
+  UNREFERENCED_PARAMETER(dwStatusInformationLength);
+  BOOST_WINASIO_TRACE(winhttp_callback, instant, hInternet, dwInternetStatus,
+                      dwStatusInformationLength, {});
+  websocket_context<Executor> *cpContext =
+      (websocket_context<Executor> *)dwContext;
+  if (cpContext == NULL) {
+    return;
+  }
+
+  switch (dwInternetStatus) {
+  case WINHTTP_CALLBACK_STATUS_READ_COMPLETE: {
+    WINHTTP_WEB_SOCKET_STATUS *st =
+        (WINHTTP_WEB_SOCKET_STATUS *)lpvStatusInformation;
+    spdlog::debug("WEBSOCKET READ_COMPLETE len: {} type: {}",
+                  st->dwBytesTransferred, static_cast<int>(st->eBufferType));
+    cpContext->buffer_type = st->eBufferType;
+    cpContext->get(step_direction::read).complete({}, st->dwBytesTransferred);
+  } break;
+  case WINHTTP_CALLBACK_STATUS_WRITE_COMPLETE: {
+    WINHTTP_WEB_SOCKET_STATUS *st =
+        (WINHTTP_WEB_SOCKET_STATUS *)lpvStatusInformation;
+    spdlog::debug("WEBSOCKET WRITE_COMPLETE len: {}", st->dwBytesTransferred);
+    cpContext->get(step_direction::write).complete({}, st->dwBytesTransferred);
+  } break;
+  case WINHTTP_CALLBACK_STATUS_CLOSE_COMPLETE:
+    spdlog::debug("WEBSOCKET CLOSE_COMPLETE");
+    cpContext->get(step_direction::write).complete({});
+    break;
+  case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR: {
+    WINHTTP_WEB_SOCKET_ASYNC_RESULT *pAR =
+        (WINHTTP_WEB_SOCKET_ASYNC_RESULT *)lpvStatusInformation;
+    boost::system::error_code ec(pAR->AsyncResult.dwError,
+                                 boost::asio::error::get_system_category());
+    spdlog::debug("WEBSOCKET REQUEST_ERROR op: {} ec: {}",
+                  static_cast<int>(pAR->Operation), ec.message());
+    switch (pAR->Operation) {
+    case WINHTTP_WEB_SOCKET_RECEIVE_OPERATION:
+      cpContext->get(step_direction::read).complete(ec, 0);
+      break;
+    case WINHTTP_WEB_SOCKET_SEND_OPERATION:
+    case WINHTTP_WEB_SOCKET_CLOSE_OPERATION:
+      cpContext->get(step_direction::write).complete(ec, 0);
+      break;
+    default:
+      // shutdown is not used.
+      break;
+    }
+  } break;
+  default:
+    break;
+  }
+}
+
+template <typename Executor> class websocket_connect_op;
+template <typename Executor, typename DynamicBuffer>
+class websocket_read_op;
+template <typename Executor, typename ConstBufferSequence>
+class websocket_write_op;
+
+} // namespace details
+
+template <typename Executor = net::any_io_executor>
+class basic_winhttp_websocket {
+public:
+  /// The type of the executor associated with the object.
+  typedef Executor executor_type;
+
+  explicit basic_winhttp_websocket(const executor_type &ex)
+      : ctx_(ex), session_(ex), connect_(ex), request_(ex), socket_(ex),
+        keepalive_(0), text_(false), got_text_(false) {
+    // a terminal cancellation closes the socket, like close().
+    ctx_.set_canceller([this] { socket_.close(); });
+  }
+
+  template <typename ExecutionContext>
+  explicit basic_winhttp_websocket(
+      ExecutionContext &context,
+      typename net::constraint<
+          net::is_convertible<ExecutionContext &,
+                              net::execution_context &>::value,
+          net::defaulted_constraint>::type = net::defaulted_constraint())
+      : basic_winhttp_websocket(executor_type(context.get_executor())) {}
+
+  executor_type get_executor() { return socket_.get_executor(); }
+
+  // interval of keepalive pings, set before connect. Zero keeps the
+  // default. winhttp sends them at most every 15 seconds.
+  void set_keepalive(std::chrono::milliseconds interval) {
+    keepalive_ = interval;
+  }
+
+  // messages are written as text, otherwise as binary.
+  void text(bool value) { text_ = value; }
+  bool text() const { return text_; }
+
+  // whether the last message read is text.
+  bool got_text() const { return got_text_; }
+
+  bool is_open() { return socket_.native_handle() != nullptr; }
+
+  // close code of the peer, 0 if none was received.
+  unsigned short close_code() {
+    USHORT status = 0;
+    DWORD consumed = 0;
+    BYTE reason[WINHTTP_WEB_SOCKET_MAX_CLOSE_REASON_LENGTH];
+    DWORD err = WinHttpWebSocketQueryCloseStatus(
+        socket_.native_handle(), &status, reason, sizeof(reason), &consumed);
+    return err == NO_ERROR ? status : 0;
+  }
+
+  // closes the handles without a close handshake. Outstanding operations
+  // complete with an error.
+  void close() {
+    socket_.close();
+    request_.close();
+    connect_.close();
+    session_.close();
+  }
+
+  template <BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code))
+                Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
+  auto async_connect(std::wstring_view url, Token &&token) {
+    return net::async_compose<Token, void(boost::system::error_code)>(
+        details::websocket_connect_op<Executor>(*this, std::wstring(url)),
+        token, get_executor());
+  }
+
+  template <typename DynamicBuffer,
+            BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
+                                                 std::size_t))
+                Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
+  auto async_read(DynamicBuffer &buffer, Token &&token) {
+    return net::async_compose<Token,
+                              void(boost::system::error_code, std::size_t)>(
+        details::websocket_read_op<Executor, DynamicBuffer>(*this, buffer),
+        token, get_executor());
+  }
+
+  // the buffers are sent as fragments of one message.
+  template <typename ConstBufferSequence,
+            BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
+                                                 std::size_t))
+                Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
+  auto async_write(const ConstBufferSequence &buffers, Token &&token) {
+    return net::async_compose<Token,
+                              void(boost::system::error_code, std::size_t)>(
+        details::websocket_write_op<Executor, ConstBufferSequence>(
+            *this, buffers, text_),
+        token, get_executor());
+  }
+
+  // no write may be outstanding.
+  template <BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code))
+                Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
+  auto async_close(unsigned short code, Token &&token) {
+    auto &step = ctx_.get(details::step_direction::write);
+    step.begin(details::step_state::close_complete);
+    DWORD err = WinHttpWebSocketClose(socket_.native_handle(), code, NULL, 0);
+    if (err != NO_ERROR) {
+      step.set_state(details::step_state::error);
+      step.complete(boost::system::error_code(
+          err, boost::asio::error::get_system_category()));
+    }
+    return details::async_wait_step(step, std::forward<Token>(token));
+  }
+
+  // frame level api of the ops.
+
+  // callback case: WINHTTP_CALLBACK_STATUS_READ_COMPLETE
+  // the buffer type is in buffer_type() once the handler runs.
+  template <typename Token>
+  auto async_receive(void *data, DWORD size, Token &&token) {
+    auto &step = ctx_.get(details::step_direction::read);
+    step.begin(details::step_state::read_complete);
+    DWORD err = WinHttpWebSocketReceive(socket_.native_handle(), data, size,
+                                        NULL, NULL);
+    if (err != NO_ERROR) {
+      step.set_state(details::step_state::error);
+      step.complete(boost::system::error_code(
+                        err, boost::asio::error::get_system_category()),
+                    0);
+    }
+    return details::async_wait_step_len(step, std::forward<Token>(token));
+  }
+
+  WINHTTP_WEB_SOCKET_BUFFER_TYPE buffer_type() const {
+    return ctx_.buffer_type;
+  }
+
+  // callback case: WINHTTP_CALLBACK_STATUS_WRITE_COMPLETE
+  template <typename Token>
+  auto async_send(WINHTTP_WEB_SOCKET_BUFFER_TYPE type, const void *data,
+                  DWORD size, Token &&token) {
+    auto &step = ctx_.get(details::step_direction::write);
+    step.begin(details::step_state::write_complete);
+    DWORD err = WinHttpWebSocketSend(socket_.native_handle(), type,
+                                     const_cast<void *>(data), size);
+    if (err != NO_ERROR) {
+      step.set_state(details::step_state::error);
+      step.complete(boost::system::error_code(
+                        err, boost::asio::error::get_system_category()),
+                    0);
+    }
+    return details::async_wait_step_len(step, std::forward<Token>(token));
+  }
+
+private:
+  template <typename> friend class details::websocket_connect_op;
+  template <typename, typename> friend class details::websocket_read_op;
+
+  // synchronous part of the connect, up to the upgrade request.
+  void open_request(const std::wstring &url, boost::system::error_code &ec) {
+    wurl_view u = parse_url(std::wstring_view(url), ec);
+    if (ec) {
+      return;
+    }
+    bool secure = false;
+    details::check_websocket_url(u, secure, ec);
+    if (ec) {
+      return;
+    }
+    session_.open(ec);
+    if (ec) {
+      return;
+    }
+    if (keepalive_.count() != 0) {
+      DWORD ms = static_cast<DWORD>((std::max)(
+          keepalive_.count(), std::chrono::milliseconds::rep{15000}));
+      session_.set_option(WINHTTP_OPTION_WEB_SOCKET_KEEPALIVE_INTERVAL, &ms,
+                          sizeof(ms), ec);
+      if (ec) {
+        return;
+      }
+    }
+    std::wstring host(u.host);
+    connect_.connect(session_.native_handle(), host.c_str(),
+                     static_cast<INTERNET_PORT>(u.port), ec);
+    if (ec) {
+      return;
+    }
+    std::wstring target(u.target().empty() ? std::wstring_view(L"/")
+                                           : u.target());
+    request_.managed_open(connect_.native_handle(), L"GET", target.c_str(),
+                          NULL, WINHTTP_NO_REFERER,
+                          WINHTTP_DEFAULT_ACCEPT_TYPES,
+                          secure ? WINHTTP_FLAG_SECURE : 0, ec);
+    if (ec) {
+      return;
+    }
+    request_.set_option(WINHTTP_OPTION_UPGRADE_TO_WEB_SOCKET, NULL, 0, ec);
+  }
+
+  // after the response of the upgrade request.
+  void complete_upgrade(boost::system::error_code &ec) {
+    DWORD status = 0;
+    header::get_status_code(request_, ec, status);
+    if (ec) {
+      return;
+    }
+    if (status != HTTP_STATUS_SWITCH_PROTOCOLS) {
+      ec = details::websocket_upgrade_declined();
+      return;
+    }
+    HINTERNET h = WinHttpWebSocketCompleteUpgrade(request_.native_handle(),
+                                                  (DWORD_PTR)&ctx_);
+    if (h == NULL) {
+      ec = boost::system::error_code(GetLastError(),
+                                     boost::asio::error::get_system_category());
+      return;
+    }
+    socket_.assign(h);
+    socket_.set_status_callback(
+        (WINHTTP_STATUS_CALLBACK)details::WebSocketAsioCallback<executor_type>,
+        WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS, ec);
+    // the request handle is not needed once upgraded.
+    request_.close();
+  }
+
+  // first, so that it outlives the handles.
+  details::websocket_context<executor_type> ctx_;
+  basic_winhttp_session_handle<executor_type> session_;
+  basic_winhttp_connect_handle<executor_type> connect_;
+  basic_winhttp_request_asio_handle<executor_type> request_;
+  basic_winhttp_handle<executor_type> socket_;
+  std::chrono::milliseconds keepalive_;
+  bool text_;
+  bool got_text_;
+};
+
+namespace details {
+
+template <typename Executor> class websocket_connect_op {
+public:
+  websocket_connect_op(basic_winhttp_websocket<Executor> &ws, std::wstring url)
+      : ws_(ws), url_(std::move(url)), state_(state::idle) {}
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec = {}) {
+    if (ec) {
+      ws_.close();
+      self.complete(ec);
+      return;
+    }
+    switch (state_) {
+    case state::idle:
+      ws_.open_request(url_, ec);
+      if (ec) {
+        // complete outside of the initiating function.
+        state_ = state::done;
+        net::post(ws_.get_executor(),
+                  [self = std::move(self), ec]() mutable { self(ec); });
+        return;
+      }
+      state_ = state::send;
+      ws_.request_.async_send(WINHTTP_NO_ADDITIONAL_HEADERS, 0,
+                              WINHTTP_NO_REQUEST_DATA, 0, 0, std::move(self));
+      break;
+    case state::send:
+      state_ = state::receive;
+      ws_.request_.async_recieve_response(std::move(self));
+      break;
+    case state::receive:
+      state_ = state::done;
+      ws_.complete_upgrade(ec);
+      if (ec) {
+        ws_.close();
+      }
+      self.complete(ec);
+      break;
+    default:
+      BOOST_ASSERT_MSG(false, "unknown state");
+      break;
+    }
+  }
+
+private:
+  basic_winhttp_websocket<Executor> &ws_;
+  std::wstring url_;
+  enum class state { idle, send, receive, done } state_;
+};
+
+// receives fragments into the buffer until the end of a message.
+template <typename Executor, typename DynamicBuffer>
+class websocket_read_op {
+public:
+  websocket_read_op(basic_winhttp_websocket<Executor> &ws,
+                    DynamicBuffer &buff)
+      : ws_(ws), buff_(buff), started_(false), total_(0) {}
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec = {},
+                  std::size_t len = 0) {
+    if (!started_) {
+      started_ = true;
+      receive(self);
+      return;
+    }
+    if (ec) {
+      self.complete(ec, total_);
+      return;
+    }
+    buff_.commit(len);
+    total_ += len;
+    switch (ws_.buffer_type()) {
+    case WINHTTP_WEB_SOCKET_BINARY_MESSAGE_BUFFER_TYPE:
+      ws_.got_text_ = false;
+      self.complete(ec, total_);
+      break;
+    case WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE:
+      ws_.got_text_ = true;
+      self.complete(ec, total_);
+      break;
+    case WINHTTP_WEB_SOCKET_CLOSE_BUFFER_TYPE:
+      self.complete(net::error::eof, total_);
+      break;
+    default:
+      // a fragment, the message continues.
+      receive(self);
+      break;
+    }
+  }
+
+private:
+  template <typename Self> void receive(Self &self) {
+    std::size_t n = websocket_read_size(buff_);
+    if (n == 0) {
+      // no receive is started, complete outside of the initiating function.
+      net::post(ws_.get_executor(),
+                [self = std::move(self), total = total_]() mutable {
+                  self(net::error::no_buffer_space, total);
+                });
+      return;
+    }
+    // a buffer like multi_buffer prepares several, receive into the first.
+    net::mutable_buffer b = *net::buffer_sequence_begin(
+        buff_.prepare((std::min)(n, max_winhttp_io)));
+    ws_.async_receive(b.data(), static_cast<DWORD>(b.size()), std::move(self));
+  }
+
+  basic_winhttp_websocket<Executor> &ws_;
+  DynamicBuffer &buff_;
+  bool started_;
+  std::size_t total_;
+};
+
+// sends each non empty buffer as a fragment, the last one ends the message.
+template <typename Executor, typename ConstBufferSequence>
+class websocket_write_op {
+public:
+  websocket_write_op(basic_winhttp_websocket<Executor> &ws,
+                     const ConstBufferSequence &buffers, bool text)
+      : ws_(ws), buffers_(buffers), text_(text), started_(false), index_(0),
+        count_(static_cast<std::size_t>(
+            std::distance(net::buffer_sequence_begin(buffers_),
+                          net::buffer_sequence_end(buffers_)))),
+        total_(0) {}
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec = {},
+                  std::size_t len = 0) {
+    if (started_) {
+      if (ec) {
+        self.complete(ec, total_);
+        return;
+      }
+      total_ += len;
+      if (index_ == count_) {
+        self.complete(ec, total_);
+        return;
+      }
+    }
+    started_ = true;
+    std::size_t i = next_buffer(index_);
+    net::const_buffer b = i == count_ ? net::const_buffer() : at(i);
+    index_ = i == count_ ? count_ : next_buffer(i + 1);
+    bool last = index_ == count_;
+    WINHTTP_WEB_SOCKET_BUFFER_TYPE type;
+    if (text_) {
+      type = last ? WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE
+                  : WINHTTP_WEB_SOCKET_UTF8_FRAGMENT_BUFFER_TYPE;
+    } else {
+      type = last ? WINHTTP_WEB_SOCKET_BINARY_MESSAGE_BUFFER_TYPE
+                  : WINHTTP_WEB_SOCKET_BINARY_FRAGMENT_BUFFER_TYPE;
+    }
+    BOOST_ASSERT(b.size() <= 0xffffffff);
+    ws_.async_send(type, b.data(), static_cast<DWORD>(b.size()),
+                   std::move(self));
+  }
+
+private:
+  net::const_buffer at(std::size_t i) const {
+    auto it = net::buffer_sequence_begin(buffers_);
+    std::advance(it, i);
+    return net::const_buffer(*it);
+  }
+
+  // index of the next non empty buffer from i, or count_.
+  std::size_t next_buffer(std::size_t i) const {
+    while (i < count_ && at(i).size() == 0) {
+      ++i;
+    }
+    return i;
+  }
+
+  basic_winhttp_websocket<Executor> &ws_;
+  ConstBufferSequence buffers_;
+  bool text_;
+  bool started_;
+  std::size_t index_;
+  std::size_t count_;
+  std::size_t total_;
+};
+
+} // namespace details
+
+#else // _WIN32
+
+namespace details {
+
+inline boost::system::error_code
+beast_websocket_error(boost::system::error_code ec) {
+  if (ec == boost::beast::websocket::error::closed) {
+    return net::error::eof;
+  }
+  if (ec == boost::beast::websocket::error::upgrade_declined) {
+    return websocket_upgrade_declined();
+  }
+  return ec;
+}
+
+// runs one beast operation and maps its error.
+template <typename Initiate, bool WithLen> class beast_websocket_op {
+public:
+  explicit beast_websocket_op(Initiate init)
+      : init_(std::move(init)), started_(false) {}
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec = {},
+                  std::size_t len = 0) {
+    if (!started_) {
+      started_ = true;
+      init_(std::move(self));
+      return;
+    }
+    if constexpr (WithLen) {
+      self.complete(beast_websocket_error(ec), len);
+    } else {
+      (void)len;
+      self.complete(beast_websocket_error(ec));
+    }
+  }
+
+private:
+  Initiate init_;
+  bool started_;
+};
+
+template <typename Executor> class beast_websocket_connect_op;
+
+} // namespace details
+
+template <typename Executor = net::any_io_executor>
+class basic_winhttp_websocket {
+public:
+  /// The type of the executor associated with the object.
+  typedef Executor executor_type;
+
+  typedef boost::beast::websocket::stream<
+      boost::beast::basic_stream<net::ip::tcp, executor_type>>
+      stream_type;
+
+  explicit basic_winhttp_websocket(const executor_type &ex)
+      : ws_(ex), resolver_(ex), keepalive_(0) {}
+
+  template <typename ExecutionContext>
+  explicit basic_winhttp_websocket(
+      ExecutionContext &context,
+      typename net::constraint<
+          net::is_convertible<ExecutionContext &,
+                              net::execution_context &>::value,
+          net::defaulted_constraint>::type = net::defaulted_constraint())
+      : basic_winhttp_websocket(executor_type(context.get_executor())) {}
+
+  executor_type get_executor() { return ws_.get_executor(); }
+
+  // interval of keepalive pings, set before connect. Zero keeps the
+  // default. Beast fails the connection if the peer stays silent for
+  // another interval after the ping.
+  void set_keepalive(std::chrono::milliseconds interval) {
+    keepalive_ = interval;
+  }
+
+  // messages are written as text, otherwise as binary.
+  void text(bool value) { ws_.text(value); }
+  bool text() const { return ws_.text(); }
+
+  // whether the last message read is text.
+  bool got_text() const { return ws_.got_text(); }
+
+  bool is_open() const { return ws_.is_open(); }
+
+  // close code of the peer, 0 if none was received.
+  unsigned short close_code() const {
+    return static_cast<unsigned short>(ws_.reason().code);
+  }
+
+  // closes the socket without a close handshake. Outstanding operations
+  // complete with an error.
+  void close() {
+    resolver_.cancel();
+    boost::beast::get_lowest_layer(ws_).close();
+  }
+
+  // the beast stream, e.g. for its options.
+  stream_type &native_stream() { return ws_; }
+
+  template <BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code))
+                Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
+  auto async_connect(std::wstring_view url, Token &&token) {
+    return net::async_compose<Token, void(boost::system::error_code)>(
+        details::beast_websocket_connect_op<Executor>(*this, url), token,
+        ws_);
+  }
+
+  template <typename DynamicBuffer,
+            BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
+                                                 std::size_t))
+                Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
+  auto async_read(DynamicBuffer &buffer, Token &&token) {
+    auto init = [this, &buffer](auto self) {
+      ws_.async_read(buffer, std::move(self));
+    };
+    return net::async_compose<Token,
+                              void(boost::system::error_code, std::size_t)>(
+        details::beast_websocket_op<decltype(init), true>(std::move(init)),
+        token, ws_);
+  }
+
+  template <typename ConstBufferSequence,
+            BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
+                                                 std::size_t))
+                Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
+  auto async_write(const ConstBufferSequence &buffers, Token &&token) {
+    auto init = [this, buffers](auto self) {
+      ws_.async_write(buffers, std::move(self));
+    };
+    return net::async_compose<Token,
+                              void(boost::system::error_code, std::size_t)>(
+        details::beast_websocket_op<decltype(init), true>(std::move(init)),
+        token, ws_);
+  }
+
+  // no write may be outstanding.
+  template <BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code))
+                Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
+  auto async_close(unsigned short code, Token &&token) {
+    auto init = [this, code](auto self) {
+      ws_.async_close(boost::beast::websocket::close_reason(code),
+                      std::move(self));
+    };
+    return net::async_compose<Token, void(boost::system::error_code)>(
+        details::beast_websocket_op<decltype(init), false>(std::move(init)),
+        token, ws_);
+  }
+
+private:
+  template <typename> friend class details::beast_websocket_connect_op;
+
+  stream_type ws_;
+  net::ip::basic_resolver<net::ip::tcp, executor_type> resolver_;
+  std::chrono::milliseconds keepalive_;
+};
+
+namespace details {
+
+// ascii only, as beast takes narrow host names.
+inline std::string narrow_ascii(std::wstring_view s,
+                                boost::system::error_code &ec) {
+  std::string out;
+  out.reserve(s.size());
+  for (wchar_t c : s) {
+    if (static_cast<unsigned long>(c) > 0x7f) {
+      ec = net::error::invalid_argument;
+      return {};
+    }
+    out.push_back(static_cast<char>(c));
+  }
+  return out;
+}
+
+// resolve, connect, then the handshake.
+template <typename Executor> class beast_websocket_connect_op {
+public:
+  typedef net::ip::basic_resolver<net::ip::tcp, Executor> resolver_type;
+
+  beast_websocket_connect_op(basic_winhttp_websocket<Executor> &ws,
+                             std::wstring_view url)
+      : ws_(ws), ec_(), host_(), port_(), authority_(), target_(),
+        handshake_(false) {
+    wurl_view u = parse_url(url, ec_);
+    bool secure = false;
+    if (!ec_) {
+      check_websocket_url(u, secure, ec_);
+    }
+    if (!ec_ && secure) {
+      ec_ = net::error::operation_not_supported;
+    }
+    if (ec_) {
+      return;
+    }
+    host_ = narrow_ascii(u.host, ec_);
+    authority_ = narrow_ascii(u.host_text(), ec_);
+    if (u.has_port) {
+      authority_ += ':';
+      authority_ += narrow_ascii(u.port_text, ec_);
+    }
+    port_ = std::to_string(u.port);
+    target_ = narrow_ascii(u.target().empty() ? std::wstring_view(L"/")
+                                              : u.target(),
+                           ec_);
+  }
+
+  template <typename Self> void operator()(Self &self) {
+    if (ec_) {
+      // complete outside of the initiating function.
+      net::post(ws_.get_executor(), [self = std::move(self),
+                                     ec = ec_]() mutable { self(ec); });
+      return;
+    }
+    ws_.resolver_.async_resolve(host_, port_, std::move(self));
+  }
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec,
+                  typename resolver_type::results_type results) {
+    if (ec) {
+      self.complete(ec);
+      return;
+    }
+    boost::beast::get_lowest_layer(ws_.ws_).async_connect(results,
+                                                          std::move(self));
+  }
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec,
+                  typename net::ip::tcp::endpoint) {
+    if (ec) {
+      self.complete(ec);
+      return;
+    }
+    namespace websocket = boost::beast::websocket;
+    // the websocket timeouts replace the ones of the tcp stream.
+    boost::beast::get_lowest_layer(ws_.ws_).expires_never();
+    auto t = websocket::stream_base::timeout::suggested(
+        boost::beast::role_type::client);
+    if (ws_.keepalive_.count() != 0) {
+      t.idle_timeout = ws_.keepalive_;
+      t.keep_alive_pings = true;
+    }
+    ws_.ws_.set_option(t);
+    handshake_ = true;
+    ws_.ws_.async_handshake(authority_, target_, std::move(self));
+  }
+
+  template <typename Self>
+  void operator()(Self &self, boost::system::error_code ec) {
+    if (handshake_ && ec) {
+      boost::beast::get_lowest_layer(ws_.ws_).close();
+    }
+    self.complete(beast_websocket_error(ec));
+  }
+
+private:
+  basic_winhttp_websocket<Executor> &ws_;
+  boost::system::error_code ec_;
+  std::string host_;
+  std::string port_;
+  // host header.
+  std::string authority_;
+  std::string target_;
+  bool handshake_;
+};
+
+} // namespace details
+
+#endif // _WIN32
+
+typedef basic_winhttp_websocket<> winhttp_websocket;
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
@@ -11,14 +11,20 @@
 #include <boost/asio/windows/basic_object_handle.hpp>
 
 #include "boost/assert.hpp"
+#include "boost/winasio/winhttp/response_headers.hpp"
+#include "boost/winasio/winhttp/url.hpp"
 
 #include <spdlog/spdlog.h>
 
 #include "winhttp.h"
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
+#include <cwchar>
 #include <optional>
 #include <string>
+#include <string_view>
 
 #pragma comment(lib, "winhttp.lib")
 
@@ -28,27 +34,67 @@ namespace winhttp {
 namespace net = boost::asio;
 // namespace winnet = net::windows;
 
+// Splits a url with parse_url of url.hpp, in the layout of WinHttpCrackUrl.
+// The components point into a copy of the url, so there is no limit on
+// their size.
 class url_component {
 public:
-  url_component() : uc_() {
+  url_component() : uc_(), url_(), decoded_(), view_() {
     uc_.dwStructSize = sizeof(uc_);
-    uc_.lpszHostName = szHost_.data();
-    uc_.dwHostNameLength = std::tuple_size<decltype(szHost_)>::value;
-    uc_.lpszUrlPath = szPath_.data();
-    uc_.dwUrlPathLength = std::tuple_size<decltype(szPath_)>::value;
-    uc_.lpszScheme = szScheme_.data();
-    uc_.dwSchemeLength = std::tuple_size<decltype(szScheme_)>::value;
-    uc_.lpszExtraInfo = szQuery_.data();
-    uc_.dwExtraInfoLength = std::tuple_size<decltype(szQuery_)>::value;
   }
 
+  // dwUrlLength 0 means the url is null terminated. ICU_DECODE decodes the
+  // escapes of the path and extra info, other flags are ignored.
+  // Errors are the ones of WinHttpCrackUrl.
   inline void crack(LPCWSTR pwszUrl, DWORD dwUrlLength, DWORD dwFlags,
                     boost::system::error_code &ec) {
-    bool ok = WinHttpCrackUrl(pwszUrl, dwUrlLength, dwFlags, &uc_);
-    if (!ok) {
-      ec = boost::system::error_code(GetLastError(),
+    url_.assign(pwszUrl, dwUrlLength == 0 ? std::wcslen(pwszUrl)
+                                          : static_cast<std::size_t>(
+                                                dwUrlLength));
+    view_ = parse_url(std::wstring_view(url_), ec);
+    if (ec) {
+      ec = boost::system::error_code(ERROR_WINHTTP_INVALID_URL,
+                                     boost::asio::error::get_system_category());
+      return;
+    }
+    if (wurl_view::iequals(view_.scheme, "http")) {
+      uc_.nScheme = INTERNET_SCHEME_HTTP;
+    } else if (wurl_view::iequals(view_.scheme, "https")) {
+      uc_.nScheme = INTERNET_SCHEME_HTTPS;
+    } else {
+      ec = boost::system::error_code(ERROR_WINHTTP_UNRECOGNIZED_SCHEME,
                                      boost::asio::error::get_system_category());
+      return;
+    }
+    std::wstring_view path = view_.path;
+    std::wstring_view extra = view_.extra();
+    if (dwFlags & ICU_DECODE) {
+      decoded_.resize(path.size() + extra.size());
+      std::size_t n = percent_decode(path, decoded_.data(), ec);
+      std::size_t m = ec ? 0 : percent_decode(extra, decoded_.data() + n, ec);
+      if (ec) {
+        ec = boost::system::error_code(
+            ERROR_WINHTTP_INVALID_URL,
+            boost::asio::error::get_system_category());
+        return;
+      }
+      path = std::wstring_view(decoded_.data(), n);
+      extra = std::wstring_view(decoded_.data() + n, m);
+    }
+    std::wstring_view user = view_.userinfo;
+    std::wstring_view password;
+    std::size_t colon = user.find(L':');
+    if (colon != std::wstring_view::npos) {
+      password = user.substr(colon + 1);
+      user = user.substr(0, colon);
     }
+    set(uc_.lpszScheme, uc_.dwSchemeLength, view_.scheme);
+    set(uc_.lpszUserName, uc_.dwUserNameLength, user);
+    set(uc_.lpszPassword, uc_.dwPasswordLength, password);
+    set(uc_.lpszHostName, uc_.dwHostNameLength, view_.host_text());
+    set(uc_.lpszUrlPath, uc_.dwUrlPathLength, path);
+    set(uc_.lpszExtraInfo, uc_.dwExtraInfoLength, extra);
+    uc_.nPort = view_.port;
   }
 
   inline void crack(std::wstring const &url, boost::system::error_code &ec) {
@@ -74,12 +120,19 @@ public:
 
   inline const URL_COMPONENTS &get() { return uc_; }
 
+  // components without copies, valid while this object is.
+  inline const wurl_view &view() const { return view_; }
+
 private:
+  static void set(LPWSTR &p, DWORD &len, std::wstring_view v) {
+    p = const_cast<LPWSTR>(v.data());
+    len = static_cast<DWORD>(v.size());
+  }
+
   URL_COMPONENTS uc_;
-  std::array<WCHAR, 128> szHost_;
-  std::array<WCHAR, 128> szPath_;
-  std::array<WCHAR, 64> szScheme_;
-  std::array<WCHAR, 128> szQuery_;
+  std::wstring url_;
+  std::wstring decoded_;
+  wurl_view view_;
 };
 
 template <typename Executor = net::any_io_executor> class basic_winhttp_handle {
@@ -397,6 +450,17 @@ void get_status_code(basic_winhttp_request_handle<Executor> &h,
                   WINHTTP_NO_HEADER_INDEX, ec);
 }
 
+// ec is ERROR_WINHTTP_HEADER_NOT_FOUND if the body is chunked.
+template <typename Executor = net::any_io_executor>
+void get_content_length(basic_winhttp_request_handle<Executor> &h,
+                        _Out_ boost::system::error_code &ec,
+                        _Out_ std::uint64_t &length) {
+  DWORD dwSize = sizeof(length);
+  h.query_headers(WINHTTP_QUERY_CONTENT_LENGTH | WINHTTP_QUERY_FLAG_NUMBER64,
+                  WINHTTP_HEADER_NAME_BY_INDEX, &length, &dwSize,
+                  WINHTTP_NO_HEADER_INDEX, ec);
+}
+
 // todo: make private
 template <typename Executor = net::any_io_executor>
 void get_string_header_helper(basic_winhttp_request_handle<Executor> &h,
@@ -426,6 +490,14 @@ void get_version(basic_winhttp_request_handle<Executor> &h,
   get_string_header_helper(h, WINHTTP_QUERY_VERSION, ec, data);
 }
 
+// the verb of the request, i.e. GET.
+template <typename Executor = net::any_io_executor>
+void get_request_method(basic_winhttp_request_handle<Executor> &h,
+                        _Out_ boost::system::error_code &ec,
+                        _Out_ std::wstring &data) {
+  get_string_header_helper(h, WINHTTP_QUERY_REQUEST_METHOD, ec, data);
+}
+
 template <typename Executor = net::any_io_executor>
 void get_content_type(basic_winhttp_request_handle<Executor> &h,
                       _Out_ boost::system::error_code &ec,
@@ -433,6 +505,15 @@ void get_content_type(basic_winhttp_request_handle<Executor> &h,
   get_string_header_helper(h, WINHTTP_QUERY_CONTENT_TYPE, ec, data);
 }
 
+// the coding of the body. ec is ERROR_WINHTTP_HEADER_NOT_FOUND without
+// Content-Encoding.
+template <typename Executor = net::any_io_executor>
+void get_content_encoding(basic_winhttp_request_handle<Executor> &h,
+                          _Out_ boost::system::error_code &ec,
+                          _Out_ std::wstring &data) {
+  get_string_header_helper(h, WINHTTP_QUERY_CONTENT_ENCODING, ec, data);
+}
+
 template <typename Executor = net::any_io_executor>
 void get_all_raw_crlf(basic_winhttp_request_handle<Executor> &h,
                       _Out_ boost::system::error_code &ec,
@@ -440,6 +521,27 @@ void get_all_raw_crlf(basic_winhttp_request_handle<Executor> &h,
   get_string_header_helper(h, WINHTTP_QUERY_RAW_HEADERS_CRLF, ec, data);
 }
 
+// all response headers with one WinHttpQueryHeaders call, if the buffer of
+// out is large enough from a previous response.
+template <typename Executor = net::any_io_executor>
+void get_response_headers(basic_winhttp_request_handle<Executor> &h,
+                          _Out_ boost::system::error_code &ec,
+                          _Out_ response_headers &out) {
+  // at least 1KB, so that a new object also does a single call usually.
+  std::size_t chars = (std::max)(out.capacity(), std::size_t{1024});
+  DWORD dwSize = static_cast<DWORD>(chars * sizeof(wchar_t));
+  h.query_headers(WINHTTP_QUERY_RAW_HEADERS_CRLF, WINHTTP_HEADER_NAME_BY_INDEX,
+                  out.prepare(chars), &dwSize, WINHTTP_NO_HEADER_INDEX, ec);
+  if (ec.value() == ERROR_INSUFFICIENT_BUFFER) {
+    ec.clear();
+    chars = dwSize / sizeof(wchar_t);
+    h.query_headers(WINHTTP_QUERY_RAW_HEADERS_CRLF,
+                    WINHTTP_HEADER_NAME_BY_INDEX, out.prepare(chars), &dwSize,
+                    WINHTTP_NO_HEADER_INDEX, ec);
+  }
+  out.commit(ec ? 0 : dwSize / sizeof(wchar_t));
+}
+
 template <typename Executor = net::any_io_executor>
 void get_trailers(basic_winhttp_request_handle<Executor> &h,
                   _Out_ boost::system::error_code &ec,
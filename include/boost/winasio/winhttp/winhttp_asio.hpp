@@ -9,8 +9,12 @@
 
 // aims to have asio style apis
 // send_header(handle, token)
+#include "boost/winasio/winhttp/body_read_sizer.hpp"
 #include "boost/winasio/winhttp/winhttp.hpp"
+#include "boost/winasio/winhttp/winhttp_step.hpp"
+#include <cstddef>
 #include <functional>
+#include <memory>
 #include <spdlog/spdlog.h>
 
 namespace boost {
@@ -22,156 +26,35 @@ namespace winnet = boost::winasio;
 
 namespace details {
 
-// Compose operation to support coroutine
-// pass in an oh, and init by async compose, in WinHttp callback then set the
-// event, then the operation is compeleted. This is just a wrapper to support
-// coroutine return type.
-// The idea is to pass ec and len in ctx and access them here and pass to user
-// handler. The ctx in the asio_winhttp handle should out last the async
-// operations, so the pointers passed in ctor should be valid in the life time.
-//
-// The intended handler type is void (boost::system::error_code ec)
-template <typename Executor> class async_op : boost::asio::coroutine {
-public:
-  // oh needs to persist until async operation finishes.
-  async_op(net::windows::basic_object_handle<Executor> *oh,
-           boost::system::error_code *ctx_ec)
-      : oh_(oh), ctx_ec_(ctx_ec) {}
-
-  template <typename Self>
-  void operator()(Self &self, boost::system::error_code ec = {}) {
-    if (ec.failed()) {
-      // trigger user handler
-      self.complete(ec);
-      return;
-    }
-
-    oh_->async_wait([self = std::move(self),
-                     c = ctx_ec_](boost::system::error_code ec) mutable {
-      // we don't expect event can fail.
-      assert(!ec.failed());
-      DBG_UNREFERENCED_LOCAL_VARIABLE(ec);
-      // This invokes the user handler.
-      // pass the ctx_ec to the handler.
-      self.complete(*c);
-    });
-  }
-
-private:
-  net::windows::basic_object_handle<Executor> *oh_;
-  boost::system::error_code *ctx_ec_;
-};
-
-// differ from the above by having the len signature.
-// used to complete handler with len.
-// The intended handler type is void (boost::system::error_code ec, std::size_t
-// len)
-template <typename Executor> class async_len_op : boost::asio::coroutine {
-public:
-  // oh needs to persist until async operation finishes.
-  async_len_op(net::windows::basic_object_handle<Executor> *oh,
-               boost::system::error_code *ctx_ec, std::size_t *len)
-      : oh_(oh), ctx_ec_(ctx_ec), len_(len) {}
-
-  template <typename Self>
-  void operator()(Self &self, boost::system::error_code ec = {}) {
-    if (ec.failed()) {
-      // trigger user handler
-      self.complete(ec, 0);
-      return;
-    }
-    // len_ and ctx_ec_ are owned by request hanle where it is guaranteed to be
-    // valid when operation is going on. capture this causes problems because
-    // this can be gone when async_compose frontend finishes.
-    oh_->async_wait([self = std::move(self), l = len_,
-                     c = ctx_ec_](boost::system::error_code ec) mutable {
-      assert(!ec.failed());
-      DBG_UNREFERENCED_LOCAL_VARIABLE(ec);
-      // pass the ctx_ec and len to the handler
-      self.complete(*c, *l);
-    });
-  }
-
-private:
-  net::windows::basic_object_handle<Executor> *oh_;
-  boost::system::error_code *ctx_ec_;
-  std::size_t *len_;
-};
-
-// The hook between asio and winhttp is through a single object handle (event).
-// where user handler's are moved into the object handle, when winhttp frontend
-// api is triggered, and winhttp backend thread (callback) sets the event, so
-// that the user handler gets invoked. In each step/winhttp front end
-// invokation, the event is reset, and then reused.
-template <typename Executor> class asio_request_context {
+// The hook between asio and winhttp. User handlers are stored in the step
+// when winhttp frontend api is triggered, and the winhttp backend thread
+// (callback) completes the step, which posts the handler to its executor.
+// Read and write steps are separate, so one of each can be outstanding.
+template <typename Executor>
+class asio_request_context : public duplex_step<Executor> {
 public:
   typedef Executor executor_type;
-  enum class state {
-    idle,
-    send_request,
-    headers_available,
-    data_available,
-    read_complete,
-    write_complete,
-    error
-  };
-
-  // callbacks
-  asio_request_context(const executor_type &ex)
-      : ex_(ex), step_event(ex), step_ec(), step_len(0), state_(state::idle) {
-    HANDLE ev = CreateEvent(NULL,  // default security attributes
-                            TRUE,  // manual-reset event
-                            FALSE, // initial state is nonsignaled
-                            NULL   // object name
-    );
-    assert(ev != nullptr);
-    this->step_event.assign(ev);
-  }
-
-  void set_state(state s) noexcept { state_ = s; }
+  typedef step_state state;
 
-  state get_state() const noexcept { return state_; }
+  asio_request_context(const executor_type &ex) : duplex_step<Executor>(ex) {}
 
-  // completes the current step.
-  // This sets the event so that asio handler/token gets run,
-  // and ec value will be accessable in handler.
-  void step_complete(boost::system::error_code ec, std::size_t len = 0) {
-    spdlog::debug("step_complete: state={} ec={} len={}",
-                  static_cast<int>(state_), ec.message(), len);
-    // remembers the error and then set the event
-    this->step_ec = ec;
-    this->step_len = len;
-
-    HANDLE h = this->step_event.native_handle();
-    assert(h != NULL);
-    assert(h != INVALID_HANDLE_VALUE);
-    bool ok = SetEvent(h);
-    assert(ok);
-    DBG_UNREFERENCED_LOCAL_VARIABLE(ok);
+  // starts a step in the direction of s.
+  async_step<Executor> &begin(state s) {
+    async_step<Executor> &step = this->get(direction_of(s));
+    step.begin(s);
+    return step;
   }
 
-  // reset event and clear ec.
-  // usually used before initiate winhttp api call.
-  void step_reset() {
-    HANDLE h = this->step_event.native_handle();
-    assert(h != NULL);
-    assert(h != INVALID_HANDLE_VALUE);
-    bool ok = ResetEvent(h);
-    assert(ok);
-    DBG_UNREFERENCED_LOCAL_VARIABLE(ok);
-    step_ec.clear();
-    step_len = 0;
+  // completes the current step of the direction of s, which must be in s.
+  // The handler is posted with ec and len.
+  void step_complete(state s, boost::system::error_code ec,
+                     std::size_t len = 0) {
+    async_step<Executor> &step = this->get(direction_of(s));
+    spdlog::debug("step_complete: state={} ec={} len={}",
+                  static_cast<int>(step.get_state()), ec.message(), len);
+    BOOST_ASSERT(step.get_state() == s);
+    step.complete(ec, len);
   }
-
-  net::windows::basic_object_handle<executor_type> step_event;
-  boost::system::error_code step_ec;
-  std::size_t step_len;
-
-  executor_type get_executor() { return ex_; }
-
-private:
-  executor_type ex_;
-  state state_;
 };
 
 template <typename Executor>
@@ -181,6 +64,8 @@ void __stdcall BasicAsioAsyncCallback(HINTERNET hInternet, DWORD_PTR dwContext,
                                       DWORD dwStatusInformationLength) {
   spdlog::debug("BasicAsioAsyncCallback ENTERED: status={}", dwInternetStatus);
   UNREFERENCED_PARAMETER(hInternet);
+  BOOST_WINASIO_TRACE(winhttp_callback, instant, hInternet, dwInternetStatus,
+                      dwStatusInformationLength, {});
   typedef asio_request_context<Executor>::state ctx_state_type;
   asio_request_context<Executor> *cpContext;
   cpContext = (asio_request_context<Executor> *)dwContext;
@@ -206,16 +91,14 @@ void __stdcall BasicAsioAsyncCallback(HINTERNET hInternet, DWORD_PTR dwContext,
     spdlog::debug("DATA_AVAILABLE {}", data_len);
 
     // call back needs to finish request if len is 0
-    BOOST_ASSERT(cpContext->get_state() == ctx_state_type::data_available);
-    cpContext->step_complete(ec, data_len);
+    cpContext->step_complete(ctx_state_type::data_available, ec, data_len);
   } break;
   case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE:
     // The response header has been received and is available with
     // WinHttpQueryHeaders. The lpvStatusInformation parameter is NULL.
     spdlog::debug("HEADERS_AVAILABLE {}", dwStatusInformationLength);
     // Begin downloading the resource.
-    BOOST_ASSERT(cpContext->get_state() == ctx_state_type::headers_available);
-    cpContext->step_complete(ec);
+    cpContext->step_complete(ctx_state_type::headers_available, ec);
     break;
   case WINHTTP_CALLBACK_STATUS_READ_COMPLETE:
     // Data was successfully read from the server. The lpvStatusInformation
@@ -229,21 +112,19 @@ void __stdcall BasicAsioAsyncCallback(HINTERNET hInternet, DWORD_PTR dwContext,
     spdlog::debug("READ_COMPLETE Number of bytes read {}",
                   dwStatusInformationLength);
     // Copy the data and delete the buffers.
-    BOOST_ASSERT(cpContext->get_state() == ctx_state_type::read_complete);
-    cpContext->step_complete(ec, dwStatusInformationLength);
+    cpContext->step_complete(ctx_state_type::read_complete, ec,
+                             dwStatusInformationLength);
     break;
   case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
     spdlog::debug("SENDREQUEST_COMPLETE {}", dwStatusInformationLength);
     // Prepare the request handle to receive a response.
-    BOOST_ASSERT(cpContext->get_state() == ctx_state_type::send_request);
-    cpContext->step_complete(ec);
+    cpContext->step_complete(ctx_state_type::send_request, ec);
     break;
   case WINHTTP_CALLBACK_STATUS_WRITE_COMPLETE: {
-    BOOST_ASSERT(cpContext->get_state() == ctx_state_type::write_complete);
     BOOST_ASSERT(dwStatusInformationLength == sizeof(DWORD));
     DWORD data_len = *((LPDWORD)lpvStatusInformation);
     spdlog::debug("WRITE_COMPLETE len: {}", data_len);
-    cpContext->step_complete(ec, data_len);
+    cpContext->step_complete(ctx_state_type::write_complete, ec, data_len);
   } break;
   case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR: {
     WINHTTP_ASYNC_RESULT *pAR = (WINHTTP_ASYNC_RESULT *)lpvStatusInformation;
@@ -252,33 +133,29 @@ void __stdcall BasicAsioAsyncCallback(HINTERNET hInternet, DWORD_PTR dwContext,
     spdlog::debug(L"winhttp callback error: {}", err);
     ec.assign(pAR->dwError, boost::asio::error::get_system_category());
     BOOST_ASSERT(ec.failed()); // ec must be failed.
-    switch (cpContext->get_state()) {
-    case ctx_state_type::data_available:
-      BOOST_ASSERT(pAR->dwResult == API_QUERY_DATA_AVAILABLE);
-      cpContext->step_complete(ec, 0);
+    // dwResult names the failed api, and so the step, as a read and a write
+    // may both be outstanding.
+    switch (pAR->dwResult) {
+    case API_QUERY_DATA_AVAILABLE:
+      cpContext->step_complete(ctx_state_type::data_available, ec, 0);
       break;
-    case ctx_state_type::headers_available:
-      BOOST_ASSERT(pAR->dwResult == API_RECEIVE_RESPONSE);
-      cpContext->step_complete(ec);
+    case API_RECEIVE_RESPONSE:
+      cpContext->step_complete(ctx_state_type::headers_available, ec);
       break;
-    case ctx_state_type::read_complete:
-      BOOST_ASSERT(pAR->dwResult == API_READ_DATA);
-      cpContext->step_complete(ec, 0);
+    case API_READ_DATA:
+      cpContext->step_complete(ctx_state_type::read_complete, ec, 0);
       break;
-    case ctx_state_type::send_request:
-      BOOST_ASSERT(pAR->dwResult == API_SEND_REQUEST);
-      cpContext->step_complete(ec);
+    case API_SEND_REQUEST:
+      cpContext->step_complete(ctx_state_type::send_request, ec);
       break;
-    case ctx_state_type::write_complete:
-      BOOST_ASSERT(pAR->dwResult == API_WRITE_DATA);
-      cpContext->step_complete(ec, 0);
+    case API_WRITE_DATA:
+      cpContext->step_complete(ctx_state_type::write_complete, ec, 0);
       break;
     default:
       // API_GET_PROXY_FOR_URL is not used.
-      spdlog::debug("winhttp callback error unknown state num: {}",
+      spdlog::debug("winhttp callback error unknown api num: {}",
                     pAR->dwResult);
-      BOOST_ASSERT_MSG(false, "Unknown error winhttp callback error state" +
-                                  pAR->dwResult);
+      BOOST_ASSERT_MSG(false, "Unknown api in winhttp callback error");
     }
   } break;
   default:
@@ -304,7 +181,9 @@ public:
 
   explicit basic_winhttp_request_asio_handle(const executor_type &ex)
       : basic_winhttp_request_handle<executor_type>(ex), ctx_(ex) {
-    // set call back
+    // a terminal cancellation of an async op closes the request, winhttp
+    // has no other way to abort a call.
+    ctx_.set_canceller([this] { this->close(); });
   }
 
   // open request using manged asio callback and ctx
@@ -338,6 +217,8 @@ public:
   }
 
   // all async handler are of type void(ec, size_t)
+  // A terminal cancellation through the cancellation slot of a handler
+  // closes the request, and the handler gets net::error::operation_aborted.
 
   // one needs to call sync open before send.
   // async has all the same param with sync version
@@ -350,22 +231,18 @@ public:
                   DWORD dwOptionalLength, DWORD dwTotalLength,
                   Handler &&token) {
     boost::system::error_code ec;
-    ctx_.set_state(ctx_state_type::send_request);
-    // this is optional.
-    ctx_.step_reset();
+    auto &step = ctx_.begin(ctx_state_type::send_request);
     parent_type::send(lpszHeaders, dwHeadersLength, lpOptional,
                       dwOptionalLength, dwTotalLength, (DWORD_PTR)&ctx_, ec);
     if (ec) {
-      ctx_.set_state(ctx_state_type::error);
-      // set the event so that the async op will complete immediately.
-      ctx_.step_complete(ec);
+      step.set_state(ctx_state_type::error);
+      // complete the step so that the handler is posted immediately.
+      step.complete(ec);
     }
 
     // defer to winhttp to invoke callback
-    // callback/token is passed to a windows event/object handle in ctx
-    return boost::asio::async_compose<Handler, void(boost::system::error_code)>(
-        details::async_op<executor_type>(&ctx_.step_event, &ctx_.step_ec),
-        token, ctx_.step_event);
+    // callback/token is stored in ctx
+    return details::async_wait_step(step, std::forward<Handler>(token));
   }
 
   // callback case: WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE
@@ -373,18 +250,14 @@ public:
   // handler should call async_query_data_available
   template <typename Handler> auto async_recieve_response(Handler &&token) {
     boost::system::error_code ec;
-    ctx_.set_state(ctx_state_type::headers_available);
-
-    ctx_.step_reset();
+    auto &step = ctx_.begin(ctx_state_type::headers_available);
     parent_type::receive_response(ec);
     if (ec) {
-      ctx_.set_state(ctx_state_type::error);
-      ctx_.step_complete(ec);
+      step.set_state(ctx_state_type::error);
+      step.complete(ec);
     }
 
-    return boost::asio::async_compose<Handler, void(boost::system::error_code)>(
-        details::async_op<executor_type>(&ctx_.step_event, &ctx_.step_ec),
-        token, ctx_.step_event);
+    return details::async_wait_step(step, std::forward<Handler>(token));
   }
 
   // can be invoke in async_recieve_response or ...
@@ -394,19 +267,13 @@ public:
   // if callback len is 0, this means body/request has ended.
   template <typename Handler> auto async_query_data_available(Handler &&token) {
     boost::system::error_code ec;
-    ctx_.set_state(ctx_state_type::data_available);
-
-    ctx_.step_reset();
+    auto &step = ctx_.begin(ctx_state_type::data_available);
     parent_type::query_data_available(NULL, ec);
     if (ec) {
-      ctx_.set_state(ctx_state_type::error);
-      ctx_.step_complete(ec, 0);
+      step.set_state(ctx_state_type::error);
+      step.complete(ec, 0);
     }
-    return boost::asio::async_compose<Handler, void(boost::system::error_code,
-                                                    std::size_t)>(
-        details::async_len_op<executor_type>(&ctx_.step_event, &ctx_.step_ec,
-                                             &ctx_.step_len),
-        token, ctx_.step_event);
+    return details::async_wait_step_len(step, std::forward<Handler>(token));
   }
 
   // callback case: WINHTTP_CALLBACK_STATUS_READ_COMPLETE
@@ -416,20 +283,15 @@ public:
   auto async_read_data(_Out_ LPVOID lpBuffer, _In_ DWORD dwNumberOfBytesToRead,
                        Handler &&token) {
     boost::system::error_code ec;
-    ctx_.set_state(ctx_state_type::read_complete);
-    ctx_.step_reset();
+    auto &step = ctx_.begin(ctx_state_type::read_complete);
     parent_type::read_data(lpBuffer, dwNumberOfBytesToRead,
                            NULL, // lpdwNumberOfBytesRead
                            ec);
     if (ec) {
-      ctx_.set_state(ctx_state_type::error);
-      ctx_.step_complete(ec, 0);
+      step.set_state(ctx_state_type::error);
+      step.complete(ec, 0);
     }
-    return boost::asio::async_compose<Handler, void(boost::system::error_code,
-                                                    std::size_t)>(
-        details::async_len_op<executor_type>(&ctx_.step_event, &ctx_.step_ec,
-                                             &ctx_.step_len),
-        token, ctx_.step_event);
+    return details::async_wait_step_len(step, std::forward<Handler>(token));
   }
 
   // callback case: WINHTTP_CALLBACK_STATUS_WRITE_COMPLETE
@@ -440,36 +302,64 @@ public:
                         _In_ DWORD dwNumberOfBytesToWrite, Handler &&token) {
 
     boost::system::error_code ec;
-    ctx_.set_state(ctx_state_type::write_complete);
-    ctx_.step_reset();
+    auto &step = ctx_.begin(ctx_state_type::write_complete);
     parent_type::write_data(lpBuffer, dwNumberOfBytesToWrite,
                             NULL, // lpdwNumberOfBytesWritten
                             ec);
     if (ec) {
-      ctx_.set_state(ctx_state_type::error);
-      ctx_.step_complete(ec, 0);
+      step.set_state(ctx_state_type::error);
+      step.complete(ec, 0);
     }
-    return boost::asio::async_compose<Handler, void(boost::system::error_code,
-                                                    std::size_t)>(
-        details::async_len_op<executor_type>(&ctx_.step_event, &ctx_.step_ec,
-                                             &ctx_.step_len),
-        token, ctx_.step_event);
+    return details::async_wait_step_len(step, std::forward<Handler>(token));
   }
 
+  // number of completed async steps, i.e. winhttp callbacks.
+  std::size_t step_count() const noexcept { return ctx_.completed_steps(); }
+
 private:
   details::asio_request_context<executor_type> ctx_;
 };
 
+// how async_read_body reads the body.
+enum class read_body_mode {
+  // WinHttpQueryDataAvailable then WinHttpReadData for every chunk.
+  query,
+  // WinHttpReadData into large buffers growing geometrically, toward the
+  // Content-Length if any. One callback per read.
+  direct
+};
+
 namespace details {
 
+// Largest length given to one winhttp read, write or websocket receive.
+// Their lengths are DWORDs, INT_MAX fits a DWORD and an int alike, and is
+// far above most buffers they are given.
+constexpr std::size_t max_winhttp_io = 0x7fffffff;
+
+// false when no body follows, whatever Content-Length says: the response
+// to a HEAD request, or a 204 or 304.
+template <typename Executor>
+bool may_have_body(basic_winhttp_request_handle<Executor> &h) {
+  boost::system::error_code ec;
+  DWORD status = 0;
+  header::get_status_code(h, ec, status);
+  if (!ec && (status == 204 || status == 304)) {
+    return false;
+  }
+  std::wstring method;
+  header::get_request_method(h, ec, method);
+  return ec || method != L"HEAD";
+}
+
 // compose operation that reads all http body into buff
 template <typename Executor, typename DynamicBuffer>
 class async_read_body_op : boost::asio::coroutine {
 public:
   typedef Executor executor_type;
   async_read_body_op(basic_winhttp_request_asio_handle<executor_type> &h,
-                     DynamicBuffer &buff)
-      : h_request_(h), buff_(buff), state_(state::idle) {}
+                     DynamicBuffer &buff, read_body_mode mode)
+      : h_request_(h), buff_(buff), mode_(mode), state_(state::idle),
+        sizer_(), requested_(0), total_(0) {}
 
   template <typename Self>
   void operator()(Self &self, boost::system::error_code ec = {},
@@ -481,6 +371,17 @@ public:
 
     switch (state_) {
     case state::idle:
+      if (mode_ == read_body_mode::direct) {
+        if (may_have_body(h_request_)) {
+          std::uint64_t content_length = 0;
+          header::get_content_length(h_request_, ec, content_length);
+          if (!ec) {
+            sizer_ = body_read_sizer(content_length);
+          }
+        }
+        read_direct(self);
+        break;
+      }
       state_ = state::query_data;
       h_request_.async_query_data_available(std::move(self));
       break;
@@ -498,13 +399,27 @@ public:
     case state::read_data:
       if (len != 0) {
         this->buff_.commit(len);
+        total_ += len;
         // Check for more data.
         state_ = state::query_data;
         h_request_.async_query_data_available(std::move(self));
       } else {
         spdlog::debug("state::read_data complete");
         state_ = state::done;
-        self.complete(ec, 0); // TODO total len;
+        self.complete(ec, total_);
+      }
+      break;
+    case state::read_direct:
+      if (len != 0) {
+        this->buff_.commit(len);
+        total_ += len;
+        sizer_.consumed(requested_, len);
+        read_direct(self);
+      } else {
+        // zero length read ends the body, and populates trailers.
+        spdlog::debug("state::read_direct complete");
+        state_ = state::done;
+        self.complete(ec, total_);
       }
       break;
     default:
@@ -514,25 +429,65 @@ public:
   }
 
 private:
+  template <typename Self> void read_direct(Self &self) {
+    state_ = state::read_direct;
+    std::size_t room = buff_.max_size() - buff_.size();
+    requested_ = (std::min)(sizer_.next(), room);
+    if (requested_ == 0) {
+      // no read is started, complete outside of the initiating function.
+      net::post(h_request_.get_executor(),
+                [self = std::move(self), total = total_]() mutable {
+                  self(net::error::no_buffer_space, total);
+                });
+      return;
+    }
+    requested_ = (std::min)(requested_, max_winhttp_io);
+    auto buff = this->buff_.prepare(requested_);
+    h_request_.async_read_data((LPVOID)buff.data(),
+                               static_cast<DWORD>(requested_), std::move(self));
+  }
+
   basic_winhttp_request_asio_handle<executor_type> &h_request_;
   DynamicBuffer &buff_;
-  enum class state { idle, query_data, read_data, done } state_;
+  read_body_mode mode_;
+  enum class state {
+    idle,
+    query_data,
+    read_data,
+    read_direct,
+    done
+  } state_;
+  body_read_sizer sizer_;
+  std::size_t requested_;
+  std::size_t total_;
 };
 } // namespace details
 
 // async read all body into buffer
 // use this in async_recieve_response handler
-// handler signature void(ec, size_t)
+// handler signature void(ec, size_t), size_t is the body length.
 template <typename Executor, typename DynamicBuffer,
           BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
                                                std::size_t))
               Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
 auto async_read_body(basic_winhttp_request_asio_handle<Executor> &h,
-                     DynamicBuffer &buffer, Token &&token) {
+                     DynamicBuffer &buffer, read_body_mode mode,
+                     Token &&token) {
   return boost::asio::async_compose<Token, void(boost::system::error_code,
                                                 std::size_t)>(
-      details::async_read_body_op<Executor, DynamicBuffer>(h, buffer), token,
-      h.get_executor());
+      details::async_read_body_op<Executor, DynamicBuffer>(h, buffer, mode),
+      token, h.get_executor());
+}
+
+// reads with read_body_mode::direct.
+template <typename Executor, typename DynamicBuffer,
+          BOOST_ASIO_COMPLETION_TOKEN_FOR(void(boost::system::error_code,
+                                               std::size_t))
+              Token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(Executor)>
+auto async_read_body(basic_winhttp_request_asio_handle<Executor> &h,
+                     DynamicBuffer &buffer, Token &&token) {
+  return async_read_body(h, buffer, read_body_mode::direct,
+                         std::forward<Token>(token));
 }
 
 } // namespace winhttp
@@ -0,0 +1,417 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Completion of the steps of an async winhttp request.
+// A winhttp request has at most one outstanding step per direction: a read
+// step (receive response, query data, read) and a write step (send, write),
+// so that an upload can overlap a download. Each direction has its own
+// async_step. A step is completed by the winhttp callback thread, which
+// posts the stored user handler to its executor.
+// The callback can run before the handler is stored, i.e. on another thread
+// while the winhttp api is still returning, so both orders are handled by a
+// small lock free state machine.
+// A step honours a terminal cancellation of the cancellation slot of its
+// handler by calling the canceller of the step, which for winhttp closes
+// the handle. The pending call then fails, and the handler completes with
+// net::error::operation_aborted.
+// The callback source is not necessarily winhttp, tests drive the state
+// machine from plain threads.
+
+#include <boost/winasio/recycling_allocator.hpp>
+#include <boost/winasio/trace.hpp>
+
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/cancellation_type.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace boost {
+namespace winasio {
+namespace winhttp {
+
+namespace net = boost::asio;
+
+namespace details {
+
+enum class step_state {
+  idle,
+  send_request,
+  headers_available,
+  data_available,
+  read_complete,
+  write_complete,
+  // websocket close handshake.
+  close_complete,
+  error
+};
+
+enum class step_direction { read, write };
+
+inline step_direction direction_of(step_state s) noexcept {
+  return s == step_state::send_request || s == step_state::write_complete ||
+                 s == step_state::close_complete
+             ? step_direction::write
+             : step_direction::read;
+}
+
+// Memory for the post of a completed step. The callback thread posts the
+// handler, and memory allocated there is not recycled by the io threads,
+// so the post is allocated from here instead, falling back to the heap
+// when it does not fit.
+class post_memory {
+public:
+  post_memory() noexcept : used_(false) {}
+  post_memory(const post_memory &) = delete;
+  post_memory &operator=(const post_memory &) = delete;
+
+  void *allocate(std::size_t n) {
+    if (!used_ && n <= sizeof(storage_)) {
+      used_ = true;
+      return &storage_;
+    }
+    return ::operator new(n);
+  }
+
+  void deallocate(void *p) noexcept {
+    if (p == &storage_) {
+      used_ = false;
+      return;
+    }
+    ::operator delete(p);
+  }
+
+private:
+  alignas(std::max_align_t) unsigned char storage_[256];
+  bool used_;
+};
+
+template <typename T> class post_allocator {
+public:
+  typedef T value_type;
+
+  explicit post_allocator(post_memory &m) noexcept : m_(&m) {}
+
+  template <typename U>
+  post_allocator(const post_allocator<U> &other) noexcept : m_(other.m_) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(m_->allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T *p, std::size_t) noexcept { m_->deallocate(p); }
+
+  template <typename U>
+  bool operator==(const post_allocator<U> &other) const noexcept {
+    return m_ == other.m_;
+  }
+
+  template <typename U>
+  bool operator!=(const post_allocator<U> &other) const noexcept {
+    return m_ != other.m_;
+  }
+
+private:
+  template <typename> friend class post_allocator;
+  post_memory *m_;
+};
+
+// type erased user handler of a step.
+class step_handler_base {
+public:
+  // post the handler with the result. The handler's memory is freed before
+  // it is called, so that the next step reuses it.
+  virtual void post(boost::system::error_code ec, std::size_t len) = 0;
+  // frees a handler that is not posted.
+  virtual void destroy() noexcept = 0;
+
+protected:
+  ~step_handler_base() = default;
+};
+
+// WithLen selects the handler signature void(ec, len) or void(ec).
+// Allocated with the handler's allocator, see handler_allocator.
+template <typename Handler, typename Executor, bool WithLen>
+class step_handler : public step_handler_base {
+public:
+  typedef net::associated_executor_t<Handler, Executor> handler_executor;
+  typedef handler_allocator_t<Handler> allocator_type;
+  typedef typename std::allocator_traits<allocator_type>::template rebind_alloc<
+      step_handler>
+      alloc_type;
+  typedef std::allocator_traits<alloc_type> alloc_traits;
+
+  static step_handler *create(Handler &&h, const Executor &ex) {
+    alloc_type alloc(get_handler_allocator(h));
+    step_handler *p = alloc_traits::allocate(alloc, 1);
+    try {
+      alloc_traits::construct(alloc, p, std::move(h), ex, alloc);
+    } catch (...) {
+      alloc_traits::deallocate(alloc, p, 1);
+      throw;
+    }
+    return p;
+  }
+
+  step_handler(Handler &&h, const Executor &ex, const alloc_type &alloc)
+      : work_(net::make_work_guard(net::get_associated_executor(h, ex))),
+        handler_(std::move(h)), alloc_(alloc), memory_() {}
+
+  void post(boost::system::error_code ec, std::size_t len) override {
+    // owned by the posted function. The work guard is released there, so
+    // that the executor does not run out of work in between.
+    handler_executor ex = work_.get_executor();
+    net::post(ex, completion{std::unique_ptr<step_handler, deleter>(this),
+                             ec, len});
+  }
+
+  void destroy() noexcept override {
+    net::get_associated_cancellation_slot(handler_).clear();
+    deleter()(this);
+  }
+
+private:
+  struct deleter {
+    void operator()(step_handler *p) const noexcept {
+      alloc_type alloc(p->alloc_);
+      alloc_traits::destroy(alloc, p);
+      alloc_traits::deallocate(alloc, p, 1);
+    }
+  };
+
+  // the posted function, allocated in memory_.
+  struct completion {
+    typedef post_allocator<void> allocator_type;
+
+    allocator_type get_allocator() const noexcept {
+      return allocator_type(self->memory_);
+    }
+
+    void operator()() {
+      Handler h(std::move(self->handler_));
+      self.reset();
+      // the step is done, it must not be cancelled any more.
+      net::get_associated_cancellation_slot(h).clear();
+      if constexpr (WithLen) {
+        std::move(h)(ec, len);
+      } else {
+        std::move(h)(ec);
+      }
+    }
+
+    std::unique_ptr<step_handler, deleter> self;
+    boost::system::error_code ec;
+    std::size_t len;
+  };
+
+  // keeps the executor running while winhttp owns the step.
+  net::executor_work_guard<handler_executor> work_;
+  Handler handler_;
+  alloc_type alloc_;
+  post_memory memory_;
+};
+
+// Holds the current step of a request.
+// The initiating side calls begin(), then the winhttp api, then wait() with
+// the user handler. The callback side calls complete(). Whichever of wait()
+// and complete() comes second posts the handler.
+template <typename Executor> class async_step {
+public:
+  typedef Executor executor_type;
+
+  explicit async_step(const executor_type &ex)
+      : ex_(ex), slot_(slot::empty), state_(step_state::idle), handler_(),
+        ec_(), len_(0), completed_(0), cancelled_(false), canceller_() {}
+
+  async_step(const async_step &) = delete;
+  async_step &operator=(const async_step &) = delete;
+
+  ~async_step() {
+    // a request must not be destroyed while winhttp owns a step.
+    BOOST_ASSERT(slot_.load() != slot::armed);
+    if (handler_ != nullptr) {
+      handler_->destroy();
+    }
+  }
+
+  executor_type get_executor() const noexcept { return ex_; }
+
+  void set_state(step_state s) noexcept { state_ = s; }
+
+  step_state get_state() const noexcept { return state_; }
+
+  // called on a terminal cancellation of a pending step, on the thread that
+  // emits it. It must fail the pending call. Without a canceller the
+  // cancellation slot of the handler is not used.
+  void set_canceller(std::function<void()> fn) { canceller_ = std::move(fn); }
+
+  // number of completed steps, i.e. winhttp callbacks.
+  std::size_t completed_steps() const noexcept {
+    return completed_.load(std::memory_order_relaxed);
+  }
+
+  // start a new step, before the winhttp api is called.
+  void begin(step_state s) noexcept {
+    BOOST_ASSERT(slot_.load(std::memory_order_relaxed) != slot::armed);
+    slot_.store(slot::empty, std::memory_order_relaxed);
+    state_ = s;
+    ec_.clear();
+    len_ = 0;
+    cancelled_.store(false, std::memory_order_relaxed);
+    BOOST_WINASIO_TRACE(winhttp_step, begin, this, s, 0, {});
+  }
+
+  // called by the winhttp callback, or by the initiating side if the api
+  // failed synchronously.
+  void complete(boost::system::error_code ec, std::size_t len = 0) {
+    BOOST_WINASIO_TRACE(winhttp_step, end, this, state_, len, ec);
+    completed_.fetch_add(1, std::memory_order_relaxed);
+    if (ec && cancelled_.load(std::memory_order_acquire)) {
+      ec = net::error::operation_aborted;
+    }
+    ec_ = ec;
+    len_ = len;
+    slot expected = slot::empty;
+    if (slot_.compare_exchange_strong(expected, slot::ready,
+                                      std::memory_order_acq_rel)) {
+      // handler is not stored yet, wait() will post it.
+      return;
+    }
+    BOOST_ASSERT(expected == slot::armed);
+    fire();
+  }
+
+  // store the handler of the current step.
+  template <bool WithLen, typename Handler> void wait(Handler &&h) {
+    typedef typename std::decay<Handler>::type handler_type;
+    BOOST_ASSERT(handler_ == nullptr);
+    auto cs = net::get_associated_cancellation_slot(h);
+    if (canceller_ && cs.is_connected()) {
+      cs.template emplace<cancellation>(this);
+    }
+    handler_ = step_handler<handler_type, executor_type, WithLen>::create(
+        std::move(h), ex_);
+    slot expected = slot::empty;
+    if (slot_.compare_exchange_strong(expected, slot::armed,
+                                      std::memory_order_acq_rel)) {
+      // complete() will post it.
+      return;
+    }
+    BOOST_ASSERT(expected == slot::ready);
+    fire();
+  }
+
+private:
+  enum class slot { empty, armed, ready };
+
+  // installed in the cancellation slot of a waiting handler.
+  struct cancellation {
+    explicit cancellation(async_step *s) noexcept : step(s) {}
+    void operator()(net::cancellation_type type) const {
+      if ((type & net::cancellation_type::terminal) !=
+          net::cancellation_type::none) {
+        step->cancel();
+      }
+    }
+    async_step *step;
+  };
+
+  void cancel() {
+    // the step may have completed, with the handler not run yet.
+    if (slot_.load(std::memory_order_acquire) != slot::armed) {
+      return;
+    }
+    cancelled_.store(true, std::memory_order_release);
+    canceller_();
+  }
+
+  void fire() {
+    step_handler_base *h = handler_;
+    boost::system::error_code ec = ec_;
+    std::size_t len = len_;
+    handler_ = nullptr;
+    slot_.store(slot::empty, std::memory_order_relaxed);
+    h->post(ec, len);
+  }
+
+  executor_type ex_;
+  std::atomic<slot> slot_;
+  step_state state_;
+  step_handler_base *handler_;
+  boost::system::error_code ec_;
+  std::size_t len_;
+  std::atomic<std::size_t> completed_;
+  std::atomic<bool> cancelled_;
+  std::function<void()> canceller_;
+};
+
+// The read and the write step of a request.
+template <typename Executor> class duplex_step {
+public:
+  typedef Executor executor_type;
+
+  explicit duplex_step(const executor_type &ex) : read_(ex), write_(ex) {}
+
+  async_step<Executor> &get(step_direction d) noexcept {
+    return d == step_direction::read ? read_ : write_;
+  }
+
+  // see async_step::set_canceller.
+  void set_canceller(std::function<void()> fn) {
+    read_.set_canceller(fn);
+    write_.set_canceller(std::move(fn));
+  }
+
+  // number of completed steps of both directions.
+  std::size_t completed_steps() const noexcept {
+    return read_.completed_steps() + write_.completed_steps();
+  }
+
+private:
+  async_step<Executor> read_;
+  async_step<Executor> write_;
+};
+
+// initiating functions of a step, to be used after the winhttp api is
+// called.
+template <typename Executor, typename Token>
+auto async_wait_step(async_step<Executor> &step, Token &&token) {
+  return net::async_initiate<Token, void(boost::system::error_code)>(
+      [](auto handler, async_step<Executor> *s) {
+        s->template wait<false>(std::move(handler));
+      },
+      token, &step);
+}
+
+template <typename Executor, typename Token>
+auto async_wait_step_len(async_step<Executor> &step, Token &&token) {
+  return net::async_initiate<Token,
+                             void(boost::system::error_code, std::size_t)>(
+      [](auto handler, async_step<Executor> *s) {
+        s->template wait<true>(std::move(handler));
+      },
+      token, &step);
+}
+
+} // namespace details
+
+} // namespace winhttp
+} // namespace winasio
+} // namespace boost
@@ -9,6 +9,14 @@
 
 #include "boost/winasio/winhttp/winhttp_asio.hpp"
 
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/coroutine.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <vector>
+
 namespace boost {
 namespace winasio {
 namespace winhttp {
@@ -18,102 +26,188 @@ namespace winnet = boost::winasio;
 
 namespace details {
 
+// position in a buffer sequence, skipping empty buffers.
+template <typename BufferSequence, typename Buffer> class buffer_cursor {
+public:
+  explicit buffer_cursor(const BufferSequence &buffers)
+      : buffers_(buffers), index_(0), offset_(0) {}
+
+  // the rest of the current buffer, empty at the end of the sequence.
+  Buffer current() const {
+    std::size_t i = 0;
+    auto end = net::buffer_sequence_end(buffers_);
+    for (auto it = net::buffer_sequence_begin(buffers_); it != end;
+         ++it, ++i) {
+      if (i < index_) {
+        continue;
+      }
+      Buffer b(*it);
+      b += (i == index_ ? offset_ : 0);
+      if (b.size() != 0) {
+        return b;
+      }
+    }
+    return Buffer();
+  }
+
+  void consume(std::size_t n) {
+    std::size_t i = 0;
+    auto end = net::buffer_sequence_end(buffers_);
+    for (auto it = net::buffer_sequence_begin(buffers_); it != end && n > 0;
+         ++it, ++i) {
+      if (i < index_) {
+        continue;
+      }
+      std::size_t base = i == index_ ? offset_ : 0;
+      std::size_t left = Buffer(*it).size() - base;
+      if (n < left) {
+        index_ = i;
+        offset_ = base + n;
+        return;
+      }
+      n -= left;
+      index_ = i + 1;
+      offset_ = 0;
+    }
+  }
+
+  const BufferSequence &buffers() const { return buffers_; }
+
+private:
+  // held by value, the sequence object of the caller may be a temporary.
+  BufferSequence buffers_;
+  std::size_t index_;
+  std::size_t offset_;
+};
+
 // compose operation that reads some data.
-// This only read once, but not all data
-template <typename Executor> class async_read_some_op : boost::asio::coroutine {
+// Queries the available data once, then fills the buffers in order until it
+// is consumed. Completes with net::error::eof at the end of the body.
+template <typename Executor, typename MutableBufferSequence>
+class async_read_some_op : boost::asio::coroutine {
 public:
   typedef Executor executor_type;
-  // in net::async_read, the passed in MutableBufferSequence is on stack, and
-  // can be destroyed in compose second run, so we use raw data and len of the
-  // buffer for this compose operation.
   async_read_some_op(basic_winhttp_request_asio_handle<executor_type> *h,
-                     void *data, std::size_t size)
-      : h_(h), data_(data), size_(size), state_(state::idle) {}
+                     const MutableBufferSequence &buffers)
+      : h_(h), cursor_(buffers), available_(0), total_(0) {}
 
   template <typename Self>
   void operator()(Self &self, boost::system::error_code ec = {},
                   std::size_t len = 0) {
     if (ec) {
-      self.complete(ec, len);
+      self.complete(ec, total_);
       return;
     }
-
-    switch (state_) {
-    case state::idle:
-      state_ = state::query_data;
-      h_->async_query_data_available(std::move(self));
-      break;
-    case state::query_data: {
-      state_ = state::read_data;
-      //  read bytes into data buff
-      std::size_t read_len = std::min(len, size_);
-      h_->async_read_data((LPVOID)data_, static_cast<DWORD>(read_len),
-                          std::move(self));
-    } break;
-    case state::read_data:
-      state_ = state::done;
-      // seems like net::async_read will stop if read len is 0 automatically.
-      self.complete(ec, len);
-      break;
-    default:
-      BOOST_ASSERT_MSG(false, "unknown state");
-      break;
+    BOOST_ASIO_CORO_REENTER(*this) {
+      if (net::buffer_size(cursor_.buffers()) == 0) {
+        // reading into empty buffers completes at once.
+        BOOST_ASIO_CORO_YIELD net::post(h_->get_executor(), std::move(self));
+        self.complete(ec, 0);
+        return;
+      }
+      BOOST_ASIO_CORO_YIELD h_->async_query_data_available(std::move(self));
+      available_ = len;
+      if (available_ == 0) {
+        // the read of 0 bytes populates trailers.
+        BOOST_ASIO_CORO_YIELD h_->async_read_data(
+            (LPVOID)cursor_.current().data(), 0, std::move(self));
+        self.complete(net::error::eof, 0);
+        return;
+      }
+      for (;;) {
+        BOOST_ASIO_CORO_YIELD {
+          net::mutable_buffer b = cursor_.current();
+          std::size_t n = (std::min)(available_, b.size());
+          h_->async_read_data((LPVOID)b.data(), static_cast<DWORD>(n),
+                              std::move(self));
+        }
+        total_ += len;
+        available_ -= (std::min)(available_, len);
+        cursor_.consume(len);
+        if (len == 0 || available_ == 0 || cursor_.current().size() == 0) {
+          break;
+        }
+      }
+      self.complete(ec, total_);
     }
   }
 
 private:
   basic_winhttp_request_asio_handle<executor_type> *h_;
-  // data and len of the mutable buffer
-  void *data_;
-  std::size_t size_;
-  enum class state { idle, query_data, read_data, done } state_;
+  buffer_cursor<MutableBufferSequence, net::mutable_buffer> cursor_;
+  std::size_t available_;
+  std::size_t total_;
 };
 
-template <typename Executor>
+// compose operation that writes all buffers.
+// Small sequences are gathered into one write, larger ones are written
+// buffer by buffer without copies.
+template <typename Executor, typename ConstBufferSequence>
 class async_write_some_op : boost::asio::coroutine {
 public:
   typedef Executor executor_type;
+  // sequences up to this size are copied and written at once.
+  static constexpr std::size_t gather_limit = 4096;
+
   async_write_some_op(basic_winhttp_request_asio_handle<executor_type> *h,
-                      const void *data, std::size_t size)
-      : h_(h), data_(data), size_(size), state_(state::idle) {}
+                      const ConstBufferSequence &buffers)
+      : h_(h), cursor_(buffers), staging_(), total_(0) {}
 
   template <typename Self>
   void operator()(Self &self, boost::system::error_code ec = {},
                   std::size_t len = 0) {
     if (ec) {
-      self.complete(ec, len);
+      self.complete(ec, total_);
       return;
     }
-
-    switch (state_) {
-    case state::idle:
-      state_ = state::write_data;
-      h_->async_write_data((LPCVOID)data_, static_cast<DWORD>(size_),
-                           std::move(self));
-      break;
-    case state::write_data:
-      state_ = state::done;
-      self.complete(ec, len);
-      break;
-    default:
-      BOOST_ASSERT_MSG(false, "unknown state");
-      break;
+    BOOST_ASIO_CORO_REENTER(*this) {
+      if (net::buffer_size(cursor_.buffers()) == 0) {
+        BOOST_ASIO_CORO_YIELD net::post(h_->get_executor(), std::move(self));
+        self.complete(ec, 0);
+        return;
+      }
+      if (net::buffer_size(cursor_.buffers()) <= gather_limit &&
+          cursor_.current().size() < net::buffer_size(cursor_.buffers())) {
+        // several small buffers.
+        staging_.resize(net::buffer_size(cursor_.buffers()));
+        net::buffer_copy(net::buffer(staging_), cursor_.buffers());
+        BOOST_ASIO_CORO_YIELD h_->async_write_data(
+            (LPCVOID)staging_.data(), static_cast<DWORD>(staging_.size()),
+            std::move(self));
+        self.complete(ec, len);
+        return;
+      }
+      for (;;) {
+        BOOST_ASIO_CORO_YIELD {
+          // larger buffers are written in several calls.
+          net::const_buffer b = cursor_.current();
+          std::size_t n = (std::min)(b.size(), max_winhttp_io);
+          h_->async_write_data((LPCVOID)b.data(), static_cast<DWORD>(n),
+                               std::move(self));
+        }
+        total_ += len;
+        cursor_.consume(len);
+        if (len == 0 || cursor_.current().size() == 0) {
+          break;
+        }
+      }
+      self.complete(ec, total_);
     }
   }
 
 private:
   basic_winhttp_request_asio_handle<executor_type> *h_;
-  // data and len of const buffer
-  // we can use const buffer sequence reference here, but for consistency of the
-  // read op, we use raw types.
-  const void *data_;
-  std::size_t size_;
-  enum class state { idle, write_data, done } state_;
+  buffer_cursor<ConstBufferSequence, net::const_buffer> cursor_;
+  // heap storage stays in place when the op is moved.
+  std::vector<char> staging_;
+  std::size_t total_;
 };
 
 } // namespace details
 
-// wrapper for asio operations to impl asio stream
+// wrapper for asio operations to impl asio stream.
+// Meets AsyncReadStream and AsyncWriteStream for the body, reads complete
+// with net::error::eof at the end of the body.
 template <typename Executor = net::any_io_executor>
 class basic_winhttp_request_stream_handle
     : public basic_winhttp_request_asio_handle<Executor> {
@@ -137,8 +231,8 @@ public:
 
     return boost::asio::async_compose<ReadToken, void(boost::system::error_code,
                                                       std::size_t)>(
-        details::async_read_some_op<Executor>(this, buffers.data(),
-                                              buffers.size()),
+        details::async_read_some_op<Executor, MutableBufferSequence>(this,
+                                                                     buffers),
         token, this->get_executor());
   }
 
@@ -154,8 +248,8 @@ public:
           token BOOST_ASIO_DEFAULT_COMPLETION_TOKEN(executor_type)) {
     return boost::asio::async_compose<
         WriteToken, void(boost::system::error_code, std::size_t)>(
-        details::async_write_some_op<Executor>(this, buffers.data(),
-                                               buffers.size()),
+        details::async_write_some_op<Executor, ConstBufferSequence>(this,
+                                                                    buffers),
         token, this->get_executor());
   }
 };
@@ -34,6 +34,7 @@ public:
 
   // private:
   http::verb verb_ = http::verb::get;
+  std::string target_ = "/winhttpapitest";
   std::map<std::string, std::string> headers_;
   std::string body_;
 };
@@ -43,6 +44,7 @@ public:
   int status_code;
   http::status status;
   std::string body;
+  std::map<std::string, std::string> headers;
 
 private:
 };
@@ -63,7 +65,7 @@ inline boost::system::error_code make_test_request(test_request const &request,
   stream.connect(results);
 
   // Set up an HTTP request message
-  http::request<http::string_body> req{request.verb_, "/winhttpapitest", 11};
+  http::request<http::string_body> req{request.verb_, request.target_, 11};
   req.set(http::field::host, "localhost");
   req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
   req.body() = request.body_;
@@ -102,6 +104,10 @@ inline boost::system::error_code make_test_request(test_request const &request,
 
   response.status = res.result();
   response.body = boost::beast::buffers_to_string(res.body().data());
+  for (auto const &field : res) {
+    response.headers[std::string(field.name_string())] =
+        std::string(field.value());
+  }
 
   return beast::error_code{};
 }
\ No newline at end of file
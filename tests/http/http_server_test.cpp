@@ -24,6 +24,10 @@
 
 #include <chrono>
 #include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <latch>
+#include <stdexcept>
 #include <utility>
 
 using namespace std::chrono_literals;
@@ -143,6 +147,61 @@ void server_gracefully_shutdown_helper() {
   boost::ut::expect(cncl_ec.value() == 995); // cancelled.
 }
 
+// returns false if pred is not true within timeout.
+template <typename Pred>
+bool wait_for(Pred &&pred, std::chrono::milliseconds timeout = 5s) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+  return true;
+}
+
+// runs a controller on http://localhost:12356/winhttpapitest/ with an io
+// thread of io_context. setup configures the controller before start, and
+// client makes the requests while it runs.
+template <typename Setup, typename Client>
+void controller_test_helper(net::io_context &io_context, Setup &&setup,
+                            Client &&client) {
+  winnet::http::http_initializer<winnet::http::HTTP_MAJOR_VERSION::http_ver_2>
+      init;
+  std::wstring url = L"http://localhost:12356/winhttpapitest/";
+
+  boost::system::error_code ec;
+  winnet::http::queue queue(io_context, init.create_http_queue(ec));
+  BOOST_ASSERT(!ec.failed());
+  winnet::http::basic_http_url<net::any_io_executor,
+                               winnet::http::HTTP_MAJOR_VERSION::http_ver_2>
+      simple_url(queue, url);
+
+  winnet::http::controller controller(queue, url);
+  setup(controller);
+  controller.start();
+
+  std::thread server([&] { io_context.run(); });
+  client(controller);
+
+  io_context.stop();
+  server.join();
+}
+
+// GET target, returns the status.
+http::status test_get(const std::string &target,
+                      test_response *out = nullptr) {
+  test_request req;
+  test_response resp;
+  req.target_ = target;
+  boost::system::error_code ec = make_test_request(req, resp);
+  boost::ut::expect(!ec.failed());
+  if (out != nullptr) {
+    *out = resp;
+  }
+  return resp.status;
+}
+
 boost::ut::suite errors = [] {
   using namespace boost::ut;
 
@@ -211,6 +270,193 @@ boost::ut::suite errors = [] {
     controller.start();
     // ctx.run();
   };
+
+  // the request is still answered and released.
+  "controller_offload_throw"_test = [] {
+    net::io_context io_context;
+    winnet::http::offload_pool pool(1);
+    controller_test_helper(
+        io_context,
+        [&](winnet::http::controller &c) {
+          c.set_offload_pool(pool);
+          c.get(
+              L"/throw",
+              [](winnet::http::controller::request_context &) {
+                throw std::runtime_error("handler");
+              },
+              winnet::http::handler_execution::offload);
+        },
+        [](winnet::http::controller &c) {
+          expect(test_get("/winhttpapitest/throw") ==
+                 http::status::internal_server_error);
+          expect(wait_for(
+              [&] { return 0 == c.get_metrics().in_flight.value(); }));
+        });
+    expect(0u == pool.failed_count());
+  };
+
+  "controller_shed"_test = [] {
+    net::io_context io_context;
+    controller_test_helper(
+        io_context,
+        [](winnet::http::controller &c) {
+          winnet::http::admission_options options;
+          options.retry_after = 7s;
+          c.set_admission(options);
+          c.get(L"/limited",
+                [](winnet::http::controller::request_context &) {});
+          winnet::http::route_limits limits;
+          limits.rate = 0.001;
+          c.set_route_limits(L"/limited", limits);
+        },
+        [](winnet::http::controller &c) {
+          expect(test_get("/winhttpapitest/limited") == http::status::ok);
+          // the token of the route is spent.
+          test_response resp;
+          expect(test_get("/winhttpapitest/limited", &resp) ==
+                 http::status::service_unavailable);
+          expect(resp.headers["Retry-After"] == "7");
+          expect(wait_for([&] { return 1 == c.get_metrics().shed.value(); }));
+          expect(wait_for(
+              [&] { return 0 == c.get_metrics().in_flight.value(); }));
+        });
+  };
+
+  // requests over the queue bound of the pool are shed.
+  "controller_offload_saturated"_test = [] {
+    net::io_context io_context;
+    winnet::http::offload_pool pool(1, 1);
+    std::latch started(1);
+    std::latch blocked(1);
+    controller_test_helper(
+        io_context,
+        [&](winnet::http::controller &c) {
+          c.set_offload_pool(pool);
+          c.get(
+              L"/slow",
+              [&](winnet::http::controller::request_context &) {
+                started.count_down();
+                blocked.wait();
+              },
+              winnet::http::handler_execution::offload);
+        },
+        [&](winnet::http::controller &c) {
+          // one request runs, one waits in the queue of the pool.
+          std::vector<std::thread> clients;
+          for (int i = 0; i < 2; ++i) {
+            clients.emplace_back([] {
+              expect(test_get("/winhttpapitest/slow") == http::status::ok);
+            });
+          }
+          started.wait();
+          expect(wait_for([&] { return 1u == pool.queued(); }));
+          expect(test_get("/winhttpapitest/slow") ==
+                 http::status::service_unavailable);
+          blocked.count_down();
+          for (auto &t : clients) {
+            t.join();
+          }
+          expect(wait_for(
+              [&] { return 0 == c.get_metrics().in_flight.value(); }));
+        });
+  };
+
+  "controller_metrics"_test = [] {
+    net::io_context io_context;
+    controller_test_helper(
+        io_context,
+        [](winnet::http::controller &c) {
+          c.enable_metrics(L"/metrics");
+          c.get(L"/hello",
+                [](winnet::http::controller::request_context &) {});
+        },
+        [](winnet::http::controller &) {
+          expect(test_get("/winhttpapitest/hello") == http::status::ok);
+          test_response resp;
+          expect(test_get("/winhttpapitest/metrics", &resp) ==
+                 http::status::ok);
+          expect(resp.headers["Content-Type"] == "text/plain; version=0.0.4");
+          expect(resp.body.find("winasio_http_request_duration_seconds_count{"
+                                "route=\"/hello\",verb=\"GET\",phase="
+                                "\"handler\"} 1\n") != std::string::npos);
+          // the metrics request itself.
+          expect(resp.body.find("winasio_http_in_flight_requests 1\n") !=
+                 std::string::npos);
+        });
+  };
+
+  // a record per request sent, whatever its status.
+  "controller_access_log"_test = [] {
+    auto dir = std::filesystem::temp_directory_path() /
+               "winasio_controller_access_log_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    winnet::http::access_log_options opts;
+    opts.file = dir / "access.log";
+    opts.flush_interval = 1ms;
+    winnet::http::access_log log(opts);
+
+    net::io_context io_context;
+    controller_test_helper(
+        io_context,
+        [&](winnet::http::controller &c) {
+          c.set_access_log(log);
+          c.get(L"/hello",
+                [](winnet::http::controller::request_context &) {});
+        },
+        [&](winnet::http::controller &) {
+          expect(test_get("/winhttpapitest/hello") == http::status::ok);
+          expect(test_get("/winhttpapitest/none") ==
+                 http::status::not_found);
+          expect(wait_for([&] { return 2u == log.written(); }));
+        });
+    log.stop();
+
+    std::ifstream in(opts.file);
+    std::string first;
+    std::string second;
+    std::getline(in, first);
+    std::getline(in, second);
+    expect(first.find(" GET /winhttpapitest/hello 200 ") != std::string::npos);
+    expect(second.find(" GET /winhttpapitest/none 404 ") != std::string::npos);
+    in.close();
+    std::filesystem::remove_all(dir);
+  };
+
+  // the deadline cancels the request while the handler runs.
+  "controller_request_timeout"_test = [] {
+    net::io_context io_context;
+    winnet::deadline_wheel wheel(io_context.get_executor(), 10ms);
+    winnet::http::offload_pool pool(1);
+    controller_test_helper(
+        io_context,
+        [&](winnet::http::controller &c) {
+          c.set_request_timeout(wheel, 100ms);
+          c.set_offload_pool(pool);
+          c.get(
+              L"/slow",
+              [](winnet::http::controller::request_context &) {
+                std::this_thread::sleep_for(500ms);
+              },
+              winnet::http::handler_execution::offload);
+        },
+        [](winnet::http::controller &c) {
+          test_request req;
+          test_response resp;
+          req.target_ = "/winhttpapitest/slow";
+          bool failed = false;
+          try {
+            failed = make_test_request(req, resp).failed();
+          } catch (const boost::system::system_error &) {
+            // the connection is reset.
+            failed = true;
+          }
+          expect(failed);
+          expect(1 == c.get_metrics().timeouts.value());
+          expect(wait_for(
+              [&] { return 0 == c.get_metrics().in_flight.value(); }));
+        });
+  };
 };
 
 int main() {}
\ No newline at end of file
@@ -12,7 +12,15 @@
 
 #include "named_pipe/echoserver.hpp"
 
+#include "boost/winasio/io_runtime.hpp"
+
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+
+#include <algorithm>
+#include <memory>
 #include <semaphore>
+#include <string>
 
 template <typename Server> void test_server() {
   auto server_count = 2; // std::thread::hardware_concurrency() * 2;
@@ -88,6 +96,106 @@ boost::ut::suite errors = [] {
   "movable_server"_test = [] { test_server<server_movable>(); };
 
   "nonmovable_server"_test = [] { test_server<server>(); };
+
+  // a server per context of a runtime, listening on the same pipe name.
+  "runtime_server"_test = [] {
+    winnet::io_runtime_options options;
+    options.contexts = 4;
+    winnet::io_runtime rt(options);
+    std::vector<std::unique_ptr<server_movable>> servers(rt.size());
+    rt.for_each([&](std::size_t i, net::io_context &ioc) {
+      servers[i] =
+          std::make_unique<server_movable>(ioc, "\\\\.\\pipe\\mynamedpipe");
+    });
+
+    std::vector<std::thread> client_threads;
+    for (int n = 0; n < 8; ++n) {
+      client_threads.emplace_back([n] {
+        std::string myMessage = "runtime" + std::to_string(n);
+        std::string replyMsg;
+        boost::system::error_code ec = make_client_call(myMessage, replyMsg);
+        expect(!ec.failed()) << myMessage + " failed: " + ec.message();
+        expect(myMessage == replyMsg);
+      });
+    }
+    for (auto &thread : client_threads) {
+      thread.join();
+    }
+    rt.stop();
+    rt.join();
+  };
+
+  // reads smaller than a message, and across messages.
+  "read_ahead"_test = [] {
+    net::io_context io_context;
+    typedef winnet::named_pipe_protocol<net::io_context::executor_type>
+        protocol;
+    const std::string name = "\\\\.\\pipe\\readaheadpipe";
+    protocol::pipe server(io_context);
+    server.set_read_ahead(4096);
+    expect(4096u == server.read_ahead());
+    boost::system::error_code ec;
+    server.server_create(ec, name);
+    expect(!ec) << ec.message();
+    bool connected = false;
+    server.async_server_connect(
+        [&](boost::system::error_code e) { connected = !e; });
+    protocol::pipe client(io_context);
+    client.connect(name, ec);
+    expect(!ec) << ec.message();
+    io_context.run();
+    io_context.restart();
+    expect(connected);
+
+    for (std::string m : {"hello", "named", "pipe", "async"}) {
+      net::write(client, net::buffer(m), ec);
+      expect(!ec) << ec.message();
+    }
+    std::string got(14, '\0');
+    std::size_t total = 0;
+    while (total < got.size() && !ec) {
+      total += net::read(
+          server,
+          net::buffer(&got[total], (std::min)(got.size() - total,
+                                              std::size_t(3))),
+          ec);
+    }
+    expect(!ec) << ec.message();
+    expect(got == "hellonamedpipe");
+
+    char tail[5] = {};
+    std::size_t tail_len = 0;
+    net::async_read(server, net::buffer(tail),
+                    [&](boost::system::error_code e, std::size_t n) {
+                      ec = e;
+                      tail_len = n;
+                    });
+    io_context.run();
+    expect(!ec) << ec.message();
+    expect(std::string(tail, tail_len) == "async");
+  };
+
+  // an accept without a client is cancelled through its slot.
+  "cancel_accept"_test = [] {
+    net::io_context io_context;
+    typedef winnet::named_pipe_protocol<net::io_context::executor_type>
+        protocol;
+    protocol::acceptor acceptor(io_context, "\\\\.\\pipe\\cancelpipe");
+    net::cancellation_signal signal;
+    boost::system::error_code result;
+    bool done = false;
+    acceptor.async_accept(net::bind_cancellation_slot(
+        signal.slot(),
+        [&](boost::system::error_code ec, protocol::pipe) {
+          result = ec;
+          done = true;
+        }));
+    net::post(io_context,
+              [&] { signal.emit(net::cancellation_type::terminal); });
+    io_context.run();
+    expect(done);
+    expect(result == net::error::operation_aborted) << result.message();
+  };
 };
 
 int main() {}
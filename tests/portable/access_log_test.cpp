@@ -0,0 +1,160 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/http/http_access_log.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace winnet = boost::winasio;
+
+winnet::http::access_log_record test_record() {
+  winnet::http::access_log_record r;
+  r.time = std::chrono::system_clock::time_point(1700000000123ms);
+  r.family = 4;
+  r.address = {127, 0, 0, 1};
+  r.port = 5000;
+  r.verb = "GET";
+  r.set_path("/url-123?x=1");
+  r.status = 200;
+  r.request_bytes = 3;
+  r.response_bytes = 11;
+  r.latency = 1500us;
+  return r;
+}
+
+std::filesystem::path test_dir(const char *name) {
+  auto dir = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+int main() {
+  using namespace boost::ut;
+
+  "Format"_test = [] {
+    std::string line;
+    winnet::http::access_log::format(line, test_record());
+    expect(line == "2023-11-14T22:13:20.123Z 127.0.0.1:5000 GET "
+                   "/url-123?x=1 200 3 11 1.500ms");
+  };
+
+  "Rotate"_test = [] {
+    auto dir = test_dir("winasio_access_log_test");
+    winnet::http::access_log_options opts;
+    opts.file = dir / "access.log";
+    opts.ring_capacity = 8;
+    opts.max_file_size = 300;
+    opts.max_files = 2;
+    // only flush on stop.
+    opts.flush_interval = 1h;
+
+    winnet::http::access_log log(opts);
+    auto r = test_record();
+    for (int i = 0; i < 10; ++i) {
+      log.log(r);
+    }
+    // ring is full after 8 records.
+    expect(2u == log.dropped());
+    log.stop();
+    expect(8u == log.written());
+    // the records exceeded max_file_size and were rotated.
+    expect(std::filesystem::exists(dir / "access.1.log"));
+    expect(std::filesystem::file_size(dir / "access.log") <= 300u);
+    std::filesystem::remove_all(dir);
+  };
+
+  // the rings of exited threads are written, then dropped.
+  "Threads"_test = [] {
+    auto dir = test_dir("winasio_access_log_threads_test");
+    winnet::http::access_log_options opts;
+    opts.file = dir / "access.log";
+    opts.ring_capacity = 64;
+    opts.flush_interval = 1ms;
+    winnet::http::access_log log(opts);
+    auto r = test_record();
+    for (int round = 0; round < 20; ++round) {
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+          for (int i = 0; i < 50; ++i) {
+            log.log(r);
+          }
+        });
+      }
+      for (auto &t : threads) {
+        t.join();
+      }
+    }
+    log.stop();
+    expect(4000u == log.written() + log.dropped());
+    std::filesystem::remove_all(dir);
+  };
+
+  // records logged after stop are dropped, by threads that logged before
+  // and by new ones.
+  "AfterStop"_test = [] {
+    auto dir = test_dir("winasio_access_log_stop_test");
+    winnet::http::access_log_options opts;
+    opts.file = dir / "access.log";
+    winnet::http::access_log log(opts);
+    auto r = test_record();
+    expect(log.log(r));
+    log.stop();
+    expect(1u == log.written());
+    expect(!log.log(r));
+    std::thread([&] { expect(!log.log(r)); }).join();
+    expect(2u == log.dropped());
+    expect(1u == log.written());
+    std::filesystem::remove_all(dir);
+  };
+
+  // every record logged while stopping is written or dropped.
+  "StopRace"_test = [] {
+    auto dir = test_dir("winasio_access_log_stop_race_test");
+    for (int round = 0; round < 20; ++round) {
+      winnet::http::access_log_options opts;
+      opts.file = dir / "access.log";
+      opts.ring_capacity = 64;
+      opts.flush_interval = 1ms;
+      winnet::http::access_log log(opts);
+      auto r = test_record();
+      std::atomic<std::uint64_t> logged = 0;
+      std::atomic<bool> go = false;
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+          while (!go) {
+            std::this_thread::yield();
+          }
+          for (int i = 0; i < 2000; ++i) {
+            log.log(r);
+            ++logged;
+          }
+        });
+      }
+      go = true;
+      std::this_thread::sleep_for(std::chrono::microseconds(round * 50));
+      log.stop();
+      for (auto &t : threads) {
+        t.join();
+      }
+      expect(logged.load() == log.written() + log.dropped());
+    }
+    std::filesystem::remove_all(dir);
+  };
+}
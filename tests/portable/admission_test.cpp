@@ -0,0 +1,62 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/http/http_admission.hpp"
+
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+namespace winnet = boost::winasio;
+
+int main() {
+  using namespace boost::ut;
+
+  "AdmissionControl"_test = [] {
+    using winnet::http::admission_clock;
+    using winnet::http::admission_result;
+    winnet::http::admission_control ac;
+    winnet::http::admission_options opts;
+    opts.max_in_flight = 2;
+    opts.max_queue_time = 10ms;
+    ac.set_options(opts);
+
+    winnet::http::route_admission route;
+    winnet::http::route_limits limits;
+    limits.rate = 10; // one token every 100ms
+    limits.burst = 1;
+    route.set_limits(limits);
+
+    auto now = admission_clock::now();
+    expect(ac.admit(&route, now) == admission_result::admitted);
+    // bucket is empty until 100ms later.
+    expect(ac.admit(&route, now + 50ms) == admission_result::rate_limited);
+    expect(ac.admit(nullptr, now) == admission_result::admitted);
+    // global limit reached.
+    expect(ac.admit(nullptr, now) == admission_result::global_limit);
+    expect(2u == ac.in_flight());
+    ac.release(&route);
+    expect(ac.admit(&route, now + 100ms) == admission_result::admitted);
+
+    expect(ac.check_queue_time(now, now + 5ms) == admission_result::admitted);
+    expect(ac.check_queue_time(now, now + 20ms) ==
+           admission_result::queue_timeout);
+    expect(3u == ac.shed_count());
+
+    // a request shed by the route limit does not spend a rate token.
+    winnet::http::route_admission single;
+    limits.max_in_flight = 1;
+    single.set_limits(limits);
+    winnet::http::admission_control ac2;
+    expect(ac2.admit(&single, now) == admission_result::admitted);
+    expect(ac2.admit(&single, now + 100ms) == admission_result::route_limit);
+    ac2.release(&single);
+    expect(ac2.admit(&single, now + 100ms) == admission_result::admitted);
+  };
+}
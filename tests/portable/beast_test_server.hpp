@@ -15,17 +15,23 @@
 
 #include <boost/asio.hpp>
 
+#ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable : 4702)
+#endif // _MSC_VER
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
+#ifdef _MSC_VER
 #pragma warning(pop)
+#endif // _MSC_VER
 
+#include "boost/winasio/deadline_wheel.hpp"
 // #include "boost/winasio/named_pipe/named_pipe_protocol.hpp"
 
 #include <chrono>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iostream>
 #include <memory>
@@ -57,16 +63,25 @@ std::size_t request_count() {
 void set_request_count(std::size_t x) { count = x; }
 
 std::time_t now() { return std::time(0); }
+
+// ETag version of /cached/ responses, and the requests they got.
+std::atomic<std::size_t> cache_version = 1;
+std::atomic<std::size_t> cache_requests = 0;
 } // namespace my_program_state
 
 class http_connection : public std::enable_shared_from_this<http_connection> {
 public:
-  http_connection(mysocket socket) : socket_(std::move(socket)) {}
+  http_connection(mysocket socket, winnet::deadline_wheel &wheel)
+      : socket_(std::move(socket)), deadline_(wheel, [this] {
+          // Close socket to cancel any outstanding operation.
+          beast::error_code ec;
+          socket_.close(ec);
+        }) {}
 
   // Initiate the asynchronous operations associated with the connection.
   void start() {
+    deadline_.expires_after(std::chrono::seconds(60));
     read_request();
-    check_deadline();
   }
 
 private:
@@ -82,8 +97,9 @@ private:
   // The response message.
   http::response<http::dynamic_body> response_;
 
-  // The timer for putting a deadline on connection processing.
-  net::steady_timer deadline_{socket_.get_executor(), std::chrono::seconds(60)};
+  // The deadline on connection processing. The connections share the timer
+  // of the wheel, the deadline is cancelled when the connection is gone.
+  winnet::deadline deadline_;
 
   // Asynchronously receive a complete request message.
   void read_request() {
@@ -155,7 +171,7 @@ private:
     std::size_t x = {};
     try {
       x = std::stoi(num);
-    } catch (std::exception) {
+    } catch (const std::exception &) {
       f();
       return;
     }
@@ -209,6 +225,30 @@ private:
           << " seconds since the epoch.</p>\n"
           << "</body>\n"
           << "</html>\n";
+    } else if (request_.target().starts_with("/cached/")) {
+      // the rest of the target is the Cache-Control of the response.
+      ++my_program_state::cache_requests;
+      std::string etag =
+          "\"v" + std::to_string(my_program_state::cache_version) + "\"";
+      response_.set(http::field::cache_control,
+                    request_.target().substr(std::strlen("/cached/")));
+      response_.set(http::field::etag, etag);
+      response_.set(http::field::last_modified,
+                    "Mon, 01 Jan 2024 00:00:00 GMT");
+      if (request_[http::field::if_none_match] == etag) {
+        response_.result(http::status::not_modified);
+      } else {
+        response_.set(http::field::content_type, "text/plain");
+        beast::ostream(response_.body()) << "cached " << etag;
+      }
+    } else if (request_.target().starts_with("/bytes/") ||
+               request_.target().starts_with("/chunked/")) {
+      // n bytes of body, with content length or chunked.
+      std::string target(request_.target().data(), request_.target().size());
+      std::size_t n = std::stoul(target.substr(target.find('/', 1) + 1));
+      response_.set(http::field::content_type, "application/octet-stream");
+      beast::ostream(response_.body()) << std::string(n, 'x');
+      response_.chunked(target.starts_with("/chunked/"));
     } else {
       response_.result(http::status::not_found);
       response_.set(http::field::content_type, "text/plain");
@@ -221,7 +261,10 @@ private:
     spdlog::debug("Beast: Start to write response");
     auto self = shared_from_this();
 
-    response_.content_length(response_.body().size());
+    if (!response_.chunked() &&
+        response_.result() != http::status::not_modified) {
+      response_.content_length(response_.body().size());
+    }
 
     http::async_write(socket_, response_,
                       [self](beast::error_code ec, std::size_t) {
@@ -233,25 +276,15 @@ private:
                       });
   }
 
-  // Check whether we have spent enough time on this connection.
-  void check_deadline() {
-    auto self = shared_from_this();
-
-    deadline_.async_wait([self](beast::error_code ec) {
-      if (!ec) {
-        // Close socket to cancel any outstanding operation.
-        self->socket_.close(ec);
-      }
-    });
-  }
 };
 
 // "Loop" forever accepting new connections.
-void http_server(myacceptor &acceptor, mysocket &socket) {
+void http_server(myacceptor &acceptor, mysocket &socket,
+                 winnet::deadline_wheel &wheel) {
   acceptor.async_accept(socket, [&](beast::error_code ec) {
     if (!ec)
-      std::make_shared<http_connection>(std::move(socket))->start();
-    http_server(acceptor, socket);
+      std::make_shared<http_connection>(std::move(socket), wheel)->start();
+    http_server(acceptor, socket, wheel);
   });
 }
 
@@ -277,8 +310,10 @@ void http_server(myacceptor &acceptor, mysocket &socket) {
 
 //     myacceptor acceptor(ioc, "\\\\.\\pipe\\mynamedpipe");
 
+//     winnet::deadline_wheel wheel(ioc.get_executor(),
+//                                  std::chrono::seconds(1));
 //     mysocket socket{ioc};
-//     http_server(acceptor, socket);
+//     http_server(acceptor, socket, wheel);
 
 //     ioc.run();
 //   } catch (std::exception const &e) {
@@ -0,0 +1,167 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Transport of basic_client_pool over beast, and the beast test server on
+// port 12345, so that the pooled client runs without winhttp.
+
+#include "boost/winasio/winhttp/client_pool.hpp"
+
+#include "beast_test_server.hpp"
+
+#include <latch>
+#include <memory>
+#include <string>
+#include <thread>
+#include <tuple>
+
+namespace winhttp = winnet::winhttp;
+
+class beast_server {
+public:
+  beast_server() : lch_(1), ioc_(1), th_() {
+    my_program_state::set_request_count(0);
+    th_ = std::jthread([this]() {
+      unsigned short port = static_cast<unsigned short>(12345);
+      myacceptor acceptor{ioc_, {tcp::v4(), port}};
+      // destroyed before the connections left in ioc_.
+      winnet::deadline_wheel wheel(ioc_.get_executor(),
+                                   std::chrono::seconds(1));
+      mysocket socket{ioc_};
+      http_server(acceptor, socket, wheel);
+      lch_.count_down();
+      ioc_.run();
+    });
+    lch_.wait();
+  }
+
+  ~beast_server() { ioc_.stop(); }
+
+private:
+  std::latch lch_;
+  net::io_context ioc_;
+  std::jthread th_;
+};
+
+std::string narrow(const std::wstring &s) {
+  return std::string(s.begin(), s.end());
+}
+
+// stand in of the winhttp transport. It ignores cancel signals. Request
+// headers are sent, and response headers returned raw.
+class beast_transport {
+public:
+  typedef net::io_context::executor_type executor_type;
+  struct connection_type {
+    tcp::endpoint endpoint;
+  };
+
+  explicit beast_transport(const executor_type &ex) : ex_(ex) {}
+
+  std::unique_ptr<connection_type> connect(const winhttp::host_key &key,
+                                           boost::system::error_code &ec) {
+    ++connects;
+    if (key.port == 0) {
+      ec = net::error::host_not_found;
+      return nullptr;
+    }
+    tcp::resolver r(ex_);
+    auto results = r.resolve(narrow(key.host), std::to_string(key.port), ec);
+    if (ec) {
+      return nullptr;
+    }
+    return std::make_unique<connection_type>(
+        connection_type{results.begin()->endpoint()});
+  }
+
+  template <typename Handler>
+  void async_exec(connection_type &c, const winhttp::client_request &req,
+                  std::shared_ptr<winhttp::cancel_signal>, Handler &&handler) {
+    max_in_flight = std::max(max_in_flight, ++in_flight);
+    // start the coroutine before the handler, which owns req, is moved.
+    auto op = exec(c.endpoint, req);
+    net::co_spawn(ex_, std::move(op),
+                  [this, h = std::move(handler)](
+                      std::exception_ptr,
+                      std::tuple<boost::system::error_code,
+                                 winhttp::client_response>
+                          r) mutable {
+                    --in_flight;
+                    std::move(h)(std::get<0>(r), std::move(std::get<1>(r)));
+                  });
+  }
+
+  int connects = 0;
+  int in_flight = 0;
+  int max_in_flight = 0;
+
+private:
+  static net::awaitable<
+      std::tuple<boost::system::error_code, winhttp::client_response>>
+  exec(tcp::endpoint ep, winhttp::client_request req) {
+    boost::system::error_code ec;
+    tcp::socket s(co_await net::this_coro::executor);
+    co_await s.async_connect(ep, net::redirect_error(net::use_awaitable, ec));
+    if (ec) {
+      co_return std::make_tuple(ec, winhttp::client_response{});
+    }
+    http::request<http::string_body> hreq{
+        http::string_to_verb(narrow(req.method)), narrow(req.target), 11};
+    hreq.set(http::field::host, "localhost");
+    // additional headers, crlf separated.
+    std::string extra = narrow(req.headers);
+    for (std::size_t pos = 0; pos < extra.size();) {
+      std::size_t eol = extra.find("\r\n", pos);
+      if (eol == std::string::npos) {
+        eol = extra.size();
+      }
+      std::string line = extra.substr(pos, eol - pos);
+      std::size_t colon = line.find(':');
+      if (colon != std::string::npos) {
+        std::size_t v = line.find_first_not_of(' ', colon + 1);
+        hreq.set(line.substr(0, colon),
+                 v == std::string::npos ? "" : line.substr(v));
+      }
+      pos = eol + 2;
+    }
+    if (req.body) {
+      hreq.body() = *req.body;
+    }
+    hreq.prepare_payload();
+    co_await http::async_write(s, hreq,
+                               net::redirect_error(net::use_awaitable, ec));
+    if (ec) {
+      co_return std::make_tuple(ec, winhttp::client_response{});
+    }
+    beast::flat_buffer b;
+    http::response<http::string_body> hresp;
+    co_await http::async_read(s, b, hresp,
+                              net::redirect_error(net::use_awaitable, ec));
+    winhttp::client_response resp;
+    resp.status = hresp.result_int();
+    // raw headers like WINHTTP_QUERY_RAW_HEADERS_CRLF.
+    std::string raw = "HTTP/1.1 " + std::to_string(hresp.result_int()) + " " +
+                      std::string(hresp.reason()) + "\r\n";
+    for (const auto &f : hresp) {
+      raw += std::string(f.name_string()) + ": " + std::string(f.value()) +
+             "\r\n";
+    }
+    raw += "\r\n";
+    resp.headers.assign(raw.begin(), raw.end());
+    if (req.body_buffer) {
+      req.body_buffer->assign(hresp.body());
+      resp.body = winhttp::borrowed_body(req.body_buffer);
+    } else {
+      resp.body =
+          std::make_shared<const std::string>(std::move(hresp.body()));
+    }
+    co_return std::make_tuple(ec, std::move(resp));
+  }
+
+  executor_type ex_;
+};
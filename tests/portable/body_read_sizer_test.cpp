@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/winhttp/body_read_sizer.hpp"
+
+#include <cstdint>
+
+namespace winnet = boost::winasio;
+
+int main() {
+  using namespace boost::ut;
+
+  "BodyReadSizer"_test = [] {
+    using winnet::winhttp::details::body_read_sizer;
+    // known length is read at once, then a read returns 0.
+    body_read_sizer known(std::uint64_t{100000});
+    expect(100000u == known.next());
+    known.consumed(100000, 60000);
+    expect(40000u == known.next());
+    known.consumed(40000, 40000);
+    expect(1u == known.next());
+
+    // a large length is not allocated at once, reads grow toward it.
+    const std::uint64_t large = 10 * body_read_sizer::max_read + 7;
+    body_read_sizer big(large);
+    expect(body_read_sizer::max_read == big.next());
+    // the server sends less than asked, no growth.
+    big.consumed(big.next(), 100);
+    expect(body_read_sizer::max_read == big.next());
+    std::uint64_t left = large - 100;
+    std::size_t reads = 0;
+    while (left != 0) {
+      std::size_t n = big.next();
+      expect(n <= left);
+      big.consumed(n, n);
+      left -= n;
+      ++reads;
+    }
+    // 1MB, 2MB, 4MB, then the rest.
+    expect(4u == reads);
+    expect(1u == big.next());
+
+    // unknown length grows while reads fill the buffer.
+    body_read_sizer unknown;
+    expect(body_read_sizer::initial_read == unknown.next());
+    unknown.consumed(unknown.next(), body_read_sizer::initial_read);
+    expect(2 * body_read_sizer::initial_read == unknown.next());
+    unknown.consumed(unknown.next(), 100);
+    expect(2 * body_read_sizer::initial_read == unknown.next());
+    for (int i = 0; i < 20; ++i) {
+      unknown.consumed(unknown.next(), unknown.next());
+    }
+    expect(body_read_sizer::max_read == unknown.next());
+
+    // server sends more than content length.
+    body_read_sizer wrong(std::uint64_t{0});
+    expect(1u == wrong.next());
+    wrong.consumed(1, 1);
+    expect(body_read_sizer::initial_read == wrong.next());
+  };
+}
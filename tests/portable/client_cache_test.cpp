@@ -0,0 +1,272 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Response cache of the pooled client, against the /cached/ route of the
+// beast test server.
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/winhttp/client_cache.hpp"
+#include "boost/winasio/winhttp/client_pool.hpp"
+
+#include "beast_transport.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+typedef winhttp::basic_client_pool<beast_transport> test_pool;
+
+using namespace std::chrono_literals;
+
+// runs one GET on the pool and returns its response.
+winhttp::client_response get(net::io_context &ioc, test_pool &pool,
+                             const std::wstring &target) {
+  winhttp::host_key key{false, L"localhost", 12345};
+  winhttp::client_request req;
+  req.method = L"GET";
+  req.target = target;
+  winhttp::client_response out;
+  bool done = false;
+  pool.async_request(key, std::move(req),
+                     [&](boost::system::error_code ec,
+                         winhttp::client_response resp) {
+                       boost::ut::expect(!ec.failed()) << ec.message();
+                       out = std::move(resp);
+                       done = true;
+                     });
+  // a hit is posted, not completed inline.
+  boost::ut::expect(!done);
+  ioc.restart();
+  ioc.run();
+  boost::ut::expect(done);
+  return out;
+}
+
+int main() {
+  using namespace boost::ut;
+
+  "CacheControl"_test = [] {
+    auto cc = winhttp::parse_cache_control(
+        L"public, Max-Age=60 ,stale-while-revalidate=\"30\", must-revalidate");
+    expect(cc.max_age == 60s);
+    expect(cc.stale_while_revalidate == 30s);
+    expect(cc.must_revalidate);
+    expect(!cc.no_store && !cc.no_cache);
+
+    cc = winhttp::parse_cache_control(L"no-store,no-cache,max-age=x");
+    expect(cc.no_store && cc.no_cache);
+    expect(!cc.max_age.has_value());
+
+    cc = winhttp::parse_cache_control(L"max-age=99999999999");
+    expect(cc.max_age == std::chrono::seconds(0x80000000));
+  };
+
+  "Lru"_test = [] {
+    auto entry = [](std::size_t body) {
+      winhttp::client_response r;
+      r.status = 200;
+      r.headers = L"HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\n\r\n";
+      r.body = std::make_shared<const std::string>(body, 'x');
+      return std::make_shared<winhttp::cache_entry>(
+          std::move(r), winhttp::cache_entry::clock::now());
+    };
+    // one shard, room for about three entries.
+    winhttp::response_cache cache(3 * entry(1000)->cost() + 500, 1);
+    cache.store(L"a", entry(1000));
+    cache.store(L"b", entry(1000));
+    cache.store(L"c", entry(1000));
+    expect(3u == cache.size());
+    // a is used, so b is the least recent.
+    expect(cache.find(L"a") != nullptr);
+    cache.store(L"d", entry(1000));
+    expect(3u == cache.size());
+    expect(cache.find(L"b") == nullptr);
+    expect(cache.find(L"a") != nullptr);
+    expect(1u == cache.stats().evictions);
+
+    // replaced, not duplicated.
+    cache.store(L"a", entry(10));
+    expect(3u == cache.size());
+    expect(10u == cache.find(L"a")->response.body->size());
+
+    // larger than the shard.
+    cache.store(L"e", entry(100000));
+    expect(cache.find(L"e") == nullptr);
+    expect(cache.bytes() <= 3 * entry(1000)->cost() + 500);
+
+    cache.clear();
+    expect(0u == cache.size() && 0u == cache.bytes());
+
+    // many shards.
+    winhttp::response_cache sharded(1 << 20);
+    for (int i = 0; i < 100; ++i) {
+      sharded.store(std::to_wstring(i), entry(100));
+    }
+    expect(100u == sharded.size());
+  };
+
+  "FreshHit"_test = [] {
+    beast_server bs;
+    my_program_state::cache_requests = 0;
+    net::io_context ioc;
+    test_pool pool(ioc.get_executor(), beast_transport(ioc.get_executor()),
+                   4);
+    auto cache = std::make_shared<winhttp::response_cache>(1 << 20);
+    pool.set_cache(cache);
+
+    auto r1 = get(ioc, pool, L"/cached/max-age=60");
+    auto r2 = get(ioc, pool, L"/cached/max-age=60");
+    expect(200u == r1.status && 200u == r2.status);
+    expect(1u == my_program_state::cache_requests);
+    // the body is shared, not copied.
+    expect((r1.body.get() == r2.body.get()) >> fatal);
+    expect(r2.body->starts_with("cached "));
+    expect(1u == cache->stats().hits);
+    expect(1u == cache->stats().misses);
+
+    // other targets are other entries.
+    get(ioc, pool, L"/cached/max-age=61");
+    expect(2u == my_program_state::cache_requests);
+    expect(2u == cache->size());
+  };
+
+  "Revalidate"_test = [] {
+    beast_server bs;
+    my_program_state::cache_requests = 0;
+    net::io_context ioc;
+    test_pool pool(ioc.get_executor(), beast_transport(ioc.get_executor()),
+                   4);
+    auto cache = std::make_shared<winhttp::response_cache>(1 << 20);
+    pool.set_cache(cache);
+
+    auto r1 = get(ioc, pool, L"/cached/max-age=1");
+    cache->advance(2s);
+    // stale, the server answers 304 to the conditional request.
+    auto r2 = get(ioc, pool, L"/cached/max-age=1");
+    expect(2u == my_program_state::cache_requests);
+    expect(200u == r2.status);
+    expect(r1.body.get() == r2.body.get());
+    expect(1u == cache->stats().not_modified);
+    // refreshed by the 304.
+    get(ioc, pool, L"/cached/max-age=1");
+    expect(2u == my_program_state::cache_requests);
+
+    // changed on the server.
+    ++my_program_state::cache_version;
+    cache->advance(2s);
+    auto r3 = get(ioc, pool, L"/cached/max-age=1");
+    expect(3u == my_program_state::cache_requests);
+    expect(*r3.body != *r1.body);
+    expect(1u == cache->stats().not_modified);
+
+    // no-cache revalidates every time.
+    get(ioc, pool, L"/cached/no-cache");
+    get(ioc, pool, L"/cached/no-cache");
+    expect(5u == my_program_state::cache_requests);
+    expect(2u == cache->stats().not_modified);
+  };
+
+  "NoStore"_test = [] {
+    beast_server bs;
+    my_program_state::cache_requests = 0;
+    net::io_context ioc;
+    test_pool pool(ioc.get_executor(), beast_transport(ioc.get_executor()),
+                   4);
+    auto cache = std::make_shared<winhttp::response_cache>(1 << 20);
+    pool.set_cache(cache);
+
+    get(ioc, pool, L"/cached/no-store,max-age=60");
+    get(ioc, pool, L"/cached/no-store,max-age=60");
+    expect(2u == my_program_state::cache_requests);
+    expect(0u == cache->size());
+
+    // not a GET, the cache is not consulted.
+    winhttp::host_key key{false, L"localhost", 12345};
+    winhttp::client_request req;
+    req.method = L"HEAD";
+    req.target = L"/cached/max-age=60";
+    pool.async_request(key, std::move(req),
+                       [](boost::system::error_code, winhttp::client_response) {
+                       });
+    ioc.restart();
+    ioc.run();
+    expect(2u == cache->stats().misses);
+    expect(0u == cache->size());
+  };
+
+  // responses that depend on the request are not mixed up.
+  "RequestKey"_test = [] {
+    using winhttp::response_cache;
+    winhttp::host_key key{false, L"localhost", 12345};
+    winhttp::client_request req;
+    req.method = L"GET";
+    req.target = L"/cached/max-age=60";
+    expect(response_cache::cacheable(req));
+    auto plain = response_cache::make_key(key, req);
+    req.decompress = true;
+    expect(response_cache::cacheable(req));
+    expect(plain != response_cache::make_key(key, req));
+    req.headers = L"Authorization: Bearer x";
+    expect(!response_cache::cacheable(req));
+  };
+
+  "StaleWhileRevalidate"_test = [] {
+    beast_server bs;
+    my_program_state::cache_requests = 0;
+    net::io_context ioc;
+    test_pool pool(ioc.get_executor(), beast_transport(ioc.get_executor()),
+                   4);
+    auto cache = std::make_shared<winhttp::response_cache>(1 << 20);
+    pool.set_cache(cache);
+    const std::wstring target = L"/cached/max-age=1,stale-while-revalidate=60";
+
+    auto r1 = get(ioc, pool, target);
+    ++my_program_state::cache_version;
+    cache->advance(2s);
+    // the stale response at once, the refresh runs in the background and
+    // finishes before run() returns.
+    auto r2 = get(ioc, pool, target);
+    expect(r1.body.get() == r2.body.get());
+    expect(2u == my_program_state::cache_requests);
+    expect(1u == cache->stats().stale_hits);
+
+    // the refreshed entry is fresh.
+    auto r3 = get(ioc, pool, target);
+    expect(2u == my_program_state::cache_requests);
+    expect(*r3.body != *r1.body);
+
+    // past stale-while-revalidate the request waits for the server.
+    cache->advance(100s);
+    get(ioc, pool, target);
+    expect(3u == my_program_state::cache_requests);
+    expect(1u == cache->stats().stale_hits);
+    expect(1u == cache->stats().not_modified);
+  };
+
+  // a failed background revalidation lets the next stale hit retry.
+  "FailedRevalidation"_test = [] {
+    my_program_state::cache_requests = 0;
+    net::io_context ioc;
+    test_pool pool(ioc.get_executor(), beast_transport(ioc.get_executor()),
+                   4);
+    auto cache = std::make_shared<winhttp::response_cache>(1 << 20);
+    pool.set_cache(cache);
+    const std::wstring target = L"/cached/max-age=1,stale-while-revalidate=60";
+    {
+      beast_server bs;
+      get(ioc, pool, target);
+    }
+    cache->advance(2s);
+    // the server is gone, each revalidation fails.
+    auto r1 = get(ioc, pool, target);
+    auto r2 = get(ioc, pool, target);
+    expect(r1.body.get() == r2.body.get());
+    expect(2u == cache->stats().stale_hits);
+    expect(2u == cache->stats().revalidations);
+  };
+}
@@ -0,0 +1,443 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Scheduling of the pooled client, with a beast transport so that it runs
+// without winhttp.
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/winhttp/client_pool.hpp"
+
+#include "beast_transport.hpp"
+
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <latch>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+typedef winhttp::basic_client_pool<beast_transport> test_pool;
+
+// completes attempt i after the delay of step i with its error, the last
+// step repeats. A cancelled attempt completes with operation_aborted.
+class scripted_transport {
+public:
+  typedef net::io_context::executor_type executor_type;
+  struct connection_type {};
+  struct step {
+    std::chrono::milliseconds delay;
+    boost::system::error_code ec;
+  };
+
+  scripted_transport(const executor_type &ex, std::vector<step> script)
+      : ex_(ex), script_(std::move(script)) {}
+
+  std::unique_ptr<connection_type> connect(const winhttp::host_key &,
+                                           boost::system::error_code &) {
+    return std::make_unique<connection_type>();
+  }
+
+  template <typename Handler>
+  void async_exec(connection_type &, const winhttp::client_request &,
+                  std::shared_ptr<winhttp::cancel_signal> cancel,
+                  Handler &&handler) {
+    step s = script_[std::min<std::size_t>(attempts++, script_.size() - 1)];
+    auto t = std::make_shared<net::steady_timer>(ex_, s.delay);
+    cancel->install(
+        [t, ex = ex_] { net::post(ex, [t] { t->cancel(); }); });
+    t->async_wait([this, t, s, h = std::move(handler)](
+                      boost::system::error_code ec) mutable {
+      if (ec) {
+        ++cancelled;
+        h(net::error::operation_aborted, winhttp::client_response{});
+        return;
+      }
+      winhttp::client_response resp;
+      resp.status = s.ec ? 0 : 200;
+      h(s.ec, std::move(resp));
+    });
+  }
+
+  int attempts = 0;
+  int cancelled = 0;
+
+private:
+  executor_type ex_;
+  std::vector<step> script_;
+};
+
+typedef winhttp::basic_client_pool<scripted_transport> scripted_pool;
+
+using namespace std::chrono_literals;
+typedef std::chrono::steady_clock test_clock;
+
+int main() {
+  using namespace boost::ut;
+
+  // the host of the key is the bare address, which the transport resolves.
+  "Ipv6Literal"_test = [] {
+    boost::system::error_code ec;
+    winhttp::wurl_view u = winhttp::parse_url(L"http://[::1]:12345/count", ec);
+    expect(!ec.failed());
+    winhttp::host_key key = winhttp::make_host_key(u);
+    expect(!key.secure);
+    expect(key.host == L"::1");
+    expect(12345 == key.port);
+
+    net::io_context ioc;
+    beast_transport transport(ioc.get_executor());
+    auto conn = transport.connect(key, ec);
+    expect(!ec.failed());
+    expect(conn != nullptr && conn->endpoint.address().is_v6() &&
+           conn->endpoint.address().is_loopback());
+  };
+
+  "PerHostLimit"_test = [] {
+    beast_server bs;
+    net::io_context ioc;
+    test_pool pool(ioc.get_executor(), beast_transport(ioc.get_executor()),
+                   2);
+    winhttp::host_key key{false, L"localhost", 12345};
+
+    int done = 0;
+    for (int i = 0; i < 8; ++i) {
+      pool.async_request(key, {L"GET", L"/count", L"", nullptr},
+                         [&done](boost::system::error_code ec,
+                                 winhttp::client_response resp) {
+                           expect(!ec.failed());
+                           expect(200u == resp.status);
+                           expect(resp.body != nullptr);
+                           ++done;
+                         });
+    }
+    // two requests got a slot, the rest wait in order.
+    expect(6u == pool.waiting(key));
+    ioc.run();
+    expect(8 == done);
+    expect(1u == pool.host_count());
+    expect(1 == pool.get_transport().connects);
+    expect(2 == pool.get_transport().max_in_flight);
+    expect(0u == pool.waiting(key));
+  };
+
+  "ConnectError"_test = [] {
+    net::io_context ioc;
+    test_pool pool(ioc.get_executor(), beast_transport(ioc.get_executor()),
+                   2);
+    bool called = false;
+    pool.async_request(
+        {false, L"localhost", 0}, {L"GET", L"/", L"", nullptr},
+        [&called](boost::system::error_code ec, winhttp::client_response) {
+          expect(ec == net::error::host_not_found);
+          called = true;
+        });
+    // never completes inside the initiating function.
+    expect(!called);
+    ioc.run();
+    expect(called);
+    expect(0u == pool.host_count());
+  };
+
+  "Coroutine"_test = [] {
+    beast_server bs;
+    net::io_context ioc;
+    test_pool pool(ioc.get_executor(), beast_transport(ioc.get_executor()),
+                   1);
+    winhttp::host_key key{false, L"localhost", 12345};
+    auto f = [&pool, key]() -> net::awaitable<void> {
+      boost::system::error_code ec;
+      winhttp::client_request post{
+          L"POST", L"/count", L"",
+          std::make_shared<const std::string>("set_count=5")};
+      winhttp::client_response resp = co_await pool.async_request(
+          key, post, net::redirect_error(net::use_awaitable, ec));
+      expect(!ec.failed());
+      expect(201u == resp.status);
+      winhttp::client_request get{L"GET", L"/count", L"", nullptr};
+      resp = co_await pool.async_request(
+          key, get, net::redirect_error(net::use_awaitable, ec));
+      expect(!ec.failed());
+      expect(200u == resp.status);
+      expect(resp.body->find("There have been 6 requests") !=
+             std::string::npos);
+    };
+    net::co_spawn(ioc, f, net::detached);
+    ioc.run();
+    expect(1 == pool.get_transport().connects);
+  };
+
+  "Hedge"_test = [] {
+    net::io_context ioc;
+    // the first attempt is stuck, the hedge is fast.
+    scripted_pool pool(ioc.get_executor(),
+                       scripted_transport(ioc.get_executor(),
+                                          {{2000ms, {}}, {10ms, {}}}),
+                       4);
+    winhttp::request_policy policy;
+    policy.max_attempts = 2;
+    policy.hedge = true;
+    policy.hedge_delay = 20ms;
+    boost::system::error_code result = net::error::fault;
+    auto start = test_clock::now();
+    pool.async_request(
+        {false, L"a", 80}, {L"GET", L"/", L"", nullptr}, policy,
+        [&result](boost::system::error_code ec, winhttp::client_response r) {
+          result = ec;
+          expect(200u == r.status);
+        });
+    ioc.run();
+    expect(!result.failed());
+    expect(test_clock::now() - start < 1000ms);
+    expect(2 == pool.get_transport().attempts);
+    // the loser is cancelled.
+    expect(1 == pool.get_transport().cancelled);
+    expect(1u == pool.latency({false, L"a", 80})->count());
+  };
+
+  "NoHedgeForPost"_test = [] {
+    net::io_context ioc;
+    scripted_pool pool(
+        ioc.get_executor(),
+        scripted_transport(ioc.get_executor(), {{100ms, {}}}), 4);
+    winhttp::request_policy policy;
+    policy.max_attempts = 2;
+    policy.hedge = true;
+    policy.hedge_delay = 10ms;
+    pool.async_request({false, L"a", 80}, {L"POST", L"/", L"", nullptr},
+                       policy,
+                       [](boost::system::error_code ec,
+                          winhttp::client_response) { expect(!ec.failed()); });
+    ioc.run();
+    expect(1 == pool.get_transport().attempts);
+  };
+
+  "AttemptTimeout"_test = [] {
+    net::io_context ioc;
+    scripted_pool pool(
+        ioc.get_executor(),
+        scripted_transport(ioc.get_executor(),
+                           {{2000ms, {}}, {10ms, {}}, {2000ms, {}}}),
+        4);
+    winhttp::request_policy policy;
+    policy.max_attempts = 2;
+    policy.attempt_timeout = 50ms;
+    boost::system::error_code result = net::error::fault;
+    pool.async_request({false, L"a", 80}, {L"GET", L"/", L"", nullptr},
+                       policy,
+                       [&result](boost::system::error_code ec,
+                                 winhttp::client_response) { result = ec; });
+    ioc.run();
+    expect(!result.failed());
+    expect(2 == pool.get_transport().attempts);
+    expect(1 == pool.get_transport().cancelled);
+
+    // a single attempt reports the timeout.
+    policy.max_attempts = 1;
+    pool.async_request({false, L"a", 80}, {L"GET", L"/", L"", nullptr},
+                       policy,
+                       [&result](boost::system::error_code ec,
+                                 winhttp::client_response) { result = ec; });
+    ioc.restart();
+    ioc.run();
+    expect(result == net::error::timed_out);
+  };
+
+  "RequestTimeout"_test = [] {
+    net::io_context ioc;
+    scripted_pool pool(
+        ioc.get_executor(),
+        scripted_transport(ioc.get_executor(), {{2000ms, {}}}), 4);
+    winhttp::request_policy policy;
+    policy.timeout = 50ms;
+    boost::system::error_code result;
+    auto start = test_clock::now();
+    pool.async_request({false, L"a", 80}, {L"GET", L"/", L"", nullptr},
+                       policy,
+                       [&result](boost::system::error_code ec,
+                                 winhttp::client_response) { result = ec; });
+    ioc.run();
+    expect(result == net::error::timed_out);
+    expect(test_clock::now() - start < 1000ms);
+    expect(1 == pool.get_transport().cancelled);
+  };
+
+  "HandlerCancellation"_test = [] {
+    net::io_context ioc;
+    scripted_pool pool(
+        ioc.get_executor(),
+        scripted_transport(ioc.get_executor(), {{2000ms, {}}}), 4);
+    net::cancellation_signal signal;
+    boost::system::error_code result;
+    auto start = test_clock::now();
+    pool.async_request({false, L"a", 80}, {L"GET", L"/", L"", nullptr},
+                       winhttp::request_policy{},
+                       net::bind_cancellation_slot(
+                           signal.slot(),
+                           [&result](boost::system::error_code ec,
+                                     winhttp::client_response) {
+                             result = ec;
+                           }));
+    net::steady_timer t(ioc, 10ms);
+    t.async_wait([&signal](boost::system::error_code) {
+      signal.emit(net::cancellation_type::terminal);
+    });
+    ioc.run();
+    expect(result == net::error::operation_aborted);
+    expect(test_clock::now() - start < 1000ms);
+    expect(1 == pool.get_transport().cancelled);
+
+    // the slot is left to the caller, a late emit does nothing.
+    signal.emit(net::cancellation_type::terminal);
+    ioc.restart();
+    expect(0u == ioc.run());
+    expect(1 == pool.get_transport().cancelled);
+  };
+
+  // the handler is not called while a cancelled attempt may still write
+  // into the body buffer.
+  "BodyBufferTimeout"_test = [] {
+    net::io_context ioc;
+    scripted_pool pool(
+        ioc.get_executor(),
+        scripted_transport(ioc.get_executor(), {{2000ms, {}}}), 4);
+    winhttp::request_policy policy;
+    policy.timeout = 50ms;
+    std::string body;
+    winhttp::client_request req{L"GET", L"/", L"", nullptr};
+    req.body_buffer = &body;
+    boost::system::error_code result;
+    int cancelled = -1;
+    pool.async_request({false, L"a", 80}, req, policy,
+                       [&](boost::system::error_code ec,
+                           winhttp::client_response) {
+                         result = ec;
+                         cancelled = pool.get_transport().cancelled;
+                       });
+    ioc.run();
+    expect(result == net::error::timed_out);
+    expect(1 == cancelled);
+  };
+
+  "RetryBudget"_test = [] {
+    net::io_context ioc;
+    // every attempt fails.
+    scripted_pool pool(
+        ioc.get_executor(),
+        scripted_transport(ioc.get_executor(),
+                           {{1ms, net::error::connection_reset}}),
+        4);
+    winhttp::request_policy policy;
+    policy.max_attempts = 5;
+    int failed = 0;
+    for (int i = 0; i < 50; ++i) {
+      pool.async_request({false, L"a", 80}, {L"GET", L"/", L"", nullptr},
+                         policy,
+                         [&failed](boost::system::error_code ec,
+                                   winhttp::client_response) {
+                           expect(ec == net::error::connection_reset);
+                           ++failed;
+                         });
+    }
+    ioc.run();
+    expect(50 == failed);
+    // without a budget this would be 250 attempts.
+    int attempts = pool.get_transport().attempts;
+    expect(attempts >= 50 && attempts <= 50 + 10 + 5) << attempts;
+    expect(pool.get_budget().balance() < 1);
+  };
+
+  "BatchCollectAll"_test = [] {
+    beast_server bs;
+    net::io_context ioc;
+    test_pool pool(ioc.get_executor(), beast_transport(ioc.get_executor()),
+                   8);
+    // preallocated bodies.
+    std::vector<std::string> bodies(20);
+    std::vector<winhttp::batch_item> items;
+    for (auto &b : bodies) {
+      b.reserve(4096);
+      winhttp::client_request req{L"GET", L"/count", L"", nullptr};
+      req.body_buffer = &b;
+      items.push_back({{false, L"localhost", 12345}, req});
+    }
+    bool called = false;
+    pool.async_exec_all(
+        std::move(items), 3, winhttp::batch_mode::collect_all,
+        [&](boost::system::error_code ec,
+            std::vector<winhttp::batch_result> results) {
+          called = true;
+          expect(!ec.failed());
+          expect((20u == results.size()) >> fatal);
+          for (std::size_t i = 0; i < results.size(); ++i) {
+            expect(!results[i].ec.failed());
+            expect(200u == results[i].response.status);
+            expect(results[i].response.body.get() == &bodies[i]);
+            expect(bodies[i].find("There have been") != std::string::npos);
+          }
+        });
+    expect(!called);
+    ioc.run();
+    expect(called);
+    expect(3 == pool.get_transport().max_in_flight);
+  };
+
+  "BatchErrors"_test = [] {
+    net::io_context ioc;
+    // the second attempt fails early, the others are slow.
+    scripted_pool pool(
+        ioc.get_executor(),
+        scripted_transport(ioc.get_executor(),
+                           {{200ms, {}},
+                            {5ms, net::error::connection_reset},
+                            {10ms, {}}}),
+        8);
+    std::vector<winhttp::batch_item> items(
+        6, {{false, L"a", 80}, {L"GET", L"/", L"", nullptr}});
+    std::vector<winhttp::batch_result> got;
+    boost::system::error_code result;
+    auto collect = [&](boost::system::error_code ec,
+                       std::vector<winhttp::batch_result> r) {
+      result = ec;
+      got = std::move(r);
+    };
+
+    pool.async_exec_all(items, 2, winhttp::batch_mode::fail_fast, collect);
+    ioc.run();
+    expect(result == net::error::connection_reset);
+    expect((6u == got.size()) >> fatal);
+    // the first was cancelled in flight, the rest never started.
+    expect(got[0].ec == net::error::operation_aborted);
+    expect(got[1].ec == net::error::connection_reset);
+    for (std::size_t i = 2; i < got.size(); ++i) {
+      expect(got[i].ec == net::error::operation_aborted);
+    }
+    expect(2 == pool.get_transport().attempts);
+    expect(1 == pool.get_transport().cancelled);
+
+    // the script continues with fast successes.
+    items.push_back({{false, L"b", 80}, {L"GET", L"/", L"", nullptr}});
+    pool.async_exec_all(items, 4, winhttp::batch_mode::collect_all, collect);
+    ioc.restart();
+    ioc.run();
+    expect(!result.failed());
+    expect((7u == got.size()) >> fatal);
+    for (auto &r : got) {
+      expect(!r.ec.failed() && 200u == r.response.status);
+    }
+
+    // an empty batch completes too.
+    got.resize(1);
+    pool.async_exec_all({}, 4, winhttp::batch_mode::fail_fast, collect);
+    ioc.restart();
+    ioc.run();
+    expect(got.empty());
+  };
+}
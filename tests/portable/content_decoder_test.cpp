@@ -0,0 +1,294 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Streaming body decoding with synthetic gzip and deflate streams, fed by a
+// fake source in chunks of various sizes.
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/winhttp/content_decoder.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace net = boost::asio;
+namespace winhttp = boost::winasio::winhttp;
+
+// a body delivered in the given chunks, then a read of 0 bytes.
+class chunk_source {
+public:
+  typedef net::io_context::executor_type executor_type;
+
+  chunk_source(net::io_context &ioc, std::vector<std::string> chunks)
+      : ex_(ioc.get_executor()), chunks_(std::move(chunks)), offset_(0),
+        reads(0) {}
+
+  // one body split every n bytes.
+  chunk_source(net::io_context &ioc, const std::string &body, std::size_t n)
+      : chunk_source(ioc, split(body, n)) {}
+
+  executor_type get_executor() { return ex_; }
+
+  template <typename Token>
+  auto async_read_some(net::mutable_buffer b, Token &&token) {
+    return net::async_initiate<Token, void(boost::system::error_code,
+                                           std::size_t)>(
+        [this, b](auto handler) {
+          std::size_t n = 0;
+          if (!chunks_.empty()) {
+            std::string &c = chunks_.front();
+            n = (std::min)(b.size(), c.size() - offset_);
+            std::copy_n(c.data() + offset_, n, static_cast<char *>(b.data()));
+            offset_ += n;
+            if (offset_ == c.size()) {
+              chunks_.erase(chunks_.begin());
+              offset_ = 0;
+            }
+          }
+          ++reads;
+          net::post(ex_, [h = std::move(handler), n]() mutable {
+            h(boost::system::error_code(), n);
+          });
+        },
+        token);
+  }
+
+private:
+  static std::vector<std::string> split(const std::string &body,
+                                        std::size_t n) {
+    std::vector<std::string> chunks;
+    for (std::size_t i = 0; i < body.size(); i += n) {
+      chunks.push_back(body.substr(i, n));
+    }
+    return chunks;
+  }
+
+  executor_type ex_;
+  std::vector<std::string> chunks_;
+  std::size_t offset_;
+
+public:
+  int reads;
+};
+
+// window bits of deflateInit2: 16 + 15 gzip, 15 zlib, -15 raw deflate.
+std::string compress(const std::vector<std::string> &parts, int bits,
+                     std::vector<std::string> *flushed = nullptr) {
+  z_stream z{};
+  deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, bits, 8,
+               Z_DEFAULT_STRATEGY);
+  std::string out;
+  for (std::size_t i = 0; i < parts.size(); ++i) {
+    bool last = i + 1 == parts.size();
+    z.next_in = (Bytef *)parts[i].data();
+    z.avail_in = static_cast<uInt>(parts[i].size());
+    std::string chunk;
+    int ret;
+    do {
+      char buf[4096];
+      z.next_out = (Bytef *)buf;
+      z.avail_out = sizeof(buf);
+      ret = deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+      chunk.append(buf, sizeof(buf) - z.avail_out);
+    } while (z.avail_out == 0 || (last && ret != Z_STREAM_END));
+    if (flushed) {
+      flushed->push_back(chunk);
+    }
+    out += chunk;
+  }
+  deflateEnd(&z);
+  return out;
+}
+
+std::string compress(const std::string &body, int bits) {
+  return compress(std::vector<std::string>{body}, bits);
+}
+
+// text that compresses, but not to nothing.
+std::string sample(std::size_t n) {
+  std::string s;
+  unsigned x = 1;
+  while (s.size() < n) {
+    x = x * 1103515245 + 12345;
+    s += "line " + std::to_string((x >> 16) % 1000) + " of the body\n";
+  }
+  s.resize(n);
+  return s;
+}
+
+struct read_result {
+  boost::system::error_code ec;
+  std::size_t len = 0;
+  std::string body;
+};
+
+read_result read_all(chunk_source &source, winhttp::content_coding coding,
+                     std::size_t max = std::string().max_size()) {
+  read_result r;
+  winhttp::content_decoder decoder(coding);
+  auto buff = net::dynamic_buffer(r.body, max);
+  bool done = false;
+  winhttp::async_read_decoded(source, decoder, buff,
+                              [&](boost::system::error_code ec,
+                                  std::size_t len) {
+                                r.ec = ec;
+                                r.len = len;
+                                done = true;
+                              });
+  boost::ut::expect(!done);
+  source.get_executor().context().run();
+  boost::ut::expect(done);
+  return r;
+}
+
+int main() {
+  using namespace boost::ut;
+  using winhttp::content_coding;
+
+  "ParseContentEncoding"_test = [] {
+    expect(winhttp::parse_content_encoding(L"") == content_coding::identity);
+    expect(winhttp::parse_content_encoding(L" GZip ") == content_coding::gzip);
+    expect(winhttp::parse_content_encoding(L"x-gzip") == content_coding::gzip);
+    expect(winhttp::parse_content_encoding(L"deflate") ==
+           content_coding::deflate);
+    expect(!winhttp::parse_content_encoding(L"br").has_value());
+    expect(!winhttp::parse_content_encoding(L"deflate, gzip").has_value());
+  };
+
+  "Codings"_test = [] {
+    std::string body = sample(200000);
+    struct {
+      content_coding coding;
+      int bits;
+    } cases[] = {{content_coding::gzip, 16 + 15},
+                 {content_coding::deflate, 15},
+                 {content_coding::deflate, -15}};
+    for (auto c : cases) {
+      std::string encoded = compress(body, c.bits);
+      expect(encoded.size() < body.size() / 2);
+      for (std::size_t n : {std::size_t{1}, std::size_t{7}, std::size_t{1000},
+                            std::size_t{100000}}) {
+        // a byte at a time is slow, use a shorter body.
+        const std::string &expected = n == 1 ? sample(10000) : body;
+        std::string in = n == 1 ? compress(expected, c.bits) : encoded;
+        net::io_context ioc;
+        chunk_source source(ioc, in, n);
+        auto r = read_all(source, c.coding);
+        expect(!r.ec.failed()) << r.ec.message() << c.bits << n;
+        expect(expected.size() == r.len);
+        expect(r.body == expected) << c.bits << n;
+      }
+    }
+  };
+
+  "Identity"_test = [] {
+    std::string body = sample(50000);
+    net::io_context ioc;
+    chunk_source source(ioc, body, 3000);
+    auto r = read_all(source, content_coding::identity);
+    expect(!r.ec.failed());
+    expect(r.body == body);
+  };
+
+  "GzipMembers"_test = [] {
+    std::string a = sample(3000);
+    std::string b = "second member";
+    net::io_context ioc;
+    chunk_source source(ioc, compress(a, 31) + compress(b, 31), 100);
+    auto r = read_all(source, content_coding::gzip);
+    expect(!r.ec.failed()) << r.ec.message();
+    expect(r.body == a + b);
+  };
+
+  "EmptyBody"_test = [] {
+    net::io_context ioc;
+    chunk_source source(ioc, std::vector<std::string>{});
+    auto r = read_all(source, content_coding::gzip);
+    expect(!r.ec.failed());
+    expect(0u == r.len);
+  };
+
+  // bytes reach the consumer as each flushed chunk arrives.
+  "Incremental"_test = [] {
+    std::vector<std::string> parts = {sample(100), sample(70000), "end"};
+    std::vector<std::string> flushed;
+    compress(parts, 31, &flushed);
+    net::io_context ioc;
+    chunk_source source(ioc, flushed);
+    winhttp::content_decoder decoder(content_coding::gzip);
+    std::string out;
+    auto buff = net::dynamic_buffer(out);
+    std::vector<std::size_t> reads;
+    std::vector<std::string> got;
+    std::function<void()> next = [&] {
+      winhttp::async_read_some_decoded(
+          source, decoder, buff,
+          [&](boost::system::error_code ec, std::size_t len) {
+            expect(!ec.failed() >> fatal) << ec.message();
+            if (len == 0) {
+              return;
+            }
+            reads.push_back(source.reads);
+            got.push_back(out);
+            buff.consume(buff.size());
+            next();
+          });
+    };
+    next();
+    ioc.run();
+    // one completion per chunk read.
+    expect((3u == got.size()) >> fatal);
+    expect(got[0] == parts[0]);
+    expect(got[1] == parts[1]);
+    expect(got[2] == parts[2]);
+    expect(reads == std::vector<std::size_t>{1, 2, 3});
+  };
+
+  "Errors"_test = [] {
+    std::string body = sample(100000);
+    std::string encoded = compress(body, 31);
+    {
+      std::string corrupt = encoded;
+      for (std::size_t i = 100; i < 200; ++i) {
+        corrupt[i] = static_cast<char>(corrupt[i] ^ 0x55);
+      }
+      net::io_context ioc;
+      chunk_source source(ioc, corrupt, 4096);
+      auto r = read_all(source, content_coding::gzip);
+      expect(r.ec == boost::system::errc::bad_message) << r.ec.message();
+    }
+    {
+      net::io_context ioc;
+      chunk_source source(ioc, encoded.substr(0, encoded.size() - 10), 4096);
+      auto r = read_all(source, content_coding::gzip);
+      expect(r.ec == boost::system::errc::bad_message) << r.ec.message();
+    }
+    {
+      // the output buffer bounds memory, not the encoded size.
+      net::io_context ioc;
+      chunk_source source(ioc, encoded, 4096);
+      auto r = read_all(source, content_coding::gzip, 10000);
+      expect(r.ec == net::error::no_buffer_space) << r.ec.message();
+      expect(10000u == r.body.size());
+      expect(r.body == body.substr(0, 10000));
+    }
+    {
+      // not a gzip stream.
+      net::io_context ioc;
+      chunk_source source(ioc, body, 4096);
+      auto r = read_all(source, content_coding::gzip);
+      expect(r.ec == boost::system::errc::bad_message);
+    }
+  };
+}
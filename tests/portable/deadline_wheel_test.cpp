@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// The timer wheel against the expected ticks, and deadlines on a wheel.
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/deadline_wheel.hpp"
+
+#include <boost/asio/io_context.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace net = boost::asio;
+namespace winnet = boost::winasio;
+using namespace std::chrono_literals;
+using winnet::details::timer_wheel;
+using winnet::details::wheel_entry;
+using winnet::details::wheel_node;
+
+struct tick_entry : wheel_entry {
+  std::uint64_t want = 0;
+  std::uint64_t got = 0;
+  bool cancelled = false;
+};
+
+int main() {
+  using namespace boost::ut;
+
+  // every entry expires at its tick, at any level and past the last.
+  "TimerWheel"_test = [] {
+    const std::uint64_t start = 1000;
+    timer_wheel w(start);
+    std::mt19937_64 rng(7);
+    std::vector<std::uint64_t> distances = {0, 1, 63, 64, 65, 4095, 4096,
+                                            262143, 262144,
+                                            timer_wheel::max_distance,
+                                            timer_wheel::max_distance + 5000};
+    for (int i = 0; i < 2000; ++i) {
+      distances.push_back(rng() % 300000);
+    }
+    std::vector<std::unique_ptr<tick_entry>> entries;
+    for (std::uint64_t d : distances) {
+      auto e = std::make_unique<tick_entry>();
+      e->want = start + d;
+      w.insert(*e, e->want);
+      entries.push_back(std::move(e));
+    }
+    // cancel every tenth.
+    for (std::size_t i = 0; i < entries.size(); i += 10) {
+      w.remove(*entries[i]);
+      entries[i]->cancelled = true;
+    }
+    std::uint64_t last = start + timer_wheel::max_distance + 6000;
+    std::uint64_t t = start;
+    while (t <= last && w.size() != 0) {
+      // uneven steps, like late timer wakeups.
+      std::uint64_t to = t + rng() % 5000;
+      wheel_node expired;
+      w.advance(to, expired);
+      while (expired.linked()) {
+        tick_entry &e = static_cast<tick_entry &>(*expired.next);
+        e.unlink();
+        // not early, and not in a later advance.
+        expect(e.want <= to && e.want >= t) << e.want << t << to;
+        e.got = e.want;
+      }
+      t = to + 1;
+    }
+    expect(0u == w.size());
+    for (const auto &e : entries) {
+      if (e->cancelled) {
+        expect(0u == e->got);
+      } else {
+        expect(e->want == e->got) << e->want << e->got;
+      }
+    }
+  };
+
+  "Deadline"_test = [] {
+    net::io_context ioc;
+    winnet::deadline_wheel wheel(ioc.get_executor(), 5ms);
+    auto start = winnet::deadline_wheel::clock_type::now();
+    std::vector<std::chrono::steady_clock::duration> fired(4);
+    std::vector<std::unique_ptr<winnet::deadline>> ds;
+    for (std::size_t i = 0; i < fired.size(); ++i) {
+      ds.push_back(std::make_unique<winnet::deadline>(wheel, [&, i] {
+        fired[i] = winnet::deadline_wheel::clock_type::now() - start;
+      }));
+    }
+    ds[0]->expires_after(20ms);
+    ds[1]->expires_after(40ms);
+    ds[2]->expires_after(10ms);
+    // re-armed later.
+    ds[2]->expires_after(60ms);
+    ds[3]->expires_after(30ms);
+    ds[3]->cancel();
+    expect(3u == wheel.size());
+    expect(ds[0]->armed() && !ds[3]->armed());
+    // returns once no deadline is armed.
+    ioc.run();
+    expect(fired[0] >= 20ms);
+    expect(fired[1] >= 40ms);
+    expect(fired[2] >= 60ms);
+    expect(fired[3] == std::chrono::steady_clock::duration::zero());
+    expect(fired[0] < fired[1] && fired[1] < fired[2]);
+    expect(3u == wheel.expired());
+    expect(!ds[0]->armed());
+  };
+
+  // expiry callbacks re-arm their deadline and cancel others of the batch.
+  "Callbacks"_test = [] {
+    net::io_context ioc;
+    winnet::deadline_wheel wheel(ioc.get_executor(), 1ms);
+    int a_runs = 0;
+    int b_runs = 0;
+    std::unique_ptr<winnet::deadline> b;
+    winnet::deadline a(wheel, [&] {
+      if (++a_runs < 3) {
+        a.expires_after(2ms);
+      }
+      b->cancel();
+    });
+    b = std::make_unique<winnet::deadline>(wheel, [&] { ++b_runs; });
+    a.expires_after(2ms);
+    b->expires_after(2ms);
+    ioc.run();
+    expect(3 == a_runs);
+    expect(0 == b_runs);
+    expect(0u == wheel.size());
+  };
+
+  // a wheel destroyed with a pending tick, and before its deadlines.
+  "Destroy"_test = [] {
+    net::io_context ioc;
+    std::unique_ptr<winnet::deadline> outlives;
+    {
+      winnet::deadline_wheel wheel(ioc.get_executor(), 1ms);
+      winnet::deadline d(wheel, [] {});
+      d.expires_after(1h);
+      outlives = std::make_unique<winnet::deadline>(wheel, [] {});
+      outlives->expires_after(2h);
+    }
+    expect(!outlives->armed());
+    outlives.reset();
+    ioc.run();
+  };
+}
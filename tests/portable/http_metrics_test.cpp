@@ -0,0 +1,56 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/http/http_metrics.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace winnet = boost::winasio;
+
+int main() {
+  using namespace boost::ut;
+
+  "HttpMetrics"_test = [] {
+    using winnet::http::metrics_phase;
+    winnet::http::http_metrics metrics;
+    auto &e = metrics.add_endpoint("/url-123", "GET");
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&] {
+        for (int j = 0; j < 1000; ++j) {
+          e.observe(metrics_phase::handler, 300us);
+          metrics.in_flight.add();
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    e.observe(metrics_phase::send, 20s);
+
+    auto s = e.snapshot(metrics_phase::handler);
+    expect(4000u == s.count);
+    expect(4000u == s.buckets[5]); // (250us, 500us]
+    expect(1u == e.snapshot(metrics_phase::send).buckets.back());
+    expect(4000 == metrics.in_flight.value());
+
+    std::string out;
+    metrics.write_prometheus(out);
+    expect(out.find("winasio_http_request_duration_seconds_bucket{route=\"/"
+                    "url-123\",verb=\"GET\",phase=\"handler\",le=\"0."
+                    "0005\"} 4000\n") != std::string::npos);
+    expect(out.find("winasio_http_in_flight_requests 4000\n") !=
+           std::string::npos);
+  };
+}
@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/io_runtime.hpp"
+
+#include <atomic>
+#include <latch>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace net = boost::asio;
+namespace winnet = boost::winasio;
+
+int main() {
+  using namespace boost::ut;
+
+  "ForEach"_test = [] {
+    winnet::io_runtime_options options;
+    options.contexts = 4;
+    winnet::io_runtime rt(options);
+    expect(4u == rt.size());
+    expect(rt.size() == rt.current_index());
+    std::vector<std::thread::id> ids(rt.size());
+    std::vector<std::size_t> indexes(rt.size(), rt.size());
+    rt.for_each([&](std::size_t i, net::io_context &ioc) {
+      ids[i] = std::this_thread::get_id();
+      indexes[i] = rt.current_index();
+      expect(&ioc == &rt.context(i));
+    });
+    std::set<std::thread::id> distinct(ids.begin(), ids.end());
+    expect(rt.size() == distinct.size());
+    for (std::size_t i = 0; i < rt.size(); ++i) {
+      expect(i == indexes[i]);
+    }
+  };
+
+  // a round trip between two contexts, and dispatch within one.
+  "Post"_test = [] {
+    winnet::io_runtime_options options;
+    options.contexts = 2;
+    winnet::io_runtime rt(options);
+    std::latch done(1);
+    std::vector<std::size_t> trace;
+    rt.post(0, [&] {
+      trace.push_back(rt.current_index());
+      rt.post(1, [&] {
+        trace.push_back(rt.current_index());
+        rt.post(0, [&] {
+          bool inline_run = false;
+          rt.dispatch(0, [&] { inline_run = true; });
+          expect(inline_run);
+          trace.push_back(rt.current_index());
+          done.count_down();
+        });
+      });
+    });
+    done.wait();
+    expect(trace == std::vector<std::size_t>{0, 1, 0});
+  };
+
+  "Pin"_test = [] {
+    winnet::io_runtime_options options;
+    options.pin_threads = true;
+    options.numa_aware = true;
+    winnet::io_runtime rt(options);
+    expect(rt.size() >= 1u);
+    for (std::size_t i = 0; i < rt.size(); ++i) {
+      expect(rt.pinned(i)) << i;
+      if (i != 0) {
+        expect(rt.node(i - 1) <= rt.node(i));
+      }
+    }
+    std::atomic<std::size_t> runs = 0;
+    rt.post_all([&] { ++runs; });
+    rt.join();
+    expect(rt.size() == runs.load());
+  };
+
+  "Exception"_test = [] {
+    winnet::io_runtime_options options;
+    options.contexts = 3;
+    winnet::io_runtime rt(options);
+    std::atomic<int> runs = 0;
+    bool thrown = false;
+    try {
+      rt.for_each([&](std::size_t i, net::io_context &) {
+        ++runs;
+        if (i == 1) {
+          throw std::runtime_error("context 1");
+        }
+      });
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    expect(thrown);
+    expect(3 == runs.load());
+  };
+
+  // join finishes the work left, stop does not.
+  "Join"_test = [] {
+    winnet::io_runtime_options options;
+    options.contexts = 2;
+    std::atomic<int> runs = 0;
+    {
+      winnet::io_runtime rt(options);
+      for (int n = 0; n < 100; ++n) {
+        rt.post(rt.next_index(), [&] { ++runs; });
+      }
+      rt.join();
+      expect(100 == runs.load());
+    }
+  };
+
+  // the contexts no longer run for_each, which must not wait for them.
+  "ForEachAfterStop"_test = [] {
+    winnet::io_runtime_options options;
+    options.contexts = 2;
+    for (bool join : {false, true}) {
+      winnet::io_runtime rt(options);
+      if (join) {
+        rt.join();
+      } else {
+        rt.stop();
+      }
+      int runs = 0;
+      bool aborted = false;
+      try {
+        rt.for_each([&](std::size_t, net::io_context &) { ++runs; });
+      } catch (const boost::system::system_error &e) {
+        aborted = e.code() == net::error::operation_aborted;
+      }
+      expect(aborted);
+      expect(0 == runs);
+    }
+  };
+
+  // stop wakes a for_each that waits on a context blocked in f.
+  "StopDuringForEach"_test = [] {
+    winnet::io_runtime_options options;
+    options.contexts = 2;
+    winnet::io_runtime rt(options);
+    std::latch entered(1);
+    std::latch release(1);
+    std::atomic<bool> aborted = false;
+    std::thread t([&] {
+      try {
+        rt.for_each([&](std::size_t i, net::io_context &) {
+          if (i == 0) {
+            entered.count_down();
+            release.wait();
+          }
+        });
+      } catch (const boost::system::system_error &e) {
+        aborted = e.code() == net::error::operation_aborted;
+      }
+    });
+    entered.wait();
+    rt.stop();
+    t.join();
+    expect(aborted.load());
+    release.count_down();
+    rt.join();
+  };
+}
@@ -0,0 +1,76 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/http/http_middleware.hpp"
+
+#include <string>
+#include <tuple>
+
+namespace winnet = boost::winasio;
+
+// rejects requests without the magic status and records calls in order.
+struct test_auth_middleware {
+  struct state_type {
+    bool allowed = false;
+  };
+  std::string *trace;
+
+  template <typename Ctx> bool before(Ctx &ctx, state_type &s) {
+    *trace += "a";
+    s.allowed = ctx.status == 42;
+    if (!s.allowed) {
+      ctx.status = 401;
+    }
+    return s.allowed;
+  }
+  template <typename Ctx> void after(Ctx &, state_type &) { *trace += "A"; }
+};
+
+struct test_log_middleware {
+  std::string *trace;
+
+  template <typename Ctx>
+  bool before(Ctx &, winnet::http::empty_middleware_state &) {
+    *trace += "l";
+    return true;
+  }
+};
+
+int main() {
+  using namespace boost::ut;
+
+  "MiddlewareChain"_test = [] {
+    using chain_type =
+        winnet::http::middleware_chain<test_log_middleware,
+                                       test_auth_middleware>;
+    struct test_ctx {
+      int status;
+      chain_type::state_type state;
+    };
+    std::string trace;
+    chain_type chain(test_log_middleware{&trace},
+                     test_auth_middleware{&trace});
+    auto handler = [&trace](test_ctx &ctx) {
+      trace += "h";
+      ctx.status = 200;
+    };
+
+    test_ctx ok{42, {}};
+    chain(ok, handler);
+    expect(200 == ok.status);
+    expect(std::get<1>(ok.state).allowed);
+    expect(trace == "lahA");
+
+    trace.clear();
+    test_ctx denied{0, {}};
+    chain(denied, handler);
+    expect(401 == denied.status);
+    expect(trace == "laA");
+  };
+}
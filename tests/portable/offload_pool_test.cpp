@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/http/http_offload_pool.hpp"
+
+#include <atomic>
+#include <latch>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace winnet = boost::winasio;
+
+int main() {
+  using namespace boost::ut;
+
+  "Run"_test = [] {
+    std::atomic<int> runs = 0;
+    {
+      winnet::http::offload_pool pool(4, 1024);
+      expect(4u == pool.thread_count());
+      for (int i = 0; i < 1000; ++i) {
+        while (!pool.try_submit([&] { ++runs; })) {
+          std::this_thread::yield();
+        }
+      }
+      // stop finishes the queued tasks.
+    }
+    expect(1000 == runs.load());
+  };
+
+  "Bound"_test = [] {
+    winnet::http::offload_pool pool(1, 4);
+    std::latch started(1);
+    std::latch blocked(1);
+    expect(pool.try_submit([&] {
+      started.count_down();
+      blocked.wait();
+    }));
+    started.wait();
+    for (int i = 0; i < 4; ++i) {
+      expect(pool.try_submit([] {}));
+    }
+    expect(!pool.try_submit([] {}));
+    expect(4u == pool.queued());
+    blocked.count_down();
+    pool.stop();
+    expect(0u == pool.queued());
+    expect(!pool.try_submit([] {}));
+  };
+
+  // tasks submitted from a worker run on that worker, unless stolen.
+  "Nested"_test = [] {
+    std::atomic<int> runs = 0;
+    winnet::http::offload_pool pool(2);
+    std::latch done(101);
+    expect(pool.try_submit([&] {
+      for (int i = 0; i < 100; ++i) {
+        expect(pool.try_submit([&] {
+          ++runs;
+          done.count_down();
+        }));
+      }
+      done.count_down();
+    }));
+    done.wait();
+    expect(100 == runs.load());
+  };
+
+  // every accepted task runs, even if submitted while stopping.
+  "StopRace"_test = [] {
+    for (int round = 0; round < 20; ++round) {
+      std::atomic<int> accepted = 0;
+      std::atomic<int> runs = 0;
+      winnet::http::offload_pool pool(2);
+      std::latch go(3);
+      std::vector<std::thread> submitters;
+      for (int i = 0; i < 2; ++i) {
+        submitters.emplace_back([&] {
+          go.arrive_and_wait();
+          for (int j = 0; j < 1000; ++j) {
+            if (pool.try_submit([&] { ++runs; })) {
+              ++accepted;
+            }
+          }
+        });
+      }
+      go.arrive_and_wait();
+      pool.stop();
+      for (auto &t : submitters) {
+        t.join();
+      }
+      expect(accepted.load() == runs.load());
+    }
+  };
+
+  "Throw"_test = [] {
+    std::atomic<int> runs = 0;
+    winnet::http::offload_pool pool(1);
+    expect(pool.try_submit([] { throw std::runtime_error("task"); }));
+    expect(pool.try_submit([&] { ++runs; }));
+    pool.stop();
+    expect(1u == pool.failed_count());
+    expect(1 == runs.load());
+  };
+}
@@ -0,0 +1,171 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// The read ahead of named pipes, over a local socket pair in place of a
+// pipe in byte mode.
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/named_pipe/read_ahead.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace net = boost::asio;
+namespace winnet = boost::winasio;
+
+typedef net::local::stream_protocol::socket socket_type;
+
+// a socket read through a read ahead buffer, as the pipe does.
+class ahead_stream {
+public:
+  typedef socket_type::executor_type executor_type;
+
+  ahead_stream(socket_type &s, std::size_t capacity)
+      : s_(s),
+        ahead_(std::make_shared<winnet::details::read_ahead_buffer>(capacity)) {
+  }
+
+  executor_type get_executor() { return s_.get_executor(); }
+
+  winnet::details::read_ahead_buffer &ahead() { return *ahead_; }
+
+  template <typename MutableBufferSequence>
+  std::size_t read_some(const MutableBufferSequence &buffers,
+                        boost::system::error_code &ec) {
+    return winnet::details::read_ahead(s_, *ahead_, buffers, ec);
+  }
+
+  template <typename MutableBufferSequence, typename Token>
+  auto async_read_some(const MutableBufferSequence &buffers, Token &&token) {
+    return winnet::details::async_read_ahead(s_, ahead_, buffers,
+                                             std::forward<Token>(token));
+  }
+
+private:
+  socket_type &s_;
+  std::shared_ptr<winnet::details::read_ahead_buffer> ahead_;
+};
+
+// frames of 64 bytes, each filled with a letter of its index.
+std::string frames(int count) {
+  std::string s;
+  for (int i = 0; i < count; ++i) {
+    s.append(64, static_cast<char>('a' + i % 26));
+  }
+  return s;
+}
+
+int main() {
+  using namespace boost::ut;
+
+  "ReadAhead"_test = [] {
+    net::io_context ioc;
+    socket_type a(ioc);
+    socket_type b(ioc);
+    net::local::connect_pair(a, b);
+    ahead_stream s(a, 1024);
+    const std::string sent = frames(3);
+    net::write(b, net::buffer(sent));
+
+    // a small read fills the buffer with all that was written.
+    boost::system::error_code ec;
+    char header[4];
+    expect(4u == s.read_some(net::buffer(header), ec));
+    expect(!ec.failed());
+    expect(std::string(header, 4) == sent.substr(0, 4));
+    expect(188u == s.ahead().size());
+
+    // served from the buffer, also when asked for more.
+    std::string rest(1024, '\0');
+    expect(188u == s.read_some(net::buffer(rest), ec));
+    expect(!ec.failed());
+    expect(rest.substr(0, 188) == sent.substr(4));
+    expect(0u == s.ahead().size());
+
+    // reads of the capacity or more skip the buffer.
+    net::write(b, net::buffer(sent));
+    std::string big(1024, '\0');
+    expect(sent.size() == s.read_some(net::buffer(big), ec));
+    expect(0u == s.ahead().size());
+
+    // end of stream is reported once the buffer is empty.
+    net::write(b, net::buffer(sent.data(), 10));
+    b.close();
+    expect(2u == s.read_some(net::buffer(header, 2), ec));
+    expect(8u == s.read_some(net::buffer(rest), ec));
+    expect(!ec.failed());
+    expect(0u == s.read_some(net::buffer(header), ec));
+    expect(ec == net::error::eof);
+  };
+
+  "AsyncReadAhead"_test = [] {
+    net::io_context ioc;
+    socket_type a(ioc);
+    socket_type b(ioc);
+    net::local::connect_pair(a, b);
+    // smaller than the frames written, so the buffer is filled again.
+    ahead_stream s(a, 256);
+    const int count = 20;
+    const std::string sent = frames(count);
+    net::async_write(b, net::buffer(sent),
+                     [](boost::system::error_code ec, std::size_t) {
+                       expect(!ec.failed());
+                     });
+
+    // each frame as a header and a body, which fails in message mode.
+    std::string got;
+    char frame[64];
+    std::function<void()> next = [&] {
+      net::async_read(
+          s, net::buffer(frame, 4),
+          [&](boost::system::error_code ec, std::size_t n) {
+            expect(!ec.failed() >> fatal);
+            expect(4u == n);
+            net::async_read(
+                s, net::buffer(frame + 4, 60),
+                [&](boost::system::error_code ec2, std::size_t n2) {
+                  expect(!ec2.failed() >> fatal);
+                  got.append(frame, 4 + n2);
+                  if (got.size() < sent.size()) {
+                    next();
+                  }
+                });
+          });
+    };
+    next();
+    ioc.run();
+    expect(got == sent);
+    expect(0u == s.ahead().size());
+
+    // a read served from the buffer is posted, not run inside the caller.
+    ioc.restart();
+    net::write(b, net::buffer(sent.data(), 8));
+    boost::system::error_code ec;
+    char byte;
+    expect(1u == s.read_some(net::buffer(&byte, 1), ec));
+    expect(7u == s.ahead().size());
+    bool done = false;
+    s.async_read_some(net::buffer(&byte, 1),
+                      [&](boost::system::error_code ec2, std::size_t n) {
+                        expect(!ec2.failed());
+                        expect(1u == n);
+                        done = true;
+                      });
+    expect(!done);
+    ioc.run();
+    expect(done);
+    expect(6u == s.ahead().size());
+  };
+}
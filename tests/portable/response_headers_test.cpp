@@ -0,0 +1,126 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Parsing of raw response headers, without winhttp.
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/winhttp/response_headers.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using boost::winasio::winhttp::response_headers;
+
+const wchar_t raw[] = L"HTTP/1.1 404 Not Found\r\n"
+                      L"Content-Type: text/plain\r\n"
+                      L"content-length:  1234 \r\n"
+                      L"Set-Cookie: a=1\r\n"
+                      L"Set-Cookie: b=2\r\n"
+                      L"X-Empty:\r\n"
+                      L"\r\n";
+
+int main() {
+  using namespace boost::ut;
+
+  "StatusLine"_test = [] {
+    response_headers h;
+    h.assign(raw);
+    expect(h.status_line() == L"HTTP/1.1 404 Not Found");
+    expect(h.version() == L"HTTP/1.1");
+    expect(404u == h.status().value());
+    expect(h.reason() == L"Not Found");
+    expect(5u == h.size());
+    expect(h.at(0).name == L"Content-Type");
+    expect(h.at(0).value == L"text/plain");
+  };
+
+  "CaseInsensitiveGet"_test = [] {
+    response_headers h;
+    h.assign(raw);
+    expect(h.get(L"CONTENT-TYPE").value() == L"text/plain");
+    expect(h.get(L"Content-Length").value() == L"1234");
+    expect(h.get(L"X-Empty").value().empty());
+    expect(!h.get(L"X-Missing"));
+    std::vector<std::wstring> cookies;
+    h.for_each(L"set-cookie",
+               [&](std::wstring_view v) { cookies.emplace_back(v); });
+    expect(2u == cookies.size());
+    expect(cookies[0] == L"a=1" && cookies[1] == L"b=2");
+  };
+
+  "Numbers"_test = [] {
+    response_headers h;
+    h.assign(raw);
+    expect(1234u == h.content_length().value());
+    expect(!response_headers::parse_number(L"12a"));
+    expect(!response_headers::parse_number(L""));
+    expect(!response_headers::parse_number(L"-1"));
+    expect(18446744073709551615u ==
+           response_headers::parse_number(L"18446744073709551615").value());
+    expect(!response_headers::parse_number(L"18446744073709551616"));
+    h.assign(L"HTTP/1.1 abc\r\nContent-Length: x\r\n\r\n");
+    expect(!h.status());
+    expect(!h.content_length());
+    h.assign(L"garbage");
+    expect(!h.status());
+    expect(h.reason().empty());
+    expect(0u == h.size());
+  };
+
+  "Utf8"_test = [] {
+    response_headers h;
+    h.assign(L"HTTP/1.1 200 OK\r\n"
+             L"X-Name: café €\r\n"
+             L"X-Ascii: plain\r\n\r\n");
+    expect(h.get_utf8(L"x-name").value() == "caf\xc3\xa9 \xe2\x82\xac");
+    expect(h.get_utf8(L"X-Ascii").value() == "plain");
+    expect(!h.get_utf8(L"X-Missing"));
+  };
+
+  "FillInPlace"_test = [] {
+    response_headers h;
+    // like winhttp, the size includes the terminating null.
+    std::wstring first(raw);
+    wchar_t *p = h.prepare(first.size() + 1);
+    std::memcpy(p, first.c_str(), (first.size() + 1) * sizeof(wchar_t));
+    h.commit(first.size() + 1);
+    expect(h.raw() == first);
+    expect(404u == h.status().value());
+    std::size_t cap = h.capacity();
+
+    // a smaller response reuses the buffer and drops the old index.
+    std::wstring second(L"HTTP/1.1 200 OK\r\nServer: test\r\n\r\n");
+    p = h.prepare(cap);
+    std::memcpy(p, second.c_str(), (second.size() + 1) * sizeof(wchar_t));
+    h.commit(second.size() + 1);
+    expect(cap == h.capacity());
+    expect(200u == h.status().value());
+    expect(1u == h.size());
+    expect(h.get(L"server").value() == L"test");
+    expect(!h.get(L"Content-Type"));
+  };
+
+  // the index holds offsets into the raw headers, not views.
+  "CopyMove"_test = [] {
+    response_headers h;
+    h.assign(raw);
+    expect(404u == h.status().value());
+    response_headers copy(h);
+    h.assign(L"HTTP/1.1 200 OK\r\n\r\n");
+    expect(copy.status_line() == L"HTTP/1.1 404 Not Found");
+    expect(copy.get(L"content-type").value() == L"text/plain");
+    response_headers moved(std::move(copy));
+    copy.assign(L"HTTP/1.1 500 Error\r\n\r\n");
+    expect(moved.status_line() == L"HTTP/1.1 404 Not Found");
+    expect(404u == moved.status().value());
+    moved = h;
+    expect(moved.status_line() == L"HTTP/1.1 200 OK");
+    expect(0u == moved.size());
+  };
+}
@@ -0,0 +1,202 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Tracing rings, the events of winhttp steps, and the chrome json dump.
+
+#define WINASIO_TRACE
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/trace.hpp"
+#include "boost/winasio/winhttp/winhttp_step.hpp"
+
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <atomic>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace net = boost::asio;
+namespace trace = boost::winasio::trace;
+using boost::winasio::winhttp::details::async_step;
+using boost::winasio::winhttp::details::step_state;
+
+// an op per test, so that tests see only their own events.
+trace::op user_op(int i) {
+  return static_cast<trace::op>(static_cast<int>(trace::op::user) + i);
+}
+
+std::vector<trace::event> events_of(trace::op what) {
+  std::vector<trace::event> out;
+  for (const trace::event &e : trace::snapshot()) {
+    if (e.what == what) {
+      out.push_back(e);
+    }
+  }
+  return out;
+}
+
+int main() {
+  using namespace boost::ut;
+
+  "Record"_test = [] {
+    boost::system::error_code ec = net::error::operation_aborted;
+    trace::record(user_op(1), trace::phase::begin, std::uint64_t{7}, 3, 100,
+                  {});
+    trace::record(user_op(1), trace::phase::end, std::uint64_t{7}, 4, 200, ec);
+    auto events = events_of(user_op(1));
+    expect((2u == events.size()) >> fatal);
+    expect(events[0].ph == trace::phase::begin);
+    expect(7u == events[0].handle && 3u == events[0].state);
+    expect(100u == events[0].bytes && 0 == events[0].ec);
+    expect(events[1].ph == trace::phase::end);
+    expect(ec.value() == events[1].ec && 200u == events[1].bytes);
+    expect(events[0].time <= events[1].time);
+    expect(events[0].thread == events[1].thread);
+  };
+
+  "Threads"_test = [] {
+    const int count = 1000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([t] {
+        for (int i = 0; i < count; ++i) {
+          trace::record(user_op(2), trace::phase::instant,
+                        std::uint64_t(t * count + i), 0, 0, {});
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    auto events = events_of(user_op(2));
+    expect(4u * count == events.size());
+    std::set<std::uint32_t> ids;
+    std::set<std::uint64_t> handles;
+    for (const auto &e : events) {
+      ids.insert(e.thread);
+      handles.insert(e.handle);
+    }
+    expect(4u == ids.size());
+    expect(4u * count == handles.size());
+  };
+
+  // a ring keeps the last events of its thread.
+  "Overwrite"_test = [] {
+    const std::size_t cap = trace::details::ring::capacity;
+    std::thread([cap] {
+      for (std::size_t i = 0; i < cap + 100; ++i) {
+        trace::record(user_op(3), trace::phase::instant, std::uint64_t(i), 0,
+                      0, {});
+      }
+    }).join();
+    auto events = events_of(user_op(3));
+    expect((cap == events.size()) >> fatal);
+    expect(100u == events.front().handle);
+    expect(cap + 99 == events.back().handle);
+  };
+
+  // snapshots while a thread records never see a half written event.
+  "ConcurrentSnapshot"_test = [] {
+    std::atomic<bool> stop{false};
+    std::thread writer([&] {
+      for (std::uint64_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+        trace::record(user_op(4), trace::phase::instant, i, std::uint32_t(i),
+                      i, {});
+      }
+    });
+    for (int n = 0; n < 200; ++n) {
+      auto events = events_of(user_op(4));
+      for (std::size_t i = 0; i < events.size(); ++i) {
+        const auto &e = events[i];
+        if (e.handle != e.bytes || std::uint32_t(e.handle) != e.state ||
+            (i != 0 && e.handle != events[i - 1].handle + 1)) {
+          expect(false) << "torn event at" << i;
+          break;
+        }
+      }
+    }
+    stop = true;
+    writer.join();
+  };
+
+  "Step"_test = [] {
+    net::io_context ioc;
+    async_step<net::io_context::executor_type> step(ioc.get_executor());
+    step.begin(step_state::read_complete);
+    std::thread([&] {
+      step.complete(net::error::connection_reset, 5);
+    }).join();
+    step.wait<true>([](boost::system::error_code, std::size_t) {});
+    ioc.run();
+    std::vector<trace::event> events;
+    for (const auto &e : events_of(trace::op::winhttp_step)) {
+      if (e.handle == trace::to_handle(&step)) {
+        events.push_back(e);
+      }
+    }
+    expect((2u == events.size()) >> fatal);
+    expect(events[0].ph == trace::phase::begin);
+    expect(events[1].ph == trace::phase::end);
+    expect(unsigned(step_state::read_complete) == events[0].state);
+    expect(unsigned(step_state::read_complete) == events[1].state);
+    expect(5u == events[1].bytes);
+    expect(int(net::error::connection_reset) == events[1].ec);
+    // completed on another thread.
+    expect(events[0].thread != events[1].thread);
+  };
+
+  "Handler"_test = [] {
+    net::io_context ioc;
+    auto strand = net::make_strand(ioc);
+    bool in_strand = false;
+    auto h = BOOST_WINASIO_TRACE_HANDLER(
+        http_receive_body, 64,
+        net::bind_executor(strand, [&](boost::system::error_code,
+                                       std::size_t) {
+          in_strand = strand.running_in_this_thread();
+        }));
+    // the handler still runs on its strand.
+    auto ex = net::get_associated_executor(h, ioc.get_executor());
+    net::post(ex, [&h] { h(boost::system::error_code(), 10); });
+    ioc.run();
+    expect(in_strand);
+    auto events = events_of(trace::op::http_receive_body);
+    expect((2u == events.size()) >> fatal);
+    expect(events[0].handle == events[1].handle);
+    expect(64u == events[0].bytes && 10u == events[1].bytes);
+  };
+
+  "Dump"_test = [] {
+    trace::record(user_op(5), trace::phase::begin, std::uint64_t{0xab}, 1, 2,
+                  {});
+    auto events = events_of(user_op(5));
+    events.push_back(events_of(trace::op::http_receive_body).front());
+    std::stringstream ss;
+    trace::write(ss, events);
+    std::vector<trace::event> read;
+    expect(trace::read(ss, read));
+    expect((events.size() == read.size()) >> fatal);
+    expect(0xabu == read[0].handle && 2u == read[0].bytes);
+
+    std::stringstream bad("not a trace");
+    expect(!trace::read(bad, read));
+
+    std::ostringstream json;
+    trace::write_chrome_json(json, events);
+    std::string s = json.str();
+    expect(s.starts_with("{\"traceEvents\":["));
+    expect(s.find("\"name\":\"op_261\"") != std::string::npos) << s;
+    expect(s.find("\"name\":\"http_receive_body\"") != std::string::npos);
+    expect(s.find("\"id\":\"0xab\"") != std::string::npos);
+    expect(s.find("\"ph\":\"b\"") != std::string::npos);
+  };
+}
@@ -0,0 +1,223 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Streaming uploads with a fake writer, so that it runs without winhttp.
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/winhttp/upload.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace net = boost::asio;
+namespace winnet = boost::winasio;
+
+// completes each write on the next turn of the io_context, like winhttp.
+class fake_writer {
+public:
+  explicit fake_writer(net::io_context &ioc) : ioc_(ioc) {}
+
+  template <typename Handler>
+  void async_write_data(const void *data, std::uint32_t len,
+                        Handler &&handler) {
+    ++outstanding;
+    max_outstanding = std::max(max_outstanding, outstanding);
+    ++writes;
+    // write at most max_write bytes, like a partial WinHttpWriteData.
+    std::size_t n = std::min<std::size_t>(len, max_write);
+    written.append(static_cast<const char *>(data), n);
+    net::post(ioc_, [this, n, h = std::move(handler)]() mutable {
+      --outstanding;
+      h(boost::system::error_code{}, n);
+    });
+  }
+
+  std::string written;
+  std::size_t max_write = SIZE_MAX;
+  int outstanding = 0;
+  int max_outstanding = 0;
+  int writes = 0;
+
+private:
+  net::io_context &ioc_;
+};
+
+// decodes a chunked body.
+std::string unchunk(const std::string &s) {
+  std::string out;
+  std::size_t pos = 0;
+  for (;;) {
+    std::size_t eol = s.find("\r\n", pos);
+    std::size_t n = std::stoul(s.substr(pos, eol - pos), nullptr, 16);
+    pos = eol + 2;
+    if (n == 0) {
+      return s.substr(pos) == "\r\n" ? out : "bad trailer";
+    }
+    out += s.substr(pos, n);
+    pos += n + 2;
+  }
+}
+
+int main() {
+  using namespace boost::ut;
+
+  "BufferUpload"_test = [] {
+    net::io_context ioc;
+    fake_writer w(ioc);
+    w.max_write = 1000;
+    std::string a(3000, 'a');
+    std::string b(5000, 'b');
+    std::array<net::const_buffer, 2> bufs{net::buffer(a), net::buffer(b)};
+    auto source = winnet::winhttp::make_buffer_upload(bufs);
+    expect(8000u == *source.size());
+    std::size_t total = 0;
+    winnet::winhttp::async_upload(
+        w, source, ioc.get_executor(),
+        [&](boost::system::error_code ec, std::size_t n) {
+          expect(!ec.failed());
+          total = n;
+        });
+    ioc.run();
+    expect(8000u == total);
+    expect(a + b == w.written);
+    expect(1 == w.max_outstanding);
+  };
+
+  "GeneratorUploadIsChunked"_test = [] {
+    net::io_context ioc;
+    fake_writer w(ioc);
+    int chunks = 0;
+    int reads_during_write = 0;
+    // 10 chunks of 100 bytes, produced asynchronously.
+    auto source = winnet::winhttp::make_generator_upload(
+        [&](net::mutable_buffer b, winnet::winhttp::upload_read_handler h) {
+          if (w.outstanding > 0) {
+            ++reads_during_write;
+          }
+          std::size_t n = chunks < 10 ? 100 : 0;
+          std::memset(b.data(), '0' + chunks % 10, n);
+          ++chunks;
+          net::post(ioc, [h, n] { h({}, n); });
+        },
+        4096);
+    expect(!source.size());
+    std::size_t total = 0;
+    winnet::winhttp::async_upload(
+        w, source, ioc.get_executor(),
+        [&](boost::system::error_code ec, std::size_t n) {
+          expect(!ec.failed());
+          total = n;
+        });
+    ioc.run();
+    expect(1000u == total);
+    std::string expected;
+    for (int i = 0; i < 10; ++i) {
+      expected += std::string(100, static_cast<char>('0' + i));
+    }
+    expect(expected == unchunk(w.written));
+    expect(1 == w.max_outstanding);
+    // the next chunk is read while the previous one is written.
+    expect(reads_during_write > 0);
+  };
+
+  "FileUpload"_test = [] {
+    auto path = std::filesystem::temp_directory_path() / "winasio_upload.bin";
+    std::string content;
+    for (int i = 0; i < 100000; ++i) {
+      content += static_cast<char>(i % 251);
+    }
+    std::ofstream(path, std::ios::binary) << content;
+
+    net::io_context ioc;
+    fake_writer w(ioc);
+    boost::system::error_code ec;
+    auto source = winnet::winhttp::make_file_upload(path, ec, 4096);
+    expect(!ec.failed() >> fatal);
+    expect(100000u == *source.size());
+    winnet::winhttp::async_upload(
+        w, source, ioc.get_executor(),
+        [](boost::system::error_code e, std::size_t n) {
+          expect(!e.failed());
+          expect(100000u == n);
+        });
+    ioc.run();
+    expect(content == w.written);
+    // one write per chunk.
+    expect(25 == w.writes);
+    std::filesystem::remove(path);
+
+    winnet::winhttp::make_file_upload(path, ec);
+    expect(ec.failed());
+  };
+
+  "ShortSource"_test = [] {
+    net::io_context ioc;
+    fake_writer w(ioc);
+    // claims 100 bytes, has 10.
+    winnet::winhttp::upload_source source(
+        100, [sent = false](net::mutable_buffer b,
+                            winnet::winhttp::upload_read_handler h) mutable {
+          std::size_t n = sent ? 0 : 10;
+          std::memset(b.data(), 'x', n);
+          sent = true;
+          h({}, n);
+        });
+    boost::system::error_code result;
+    winnet::winhttp::async_upload(
+        w, source, ioc.get_executor(),
+        [&](boost::system::error_code ec, std::size_t) { result = ec; });
+    ioc.run();
+    expect(result == net::error::eof);
+  };
+
+  // nothing to write, still completes outside of async_upload.
+  "EmptySource"_test = [] {
+    net::io_context ioc;
+    fake_writer w(ioc);
+    std::string empty;
+    auto source = winnet::winhttp::make_buffer_upload(net::buffer(empty));
+    bool done = false;
+    // started on the executor of the handler, where dispatch runs inline.
+    net::post(ioc, [&] {
+      winnet::winhttp::async_upload(
+          w, source, ioc.get_executor(),
+          [&](boost::system::error_code ec, std::size_t n) {
+            expect(!ec.failed());
+            expect(0u == n);
+            done = true;
+          });
+      expect(!done);
+    });
+    ioc.run();
+    expect(done);
+    expect(0 == w.writes);
+  };
+
+  // a write of 0 bytes fails the upload instead of skipping the chunk.
+  "ZeroWrite"_test = [] {
+    net::io_context ioc;
+    fake_writer w(ioc);
+    w.max_write = 0;
+    std::string a(100, 'a');
+    auto source = winnet::winhttp::make_buffer_upload(net::buffer(a));
+    boost::system::error_code result;
+    winnet::winhttp::async_upload(
+        w, source, ioc.get_executor(),
+        [&](boost::system::error_code ec, std::size_t) { result = ec; });
+    ioc.run();
+    expect(result == net::error::eof);
+  };
+}
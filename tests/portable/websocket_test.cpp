@@ -0,0 +1,267 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// WebSocket client against a local Beast echo server. Runs the winhttp
+// backend on Windows and the Beast backend elsewhere.
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/winhttp/websocket.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+
+#include <array>
+#include <string>
+#include <thread>
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+namespace winnet = boost::winasio;
+using tcp = net::ip::tcp;
+
+// echoes every message with its type. The message "close" closes the
+// connection, the target /decline declines the upgrade.
+class echo_server {
+public:
+  echo_server() : ioc_(1), acceptor_(ioc_), port_(0), th_() {
+    acceptor_.open(tcp::v4());
+    acceptor_.bind({net::ip::make_address("127.0.0.1"), 0});
+    acceptor_.listen();
+    port_ = acceptor_.local_endpoint().port();
+    net::co_spawn(ioc_, accept(), net::detached);
+    th_ = std::jthread([this] { ioc_.run(); });
+  }
+
+  ~echo_server() { ioc_.stop(); }
+
+  std::wstring url(const std::wstring &target = L"/echo") const {
+    return L"ws://127.0.0.1:" + std::to_wstring(port_) + target;
+  }
+
+private:
+  net::awaitable<void> accept() {
+    for (;;) {
+      tcp::socket s = co_await acceptor_.async_accept(net::use_awaitable);
+      net::co_spawn(ioc_, session(std::move(s)), net::detached);
+    }
+  }
+
+  static net::awaitable<void> session(tcp::socket s) {
+    beast::flat_buffer b;
+    http::request<http::string_body> req;
+    co_await http::async_read(s, b, req, net::use_awaitable);
+    if (req.target() == "/decline") {
+      http::response<http::string_body> resp{http::status::forbidden, 11};
+      resp.prepare_payload();
+      co_await http::async_write(s, resp, net::use_awaitable);
+      co_return;
+    }
+    websocket::stream<tcp::socket> ws(std::move(s));
+    co_await ws.async_accept(req, net::use_awaitable);
+    beast::flat_buffer msg;
+    for (;;) {
+      boost::system::error_code ec;
+      co_await ws.async_read(msg, net::redirect_error(net::use_awaitable, ec));
+      if (ec) {
+        co_return;
+      }
+      if (beast::buffers_to_string(msg.data()) == "close") {
+        websocket::close_reason reason(websocket::close_code::normal);
+        co_await ws.async_close(reason,
+                                net::redirect_error(net::use_awaitable, ec));
+        co_return;
+      }
+      ws.text(ws.got_text());
+      co_await ws.async_write(msg.data(),
+                              net::redirect_error(net::use_awaitable, ec));
+      if (ec) {
+        co_return;
+      }
+      msg.consume(msg.size());
+    }
+  }
+
+  net::io_context ioc_;
+  tcp::acceptor acceptor_;
+  unsigned short port_;
+  std::jthread th_;
+};
+
+typedef winnet::winhttp::basic_winhttp_websocket<net::io_context::executor_type>
+    test_websocket;
+
+int main() {
+  using namespace boost::ut;
+
+  "Echo"_test = [] {
+    echo_server server;
+    net::io_context ioc;
+    test_websocket ws(ioc.get_executor());
+    std::string in;
+    auto buff = net::dynamic_buffer(in);
+    bool done = false;
+    auto run = [&]() -> net::awaitable<void> {
+      co_await ws.async_connect(server.url(), net::use_awaitable);
+      expect(ws.is_open());
+
+      ws.text(true);
+      std::string hello = "hello";
+      co_await ws.async_write(net::buffer(hello), net::use_awaitable);
+      std::size_t n = co_await ws.async_read(buff, net::use_awaitable);
+      expect(5u == n);
+      expect(in == "hello");
+      expect(ws.got_text());
+
+      // buffers of one write are one message.
+      buff.consume(buff.size());
+      ws.text(false);
+      std::string a = "ab";
+      std::string c = "cd";
+      std::array<net::const_buffer, 3> parts = {
+          net::buffer(a), net::const_buffer(), net::buffer(c)};
+      n = co_await ws.async_write(parts, net::use_awaitable);
+      expect(4u == n);
+      co_await ws.async_read(buff, net::use_awaitable);
+      expect(in == "abcd");
+      expect(!ws.got_text());
+
+      // larger than a read chunk, and than the free capacity.
+      buff.consume(buff.size());
+      std::string large(100000, 'x');
+      large[99999] = 'y';
+      co_await ws.async_write(net::buffer(large), net::use_awaitable);
+      n = co_await ws.async_read(buff, net::use_awaitable);
+      expect(100000u == n);
+      expect(in == large);
+
+      co_await ws.async_close(1000, net::use_awaitable);
+      done = true;
+    };
+    net::co_spawn(ioc, run(), [](std::exception_ptr e) {
+      expect(!e >> fatal);
+    });
+    ioc.run();
+    expect(done);
+  };
+
+  // a buffer of several buffers reads the same on both backends.
+  "MultiBuffer"_test = [] {
+    echo_server server;
+    net::io_context ioc;
+    test_websocket ws(ioc.get_executor());
+    beast::multi_buffer buff;
+    bool done = false;
+    auto run = [&]() -> net::awaitable<void> {
+      co_await ws.async_connect(server.url(), net::use_awaitable);
+      std::string large(100000, 'x');
+      large[99999] = 'y';
+      co_await ws.async_write(net::buffer(large), net::use_awaitable);
+      std::size_t n = co_await ws.async_read(buff, net::use_awaitable);
+      expect(100000u == n);
+      expect(beast::buffers_to_string(buff.data()) == large);
+      co_await ws.async_close(1000, net::use_awaitable);
+      done = true;
+    };
+    net::co_spawn(ioc, run(), [](std::exception_ptr e) {
+      expect(!e >> fatal);
+    });
+    ioc.run();
+    expect(done);
+  };
+
+  // a read and a write are outstanding at the same time.
+  "FullDuplex"_test = [] {
+    echo_server server;
+    net::io_context ioc;
+    test_websocket ws(ioc.get_executor());
+    const int count = 1000;
+    int sent = 0;
+    int received = 0;
+    auto writer = [&]() -> net::awaitable<void> {
+      for (int i = 0; i < count; ++i) {
+        std::string msg = std::to_string(i);
+        co_await ws.async_write(net::buffer(msg), net::use_awaitable);
+        ++sent;
+      }
+    };
+    auto reader = [&]() -> net::awaitable<void> {
+      std::string in;
+      auto buff = net::dynamic_buffer(in);
+      for (int i = 0; i < count; ++i) {
+        buff.consume(buff.size());
+        co_await ws.async_read(buff, net::use_awaitable);
+        expect(in == std::to_string(i)) << in;
+        ++received;
+      }
+      co_await ws.async_close(1000, net::use_awaitable);
+    };
+    ws.async_connect(server.url(), [&](boost::system::error_code ec) {
+      expect(!ec.failed() >> fatal);
+      net::co_spawn(ioc, writer(), net::detached);
+      net::co_spawn(ioc, reader(), net::detached);
+    });
+    ioc.run();
+    expect(count == sent);
+    expect(count == received);
+  };
+
+  "PeerClose"_test = [] {
+    echo_server server;
+    net::io_context ioc;
+    test_websocket ws(ioc.get_executor());
+    boost::system::error_code read_ec;
+    auto run = [&]() -> net::awaitable<void> {
+      co_await ws.async_connect(server.url(), net::use_awaitable);
+      std::string msg = "close";
+      co_await ws.async_write(net::buffer(msg), net::use_awaitable);
+      std::string in;
+      auto buff = net::dynamic_buffer(in);
+      co_await ws.async_read(buff,
+                             net::redirect_error(net::use_awaitable, read_ec));
+    };
+    net::co_spawn(ioc, run(), net::detached);
+    ioc.run();
+    expect(read_ec == net::error::eof) << read_ec.message();
+    expect(1000 == ws.close_code());
+  };
+
+  "Errors"_test = [] {
+    echo_server server;
+    net::io_context ioc;
+    boost::system::error_code ec1, ec2, ec3;
+
+    test_websocket ws1(ioc.get_executor());
+    ws1.async_connect(L"http://127.0.0.1/",
+                      [&](boost::system::error_code ec) { ec1 = ec; });
+    // handler is not invoked inline.
+    expect(!ec1.failed());
+
+    test_websocket ws2(ioc.get_executor());
+    ws2.async_connect(server.url(L"/decline"),
+                      [&](boost::system::error_code ec) { ec2 = ec; });
+
+    // nothing listens on the port of a closed acceptor.
+    unsigned short port = 0;
+    {
+      tcp::acceptor a(ioc, {net::ip::make_address("127.0.0.1"), 0});
+      port = a.local_endpoint().port();
+    }
+    test_websocket ws3(ioc.get_executor());
+    ws3.async_connect(L"ws://127.0.0.1:" + std::to_wstring(port) + L"/",
+                      [&](boost::system::error_code ec) { ec3 = ec; });
+    ioc.run();
+    expect(ec1 == net::error::invalid_argument) << ec1.message();
+    expect(ec2 == boost::system::errc::protocol_error) << ec2.message();
+    expect(ec3.failed());
+    expect(!ws2.is_open());
+  };
+}
@@ -0,0 +1,203 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// The step state machine of winhttp requests, completed by plain threads in
+// place of winhttp callbacks.
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/winhttp/winhttp_step.hpp"
+
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace net = boost::asio;
+namespace winnet = boost::winasio;
+
+// callback threads, joined before the steps they complete go away.
+class callback_threads {
+public:
+  callback_threads() = default;
+  callback_threads(const callback_threads &) = delete;
+  callback_threads &operator=(const callback_threads &) = delete;
+  ~callback_threads() { join(); }
+
+  template <typename Function> void run(Function &&f) {
+    threads_.emplace_back(std::forward<Function>(f));
+  }
+
+  void join() {
+    for (auto &t : threads_) {
+      t.join();
+    }
+    threads_.clear();
+  }
+
+private:
+  std::vector<std::thread> threads_;
+};
+
+int main() {
+  using namespace boost::ut;
+
+  "AsyncStep"_test = [] {
+    using winnet::winhttp::details::async_step;
+    using winnet::winhttp::details::step_state;
+    net::io_context io_context;
+    async_step<net::io_context::executor_type> step(
+        io_context.get_executor());
+
+    // callback completes the step before the handler is stored.
+    step.begin(step_state::read_complete);
+    step.complete({}, 42);
+    std::size_t got = 0;
+    winnet::winhttp::details::async_wait_step_len(
+        step, [&got](boost::system::error_code ec, std::size_t len) {
+          expect(!ec.failed() >> fatal);
+          got = len;
+        });
+    // handler is posted, never invoked inline.
+    expect(0u == got);
+    io_context.run();
+    expect(42u == got);
+
+    // callback thread completes the step after the handler is stored.
+    io_context.restart();
+    callback_threads threads;
+    int steps = 0;
+    std::function<void()> next = [&] {
+      step.begin(step_state::send_request);
+      threads.run([&step] { step.complete({}); });
+      winnet::winhttp::details::async_wait_step(
+          step, [&](boost::system::error_code ec) {
+            expect(!ec.failed() >> fatal);
+            if (++steps < 100) {
+              next();
+            }
+          });
+    };
+    next();
+    // the pending step keeps run() from returning.
+    io_context.run();
+    threads.join();
+    expect(100 == steps);
+    // and the first step above.
+    expect(101u == step.completed_steps());
+  };
+
+  "DuplexStep"_test = [] {
+    using winnet::winhttp::details::direction_of;
+    using winnet::winhttp::details::duplex_step;
+    using winnet::winhttp::details::step_direction;
+    using winnet::winhttp::details::step_state;
+    expect(step_direction::write == direction_of(step_state::send_request));
+    expect(step_direction::write == direction_of(step_state::write_complete));
+    expect(step_direction::write == direction_of(step_state::close_complete));
+    expect(step_direction::read == direction_of(step_state::read_complete));
+    expect(step_direction::read ==
+           direction_of(step_state::headers_available));
+
+    net::io_context io_context;
+    duplex_step<net::io_context::executor_type> steps(
+        io_context.get_executor());
+
+    // writes and reads are outstanding together, completed by different
+    // threads in any order.
+    callback_threads threads;
+    int writes = 0;
+    int reads = 0;
+    std::function<void()> next_write = [&] {
+      auto &step = steps.get(step_direction::write);
+      step.begin(step_state::write_complete);
+      threads.run([&step] { step.complete({}, 7); });
+      winnet::winhttp::details::async_wait_step_len(
+          step, [&](boost::system::error_code ec, std::size_t len) {
+            expect(!ec.failed() >> fatal);
+            expect(7u == len);
+            if (++writes < 100) {
+              next_write();
+            }
+          });
+    };
+    std::function<void()> next_read = [&] {
+      auto &step = steps.get(step_direction::read);
+      step.begin(step_state::read_complete);
+      threads.run([&step] { step.complete({}, 9); });
+      winnet::winhttp::details::async_wait_step_len(
+          step, [&](boost::system::error_code ec, std::size_t len) {
+            expect(!ec.failed() >> fatal);
+            expect(9u == len);
+            if (++reads < 100) {
+              next_read();
+            }
+          });
+    };
+    next_write();
+    next_read();
+    io_context.run();
+    threads.join();
+    expect(100 == writes);
+    expect(100 == reads);
+    expect(200u == steps.completed_steps());
+  };
+
+  "StepCancellation"_test = [] {
+    using winnet::winhttp::details::async_step;
+    using winnet::winhttp::details::step_state;
+    net::io_context io_context;
+    async_step<net::io_context::executor_type> step(
+        io_context.get_executor());
+    // like closing a winhttp handle, fails the pending call.
+    callback_threads threads;
+    int cancels = 0;
+    step.set_canceller([&] {
+      ++cancels;
+      threads.run([&step] {
+        step.complete(boost::system::error_code(
+                          12017, boost::system::system_category()),
+                      0);
+      });
+    });
+    net::cancellation_signal signal;
+    boost::system::error_code result;
+    step.begin(step_state::read_complete);
+    winnet::winhttp::details::async_wait_step_len(
+        step, net::bind_cancellation_slot(
+                  signal.slot(),
+                  [&](boost::system::error_code ec, std::size_t) {
+                    result = ec;
+                  }));
+    // partial cancellation would leave the request usable, winhttp can not.
+    signal.emit(net::cancellation_type::partial);
+    expect(0 == cancels);
+    signal.emit(net::cancellation_type::terminal);
+    io_context.run();
+    threads.join();
+    expect(1 == cancels);
+    expect(result == net::error::operation_aborted) << result.message();
+
+    // the slot is cleared once the step completes.
+    io_context.restart();
+    step.begin(step_state::read_complete);
+    step.complete({}, 3);
+    winnet::winhttp::details::async_wait_step_len(
+        step, net::bind_cancellation_slot(
+                  signal.slot(),
+                  [&](boost::system::error_code ec, std::size_t) {
+                    result = ec;
+                  }));
+    io_context.run();
+    expect(!result.failed());
+    signal.emit(net::cancellation_type::terminal);
+    expect(1 == cancels);
+  };
+}
@@ -0,0 +1,169 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Deterministic simulation. Time is virtual: sim::clock only moves when
+// sim::run finds no handler ready, by the resolution given, so a run of
+// minutes of timeouts takes milliseconds, and the order of handlers depends
+// on nothing but the program and the seed. Faults are drawn from
+// sim::random, seeded by the test, whose distributions are computed here as
+// those of the standard library differ between implementations.
+// The harness is single threaded: one io_context, run only by sim::run.
+
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace net = boost::asio;
+
+namespace sim {
+
+// Shares the epoch and duration of steady_clock, so that its time points
+// are those of steady_clock, as taken by admission_control and the latency
+// tracker of the client pool.
+class clock {
+public:
+  typedef std::chrono::steady_clock::duration duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::steady_clock::time_point time_point;
+  static constexpr bool is_steady = true;
+
+  static time_point now() noexcept { return time_point(offset()); }
+
+  static void advance(duration d) noexcept { offset() += d; }
+
+  // back to the start, for the next test.
+  static void reset() noexcept { offset() = duration::zero(); }
+
+private:
+  static duration &offset() noexcept {
+    static duration d = duration::zero();
+    return d;
+  }
+};
+
+// Timers never wait in real time, the io_context checks them on every
+// poll, and they fire once run has advanced the clock past their expiry.
+struct wait_traits {
+  static clock::duration to_wait_duration(const clock::duration &) {
+    return clock::duration::zero();
+  }
+  static clock::duration to_wait_duration(const clock::time_point &) {
+    return clock::duration::zero();
+  }
+};
+
+typedef net::basic_waitable_timer<clock, wait_traits> timer;
+
+// Runs the ready handlers of ioc, and advances the clock by resolution when
+// there are none, until ioc is out of work or the clock reaches until.
+// Returns the number of handlers run.
+inline std::size_t
+run(net::io_context &ioc,
+    clock::duration resolution = std::chrono::milliseconds(1),
+    clock::time_point until = clock::time_point::max()) {
+  std::size_t n = 0;
+  ioc.restart();
+  for (;;) {
+    std::size_t ran = ioc.poll();
+    n += ran;
+    if (ioc.stopped()) {
+      break;
+    }
+    if (ran == 0) {
+      if (clock::now() >= until) {
+        break;
+      }
+      clock::advance(resolution);
+    }
+  }
+  return n;
+}
+
+// mt19937_64, whose sequence is fixed by the standard, and distributions
+// over it.
+class random {
+public:
+  explicit random(std::uint64_t seed) : gen_(seed) {}
+
+  // in [0, 1).
+  double uniform() { return static_cast<double>(gen_() >> 11) * 0x1.0p-53; }
+
+  bool chance(double p) { return p > 0 && uniform() < p; }
+
+  // in [0, n).
+  std::uint64_t below(std::uint64_t n) {
+    return n == 0 ? 0 : static_cast<std::uint64_t>(uniform() * n);
+  }
+
+  double exponential(double mean) { return -mean * std::log1p(-uniform()); }
+
+  // with the median and sigma of the log, by Box-Muller.
+  double lognormal(double median, double sigma) {
+    double u = 1.0 - uniform();
+    double v = uniform();
+    double z = std::sqrt(-2.0 * std::log(u)) * std::cos(6.283185307179586 * v);
+    return median * std::exp(sigma * z);
+  }
+
+private:
+  std::mt19937_64 gen_;
+};
+
+// Latency of an operation: fixed, plus a lognormal part, plus rarely a
+// stall, the tail.
+struct latency_model {
+  clock::duration fixed{};
+  // median of the lognormal part, zero for none.
+  clock::duration median{};
+  double sigma = 0.5;
+  double stall_rate = 0;
+  clock::duration stall{};
+
+  clock::duration sample(random &r) const {
+    clock::duration d = fixed;
+    if (median.count() > 0) {
+      d += clock::duration(static_cast<clock::rep>(
+          r.lognormal(static_cast<double>(median.count()), sigma)));
+    }
+    if (r.chance(stall_rate)) {
+      d += stall;
+    }
+    return d;
+  }
+};
+
+// What happened and when, compared between runs of one seed.
+class trace {
+public:
+  void add(const std::string &event) {
+    events_.push_back(
+        std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(
+                           clock::now().time_since_epoch())
+                           .count()) +
+        " " + event);
+  }
+
+  const std::vector<std::string> &events() const noexcept { return events_; }
+
+  bool operator==(const trace &other) const {
+    return events_ == other.events_;
+  }
+
+private:
+  std::vector<std::string> events_;
+};
+
+} // namespace sim
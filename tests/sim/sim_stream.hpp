@@ -0,0 +1,179 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Read side of a pipe in virtual time, in place of a named pipe handle. The
+// test pushes messages, reads take a latency drawn from the model. In byte
+// mode a read returns what is available across messages, or with
+// partial_rate a shorter part of it. In message mode, as a pipe opened with
+// PIPE_READMODE_MESSAGE, a read returns at most one message, and one smaller
+// than the message returns what fits with ERROR_MORE_DATA, the rest follows
+// with the next read. A disconnect drops the unread data and fails the read
+// with broken_pipe, the reads after it with eof.
+
+#include "sim.hpp"
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string>
+
+namespace sim {
+
+struct stream_faults {
+  latency_model latency;
+  // reads returning less than they could, in byte mode.
+  double partial_rate = 0;
+  // reads failing with broken_pipe, the end of the stream.
+  double disconnect_rate = 0;
+  bool message_mode = false;
+};
+
+#ifdef _WIN32
+const int more_data_value = ERROR_MORE_DATA;
+#else  // _WIN32
+const int more_data_value = 234;
+#endif // _WIN32
+
+inline boost::system::error_code more_data_error() {
+  return boost::system::error_code(more_data_value,
+                                   net::error::get_system_category());
+}
+
+class stream {
+public:
+  typedef net::io_context::executor_type executor_type;
+
+  stream(const executor_type &ex, std::uint64_t seed,
+         const stream_faults &faults)
+      : ex_(ex), random_(seed), faults_(faults), offset_(0), closed_(false),
+        reads_(0) {}
+
+  executor_type get_executor() const noexcept { return ex_; }
+
+  void push(std::string message) {
+    if (!closed_) {
+      messages_.push_back(std::move(message));
+    }
+  }
+
+  // the writer is gone, reads return eof once the data is read.
+  void close() { closed_ = true; }
+
+  // reads of the handle, as counted by the os.
+  int reads() const noexcept { return reads_; }
+
+  const sim::trace &get_trace() const noexcept { return trace_; }
+
+  // not completed inside the initiation. Without data waits for it, by
+  // steps of 1ms of virtual time.
+  template <typename MutableBufferSequence, typename Token>
+  auto async_read_some(const MutableBufferSequence &buffers, Token &&token) {
+    return net::async_initiate<Token, void(boost::system::error_code,
+                                           std::size_t)>(
+        [this](auto handler, const MutableBufferSequence &b) {
+          auto t = std::make_shared<timer>(ex_,
+                                           faults_.latency.sample(random_));
+          wait_read(std::move(t), b, std::move(handler));
+        },
+        token, buffers);
+  }
+
+  // without latency. Without data fails with would_block.
+  template <typename MutableBufferSequence>
+  std::size_t read_some(const MutableBufferSequence &buffers,
+                        boost::system::error_code &ec) {
+    std::size_t n = 0;
+    if (!take(buffers, n, ec)) {
+      ec = net::error::would_block;
+    }
+    return n;
+  }
+
+private:
+  template <typename MutableBufferSequence, typename Handler>
+  void wait_read(std::shared_ptr<timer> t, const MutableBufferSequence &b,
+                 Handler &&handler) {
+    t->async_wait([this, t, b, h = std::move(handler)](
+                      boost::system::error_code) mutable {
+      std::size_t n = 0;
+      boost::system::error_code ec;
+      if (!take(b, n, ec)) {
+        t->expires_after(std::chrono::milliseconds(1));
+        wait_read(std::move(t), b, std::move(h));
+        return;
+      }
+      std::move(h)(ec, n);
+    });
+  }
+
+  // false if there is nothing to read yet.
+  template <typename MutableBufferSequence>
+  bool take(const MutableBufferSequence &buffers, std::size_t &n,
+            boost::system::error_code &ec) {
+    n = 0;
+    ec = boost::system::error_code();
+    if (messages_.empty()) {
+      if (!closed_) {
+        return false;
+      }
+      ec = net::error::eof;
+      return true;
+    }
+    ++reads_;
+    if (random_.chance(faults_.disconnect_rate)) {
+      messages_.clear();
+      offset_ = 0;
+      closed_ = true;
+      trace_.add("disconnect");
+      ec = net::error::broken_pipe;
+      return true;
+    }
+    std::size_t room = net::buffer_size(buffers);
+    if (!faults_.message_mode && room > 1 &&
+        random_.chance(faults_.partial_rate)) {
+      room = 1 + random_.below(room - 1);
+    }
+    std::string out;
+    while (out.size() < room && !messages_.empty()) {
+      const std::string &m = messages_.front();
+      std::size_t c = (std::min)(room - out.size(), m.size() - offset_);
+      out.append(m, offset_, c);
+      offset_ += c;
+      if (offset_ < m.size()) {
+        if (faults_.message_mode) {
+          ec = more_data_error();
+        }
+        break;
+      }
+      messages_.pop_front();
+      offset_ = 0;
+      if (faults_.message_mode) {
+        break;
+      }
+    }
+    n = net::buffer_copy(buffers, net::buffer(out));
+    trace_.add("read " + std::to_string(n) + (ec ? " more" : ""));
+    return true;
+  }
+
+  executor_type ex_;
+  random random_;
+  stream_faults faults_;
+  std::deque<std::string> messages_;
+  std::size_t offset_;
+  bool closed_;
+  int reads_;
+  sim::trace trace_;
+};
+
+} // namespace sim
@@ -0,0 +1,395 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Retries, timeouts, backpressure and read ahead under injected faults, in
+// virtual time. Each scenario is run from a seed, and replays the same.
+
+#include <boost/ut.hpp>
+
+#include "boost/winasio/http/http_admission.hpp"
+#include "boost/winasio/named_pipe/read_ahead.hpp"
+
+#include "sim.hpp"
+#include "sim_stream.hpp"
+#include "sim_transport.hpp"
+
+#include <boost/asio/read.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace winnet = boost::winasio;
+using namespace std::chrono_literals;
+
+struct pool_result {
+  int ok = 0;
+  int timed_out = 0;
+  int failed = 0;
+  sim::clock::time_point last;
+  sim::transport::stats stats;
+  sim::trace trace;
+};
+
+// n requests to one host, with max_per_host slots, one every spacing, all
+// at once if zero.
+pool_result run_pool(std::uint64_t seed, const sim::transport_faults &faults,
+                     const winhttp::request_policy &policy, int n,
+                     std::size_t max_per_host,
+                     sim::clock::duration spacing = {}) {
+  sim::clock::reset();
+  net::io_context ioc(1);
+  sim::client_pool pool(ioc.get_executor(),
+                        sim::transport(ioc.get_executor(), seed, faults),
+                        max_per_host);
+  winhttp::host_key key{false, L"sim", 80};
+  auto body = std::make_shared<const std::string>("sim");
+  pool_result r;
+  auto request = [&] {
+    pool.async_request(key, {L"GET", L"/", L"", body}, policy,
+                       [&r](boost::system::error_code ec,
+                            winhttp::client_response resp) {
+                         r.last = sim::clock::now();
+                         if (!ec) {
+                           ++r.ok;
+                           boost::ut::expect(200u == resp.status);
+                         } else if (ec == net::error::timed_out) {
+                           ++r.timed_out;
+                         } else {
+                           ++r.failed;
+                         }
+                       });
+  };
+  sim::timer arrivals(ioc);
+  int sent = 0;
+  std::function<void()> next = [&] {
+    while (sent < n) {
+      request();
+      if (++sent < n && spacing.count() > 0) {
+        arrivals.expires_after(spacing);
+        arrivals.async_wait([&](boost::system::error_code) { next(); });
+        return;
+      }
+    }
+  };
+  next();
+  sim::run(ioc);
+  r.stats = pool.get_transport().get_stats();
+  r.trace = pool.get_transport().get_trace();
+  return r;
+}
+
+// slow tail, resets and hangs.
+sim::transport_faults unreliable() {
+  sim::transport_faults f;
+  f.latency.fixed = 2ms;
+  f.latency.median = 20ms;
+  f.latency.sigma = 0.8;
+  f.latency.stall_rate = 0.02;
+  f.latency.stall = 2s;
+  f.reset_rate = 0.1;
+  f.hang_rate = 0.05;
+  return f;
+}
+
+winhttp::request_policy retrying() {
+  winhttp::request_policy p;
+  p.timeout = 1s;
+  p.attempt_timeout = 200ms;
+  p.max_attempts = 3;
+  p.hedge = true;
+  return p;
+}
+
+struct admission_result {
+  int admitted = 0;
+  int shed = 0;
+  std::size_t max_in_flight = 0;
+};
+
+// Poisson arrivals at rate per second for the duration, each admitted one
+// is processed for a latency drawn from the model.
+admission_result run_admission(std::uint64_t seed, double rate,
+                               sim::clock::duration duration,
+                               const sim::latency_model &latency) {
+  sim::clock::reset();
+  net::io_context ioc(1);
+  sim::random random(seed);
+  winnet::http::admission_control ac;
+  winnet::http::admission_options options;
+  options.max_in_flight = 50;
+  ac.set_options(options);
+  winnet::http::route_admission route;
+  route.set_limits({0, 1000, 20});
+  admission_result r;
+  sim::timer arrivals(ioc);
+  sim::clock::time_point end = sim::clock::now() + duration;
+  std::function<void()> next = [&] {
+    arrivals.expires_after(std::chrono::duration_cast<sim::clock::duration>(
+        std::chrono::duration<double>(random.exponential(1.0 / rate))));
+    arrivals.async_wait([&](boost::system::error_code) {
+      if (sim::clock::now() >= end) {
+        return;
+      }
+      if (ac.admit(&route, sim::clock::now()) !=
+          winnet::http::admission_result::admitted) {
+        ++r.shed;
+      } else {
+        ++r.admitted;
+        r.max_in_flight = (std::max)(r.max_in_flight, ac.in_flight());
+        auto t = std::make_shared<sim::timer>(ioc, latency.sample(random));
+        t->async_wait([&ac, &route, t](boost::system::error_code) {
+          ac.release(&route);
+        });
+      }
+      next();
+    });
+  };
+  next();
+  sim::run(ioc, 100us);
+  boost::ut::expect(0u == ac.in_flight());
+  return r;
+}
+
+// frames of a 4 byte header and a body, as an rpc over a pipe.
+const std::size_t frame_size = 64;
+const std::size_t header_size = 4;
+
+std::string frame(int i) {
+  std::string f(frame_size, static_cast<char>('a' + i % 26));
+  std::memcpy(f.data(), &i, header_size);
+  return f;
+}
+
+// reads of s through a read ahead buffer, as a pipe with set_read_ahead.
+class ahead_stream {
+public:
+  typedef sim::stream::executor_type executor_type;
+
+  ahead_stream(sim::stream &s, std::size_t capacity)
+      : s_(s),
+        ahead_(std::make_shared<winnet::details::read_ahead_buffer>(capacity)) {
+  }
+
+  executor_type get_executor() const noexcept { return s_.get_executor(); }
+
+  template <typename MutableBufferSequence, typename Token>
+  auto async_read_some(const MutableBufferSequence &buffers, Token &&token) {
+    return winnet::details::async_read_ahead(s_, ahead_, buffers,
+                                             std::forward<Token>(token));
+  }
+
+private:
+  sim::stream &s_;
+  std::shared_ptr<winnet::details::read_ahead_buffer> ahead_;
+};
+
+struct frames_result {
+  int frames = 0;
+  boost::system::error_code ec;
+};
+
+// reads frames as header and body until an error, checks their content.
+template <typename Stream>
+frames_result read_frames(net::io_context &ioc, Stream &s) {
+  frames_result r;
+  std::array<char, frame_size> in;
+  std::function<void()> next = [&] {
+    net::async_read(
+        s, net::buffer(in.data(), header_size),
+        [&](boost::system::error_code ec, std::size_t) {
+          if (ec) {
+            r.ec = ec;
+            return;
+          }
+          net::async_read(s,
+                          net::buffer(in.data() + header_size,
+                                      frame_size - header_size),
+                          [&](boost::system::error_code e, std::size_t) {
+                            if (e) {
+                              r.ec = e;
+                              return;
+                            }
+                            boost::ut::expect(
+                                frame(r.frames) ==
+                                std::string(in.data(), in.size()))
+                                << r.frames;
+                            ++r.frames;
+                            next();
+                          });
+        });
+  };
+  next();
+  sim::run(ioc, 10us);
+  return r;
+}
+
+int main() {
+  using namespace boost::ut;
+
+  "Replay"_test = [] {
+    pool_result a = run_pool(42, unreliable(), retrying(), 500, 8, 2ms);
+    pool_result b = run_pool(42, unreliable(), retrying(), 500, 8, 2ms);
+    pool_result c = run_pool(43, unreliable(), retrying(), 500, 8, 2ms);
+    expect(500 == a.ok + a.timed_out + a.failed);
+    expect(a.stats.resets > 0) << a.stats.resets;
+    expect(a.stats.hangs > 0) << a.stats.hangs;
+    expect(a.stats.cancelled > 0) << a.stats.cancelled;
+    expect(a.trace.events().size() > 1000u) << a.trace.events().size();
+    expect(a.trace == b.trace);
+    expect(a.ok == b.ok && a.timed_out == b.timed_out);
+    expect(a.last == b.last);
+    expect(!(a.trace == c.trace));
+  };
+
+  // retries are paid from the budget of the pool, 10% of the requests.
+  "RetryBudget"_test = [] {
+    sim::transport_faults f;
+    f.latency.median = 10ms;
+    f.reset_rate = 0.5;
+    winhttp::request_policy p;
+    p.max_attempts = 3;
+    pool_result r = run_pool(7, f, p, 1000, 16, 1ms);
+    expect(1000 == r.ok + r.failed);
+    expect(r.stats.attempts > 1000);
+    expect(r.stats.attempts <= 1000 + 100 + 10) << r.stats.attempts;
+    expect(r.failed >= 400) << r.failed;
+  };
+
+  // retries hide the resets while the budget lasts.
+  "Retries"_test = [] {
+    sim::transport_faults f;
+    f.latency.median = 10ms;
+    f.reset_rate = 0.05;
+    winhttp::request_policy p;
+    p.max_attempts = 3;
+    pool_result r = run_pool(11, f, p, 1000, 16, 1ms);
+    expect(r.stats.resets > 20) << r.stats.resets;
+    expect(r.failed < r.stats.resets / 4) << r.failed;
+    expect(1000 == r.ok + r.failed);
+  };
+
+  // hung attempts are cut by the attempt timeout, and no request outlives
+  // its deadline, queueing for a slot included.
+  "Timeouts"_test = [] {
+    sim::transport_faults f;
+    f.latency.median = 30ms;
+    f.hang_rate = 0.2;
+    winhttp::request_policy p;
+    p.timeout = 1s;
+    p.attempt_timeout = 100ms;
+    p.max_attempts = 2;
+    pool_result r = run_pool(3, f, p, 400, 8);
+    expect(400 == r.ok + r.timed_out);
+    expect(0 == r.failed);
+    expect(r.timed_out > 0);
+    expect(r.stats.cancelled >= r.stats.hangs);
+    expect(r.last <= sim::clock::time_point(1s + 1ms));
+  };
+
+  // attempts and hedges never exceed the slots of the host.
+  "Backpressure"_test = [] {
+    sim::transport_faults f = unreliable();
+    pool_result r = run_pool(5, f, retrying(), 300, 4);
+    expect(4 == r.stats.max_in_flight);
+    expect(0 == r.stats.in_flight);
+  };
+
+  // twice the rate of the route: about half is shed, the in flight limit
+  // holds with the slow tail.
+  "Admission"_test = [] {
+    sim::latency_model latency;
+    latency.median = 10ms;
+    latency.stall_rate = 0.01;
+    latency.stall = 500ms;
+    admission_result a = run_admission(9, 2000, 10s, latency);
+    admission_result b = run_admission(9, 2000, 10s, latency);
+    expect(a.admitted == b.admitted && a.shed == b.shed);
+    double shed_ratio =
+        static_cast<double>(a.shed) / static_cast<double>(a.admitted + a.shed);
+    expect(shed_ratio > 0.4 && shed_ratio < 0.6) << shed_ratio;
+    expect(a.max_in_flight <= 50u);
+  };
+
+  // small reads of a message mode pipe fail with more data, through the
+  // read ahead buffer each message is one read of the handle.
+  "ReadAheadMessages"_test = [] {
+    sim::stream_faults f;
+    f.message_mode = true;
+    f.latency.median = 50us;
+    for (std::size_t capacity : {std::size_t(0), std::size_t(64 * 1024)}) {
+      sim::clock::reset();
+      net::io_context ioc(1);
+      sim::stream s(ioc.get_executor(), 1, f);
+      for (int i = 0; i < 1000; ++i) {
+        s.push(frame(i));
+      }
+      s.close();
+      ahead_stream as(s, capacity == 0 ? 1 : capacity);
+      frames_result r =
+          capacity == 0 ? read_frames(ioc, s) : read_frames(ioc, as);
+      if (capacity == 0) {
+        expect(r.ec == sim::more_data_error());
+        expect(0 == r.frames);
+      } else {
+        expect(r.ec == net::error::eof);
+        expect(1000 == r.frames);
+        expect(1000 == s.reads());
+      }
+    }
+  };
+
+  // frames survive partial reads, a disconnect ends the stream.
+  "ReadAheadFaults"_test = [] {
+    sim::stream_faults f;
+    f.latency.median = 50us;
+    f.partial_rate = 0.5;
+    sim::clock::reset();
+    net::io_context ioc(1);
+    sim::stream s(ioc.get_executor(), 2, f);
+    ahead_stream as(s, 256);
+    // the writer is slower than the reader.
+    sim::timer writer(ioc);
+    int written = 0;
+    std::function<void()> write = [&] {
+      writer.expires_after(1ms);
+      writer.async_wait([&](boost::system::error_code) {
+        for (int i = 0; i < 5; ++i) {
+          s.push(frame(written++));
+        }
+        if (written < 1000) {
+          write();
+        } else {
+          s.close();
+        }
+      });
+    };
+    write();
+    frames_result r = read_frames(ioc, as);
+    expect(r.ec == net::error::eof);
+    expect(1000 == r.frames);
+    expect(s.reads() < 2000) << s.reads();
+
+    f.disconnect_rate = 0.01;
+    sim::clock::reset();
+    sim::stream d(ioc.get_executor(), 2, f);
+    for (int i = 0; i < 1000; ++i) {
+      d.push(frame(i));
+    }
+    ahead_stream ad(d, 256);
+    frames_result rd = read_frames(ioc, ad);
+    expect(rd.ec == net::error::broken_pipe);
+    expect(rd.frames < 1000);
+    expect(d.get_trace().events().back().find("disconnect") !=
+           std::string::npos);
+  };
+}
@@ -0,0 +1,129 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Transport of basic_client_pool in virtual time, in place of winhttp. Each
+// attempt takes a latency drawn from the model, then completes, fails as a
+// reset connection, or hangs until cancelled. Deadlines and hedges of the
+// pool use sim::timer, see timer_type.
+
+#include "boost/winasio/winhttp/client_pool.hpp"
+
+#include "sim.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+namespace winhttp = boost::winasio::winhttp;
+
+namespace sim {
+
+struct transport_faults {
+  latency_model latency;
+  // attempts failing with connection_reset after their latency.
+  double reset_rate = 0;
+  // attempts never completing, until the pool cancels them.
+  double hang_rate = 0;
+  // connects failing with connection_refused.
+  double refuse_rate = 0;
+};
+
+class transport {
+public:
+  typedef net::io_context::executor_type executor_type;
+  typedef sim::timer timer_type;
+  struct connection_type {};
+
+  struct stats {
+    int connects = 0;
+    int attempts = 0;
+    int resets = 0;
+    int hangs = 0;
+    int cancelled = 0;
+    int in_flight = 0;
+    int max_in_flight = 0;
+  };
+
+  transport(const executor_type &ex, std::uint64_t seed,
+            const transport_faults &faults)
+      : ex_(ex), random_(std::make_shared<random>(seed)), faults_(faults),
+        stats_(std::make_shared<stats>()),
+        trace_(std::make_shared<sim::trace>()) {}
+
+  std::unique_ptr<connection_type> connect(const winhttp::host_key &,
+                                           boost::system::error_code &ec) {
+    ++stats_->connects;
+    if (random_->chance(faults_.refuse_rate)) {
+      trace_->add("refused");
+      ec = net::error::connection_refused;
+      return nullptr;
+    }
+    return std::make_unique<connection_type>();
+  }
+
+  template <typename Handler>
+  void async_exec(connection_type &, const winhttp::client_request &req,
+                  std::shared_ptr<winhttp::cancel_signal> cancel,
+                  Handler &&handler) {
+    int id = ++stats_->attempts;
+    stats_->max_in_flight = (std::max)(stats_->max_in_flight,
+                                       ++stats_->in_flight);
+    // the draws of an attempt do not depend on its outcome.
+    clock::duration latency = faults_.latency.sample(*random_);
+    bool hang = random_->chance(faults_.hang_rate);
+    bool reset = random_->chance(faults_.reset_rate);
+    std::string name = "attempt " + std::to_string(id);
+    auto t = std::make_shared<timer_type>(ex_);
+    if (hang) {
+      ++stats_->hangs;
+      t->expires_at(clock::time_point::max());
+    } else {
+      t->expires_after(latency);
+    }
+    cancel->install([t, ex = ex_] { net::post(ex, [t] { t->cancel(); }); });
+    trace_->add(name + " start");
+    t->async_wait([t, reset, name, body = req.body, s = stats_, tr = trace_,
+                   h = std::move(handler)](
+                      boost::system::error_code ec) mutable {
+      --s->in_flight;
+      if (ec) {
+        ++s->cancelled;
+        tr->add(name + " cancelled");
+        h(net::error::operation_aborted, winhttp::client_response{});
+        return;
+      }
+      if (reset) {
+        ++s->resets;
+        tr->add(name + " reset");
+        h(net::error::connection_reset, winhttp::client_response{});
+        return;
+      }
+      tr->add(name + " done");
+      winhttp::client_response resp;
+      resp.status = 200;
+      resp.body = body;
+      h(boost::system::error_code(), std::move(resp));
+    });
+  }
+
+  const stats &get_stats() const noexcept { return *stats_; }
+
+  const sim::trace &get_trace() const noexcept { return *trace_; }
+
+private:
+  executor_type ex_;
+  std::shared_ptr<random> random_;
+  transport_faults faults_;
+  std::shared_ptr<stats> stats_;
+  std::shared_ptr<sim::trace> trace_;
+};
+
+typedef winhttp::basic_client_pool<transport> client_pool;
+
+} // namespace sim
@@ -31,6 +31,13 @@ boost::ut::suite errors = [] {
     boost::ut::expect(12345 == x.get_port());
     boost::ut::expect(std::wstring(L"/person") == x.get_path());
     boost::ut::expect(std::wstring(L"?name=john") == x.get_query());
+
+    // longer than the buffers WinHttpCrackUrl used to be given.
+    std::wstring path = L"/" + std::wstring(500, L'p');
+    x.crack(L"http://localhost" + path + L"?q", ec);
+    boost::ut::expect(!ec.failed());
+    boost::ut::expect(path == x.get_path());
+    boost::ut::expect(80 == x.get_port());
   };
 
   // exercise for using buffer.
@@ -16,6 +16,9 @@
 // use beast server for testing
 #include "beast_test_server.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <latch>
 #include <spdlog/spdlog.h>
 
@@ -30,8 +33,11 @@ public:
       // start beast server
       unsigned short port = static_cast<unsigned short>(12345);
       myacceptor acceptor{ioc_, {tcp::v4(), port}};
+      // destroyed before the connections left in ioc_.
+      winnet::deadline_wheel wheel(ioc_.get_executor(),
+                                   std::chrono::seconds(1));
       mysocket socket{ioc_};
-      http_server(acceptor, socket);
+      http_server(acceptor, socket, wheel);
       lch_.count_down();
       ioc_.run();
     });
@@ -119,6 +125,15 @@ int main() {
                                                     content_type);
           expect(!ec.failed() >> fatal);
           expect(L"text/html" == content_type);
+
+          // same values from a single query.
+          winnet::winhttp::response_headers rh;
+          winnet::winhttp::header::get_response_headers(h_request, ec, rh);
+          expect(!ec.failed() >> fatal);
+          expect(rh.raw() == headers);
+          expect(dwStatusCode == rh.status().value());
+          expect(version == rh.version());
+          expect(rh.get(L"content-type").value() == content_type);
         });
 
     io_context.run();
@@ -368,9 +383,12 @@ int main() {
             net::redirect_error(net::use_awaitable, ec));
         expect(!ec.failed() >> fatal);
 
+        // gather write.
+        std::array<net::const_buffer, 2> req_bufs{
+            net::buffer(req_body.data(), 4),
+            net::buffer(req_body.data() + 4, req_body.size() - 4)};
         std::size_t write_len = co_await net::async_write(
-            h_request, net::buffer(req_body),
-            net::redirect_error(net::use_awaitable, ec));
+            h_request, req_bufs, net::redirect_error(net::use_awaitable, ec));
         expect(!ec.failed() >> fatal);
 
         expect(req_len == write_len);
@@ -378,16 +396,158 @@ int main() {
         co_await h_request.async_recieve_response(
             net::redirect_error(net::use_awaitable, ec));
         expect(!ec.failed() >> fatal);
-        std::vector<BYTE> body_buff;
+        // scatter read the head of the body.
+        std::array<char, 16> p1, p2, p3;
+        std::array<net::mutable_buffer, 3> head{
+            net::buffer(p1), net::buffer(p2), net::buffer(p3)};
+        std::size_t head_len = co_await net::async_read(
+            h_request, head, net::redirect_error(net::use_awaitable, ec));
+        expect(!ec.failed() >> fatal);
+        expect(48u == head_len);
+        std::string body_buff(p1.data(), p1.size());
+        body_buff.append(p2.data(), p2.size()).append(p3.data(), p3.size());
+        // the rest, the stream ends with eof.
         co_await net::async_read(h_request, net::dynamic_buffer(body_buff),
                                  net::redirect_error(net::use_awaitable, ec));
-        expect(!ec.failed() >> fatal);
+        expect(ec == net::error::eof);
+        expect(body_buff.find("set to 200") != std::string::npos);
         spdlog::debug("request body:");
-        spdlog::debug(std::string(body_buff.begin(), body_buff.end()));
+        spdlog::debug(body_buff);
       };
       net::co_spawn(io_context, f, net::detached);
     }
 
     io_context.run();
   };
+
+  "ReadBodyModes"_test = [] {
+    spdlog::info("winhttp_request_test - ReadBodyModes test");
+    beast_server bs;
+
+    boost::system::error_code ec;
+    net::io_context io_context;
+    winnet::winhttp::basic_winhttp_session_handle<
+        net::io_context::executor_type>
+        h_session(io_context);
+    h_session.open(ec);
+    expect(!ec.failed() >> fatal);
+    winnet::winhttp::basic_winhttp_connect_handle<
+        net::io_context::executor_type>
+        h_connect(io_context);
+    h_connect.connect(h_session.native_handle(), L"localhost", 12345, ec);
+    expect(!ec.failed() >> fatal);
+
+    // returns the number of winhttp callbacks of the request.
+    auto get = [&](std::wstring path, std::size_t n,
+                   winnet::winhttp::read_body_mode mode) {
+      winnet::winhttp::basic_winhttp_request_asio_handle<
+          net::io_context::executor_type>
+          h_request(io_context.get_executor());
+      h_request.managed_open(h_connect.native_handle(), L"GET", path.c_str(),
+                             NULL, WINHTTP_NO_REFERER,
+                             WINHTTP_DEFAULT_ACCEPT_TYPES, NULL, ec);
+      expect(!ec.failed() >> fatal);
+      std::vector<BYTE> body;
+      auto buff = net::dynamic_buffer(body);
+      auto f = [&]() -> net::awaitable<void> {
+        co_await h_request.async_send(
+            NULL, 0, WINHTTP_NO_REQUEST_DATA, 0, 0,
+            net::redirect_error(net::use_awaitable, ec));
+        expect(!ec.failed() >> fatal);
+        co_await h_request.async_recieve_response(
+            net::redirect_error(net::use_awaitable, ec));
+        expect(!ec.failed() >> fatal);
+        std::size_t len = co_await winnet::winhttp::async_read_body(
+            h_request, buff, mode,
+            net::redirect_error(net::use_awaitable, ec));
+        expect(!ec.failed() >> fatal);
+        expect(n == len);
+      };
+      net::co_spawn(io_context, f, net::detached);
+      io_context.restart();
+      io_context.run();
+      expect(n == body.size());
+      expect(std::all_of(body.begin(), body.end(),
+                         [](BYTE b) { return b == 'x'; }));
+      return h_request.step_count();
+    };
+
+    using winnet::winhttp::read_body_mode;
+    std::size_t query = get(L"/bytes/1000000", 1000000, read_body_mode::query);
+    std::size_t direct =
+        get(L"/bytes/1000000", 1000000, read_body_mode::direct);
+    spdlog::info("content length: query {} callbacks, direct {} callbacks",
+                 query, direct);
+    expect(direct < query);
+    query = get(L"/chunked/300000", 300000, read_body_mode::query);
+    direct = get(L"/chunked/300000", 300000, read_body_mode::direct);
+    spdlog::info("chunked: query {} callbacks, direct {} callbacks", query,
+                 direct);
+    expect(direct < query);
+  };
+
+  "StreamingUpload"_test = [] {
+    spdlog::info("winhttp_request_test - StreamingUpload test");
+    beast_server bs;
+
+    boost::system::error_code ec;
+    net::io_context io_context;
+    winnet::winhttp::basic_winhttp_session_handle<
+        net::io_context::executor_type>
+        h_session(io_context);
+    h_session.open(ec);
+    expect(!ec.failed() >> fatal);
+    winnet::winhttp::basic_winhttp_connect_handle<
+        net::io_context::executor_type>
+        h_connect(io_context);
+    h_connect.connect(h_session.native_handle(), L"localhost", 12345, ec);
+    expect(!ec.failed() >> fatal);
+
+    // posts the upload and returns the response body.
+    auto post = [&](winnet::winhttp::upload_source source) {
+      winnet::winhttp::payload pl;
+      pl.method = L"POST";
+      pl.path = L"/count";
+      pl.upload = std::move(source);
+      pl.secure = false;
+      pl.insecure_skip_verify = false;
+      winnet::winhttp::basic_winhttp_request_asio_handle<
+          net::io_context::executor_type>
+          h_request(io_context.get_executor());
+      std::vector<BYTE> body_buff;
+      auto buff = net::dynamic_buffer(body_buff);
+      winnet::winhttp::async_exec(
+          pl, h_connect, h_request, buff,
+          [&h_request](boost::system::error_code ec, std::size_t) {
+            expect(!ec.failed() >> fatal);
+            DWORD dwStatusCode = 0;
+            winnet::winhttp::header::get_status_code(h_request, ec,
+                                                     dwStatusCode);
+            expect(static_cast<DWORD>(201) == dwStatusCode);
+          });
+      io_context.restart();
+      io_context.run();
+      return winnet::winhttp::buff_to_string(buff);
+    };
+
+    // known size, sent with content length.
+    std::string a = "set_count=";
+    std::string b = "300";
+    std::array<net::const_buffer, 2> bufs{net::buffer(a), net::buffer(b)};
+    std::string resp = post(winnet::winhttp::make_buffer_upload(bufs));
+    expect(resp.find("set to 300") != std::string::npos);
+
+    // unknown size, sent chunked one byte per chunk.
+    std::string c = "set_count=400";
+    std::size_t pos = 0;
+    resp = post(winnet::winhttp::make_generator_upload(
+        [&](net::mutable_buffer buf, winnet::winhttp::upload_read_handler h) {
+          std::size_t n = (std::min)(buf.size(), c.size() - pos);
+          n = (std::min)(n, std::size_t{1});
+          std::memcpy(buf.data(), c.data() + pos, n);
+          pos += n;
+          net::post(io_context, [h, n] { h({}, n); });
+        }));
+    expect(resp.find("set to 400") != std::string::npos);
+  };
 }
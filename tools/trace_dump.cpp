@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2022 Youyuan Wu
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// trace_dump <trace file> [<json file>]
+// Converts a trace saved with boost::winasio::trace::dump to Chrome trace
+// json, for chrome://tracing or Perfetto. Writes to stdout without a json
+// file. Prints the operations still outstanding at the end of the trace to
+// stderr.
+
+#include <boost/winasio/trace.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace trace = boost::winasio::trace;
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    std::fprintf(stderr, "usage: trace_dump <trace file> [<json file>]\n");
+    return 2;
+  }
+  std::ifstream in(argv[1], std::ios::binary);
+  std::vector<trace::event> events;
+  if (!trace::read(in, events)) {
+    std::fprintf(stderr, "%s: not a winasio trace\n", argv[1]);
+    return 1;
+  }
+
+  if (argc == 3) {
+    std::ofstream out(argv[2]);
+    trace::write_chrome_json(out, events);
+    if (!out) {
+      std::fprintf(stderr, "%s: write failed\n", argv[2]);
+      return 1;
+    }
+  } else {
+    trace::write_chrome_json(std::cout, events);
+  }
+
+  // begins without an end, the usual suspects of a stall.
+  std::map<std::pair<trace::op, std::uint64_t>, const trace::event *> open;
+  for (const trace::event &e : events) {
+    auto key = std::make_pair(e.what, e.handle);
+    if (e.ph == trace::phase::begin) {
+      open[key] = &e;
+    } else if (e.ph == trace::phase::end) {
+      open.erase(key);
+    }
+  }
+  std::uint64_t last = events.empty() ? 0 : events.back().time;
+  for (const auto &kv : open) {
+    const trace::event *e = kv.second;
+    const char *name = trace::op_name(e->what);
+    std::fprintf(stderr,
+                 "outstanding: %s handle 0x%llx state %u thread %u for "
+                 "%.3fms\n",
+                 name ? name : "user",
+                 static_cast<unsigned long long>(e->handle), e->state,
+                 e->thread, (last - e->time) / 1e6);
+  }
+  return 0;
+}